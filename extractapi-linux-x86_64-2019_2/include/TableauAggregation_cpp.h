@@ -0,0 +1,707 @@
+// -----------------------------------------------------------------------
+// TableauAggregation_cpp.h
+// -----------------------------------------------------------------------
+// Hash aggregation stage that rolls rows up before they are inserted.
+
+#ifndef TableauAggregation_CPP_H
+#define TableauAggregation_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace Tableau {
+
+enum AggregateFunction
+{
+    AggregateFunction_Sum,     // null if every input value is null
+    AggregateFunction_Count,   // non-null input values, or rows if the column is -1
+    AggregateFunction_Min,
+    AggregateFunction_Max
+};
+
+enum DateTruncation
+{
+    DateTruncation_None,
+    DateTruncation_Minute,   // Type_DateTime only
+    DateTruncation_Hour,     // Type_DateTime only
+    DateTruncation_Day,
+    DateTruncation_Month,
+    DateTruncation_Year
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  GroupColumn
+
+  An input column the rows are grouped by. Date and DateTime values can be
+  truncated first, so that e.g. all events of an hour fall into one group.
+
+  ------------------------------------------------------------------------*/
+
+struct GroupColumn
+{
+    GroupColumn( int column, DateTruncation truncation = DateTruncation_None, const std::wstring& name = std::wstring() )
+        : column(column), truncation(truncation), name(name) {}
+
+    int column;                  // input column (zero-based)
+    DateTruncation truncation;
+    std::wstring name;           // output column name; empty keeps the input name
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  AggregateColumn
+
+  An output column computed over the rows of a group. SUM, MIN and MAX
+  take Type_Integer or Type_Double columns and keep their type; COUNT
+  yields Type_Integer.
+
+  ------------------------------------------------------------------------*/
+
+struct AggregateColumn
+{
+    AggregateColumn( AggregateFunction function, int column, const std::wstring& name )
+        : function(function), column(column), name(name) {}
+
+    AggregateFunction function;
+    int column;                  // input column (zero-based); -1 counts rows
+    std::wstring name;           // output column name
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  AggregationOptions
+
+  Parallelism and memory limits of an Aggregator.
+
+  ------------------------------------------------------------------------*/
+
+struct AggregationOptions
+{
+    AggregationOptions()
+        : threads(std::max( 1u, std::thread::hardware_concurrency() )),
+          partitions(64), memoryBudget(256 << 20), tempDirectory("/tmp") {}
+
+    size_t threads;              // threads AddBatch aggregates on; 1 aggregates on the calling thread
+    size_t partitions;           // hash partitions, the unit of parallelism and of spilling
+    size_t memoryBudget;         // approximate bytes the groups may take before partitions are spilled
+    std::string tempDirectory;   // the directory for spill files
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  AggregationStats
+
+  Counters of an aggregation run.
+
+  ------------------------------------------------------------------------*/
+
+struct AggregationStats
+{
+    AggregationStats() : rowsIn(0), rowsOut(0), spills(0), spilledBytes(0) {}
+
+    /// Returns how many input rows make up one output row on average.
+    double GetReduction() const { return rowsOut ? double( rowsIn ) / rowsOut : 0; }
+
+    size_t rowsIn;
+    size_t rowsOut;              // groups emitted by Drain
+    size_t spills;               // partitions written to spill files
+    size_t spilledBytes;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  Aggregator
+
+  Rolls rows up by a list of group columns before they are inserted, so
+  an extract that only serves hourly totals does not receive every raw
+  event. Output rows hold the group columns followed by the aggregate
+  columns; <b>GetOutputColumns</b> describes them for the output table.
+
+  Rows are spread over hash partitions by their serialized group key.
+  Each partition is an open-addressing table of 16-byte slots holding the
+  key hash and a group number, with the keys in one arena and the
+  aggregate states of a group next to each other, so a lookup usually
+  touches one slot line and one state line. <b>AddBatch</b> serializes
+  and hashes keys on all threads, then lets every thread update its own
+  partitions without locks. When the groups exceed the memory budget,
+  the largest partitions are written to spill files as partial states
+  and merged back by <b>Drain</b>, one partition at a time; a single
+  partition has to fit in memory.
+
+  Groups come out in no particular order.
+
+  ------------------------------------------------------------------------*/
+
+class Aggregator
+{
+  public:
+    /// Initializes an empty aggregator.
+    /// @param inputColumns The columns of the input rows.
+    /// @param groups The columns to group by; without any, all rows form one group.
+    /// @param aggregates The aggregates to compute per group.
+    /// @param options Parallelism and memory limits.
+    Aggregator(
+        const std::vector<ColumnSpec>& inputColumns,
+        const std::vector<GroupColumn>& groups,
+        const std::vector<AggregateColumn>& aggregates,
+        const AggregationOptions& options = AggregationOptions()
+    );
+
+    /// Removes any remaining spill files.
+    ~Aggregator();
+
+    /// Returns the columns of the output rows.
+    const std::vector<ColumnSpec>& GetOutputColumns() const { return m_outputColumns; }
+
+    /// Adds a row on the calling thread.
+    void Add( const ValueRow& row );
+
+    /// Adds a batch of rows, on all threads if it is large enough.
+    void AddBatch( const std::vector<ValueRow>& rows );
+
+    /// Calls sink( const ValueRow& ) for every group. The aggregator is empty afterwards.
+    template <class Sink>
+    void Drain( Sink sink );
+
+    /// Inserts one row per group into the table. The aggregator is empty afterwards.
+    /// @param table The table to insert into; its columns must match <b>GetOutputColumns</b>.
+    void Insert( Table& table );
+
+    /// Returns the counters.
+    const AggregationStats& GetStats() const { return m_stats; }
+
+  private:
+    struct State
+    {
+        State() : integer(0), count(0) {}
+
+        union {
+            int64_t integer;
+            double real;
+        };
+        int64_t count;           // input values folded in
+    };
+
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t group;          // plus one; zero marks an empty slot
+    };
+
+    struct Partition
+    {
+        Partition() : slots(16) {}
+
+        size_t GetBytes() const
+        {
+            return slots.size() * sizeof( Slot ) + keys.capacity() + keyEnds.capacity() * sizeof( uint64_t )
+                + states.capacity() * sizeof( State );
+        }
+
+        std::vector<Slot> slots;
+        std::string keys;
+        std::vector<uint64_t> keyEnds;   // end of each group's key in keys
+        std::vector<State> states;       // one per aggregate and group
+        std::vector<std::string> spills;
+    };
+
+    // A row of the current batch, routed to a partition.
+    struct RoutedRow
+    {
+        uint64_t hash;
+        uint32_t row;
+        uint32_t keyBegin;
+        uint32_t keyEnd;
+    };
+
+    struct Worker
+    {
+        std::string keys;
+        std::vector<std::vector<RoutedRow> > partitions;
+    };
+
+    size_t PartitionOf( uint64_t hash ) const { return static_cast<size_t>( ( ( hash >> 32 ) * m_partitions.size() ) >> 32 ); }
+    uint64_t AppendKey( const ValueRow& row, std::string& key ) const;
+    State* FindOrAdd( Partition& partition, uint64_t hash, const char* key, size_t size );
+    void Grow( Partition& partition );
+    void Update( State* states, const ValueRow& row ) const;
+    void Merge( State* states, const State* partial ) const;
+    void SetResult( Value& value, size_t aggregate, const State& state ) const;
+    void RunOnWorkers( const std::function<void( size_t )>& task );
+    void SpillIfNeeded();
+    void Spill( Partition& partition );
+    void LoadSpills( Partition& partition );
+    void Throw( const wchar_t* message ) const;
+
+    std::vector<GroupColumn> m_groups;
+    std::vector<AggregateColumn> m_aggregates;
+    std::vector<char> m_realAggregates;   // aggregate over a Type_Double column
+    std::vector<ColumnSpec> m_outputColumns;
+    AggregationOptions m_options;
+    std::vector<Partition> m_partitions;
+    std::vector<Worker> m_workers;
+    std::unique_ptr<ThreadPool> m_pool;
+    std::string m_key;
+    AggregationStats m_stats;
+
+    // Forbidden:
+    Aggregator( const Aggregator& );
+    Aggregator& operator=( const Aggregator& );
+};
+
+namespace {
+
+    // Sets the parts of a Date or DateTime value below the truncation unit to
+    // their first value.
+    inline void TruncateDate( Value& value, DateTruncation truncation )
+    {
+        if ( truncation == DateTruncation_None || value.IsNull() )
+            return;
+
+        int year, month, day, hour = 0, min = 0, sec = 0, frac = 0;
+        if ( value.GetType() == Type_Date )
+            value.GetDate( year, month, day );
+        else
+            value.GetDateTime( year, month, day, hour, min, sec, frac );
+
+        switch ( truncation ) {
+            case DateTruncation_Year:
+                month = 1;
+                // fall through
+            case DateTruncation_Month:
+                day = 1;
+                // fall through
+            case DateTruncation_Day:
+                hour = 0;
+                // fall through
+            case DateTruncation_Hour:
+                min = 0;
+                // fall through
+            default:
+                sec = 0;
+                frac = 0;
+                break;
+        }
+
+        if ( value.GetType() == Type_Date )
+            value.SetDate( year, month, day );
+        else
+            value.SetDateTime( year, month, day, hour, min, sec, frac );
+    }
+}
+
+// -----------------------------------------------------------------------
+// Aggregator methods
+// -----------------------------------------------------------------------
+
+inline Aggregator::Aggregator(
+    const std::vector<ColumnSpec>& inputColumns,
+    const std::vector<GroupColumn>& groups,
+    const std::vector<AggregateColumn>& aggregates,
+    const AggregationOptions& options
+) : m_groups(groups),
+    m_aggregates(aggregates),
+    m_options(options),
+    m_partitions(std::max<size_t>( 1, options.partitions ))
+{
+    for ( size_t i = 0; i < m_groups.size(); ++i ) {
+        const GroupColumn& group = m_groups[i];
+        if ( group.column < 0 || static_cast<size_t>( group.column ) >= inputColumns.size() )
+            throw TableauException( TAB_RESULT_BadIndex, L"Group column out of range" );
+        const ColumnSpec& input = inputColumns[group.column];
+        const bool date = input.type == Type_Date || input.type == Type_DateTime;
+        const bool time = group.truncation == DateTruncation_Minute || group.truncation == DateTruncation_Hour;
+        if ( group.truncation != DateTruncation_None && ( !date || ( time && input.type != Type_DateTime ) ) )
+            throw TableauException( TAB_RESULT_InvalidArgument, L"Column " + input.name + L" cannot be truncated to that unit" );
+        m_outputColumns.push_back( ColumnSpec( group.name.empty() ? input.name : group.name, input.type, input.collation ) );
+    }
+
+    for ( size_t i = 0; i < m_aggregates.size(); ++i ) {
+        const AggregateColumn& aggregate = m_aggregates[i];
+        const bool count = aggregate.function == AggregateFunction_Count;
+        if ( aggregate.column < ( count ? -1 : 0 ) || aggregate.column >= static_cast<int>( inputColumns.size() ) )
+            throw TableauException( TAB_RESULT_BadIndex, L"Aggregate column out of range in " + aggregate.name );
+        const Type type = aggregate.column < 0 ? Type_Integer : inputColumns[aggregate.column].type;
+        if ( !count && type != Type_Integer && type != Type_Double )
+            throw TableauException( TAB_RESULT_InvalidArgument, L"Aggregate " + aggregate.name + L" needs an integer or double column" );
+        m_realAggregates.push_back( !count && type == Type_Double );
+        m_outputColumns.push_back( ColumnSpec( aggregate.name, count ? Type_Integer : type ) );
+    }
+
+    if ( m_options.threads > 1 ) {
+        m_workers.resize( m_options.threads );
+        for ( size_t w = 0; w < m_workers.size(); ++w )
+            m_workers[w].partitions.resize( m_partitions.size() );
+        m_pool.reset( new ThreadPool( m_options.threads - 1 ) );
+    }
+}
+
+inline Aggregator::~Aggregator()
+{
+    for ( size_t p = 0; p < m_partitions.size(); ++p ) {
+        for ( size_t i = 0; i < m_partitions[p].spills.size(); ++i )
+            std::remove( m_partitions[p].spills[i].c_str() );
+    }
+}
+
+inline void Aggregator::Add( const ValueRow& row )
+{
+    m_key.clear();
+    const uint64_t hash = AppendKey( row, m_key );
+    Update( FindOrAdd( m_partitions[PartitionOf( hash )], hash, m_key.data(), m_key.size() ), row );
+    if ( ++m_stats.rowsIn % 4096 == 0 )
+        SpillIfNeeded();
+}
+
+inline void Aggregator::AddBatch( const std::vector<ValueRow>& rows )
+{
+    const size_t threads = m_workers.size();
+    if ( threads < 2 || rows.size() < 64 * threads ) {
+        for ( size_t i = 0; i < rows.size(); ++i )
+            Add( rows[i] );
+        return;
+    }
+
+    // Every worker serializes and hashes the keys of one slice of the batch
+    // and routes its rows to the partitions.
+    const size_t slice = ( rows.size() + threads - 1 ) / threads;
+    RunOnWorkers( [this, &rows, slice]( size_t w ) {
+        Worker& worker = m_workers[w];
+        worker.keys.clear();
+        for ( size_t p = 0; p < worker.partitions.size(); ++p )
+            worker.partitions[p].clear();
+        const size_t end = std::min( rows.size(), ( w + 1 ) * slice );
+        for ( size_t r = w * slice; r < end; ++r ) {
+            RoutedRow routed;
+            routed.row = static_cast<uint32_t>( r );
+            routed.keyBegin = static_cast<uint32_t>( worker.keys.size() );
+            routed.hash = AppendKey( rows[r], worker.keys );
+            routed.keyEnd = static_cast<uint32_t>( worker.keys.size() );
+            worker.partitions[PartitionOf( routed.hash )].push_back( routed );
+        }
+    } );
+
+    // Every worker then owns every threads-th partition and folds in the
+    // rows all slices routed to it, so no partition is shared.
+    RunOnWorkers( [this, &rows, threads]( size_t w ) {
+        for ( size_t p = w; p < m_partitions.size(); p += threads ) {
+            for ( size_t s = 0; s < threads; ++s ) {
+                const Worker& source = m_workers[s];
+                const std::vector<RoutedRow>& routed = source.partitions[p];
+                for ( size_t i = 0; i < routed.size(); ++i ) {
+                    const RoutedRow& r = routed[i];
+                    Update( FindOrAdd( m_partitions[p], r.hash, source.keys.data() + r.keyBegin, r.keyEnd - r.keyBegin ), rows[r.row] );
+                }
+            }
+        }
+    } );
+
+    m_stats.rowsIn += rows.size();
+    SpillIfNeeded();
+}
+
+inline uint64_t Aggregator::AppendKey( const ValueRow& row, std::string& key ) const
+{
+    const size_t begin = key.size();
+    for ( size_t i = 0; i < m_groups.size(); ++i ) {
+        const GroupColumn& group = m_groups[i];
+        if ( group.truncation == DateTruncation_None ) {
+            row[group.column].Serialize( key );
+        }
+        else {
+            Value truncated = row[group.column];
+            TruncateDate( truncated, group.truncation );
+            truncated.Serialize( key );
+        }
+    }
+    return HashBytes( key.data() + begin, key.size() - begin );
+}
+
+inline Aggregator::State* Aggregator::FindOrAdd( Partition& partition, uint64_t hash, const char* key, size_t size )
+{
+    const size_t stride = m_aggregates.size();
+    const size_t mask = partition.slots.size() - 1;
+    size_t i = hash & mask;
+    for ( ; partition.slots[i].group != 0; i = ( i + 1 ) & mask ) {
+        if ( partition.slots[i].hash != hash )
+            continue;
+        const size_t group = partition.slots[i].group - 1;
+        const size_t begin = group ? partition.keyEnds[group - 1] : 0;
+        if ( partition.keyEnds[group] - begin == size && std::memcmp( partition.keys.data() + begin, key, size ) == 0 )
+            return partition.states.data() + group * stride;
+    }
+
+    const size_t group = partition.keyEnds.size();
+    partition.slots[i].hash = hash;
+    partition.slots[i].group = group + 1;
+    partition.keys.append( key, size );
+    partition.keyEnds.push_back( partition.keys.size() );
+    partition.states.resize( partition.states.size() + stride );
+    if ( 2 * ( group + 1 ) > partition.slots.size() )
+        Grow( partition );
+    return partition.states.data() + group * stride;
+}
+
+inline void Aggregator::Grow( Partition& partition )
+{
+    std::vector<Slot> old( partition.slots.size() * 2 );
+    old.swap( partition.slots );
+    const size_t mask = partition.slots.size() - 1;
+    for ( size_t s = 0; s < old.size(); ++s ) {
+        if ( old[s].group == 0 )
+            continue;
+        size_t i = old[s].hash & mask;
+        while ( partition.slots[i].group != 0 )
+            i = ( i + 1 ) & mask;
+        partition.slots[i] = old[s];
+    }
+}
+
+inline void Aggregator::Update( State* states, const ValueRow& row ) const
+{
+    for ( size_t a = 0; a < m_aggregates.size(); ++a ) {
+        const AggregateColumn& aggregate = m_aggregates[a];
+        State& state = states[a];
+        if ( aggregate.column < 0 ) {
+            ++state.count;
+            continue;
+        }
+        const Value& value = row[aggregate.column];
+        if ( value.IsNull() )
+            continue;
+
+        const bool real = m_realAggregates[a] != 0;
+        switch ( aggregate.function ) {
+            case AggregateFunction_Sum:
+                if ( real )
+                    state.real += value.GetDouble();
+                else
+                    state.integer += value.GetInteger();
+                break;
+            case AggregateFunction_Min:
+            case AggregateFunction_Max: {
+                const bool min = aggregate.function == AggregateFunction_Min;
+                if ( real ) {
+                    const double x = value.GetDouble();
+                    if ( state.count == 0 || ( min ? x < state.real : x > state.real ) )
+                        state.real = x;
+                }
+                else {
+                    const int64_t x = value.GetInteger();
+                    if ( state.count == 0 || ( min ? x < state.integer : x > state.integer ) )
+                        state.integer = x;
+                }
+                break;
+            }
+            case AggregateFunction_Count:
+                break;
+        }
+        ++state.count;
+    }
+}
+
+inline void Aggregator::Merge( State* states, const State* partial ) const
+{
+    for ( size_t a = 0; a < m_aggregates.size(); ++a ) {
+        State& state = states[a];
+        const State& other = partial[a];
+        if ( other.count == 0 )
+            continue;
+
+        const bool real = m_realAggregates[a] != 0;
+        switch ( m_aggregates[a].function ) {
+            case AggregateFunction_Sum:
+                if ( real )
+                    state.real += other.real;
+                else
+                    state.integer += other.integer;
+                break;
+            case AggregateFunction_Min:
+            case AggregateFunction_Max: {
+                const bool min = m_aggregates[a].function == AggregateFunction_Min;
+                const bool better = real ? ( min ? other.real < state.real : other.real > state.real )
+                                         : ( min ? other.integer < state.integer : other.integer > state.integer );
+                if ( state.count == 0 || better )
+                    state.integer = other.integer;   // copies doubles bit for bit, too
+                break;
+            }
+            case AggregateFunction_Count:
+                break;
+        }
+        state.count += other.count;
+    }
+}
+
+inline void Aggregator::SetResult( Value& value, size_t aggregate, const State& state ) const
+{
+    if ( m_aggregates[aggregate].function == AggregateFunction_Count )
+        value.SetInteger( state.count );
+    else if ( state.count == 0 )
+        value.SetNull( m_realAggregates[aggregate] ? Type_Double : Type_Integer );
+    else if ( m_realAggregates[aggregate] )
+        value.SetDouble( state.real );
+    else
+        value.SetInteger( state.integer );
+}
+
+inline void Aggregator::RunOnWorkers( const std::function<void( size_t )>& task )
+{
+    // Worker 0 runs on the calling thread.
+    std::vector<std::future<void> > done;
+    for ( size_t w = 1; w < m_workers.size(); ++w )
+        done.push_back( m_pool->Submit( [&task, w] { task( w ); } ) );
+    task( 0 );
+    for ( size_t i = 0; i < done.size(); ++i )
+        done[i].get();
+}
+
+inline void Aggregator::SpillIfNeeded()
+{
+    size_t bytes = 0;
+    for ( size_t p = 0; p < m_partitions.size(); ++p )
+        bytes += m_partitions[p].GetBytes();
+
+    // Spill the largest partitions until the rest fit; small partitions are
+    // not worth a file.
+    while ( bytes > m_options.memoryBudget ) {
+        size_t largest = 0;
+        for ( size_t p = 1; p < m_partitions.size(); ++p ) {
+            if ( m_partitions[p].keyEnds.size() > m_partitions[largest].keyEnds.size() )
+                largest = p;
+        }
+        if ( m_partitions[largest].keyEnds.size() < 64 )
+            break;
+        const size_t before = m_partitions[largest].GetBytes();
+        Spill( m_partitions[largest] );
+        bytes -= before - m_partitions[largest].GetBytes();
+    }
+}
+
+// Layout: for every group a varint key length, the key and the raw states.
+inline void Aggregator::Spill( Partition& partition )
+{
+    std::string path = m_options.tempDirectory + "/tableau-aggregate-XXXXXX";
+    const int fd = mkstemp( &path[0] );
+    std::FILE* file = fd < 0 ? nullptr : fdopen( fd, "wb" );
+    if ( file == nullptr )
+        Throw( L"Could not create an aggregation spill file" );
+
+    const size_t stride = m_aggregates.size();
+    const size_t groups = partition.keyEnds.size();
+    bool ok = true;
+    std::string buffer;
+    for ( size_t g = 0; ok && g < groups; ++g ) {
+        const size_t begin = g ? partition.keyEnds[g - 1] : 0;
+        AppendVarint( buffer, partition.keyEnds[g] - begin );
+        buffer.append( partition.keys, begin, partition.keyEnds[g] - begin );
+        buffer.append( reinterpret_cast<const char*>( partition.states.data() + g * stride ), stride * sizeof( State ) );
+        if ( buffer.size() >= ( 1 << 20 ) || g + 1 == groups ) {
+            ok = std::fwrite( buffer.data(), 1, buffer.size(), file ) == buffer.size();
+            m_stats.spilledBytes += buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = std::fclose( file ) == 0 && ok;
+    if ( !ok ) {
+        std::remove( path.c_str() );
+        Throw( L"Could not write an aggregation spill file" );
+    }
+    partition.spills.push_back( path );
+    ++m_stats.spills;
+
+    const std::vector<std::string> spills( partition.spills );
+    partition = Partition();
+    partition.spills = spills;
+}
+
+inline void Aggregator::LoadSpills( Partition& partition )
+{
+    const size_t stride = m_aggregates.size();
+    std::vector<State> partial( stride );
+    std::string data;
+    for ( size_t i = 0; i < partition.spills.size(); ++i ) {
+        std::FILE* file = std::fopen( partition.spills[i].c_str(), "rb" );
+        if ( file == nullptr )
+            Throw( L"Could not open an aggregation spill file" );
+        data.clear();
+        char chunk[1 << 16];
+        size_t read;
+        while ( ( read = std::fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+            data.append( chunk, read );
+        const bool failed = std::ferror( file ) != 0;
+        std::fclose( file );
+        if ( failed )
+            Throw( L"Could not read an aggregation spill file" );
+
+        const char* pos = data.data();
+        const char* end = pos + data.size();
+        while ( pos != end ) {
+            uint64_t size;
+            if ( !ReadVarint( pos, end, size ) || static_cast<uint64_t>( end - pos ) < size + stride * sizeof( State ) )
+                throw TableauException( TAB_RESULT_InvalidFile, L"Corrupt aggregation spill file" );
+            const char* key = pos;
+            pos += size;
+            std::memcpy( partial.data(), pos, stride * sizeof( State ) );
+            pos += stride * sizeof( State );
+            Merge( FindOrAdd( partition, HashBytes( key, size ), key, size ), partial.data() );
+        }
+        std::remove( partition.spills[i].c_str() );
+    }
+    partition.spills.clear();
+}
+
+template <class Sink>
+inline void Aggregator::Drain( Sink sink )
+{
+    const size_t stride = m_aggregates.size();
+    ValueRow row( m_outputColumns.size() );
+    for ( size_t p = 0; p < m_partitions.size(); ++p ) {
+        Partition& partition = m_partitions[p];
+        LoadSpills( partition );
+        for ( size_t g = 0; g < partition.keyEnds.size(); ++g ) {
+            const char* pos = partition.keys.data() + ( g ? partition.keyEnds[g - 1] : 0 );
+            const char* end = partition.keys.data() + partition.keyEnds[g];
+            for ( size_t c = 0; c < m_groups.size(); ++c )
+                row[c].Deserialize( pos, end );
+            for ( size_t a = 0; a < stride; ++a )
+                SetResult( row[m_groups.size() + a], a, partition.states[g * stride + a] );
+            sink( const_cast<const ValueRow&>( row ) );
+            ++m_stats.rowsOut;
+        }
+        partition = Partition();
+    }
+}
+
+inline void Aggregator::Insert( Table& table )
+{
+    std::shared_ptr<TableDefinition> schema = table.GetTableDefinition();
+    Row row( *schema );
+    Drain( [&table, &row]( const ValueRow& values ) {
+        for ( size_t i = 0; i < values.size(); ++i )
+            values[i].SetInRow( row, static_cast<int>( i ) );
+        table.Insert( row );
+    } );
+}
+
+inline void Aggregator::Throw( const wchar_t* message ) const
+{
+    throw TableauException( errno != 0 ? errno : TAB_RESULT_InternalError, message );
+}
+
+} // namespace Tableau
+#endif // TableauAggregation_CPP_H
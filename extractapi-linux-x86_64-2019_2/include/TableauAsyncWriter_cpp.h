@@ -0,0 +1,508 @@
+// -----------------------------------------------------------------------
+// TableauAsyncWriter_cpp.h
+// -----------------------------------------------------------------------
+// Awaitable extract writer for C++20 coroutines.
+
+#ifndef TableauAsyncWriter_CPP_H
+#define TableauAsyncWriter_CPP_H
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "TableauCancellation_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauValue_cpp.h"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  SdkExecutor
+
+  A few threads that make all blocking Extract API calls on behalf of
+  coroutines. Each thread has a bounded queue of work. Queueing work only
+  suspends the calling coroutine while that queue is full; queued work
+  then takes the slots in the order the coroutines arrived.
+
+  Suspended coroutines are resumed through the resumer given to the
+  constructor, e.g. by posting them back to the event loop they came from.
+  Without a resumer they resume on the executor thread.
+
+  ------------------------------------------------------------------------*/
+
+class SdkExecutor
+{
+  public:
+    typedef std::function<void()> Work;
+    typedef std::function<void( std::coroutine_handle<> )> Resumer;
+
+  private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        Work* work;
+    };
+
+    struct Lane
+    {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Work> queue;
+        std::deque<Waiter> waiters;
+        std::thread thread;
+        bool stopping;
+    };
+
+  public:
+    /*--------------------------------------------------------------------
+      Awaitable returned by Post: queues the work, suspending only while
+      the lane's queue is full.
+      --------------------------------------------------------------------*/
+    class PostAwaiter
+    {
+      public:
+        PostAwaiter( SdkExecutor& executor, Lane& lane, Work work )
+            : m_executor(executor), m_lane(lane), m_work(std::move( work )) {}
+
+        bool await_ready() { return m_executor.TryPush( m_lane, m_work ); }
+        bool await_suspend( std::coroutine_handle<> handle ) { return m_executor.PushOrWait( m_lane, m_work, handle ); }
+        void await_resume() {}
+
+      private:
+        SdkExecutor& m_executor;
+        Lane& m_lane;
+        Work m_work;
+    };
+
+    /*--------------------------------------------------------------------
+      Awaitable returned by Run: queues the work and suspends until it has
+      run. Rethrows what the work threw.
+      --------------------------------------------------------------------*/
+    class RunAwaiter
+    {
+      public:
+        RunAwaiter( SdkExecutor& executor, Lane& lane, Work work )
+            : m_executor(executor), m_lane(lane), m_work(std::move( work )) {}
+
+        bool await_ready() { return false; }
+        bool await_suspend( std::coroutine_handle<> handle )
+        {
+            Work work = std::move( m_work );
+            m_work = [this, work, handle] {
+                try {
+                    work();
+                }
+                catch ( ... ) {
+                    m_error = std::current_exception();
+                }
+                m_executor.Resume( handle );
+            };
+            // Suspends in any case; the wrapped work resumes the coroutine.
+            m_executor.PushOrWait( m_lane, m_work, std::coroutine_handle<>() );
+            return true;
+        }
+        void await_resume()
+        {
+            if ( m_error )
+                std::rethrow_exception( m_error );
+        }
+
+      private:
+        SdkExecutor& m_executor;
+        Lane& m_lane;
+        Work m_work;
+        std::exception_ptr m_error;
+    };
+
+    /// Starts the threads.
+    /// @param threads The number of executor threads.
+    /// @param capacity The number of queued work items per thread before callers suspend.
+    /// @param resumer Resumes suspended coroutines; resumes them on the executor thread if empty.
+    SdkExecutor( size_t threads = 1, size_t capacity = 64, Resumer resumer = Resumer() );
+
+    /// Runs the queued work and joins the threads. Coroutines must not be suspended on the executor any more.
+    ~SdkExecutor();
+
+    /// Returns the lane for a new writer; lanes are handed out round robin. All work of one writer must go to one lane so it runs in order.
+    size_t AssignLane() { return m_next++ % m_lanes.size(); }
+
+    /// Queues work on a lane. co_await the result; it suspends only while the lane is full. The work must not throw.
+    PostAwaiter Post( size_t lane, Work work ) { return PostAwaiter( *this, *m_lanes[lane], std::move( work ) ); }
+
+    /// Queues work on a lane. co_await the result; it resumes after the work has run and rethrows its exception.
+    RunAwaiter Run( size_t lane, Work work ) { return RunAwaiter( *this, *m_lanes[lane], std::move( work ) ); }
+
+    /// Returns the number of times a coroutine had to suspend because a queue was full.
+    size_t GetSuspendCount() const { return m_suspends; }
+
+  private:
+    bool TryPush( Lane& lane, Work& work );
+    bool PushOrWait( Lane& lane, Work& work, std::coroutine_handle<> handle );
+    void Resume( std::coroutine_handle<> handle );
+    void Execute( Lane& lane );
+
+    std::vector<std::unique_ptr<Lane> > m_lanes;
+    size_t m_capacity;
+    Resumer m_resumer;
+    std::atomic<size_t> m_next;
+    std::atomic<size_t> m_suspends;
+
+    // Forbidden:
+    SdkExecutor( const SdkExecutor& );
+    SdkExecutor& operator=( const SdkExecutor& );
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  AsyncExtractWriter
+
+  Writes one extract with one table from a coroutine. The extract is
+  created, filled and closed on the writer's SdkExecutor lane; the
+  coroutine only hands over batches.
+
+      AsyncExtractWriter writer( executor, L"orders.hyper", L"Extract", columns );
+      co_await writer.InsertBatch( std::move( batch ) );
+      ...
+      co_await writer.Close();
+
+  An error while inserting is kept and rethrown by the next InsertBatch
+  or by Close; the batches after it are dropped, and the partial extract
+  is closed and deleted on the lane right away. If the extract could be
+  created but not its table, it is closed and kept, as the file may have
+  existed before.
+
+  The cancellation token is checked on the lane before every batch. Once
+  it is cancelled, the partial extract is closed and deleted right away,
+  the remaining batches are dropped and InsertBatch and Close throw a
+  TableauException with TAB_RESULT_Cancelled. GetInsertedRows still tells
+  how far the load got.
+
+  ------------------------------------------------------------------------*/
+
+class AsyncExtractWriter
+{
+  public:
+    /// Initializes a writer. Nothing is created until the first batch runs.
+    /// @param executor The executor to run the Extract API calls on.
+    /// @param path The extract to create.
+    /// @param tableName The table to create.
+    /// @param columns The columns of the table.
+    /// @param token Stops the writer between batches and discards the extract.
+    AsyncExtractWriter(
+        SdkExecutor& executor,
+        const std::wstring& path,
+        const std::wstring& tableName,
+        const std::vector<ColumnSpec>& columns,
+        const CancellationToken& token = CancellationToken()
+    );
+
+    /// Queues a batch of rows. co_await the result; it suspends only while the executor's queue is full.
+    SdkExecutor::PostAwaiter InsertBatch( std::vector<ValueRow> batch );
+
+    /// Inserts the queued batches and closes the extract. co_await the result; it resumes once the extract has been saved.
+    SdkExecutor::RunAwaiter Close();
+
+    /// Returns the number of rows inserted so far.
+    uint64_t GetInsertedRows() const { return m_state->inserted; }
+
+    /// Returns true once the writer was cancelled or failed and its partial extract deleted.
+    bool IsDiscarded() const { return m_state->discarded; }
+
+  private:
+    // Touched only on the executor lane, apart from the error and the counter.
+    struct State
+    {
+        std::wstring path;
+        std::wstring tableName;
+        std::vector<ColumnSpec> columns;
+        std::unique_ptr<Extract> extract;
+        std::unique_ptr<TableDefinition> tableDefinition;
+        std::shared_ptr<Table> table;
+        std::unique_ptr<Row> row;
+        CancellationToken token;
+        std::mutex mutex;
+        std::exception_ptr error;
+        std::atomic<uint64_t> inserted;
+        std::atomic<bool> discarded;
+    };
+
+    void ThrowPendingError();
+    static bool Discard( State& state );
+    static void Abandon( State& state );
+
+    SdkExecutor& m_executor;
+    size_t m_lane;
+    std::shared_ptr<State> m_state;
+
+    // Forbidden:
+    AsyncExtractWriter( const AsyncExtractWriter& );
+    AsyncExtractWriter& operator=( const AsyncExtractWriter& );
+};
+
+// -----------------------------------------------------------------------
+// SdkExecutor methods
+// -----------------------------------------------------------------------
+
+inline SdkExecutor::SdkExecutor(
+    size_t threads,
+    size_t capacity,
+    Resumer resumer
+) : m_capacity(capacity ? capacity : 1),
+    m_resumer(std::move( resumer )),
+    m_next(0),
+    m_suspends(0)
+{
+    for ( size_t i = 0; i < ( threads ? threads : 1 ); ++i ) {
+        m_lanes.push_back( std::unique_ptr<Lane>( new Lane() ) );
+        m_lanes.back()->stopping = false;
+    }
+    for ( size_t i = 0; i < m_lanes.size(); ++i )
+        m_lanes[i]->thread = std::thread( &SdkExecutor::Execute, this, std::ref( *m_lanes[i] ) );
+}
+
+inline SdkExecutor::~SdkExecutor()
+{
+    for ( size_t i = 0; i < m_lanes.size(); ++i ) {
+        {
+            std::lock_guard<std::mutex> lock( m_lanes[i]->mutex );
+            m_lanes[i]->stopping = true;
+        }
+        m_lanes[i]->wake.notify_all();
+    }
+    for ( size_t i = 0; i < m_lanes.size(); ++i )
+        m_lanes[i]->thread.join();
+}
+
+inline bool SdkExecutor::TryPush( Lane& lane, Work& work )
+{
+    {
+        std::lock_guard<std::mutex> lock( lane.mutex );
+        if ( lane.queue.size() >= m_capacity || !lane.waiters.empty() )
+            return false;
+        lane.queue.push_back( std::move( work ) );
+    }
+    lane.wake.notify_one();
+    return true;
+}
+
+// Queues the work if there is room and returns false; otherwise registers
+// the coroutine, whose work the executor queues when a slot frees up, and
+// returns true. A null handle registers without resuming anything.
+inline bool SdkExecutor::PushOrWait( Lane& lane, Work& work, std::coroutine_handle<> handle )
+{
+    {
+        std::lock_guard<std::mutex> lock( lane.mutex );
+        if ( lane.queue.size() >= m_capacity || !lane.waiters.empty() ) {
+            Waiter waiter = { handle, &work };
+            lane.waiters.push_back( waiter );
+            if ( handle )
+                ++m_suspends;
+            return true;
+        }
+        lane.queue.push_back( std::move( work ) );
+    }
+    lane.wake.notify_one();
+    return false;
+}
+
+inline void SdkExecutor::Resume( std::coroutine_handle<> handle )
+{
+    if ( m_resumer )
+        m_resumer( handle );
+    else
+        handle.resume();
+}
+
+inline void SdkExecutor::Execute( Lane& lane )
+{
+    for ( ;; ) {
+        Work work;
+        std::coroutine_handle<> admitted;
+        {
+            std::unique_lock<std::mutex> lock( lane.mutex );
+            lane.wake.wait( lock, [&lane] { return lane.stopping || !lane.queue.empty(); } );
+            if ( lane.queue.empty() )
+                return;
+            work = std::move( lane.queue.front() );
+            lane.queue.pop_front();
+
+            // Hand the free slot to the longest waiting coroutine.
+            if ( !lane.waiters.empty() ) {
+                Waiter waiter = lane.waiters.front();
+                lane.waiters.pop_front();
+                lane.queue.push_back( std::move( *waiter.work ) );
+                admitted = waiter.handle;
+            }
+        }
+        if ( admitted )
+            Resume( admitted );
+        work();
+    }
+}
+
+// -----------------------------------------------------------------------
+// AsyncExtractWriter methods
+// -----------------------------------------------------------------------
+
+inline AsyncExtractWriter::AsyncExtractWriter(
+    SdkExecutor& executor,
+    const std::wstring& path,
+    const std::wstring& tableName,
+    const std::vector<ColumnSpec>& columns,
+    const CancellationToken& token
+) : m_executor(executor),
+    m_lane(executor.AssignLane()),
+    m_state(std::make_shared<State>())
+{
+    m_state->path = path;
+    m_state->tableName = tableName;
+    m_state->columns = columns;
+    m_state->token = token;
+    m_state->inserted = 0;
+    m_state->discarded = false;
+}
+
+inline void AsyncExtractWriter::ThrowPendingError()
+{
+    std::lock_guard<std::mutex> lock( m_state->mutex );
+    if ( m_state->error )
+        std::rethrow_exception( m_state->error );
+}
+
+// Runs on the lane. If the token is cancelled, records the cancellation as
+// the writer's error, then closes and deletes the partial extract.
+inline bool AsyncExtractWriter::Discard( State& state )
+{
+    if ( !state.token.IsCancelled() )
+        return false;
+    {
+        std::lock_guard<std::mutex> lock( state.mutex );
+        if ( !state.error )
+            state.error = std::make_exception_ptr( TableauException( TAB_RESULT_Cancelled, state.token.GetMessage() ) );
+    }
+    Abandon( state );
+    state.discarded = true;
+    return true;
+}
+
+// Runs on the lane after the writer was cancelled or failed. Closes the
+// extract, so it is not saved later by whichever thread drops the state,
+// and deletes it unless its table was never added.
+inline void AsyncExtractWriter::Abandon( State& state )
+{
+    const bool added = state.table != nullptr;
+    state.row.reset();
+    state.table.reset();
+    if ( state.extract ) {
+        try {
+            state.extract->Close();
+        }
+        catch ( ... ) {
+            // The file is deleted either way.
+        }
+        state.extract.reset();
+        if ( added ) {
+            RemoveFile( state.path );
+            state.discarded = true;
+        }
+    }
+}
+
+inline SdkExecutor::PostAwaiter
+AsyncExtractWriter::InsertBatch(
+    std::vector<ValueRow> batch
+)
+{
+    ThrowPendingError();
+    std::shared_ptr<State> state = m_state;
+    std::shared_ptr<std::vector<ValueRow> > rows = std::make_shared<std::vector<ValueRow> >( std::move( batch ) );
+    return m_executor.Post( m_lane, [state, rows] {
+        {
+            std::lock_guard<std::mutex> lock( state->mutex );
+            if ( state->error )
+                return;
+        }
+        if ( Discard( *state ) )
+            return;
+        try {
+            if ( !state->extract ) {
+                state->extract.reset( new Extract( state->path ) );
+                state->tableDefinition.reset( new TableDefinition() );
+                AddColumns( *state->tableDefinition, state->columns );
+                state->table = state->extract->AddTable( state->tableName, *state->tableDefinition );
+                state->row.reset( new Row( *state->tableDefinition ) );
+            }
+            for ( size_t r = 0; r < rows->size(); ++r ) {
+                const ValueRow& values = ( *rows )[r];
+                for ( size_t c = 0; c < values.size(); ++c )
+                    values[c].SetInRow( *state->row, static_cast<int>( c ) );
+                state->table->Insert( *state->row );
+            }
+            state->inserted += rows->size();
+        }
+        catch ( ... ) {
+            {
+                std::lock_guard<std::mutex> lock( state->mutex );
+                state->error = std::current_exception();
+            }
+            Abandon( *state );
+        }
+    } );
+}
+
+inline SdkExecutor::RunAwaiter AsyncExtractWriter::Close()
+{
+    std::shared_ptr<State> state = m_state;
+    return m_executor.Run( m_lane, [state] {
+        {
+            std::lock_guard<std::mutex> lock( state->mutex );
+            if ( state->error )
+                std::rethrow_exception( state->error );
+        }
+        if ( Discard( *state ) )
+            std::rethrow_exception( state->error );
+        try {
+            if ( !state->extract ) {
+                // No rows: still create the extract with its empty table.
+                state->extract.reset( new Extract( state->path ) );
+                state->tableDefinition.reset( new TableDefinition() );
+                AddColumns( *state->tableDefinition, state->columns );
+                state->table = state->extract->AddTable( state->tableName, *state->tableDefinition );
+            }
+        }
+        catch ( ... ) {
+            Abandon( *state );
+            throw;
+        }
+        state->row.reset();
+        state->table.reset();
+        try {
+            state->extract->Close();
+        }
+        catch ( ... ) {
+            // An extract that could not be saved is incomplete.
+            state->extract.reset();
+            RemoveFile( state->path );
+            state->discarded = true;
+            throw;
+        }
+    } );
+}
+
+} // namespace Tableau
+
+#endif // __cpp_impl_coroutine
+#endif // TableauAsyncWriter_CPP_H
@@ -0,0 +1,109 @@
+// -----------------------------------------------------------------------
+// TableauBoundedQueue_cpp.h
+// -----------------------------------------------------------------------
+// Blocking queue with a fixed capacity for connecting pipeline stages.
+
+#ifndef TableauBoundedQueue_CPP_H
+#define TableauBoundedQueue_CPP_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  BoundedQueue
+
+  A multi-producer, multi-consumer FIFO queue. <b>Push</b> blocks while the
+  queue is full, which propagates back-pressure from a slow stage to the
+  stages feeding it. After <b>Close</b>, pushes fail and pops drain the
+  remaining items and then fail.
+
+  ------------------------------------------------------------------------*/
+
+template <class T>
+class BoundedQueue
+{
+  public:
+    /// Initializes an empty queue.
+    /// @param capacity The maximum number of queued items.
+    explicit BoundedQueue( size_t capacity ) : m_capacity(capacity ? capacity : 1), m_closed(false) {}
+
+    /// Appends an item, waiting while the queue is full.
+    /// @return False if the queue was closed.
+    bool Push( T item )
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_notFull.wait( lock, [this] { return m_closed || m_items.size() < m_capacity; } );
+        if ( m_closed )
+            return false;
+        m_items.push_back( std::move( item ) );
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// Appends an item if there is room.
+    /// @return False if the queue is full or closed.
+    bool TryPush( T& item )
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        if ( m_closed || m_items.size() >= m_capacity )
+            return false;
+        m_items.push_back( std::move( item ) );
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// Removes the oldest item, waiting while the queue is empty.
+    /// @return False if the queue is closed and empty.
+    bool Pop( T& item )
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_notEmpty.wait( lock, [this] { return m_closed || !m_items.empty(); } );
+        if ( m_items.empty() )
+            return false;
+        item = std::move( m_items.front() );
+        m_items.pop_front();
+        lock.unlock();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    /// Rejects further pushes and wakes all waiting threads.
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_closed = true;
+        }
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+    /// Returns the number of queued items.
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return m_items.size();
+    }
+
+  private:
+    const size_t m_capacity;
+    bool m_closed;
+    std::deque<T> m_items;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+
+    // Forbidden:
+    BoundedQueue( const BoundedQueue& );
+    BoundedQueue& operator=( const BoundedQueue& );
+};
+
+} // namespace Tableau
+#endif // TableauBoundedQueue_CPP_H
@@ -0,0 +1,103 @@
+// -----------------------------------------------------------------------
+// TableauCancellation_cpp.h
+// -----------------------------------------------------------------------
+// Cancellation tokens with optional deadlines for long-running loads.
+
+#ifndef TableauCancellation_CPP_H
+#define TableauCancellation_CPP_H
+
+#include "TableauCommon_cpp.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  CancellationToken
+
+  Tells a load to stop. A token is cancelled explicitly with <b>Cancel</b>
+  or implicitly once its deadline has passed. Copies share their state,
+  so a scheduler can keep one copy and hand another to the load, which
+  polls <b>IsCancelled</b> between batches. All methods are thread-safe.
+
+  ------------------------------------------------------------------------*/
+
+class CancellationToken
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    /// Initializes a token that is not cancelled and has no deadline.
+    CancellationToken() : m_state(std::make_shared<State>()) {}
+
+    /// Cancels the token.
+    void Cancel()
+    {
+        int expected = Reason_None;
+        m_state->cancelled.compare_exchange_strong( expected, Reason_Cancelled );
+    }
+
+    /// Cancels the token at a point in time. Replaces an earlier deadline.
+    void SetDeadline( Clock::time_point deadline )
+    {
+        m_state->deadline = std::chrono::duration_cast<std::chrono::nanoseconds>( deadline.time_since_epoch() ).count();
+    }
+
+    /// Cancels the token after a number of seconds from now.
+    void SetTimeout( double seconds )
+    {
+        SetDeadline( Clock::now() + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( seconds ) ) );
+    }
+
+    /// Returns true if the token was cancelled or its deadline has passed.
+    bool IsCancelled() const
+    {
+        if ( m_state->cancelled != Reason_None )
+            return true;
+        const int64_t deadline = m_state->deadline;
+        if ( deadline == std::numeric_limits<int64_t>::max() ||
+             std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count() < deadline )
+            return false;
+        int expected = Reason_None;
+        m_state->cancelled.compare_exchange_strong( expected, Reason_Deadline );
+        return true;
+    }
+
+    /// Throws a TableauException with TAB_RESULT_Cancelled if the token is cancelled.
+    void ThrowIfCancelled() const
+    {
+        if ( IsCancelled() )
+            throw TableauException( TAB_RESULT_Cancelled, GetMessage() );
+    }
+
+    /// Returns why the token was cancelled, or an empty string.
+    std::wstring GetMessage() const
+    {
+        switch ( m_state->cancelled ) {
+            case Reason_Cancelled: return L"The load was cancelled";
+            case Reason_Deadline: return L"The load exceeded its deadline";
+            default: return std::wstring();
+        }
+    }
+
+  private:
+    enum Reason { Reason_None, Reason_Cancelled, Reason_Deadline };
+
+    struct State
+    {
+        State() : cancelled(Reason_None), deadline(std::numeric_limits<int64_t>::max()) {}
+
+        std::atomic<int> cancelled;      // the first reason wins
+        std::atomic<int64_t> deadline;   // steady clock nanoseconds
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace Tableau
+#endif // TableauCancellation_CPP_H
@@ -0,0 +1,57 @@
+// -----------------------------------------------------------------------
+// TableauCloseAsync_cpp.h
+// -----------------------------------------------------------------------
+// Closes extracts on the I/O thread pool.
+
+#ifndef TableauCloseAsync_CPP_H
+#define TableauCloseAsync_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include <future>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  AsyncClose
+
+  Hands the handle of an extract to the IOThreadPool. Use CloseAsync.
+
+  ------------------------------------------------------------------------*/
+
+struct AsyncClose
+{
+    static std::future<void> Run( Extract& extract );
+};
+
+/// Closes the extract like Extract::Close(), but on the IOThreadPool, so the caller can start on the next extract while this one is written to disk. The extract and its tables must not be used after this call. Wait for the future before calling ExtractAPI::Cleanup().
+/// @param extract The extract to close.
+/// @return A future that is ready when the extract has been saved; it rethrows the TableauException if closing failed.
+inline std::future<void> CloseAsync( Extract& extract )
+{
+    return AsyncClose::Run( extract );
+}
+
+// -----------------------------------------------------------------------
+// AsyncClose methods
+// -----------------------------------------------------------------------
+
+inline std::future<void> AsyncClose::Run( Extract& extract )
+{
+    TAB_HANDLE handle = extract.m_handle;
+    extract.m_handle = nullptr;
+    extract.m_closing = true;
+
+    return IOThreadPool().Submit( [handle] {
+        if ( handle != nullptr ) {
+            TAB_RESULT result = TabExtractClose( handle );
+
+            if ( result != TAB_RESULT_Success )
+                ThrowLastError( result );
+        }
+    } );
+}
+
+} // namespace Tableau
+#endif // TableauCloseAsync_CPP_H
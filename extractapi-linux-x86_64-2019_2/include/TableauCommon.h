@@ -135,7 +135,18 @@ TAB_API_COMMON const extern TAB_COLLATION TAB_COLLATION_vi;
 TAB_API_COMMON const extern TAB_COLLATION TAB_COLLATION_zh_Hans_CN;
 TAB_API_COMMON const extern TAB_COLLATION TAB_COLLATION_zh_Hant_TW;
 
+/// Returns the message of the last call into the API that failed.
+/// The message is kept in one buffer for the whole process, which every
+/// failing call replaces without a lock. It only describes the caller's
+/// own failure if no other thread fails in between, and reading it while
+/// a call fails on another thread is a data race, as the buffer may be
+/// freed under the reader. Read it right after the failing call returns;
+/// the pointer stays valid until the next failing call or
+/// <b>TabSetLastErrorMessage</b> on any thread. The C++ wrapper copies
+/// it into the thread's ErrorContext before it throws.
 TAB_API_COMMON const wchar_t* TabGetLastErrorMessage();
+
+/// Sets the message returned by <b>TabGetLastErrorMessage</b>, for all threads.
 TAB_API_COMMON void TabSetLastErrorMessage( const wchar_t* );
 TAB_API_COMMON void TabShutdown();
 
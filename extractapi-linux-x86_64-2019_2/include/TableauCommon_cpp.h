@@ -17,6 +17,7 @@
 #include "TableauCommon.h"
 #include <cerrno>
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace Tableau {
@@ -150,6 +151,71 @@ class TableauException {
     const std::wstring m_message;
 };
 
+/*------------------------------------------------------------------------
+  STRUCT
+  ErrorContext
+
+  The result and message of the last call into the Extract API that
+  failed on a thread. The wrapper copies the message into the calling
+  thread's context right where the call failed, before the thread makes
+  another call that could replace it.
+
+  Only the result is reliably per thread. The API keeps one message
+  buffer for the whole process and replaces it, without a lock, in
+  every call that fails. The wrapper copies it under a mutex, so two of
+  its captures never overlap, but a call failing on another thread
+  while the message is copied is a data race: the copy may read a
+  buffer that is being freed, not merely the wrong text. Locking every
+  call instead would serialize the inserts of concurrent writers, so
+  code that must fail concurrently on several threads and rely on the
+  messages has to serialize its own calls into the API.
+
+  ------------------------------------------------------------------------*/
+
+struct ErrorContext
+{
+    ErrorContext() : result(TAB_RESULT_Success) {}
+
+    TAB_RESULT result;
+    std::wstring message;
+};
+
+/// Returns the error context of the calling thread.
+inline ErrorContext& GetThreadErrorContext()
+{
+    thread_local ErrorContext context;
+    return context;
+}
+
+/// Returns the mutex the wrapper holds while it reads the API's last error message.
+inline std::mutex& GetLastErrorMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+/// Copies the message of a call that just failed on the calling thread into its error context.
+/// Successful calls never take the lock this needs.
+/// @param result The result of the failed call.
+/// @return The calling thread's error context.
+inline const ErrorContext& CaptureLastError( TAB_RESULT result )
+{
+    ErrorContext& context = GetThreadErrorContext();
+    context.result = result;
+    std::lock_guard<std::mutex> lock( GetLastErrorMutex() );
+    const wchar_t* message = TabGetLastErrorMessage();
+    context.message = message != nullptr ? message : L"";
+    return context;
+}
+
+/// Throws a TableauException for a call that just failed on the calling thread.
+/// @param result The result of the failed call.
+[[noreturn]] inline void ThrowLastError( TAB_RESULT result )
+{
+    const ErrorContext& context = CaptureLastError( result );
+    throw TableauException( context.result, context.message );
+}
+
 namespace {
 
     std::basic_string<TableauWChar> MakeTableauString( const wchar_t* s )
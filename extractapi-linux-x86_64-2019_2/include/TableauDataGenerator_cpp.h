@@ -0,0 +1,426 @@
+// -----------------------------------------------------------------------
+// TableauDataGenerator_cpp.h
+// -----------------------------------------------------------------------
+// Seeded synthetic rows for any schema, for reproducible benchmarks.
+
+#ifndef TableauDataGenerator_CPP_H
+#define TableauDataGenerator_CPP_H
+
+#include "TableauBoundedQueue_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ColumnProfile
+
+  The distribution of the generated values of one column. Which fields
+  apply depends on the column type.
+
+  ------------------------------------------------------------------------*/
+
+struct ColumnProfile
+{
+    ColumnProfile()
+        : cardinality(0), nullRatio(0), zipfSkew(0), minLength(4), maxLength(16),
+          unicodeRatio(0.1), minYear(2000), maxYear(2020), minValue(0), maxValue(1000) {}
+
+    int64_t cardinality;   // number of distinct values; zero means every row is drawn independently
+    double nullRatio;      // fraction of null values
+    double zipfSkew;       // Zipf exponent of the value frequencies; zero is uniform (needs a cardinality)
+    int minLength;         // string lengths are uniform in [minLength, maxLength]
+    int maxLength;
+    double unicodeRatio;   // fraction of non-ASCII characters in Type_UnicodeString columns
+    int minYear;           // Date, DateTime and Duration values fall in [minYear, maxYear]
+    int maxYear;
+    double minValue;       // Integer and Double values fall in [minValue, maxValue]
+    double maxValue;
+};
+
+namespace {
+
+    // SplitMix64 finalizer: a bijective mix of a 64-bit counter.
+    inline uint64_t MixBits( uint64_t x )
+    {
+        x = ( x ^ ( x >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+        x = ( x ^ ( x >> 27 ) ) * 0x94D049BB133111EBull;
+        return x ^ ( x >> 31 );
+    }
+
+#ifdef __AVX2__
+    // The low 64 bits of a * b, from 32-bit multiplies, as AVX2 has no 64-bit one.
+    inline __m256i MultiplyLow64( __m256i a, __m256i bLow, __m256i bHigh )
+    {
+        const __m256i low = _mm256_mul_epu32( a, bLow );
+        const __m256i cross = _mm256_add_epi64( _mm256_mul_epu32( _mm256_srli_epi64( a, 32 ), bLow ), _mm256_mul_epu32( a, bHigh ) );
+        return _mm256_add_epi64( low, _mm256_slli_epi64( cross, 32 ) );
+    }
+#endif
+
+    // Fills out[i] with the random word of counter first + i under key.
+    // Below AVX-512 there is no 64-bit vector multiply, so compilers leave
+    // the loop scalar; with AVX2, four words are mixed at a time from 32-bit
+    // multiplies, with the same results. Two words at a time with SSE2 are
+    // no faster than the scalar loop.
+    inline void FillRandomBlock( uint64_t key, uint64_t first, size_t count, uint64_t* out )
+    {
+        const uint64_t golden = 0x9E3779B97F4A7C15ull;
+        size_t i = 0;
+#ifdef __AVX2__
+        const __m256i keys = _mm256_set1_epi64x( static_cast<long long>( key ) );
+        const __m256i step = _mm256_set1_epi64x( static_cast<long long>( 4 * golden ) );
+        const __m256i mix1Low = _mm256_set1_epi64x( 0x1CE4E5B9 ), mix1High = _mm256_set1_epi64x( 0xBF58476D );
+        const __m256i mix2Low = _mm256_set1_epi64x( 0x133111EB ), mix2High = _mm256_set1_epi64x( 0x94D049BB );
+        __m256i counters = _mm256_set_epi64x( static_cast<long long>( ( first + 3 ) * golden ), static_cast<long long>( ( first + 2 ) * golden ),
+                                              static_cast<long long>( ( first + 1 ) * golden ), static_cast<long long>( first * golden ) );
+        for ( ; i + 4 <= count; i += 4 ) {
+            __m256i x = _mm256_xor_si256( keys, counters );
+            counters = _mm256_add_epi64( counters, step );
+            x = MultiplyLow64( _mm256_xor_si256( x, _mm256_srli_epi64( x, 30 ) ), mix1Low, mix1High );
+            x = MultiplyLow64( _mm256_xor_si256( x, _mm256_srli_epi64( x, 27 ) ), mix2Low, mix2High );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>( out + i ), _mm256_xor_si256( x, _mm256_srli_epi64( x, 31 ) ) );
+        }
+#endif
+        for ( ; i < count; ++i )
+            out[i] = MixBits( key ^ ( ( first + i ) * golden ) );
+    }
+
+    inline double UnitDouble( uint64_t bits )
+    {
+        return static_cast<double>( bits >> 11 ) * ( 1.0 / 9007199254740992.0 );
+    }
+
+    // Returns the bound below which a random word falls with probability
+    // ratio. Ratios of 1 and more have no such bound, as 2^64 does not fit
+    // a word; callers test them with ratio >= 1 instead.
+    inline uint64_t ProbabilityBound( double ratio )
+    {
+        return ratio <= 0 || ratio >= 1 ? 0 : static_cast<uint64_t>( ratio * 18446744073709551616.0 );
+    }
+
+    // Days since 1970-01-01 to civil date and back (proleptic Gregorian).
+    inline int64_t DaysFromCivil( int year, int month, int day )
+    {
+        year -= month <= 2;
+        const int64_t era = ( year >= 0 ? year : year - 399 ) / 400;
+        const int64_t yoe = year - era * 400;
+        const int64_t doy = ( 153 * ( month + ( month > 2 ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+        const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    inline void CivilFromDays( int64_t days, int& year, int& month, int& day )
+    {
+        days += 719468;
+        const int64_t era = ( days >= 0 ? days : days - 146096 ) / 146097;
+        const int64_t doe = days - era * 146097;
+        const int64_t yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+        const int64_t doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+        const int64_t mp = ( 5 * doy + 2 ) / 153;
+        day = static_cast<int>( doy - ( 153 * mp + 2 ) / 5 + 1 );
+        month = static_cast<int>( mp < 10 ? mp + 3 : mp - 9 );
+        year = static_cast<int>( yoe + era * 400 + ( month <= 2 ) );
+    }
+
+}
+
+/*------------------------------------------------------------------------
+  CLASS
+  DataGenerator
+
+  Generates rows for a schema from a seed. Every value is a pure function
+  of the seed, the column and the row number: the random words come from
+  a counter-based generator (a SplitMix64 mix of the row number), so any
+  range of rows can be generated on any thread, in any order, and always
+  yields the same data. Random words are produced a block of rows at a
+  time before they are turned into values, four at a time with AVX2
+  (build with -mavx2) and one at a time otherwise.
+
+  With a cardinality, a row first draws a rank in [0, cardinality),
+  uniformly or Zipf-distributed, and the value is derived from the rank,
+  so the column has at most that many distinct values.
+
+  ------------------------------------------------------------------------*/
+
+class DataGenerator
+{
+  public:
+    /// Initializes a generator with the default profile for every column.
+    /// @param columns The schema to generate rows for.
+    /// @param seed The seed; equal seeds generate equal rows.
+    DataGenerator(
+        const std::vector<ColumnSpec>& columns,
+        uint64_t seed
+    );
+
+    /// Sets the distribution of a column.
+    /// @param columnNumber The column number (zero-based).
+    /// @param profile The distribution.
+    void SetProfile( int columnNumber, const ColumnProfile& profile );
+
+    /// Returns the number of columns.
+    int GetColumnCount() const { return static_cast<int>( m_columns.size() ); }
+
+    /// Generates a block of rows.
+    /// @param firstRow The number of the first row to generate.
+    /// @param count The number of rows.
+    /// @param rows Receives the rows; it is resized to count.
+    void Generate( uint64_t firstRow, size_t count, std::vector<ValueRow>& rows ) const;
+
+    /// Sets all columns of a row to the values of the given row number.
+    void Fill( Row& row, uint64_t rowNumber ) const;
+
+  private:
+    struct Column
+    {
+        Type type;
+        ColumnProfile profile;
+        std::vector<double> zipfCdf;   // cumulative rank probabilities, if skewed
+    };
+
+    void MakeValue( const Column& column, uint64_t draw, Value& value ) const;
+    uint64_t Rank( const Column& column, uint64_t word ) const;
+    std::wstring MakeString( const Column& column, uint64_t draw, bool unicode ) const;
+
+    std::vector<Column> m_columns;
+    uint64_t m_seed;
+};
+
+/// Generates rows in parallel and hands them to the consumer in row order.
+/// Worker t generates the batches t, t + threads, ...; the calling thread
+/// consumes them in turn, so the output does not depend on the thread count.
+/// @param generator The generator.
+/// @param rows The number of rows, starting at row 0.
+/// @param threads The number of generating threads.
+/// @param batchRows The number of rows per batch.
+/// @param consume Called on the calling thread with every batch, in order.
+inline void
+GenerateParallel(
+    const DataGenerator& generator,
+    uint64_t rows,
+    size_t threads,
+    size_t batchRows,
+    const std::function<void( std::vector<ValueRow>& batch )>& consume
+)
+{
+    threads = std::max<size_t>( 1, threads );
+    batchRows = std::max<size_t>( 1, batchRows );
+    const uint64_t batches = ( rows + batchRows - 1 ) / batchRows;
+
+    std::vector<std::unique_ptr<BoundedQueue<std::vector<ValueRow> > > > queues;
+    std::vector<std::thread> workers;
+    for ( size_t t = 0; t < threads; ++t )
+        queues.push_back( std::unique_ptr<BoundedQueue<std::vector<ValueRow> > >( new BoundedQueue<std::vector<ValueRow> >( 2 ) ) );
+    for ( size_t t = 0; t < threads; ++t ) {
+        workers.push_back( std::thread( [&generator, &queues, t, threads, rows, batchRows, batches] {
+            for ( uint64_t b = t; b < batches; b += threads ) {
+                const uint64_t first = b * batchRows;
+                std::vector<ValueRow> batch;
+                generator.Generate( first, static_cast<size_t>( std::min<uint64_t>( batchRows, rows - first ) ), batch );
+                if ( !queues[t]->Push( std::move( batch ) ) )
+                    break;
+            }
+            queues[t]->Close();
+        } ) );
+    }
+
+    std::exception_ptr error;
+    try {
+        std::vector<ValueRow> batch;
+        for ( uint64_t b = 0; b < batches && queues[b % threads]->Pop( batch ); ++b )
+            consume( batch );
+    }
+    catch ( ... ) {
+        error = std::current_exception();
+    }
+    for ( size_t t = 0; t < threads; ++t ) {
+        queues[t]->Close();
+        workers[t].join();
+    }
+    if ( error )
+        std::rethrow_exception( error );
+}
+
+// -----------------------------------------------------------------------
+// DataGenerator methods
+// -----------------------------------------------------------------------
+
+inline DataGenerator::DataGenerator(
+    const std::vector<ColumnSpec>& columns,
+    uint64_t seed
+) : m_seed(seed)
+{
+    for ( size_t c = 0; c < columns.size(); ++c ) {
+        Column column;
+        column.type = columns[c].type;
+        m_columns.push_back( column );
+    }
+}
+
+inline void DataGenerator::SetProfile( int columnNumber, const ColumnProfile& profile )
+{
+    Column& column = m_columns[columnNumber];
+    column.profile = profile;
+    column.zipfCdf.clear();
+    if ( profile.cardinality > 0 && profile.zipfSkew > 0 ) {
+        column.zipfCdf.resize( static_cast<size_t>( profile.cardinality ) );
+        double sum = 0;
+        for ( size_t k = 0; k < column.zipfCdf.size(); ++k ) {
+            sum += 1.0 / std::pow( static_cast<double>( k + 1 ), profile.zipfSkew );
+            column.zipfCdf[k] = sum;
+        }
+        for ( size_t k = 0; k < column.zipfCdf.size(); ++k )
+            column.zipfCdf[k] /= sum;
+    }
+}
+
+inline void DataGenerator::Generate( uint64_t firstRow, size_t count, std::vector<ValueRow>& rows ) const
+{
+    rows.resize( count );
+    for ( size_t r = 0; r < count; ++r )
+        rows[r].resize( m_columns.size() );
+
+    std::vector<uint64_t> draws( count );
+    std::vector<uint64_t> nulls( count );
+    for ( size_t c = 0; c < m_columns.size(); ++c ) {
+        const Column& column = m_columns[c];
+        const uint64_t key = MixBits( m_seed + 2 * c + 1 );
+        FillRandomBlock( key, firstRow, count, &draws[0] );
+
+        const bool nullable = column.profile.nullRatio > 0;
+        if ( nullable )
+            FillRandomBlock( ~key, firstRow, count, &nulls[0] );
+        const bool allNull = column.profile.nullRatio >= 1;
+        const uint64_t nullBelow = ProbabilityBound( column.profile.nullRatio );
+
+        for ( size_t r = 0; r < count; ++r ) {
+            if ( nullable && ( allNull || nulls[r] < nullBelow ) )
+                rows[r][c].SetNull( column.type );
+            else
+                MakeValue( column, column.profile.cardinality > 0 ? Rank( column, draws[r] ) : draws[r], rows[r][c] );
+        }
+    }
+}
+
+inline void DataGenerator::Fill( Row& row, uint64_t rowNumber ) const
+{
+    std::vector<ValueRow> rows;
+    Generate( rowNumber, 1, rows );
+    for ( size_t c = 0; c < m_columns.size(); ++c )
+        rows[0][c].SetInRow( row, static_cast<int>( c ) );
+}
+
+inline uint64_t DataGenerator::Rank( const Column& column, uint64_t word ) const
+{
+    if ( column.zipfCdf.empty() )
+        return static_cast<uint64_t>( UnitDouble( word ) * column.profile.cardinality );
+    const std::vector<double>::const_iterator it =
+        std::lower_bound( column.zipfCdf.begin(), column.zipfCdf.end(), UnitDouble( word ) );
+    return std::min<uint64_t>( it - column.zipfCdf.begin(), column.zipfCdf.size() - 1 );
+}
+
+inline void DataGenerator::MakeValue( const Column& column, uint64_t draw, Value& value ) const
+{
+    const ColumnProfile& profile = column.profile;
+    // Ranks are small integers; mix them so that values spread over the range.
+    const uint64_t bits = profile.cardinality > 0 ? MixBits( draw ^ m_seed ) : draw;
+    const int64_t firstDay = DaysFromCivil( profile.minYear, 1, 1 );
+    const int64_t days = std::max<int64_t>( 1, DaysFromCivil( profile.maxYear + 1, 1, 1 ) - firstDay );
+    int year, month, day;
+
+    switch ( column.type ) {
+        case Type_Integer:
+            if ( profile.cardinality > 0 ) {
+                value.SetInteger( static_cast<int64_t>( profile.minValue ) + static_cast<int64_t>( draw ) );
+            }
+            else {
+                const uint64_t range = static_cast<uint64_t>( std::max( 0.0, profile.maxValue - profile.minValue ) ) + 1;
+                value.SetInteger( static_cast<int64_t>( profile.minValue ) + static_cast<int64_t>( bits % range ) );
+            }
+            break;
+        case Type_Double:
+            value.SetDouble( profile.minValue + UnitDouble( bits ) * ( profile.maxValue - profile.minValue ) );
+            break;
+        case Type_Boolean:
+            value.SetBoolean( ( bits >> 63 ) != 0 );
+            break;
+        case Type_Date:
+            CivilFromDays( firstDay + static_cast<int64_t>( bits % days ), year, month, day );
+            value.SetDate( year, month, day );
+            break;
+        case Type_DateTime: {
+            const uint64_t seconds = bits % ( static_cast<uint64_t>( days ) * 86400 );
+            CivilFromDays( firstDay + static_cast<int64_t>( seconds / 86400 ), year, month, day );
+            const int second = static_cast<int>( seconds % 86400 );
+            value.SetDateTime( year, month, day, second / 3600, second / 60 % 60, second % 60,
+                               static_cast<int>( ( bits >> 40 ) % 10000 ) );
+            break;
+        }
+        case Type_Duration: {
+            const uint64_t seconds = bits % ( static_cast<uint64_t>( days ) * 86400 );
+            const int second = static_cast<int>( seconds % 86400 );
+            value.SetDuration( static_cast<int>( seconds / 86400 ), second / 3600, second / 60 % 60, second % 60,
+                               static_cast<int>( ( bits >> 40 ) % 10000 ) );
+            break;
+        }
+        case Type_CharString: {
+            const std::wstring text = MakeString( column, bits, false );
+            value.SetCharString( std::string( text.begin(), text.end() ) );
+            break;
+        }
+        case Type_UnicodeString:
+            value.SetString( MakeString( column, bits, true ) );
+            break;
+        case Type_Spatial: {
+            char point[64];
+            std::snprintf( point, sizeof( point ), "POINT (%.4f %.4f)",
+                           UnitDouble( bits ) * 360 - 180, UnitDouble( MixBits( bits ) ) * 180 - 90 );
+            value.SetSpatial( point );
+            break;
+        }
+        default:
+            value.SetNull( column.type );
+            break;
+    }
+}
+
+inline std::wstring DataGenerator::MakeString( const Column& column, uint64_t draw, bool unicode ) const
+{
+    static const wchar_t nonAscii[] = L"äöüßéèñçøåждлпαβγλ中文字日本語한국";
+    const size_t nonAsciiCount = sizeof( nonAscii ) / sizeof( nonAscii[0] ) - 1;
+    const ColumnProfile& profile = column.profile;
+
+    const int span = std::max( 0, profile.maxLength - profile.minLength ) + 1;
+    const int length = std::max( 0, profile.minLength ) + static_cast<int>( draw % span );
+    const bool allUnicode = unicode && profile.unicodeRatio >= 1;
+    const uint64_t unicodeBelow = unicode ? ProbabilityBound( profile.unicodeRatio ) : 0;
+
+    std::wstring text( length, L' ' );
+    for ( int i = 0; i < length; ++i ) {
+        const uint64_t word = MixBits( draw + static_cast<uint64_t>( i ) * 0x9E3779B97F4A7C15ull );
+        if ( allUnicode || word < unicodeBelow )
+            text[i] = nonAscii[( word >> 20 ) % nonAsciiCount];
+        else
+            text[i] = static_cast<wchar_t>( L'a' + ( word >> 20 ) % 26 );
+    }
+    return text;
+}
+
+} // namespace Tableau
+#endif // TableauDataGenerator_CPP_H
@@ -0,0 +1,358 @@
+// -----------------------------------------------------------------------
+// TableauDeduplicator_cpp.h
+// -----------------------------------------------------------------------
+// Key-based removal of replayed rows before they reach an extract.
+
+#ifndef TableauDeduplicator_CPP_H
+#define TableauDeduplicator_CPP_H
+
+#include "TableauBoundedQueue_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  BlockedBloomFilter
+
+  Bloom filter whose bits for one key all lie in a single 64-byte block,
+  one bit in each of the block's eight words, so a lookup touches exactly
+  one cache line. About 1% false positives at 16 bits per key.
+
+  ------------------------------------------------------------------------*/
+
+class BlockedBloomFilter
+{
+  public:
+    /// Initializes an empty filter.
+    /// @param expectedKeys The number of keys the filter is sized for.
+    explicit BlockedBloomFilter( size_t expectedKeys ) { Reset( expectedKeys ); }
+
+    /// Clears the filter and resizes it.
+    void Reset( size_t expectedKeys )
+    {
+        m_blocks = std::max<size_t>( 1, expectedKeys * 16 / 512 );
+        m_words.assign( m_blocks * 8 + 8, 0 );
+        // Align the first block to a cache line.
+        const size_t misalignment = reinterpret_cast<uintptr_t>( &m_words[0] ) % 64 / sizeof( uint64_t );
+        m_base = &m_words[0] + ( misalignment ? 8 - misalignment : 0 );
+        m_capacity = expectedKeys;
+    }
+
+    /// Returns the number of keys the filter is sized for.
+    size_t GetCapacity() const { return m_capacity; }
+
+    void Insert( uint64_t hash )
+    {
+        uint64_t* block = Block( hash );
+        for ( int i = 0; i < 8; ++i )
+            block[i] |= Bit( hash, i );
+    }
+
+    /// Returns false if the key was never inserted.
+    bool MayContain( uint64_t hash ) const
+    {
+        const uint64_t* block = Block( hash );
+        uint64_t missing = 0;
+        for ( int i = 0; i < 8; ++i )
+            missing |= Bit( hash, i ) & ~block[i];
+        return missing == 0;
+    }
+
+  private:
+    // The upper half of the hash selects the block, the lower half the bits.
+    uint64_t* Block( uint64_t hash ) const
+    {
+        return m_base + 8 * static_cast<size_t>( ( ( hash >> 32 ) * m_blocks ) >> 32 );
+    }
+
+    static uint64_t Bit( uint64_t hash, int word )
+    {
+        static const uint32_t salts[8] = { 0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                           0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U };
+        return uint64_t( 1 ) << ( ( static_cast<uint32_t>( hash ) * salts[word] ) >> 26 );
+    }
+
+    std::vector<uint64_t> m_words;
+    uint64_t* m_base;
+    size_t m_blocks;
+    size_t m_capacity;
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  DedupStats
+
+  Counters of a deduplication run.
+
+  ------------------------------------------------------------------------*/
+
+struct DedupStats
+{
+    DedupStats() : rowsIn(0), rowsOut(0), bloomNegatives(0), busySeconds(0) {}
+
+    /// Returns the fraction of input rows that were dropped as duplicates.
+    double GetDedupRatio() const { return rowsIn ? double( rowsIn - rowsOut ) / rowsIn : 0; }
+
+    size_t rowsIn;
+    size_t rowsOut;
+    size_t bloomNegatives;   // new keys that skipped the exact lookup
+    double busySeconds;      // time spent checking keys
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  Deduplicator
+
+  Drops rows whose key columns equal those of an earlier row. The blocked
+  Bloom filter answers "never seen" without touching the exact set; keys
+  that may have been seen are confirmed in an open-addressing hash set
+  over the serialized keys.
+
+  ------------------------------------------------------------------------*/
+
+class Deduplicator
+{
+  public:
+    /// Initializes an empty deduplicator.
+    /// @param keyColumns The columns (zero-based) that identify a row.
+    /// @param expectedKeys The expected number of distinct keys; the filter and set grow beyond it.
+    Deduplicator(
+        const std::vector<int>& keyColumns,
+        size_t expectedKeys = 1 << 20
+    );
+
+    /// Records the row's key.
+    /// @return True if the key was not seen before, i.e. the row should be kept.
+    bool Insert( const ValueRow& row );
+
+    /// Returns the number of distinct keys seen.
+    size_t GetKeyCount() const { return m_count; }
+
+    /// Returns the counters; busySeconds is only maintained by DedupStage.
+    const DedupStats& GetStats() const { return m_stats; }
+    DedupStats& GetStats() { return m_stats; }
+
+  private:
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t offset;   // into m_arena, plus one; zero marks an empty slot
+    };
+
+    bool Contains( uint64_t hash ) const;
+    void Add( uint64_t hash );
+    void Grow();
+
+    std::vector<int> m_keyColumns;
+    BlockedBloomFilter m_bloom;
+    std::vector<Slot> m_slots;
+    std::string m_arena;
+    std::string m_key;
+    size_t m_count;
+    DedupStats m_stats;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  DedupStage
+
+  Runs a Deduplicator on its own thread between the thread that parses
+  rows and the thread that inserts them. Batches go in with <b>Push</b>
+  and come out, without the duplicates and in the same order, with
+  <b>Pop</b>.
+
+  ------------------------------------------------------------------------*/
+
+class DedupStage
+{
+  public:
+    typedef std::vector<ValueRow> Batch;
+
+    /// Starts the deduplication thread.
+    /// @param keyColumns The columns (zero-based) that identify a row.
+    /// @param expectedKeys The expected number of distinct keys.
+    /// @param queueBatches The number of batches buffered on each side of the stage.
+    DedupStage(
+        const std::vector<int>& keyColumns,
+        size_t expectedKeys = 1 << 20,
+        size_t queueBatches = 8
+    );
+
+    /// Finishes the input and joins the thread.
+    ~DedupStage();
+
+    /// Hands a batch of parsed rows to the stage, waiting if it is behind.
+    void Push( Batch batch ) { m_input.Push( std::move( batch ) ); }
+
+    /// Signals that no more batches will be pushed.
+    void Finish() { m_input.Close(); }
+
+    /// Takes the next deduplicated batch.
+    /// @return False once all input has been processed.
+    bool Pop( Batch& batch ) { return m_output.Pop( batch ); }
+
+    /// Returns the counters. Call after <b>Pop</b> returned false.
+    DedupStats GetStats() const { return m_dedup.GetStats(); }
+
+  private:
+    void Run();
+
+    Deduplicator m_dedup;
+    BoundedQueue<Batch> m_input;
+    BoundedQueue<Batch> m_output;
+    std::thread m_thread;
+
+    // Forbidden:
+    DedupStage( const DedupStage& );
+    DedupStage& operator=( const DedupStage& );
+};
+
+// -----------------------------------------------------------------------
+// Deduplicator methods
+// -----------------------------------------------------------------------
+
+inline Deduplicator::Deduplicator(
+    const std::vector<int>& keyColumns,
+    size_t expectedKeys
+) : m_keyColumns(keyColumns),
+    m_bloom(expectedKeys),
+    m_slots(16),
+    m_count(0)
+{
+    while ( m_slots.size() < 2 * expectedKeys )
+        m_slots.resize( m_slots.size() * 2 );
+}
+
+inline bool Deduplicator::Insert( const ValueRow& row )
+{
+    m_key.clear();
+    for ( size_t i = 0; i < m_keyColumns.size(); ++i )
+        row[m_keyColumns[i]].Serialize( m_key );
+    const uint64_t hash = HashBytes( m_key.data(), m_key.size() );
+
+    ++m_stats.rowsIn;
+    if ( !m_bloom.MayContain( hash ) )
+        ++m_stats.bloomNegatives;
+    else if ( Contains( hash ) )
+        return false;
+
+    Add( hash );
+    ++m_stats.rowsOut;
+    return true;
+}
+
+inline bool Deduplicator::Contains( uint64_t hash ) const
+{
+    const size_t mask = m_slots.size() - 1;
+    for ( size_t i = hash & mask; m_slots[i].offset != 0; i = ( i + 1 ) & mask ) {
+        if ( m_slots[i].hash != hash )
+            continue;
+        const char* pos = m_arena.data() + m_slots[i].offset - 1;
+        uint64_t length;
+        ReadVarint( pos, m_arena.data() + m_arena.size(), length );
+        if ( length == m_key.size() && std::memcmp( pos, m_key.data(), length ) == 0 )
+            return true;
+    }
+    return false;
+}
+
+inline void Deduplicator::Add( uint64_t hash )
+{
+    if ( 2 * ( m_count + 1 ) > m_slots.size() )
+        Grow();
+
+    const size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while ( m_slots[i].offset != 0 )
+        i = ( i + 1 ) & mask;
+    m_slots[i].hash = hash;
+    m_slots[i].offset = m_arena.size() + 1;
+    AppendVarint( m_arena, m_key.size() );
+    m_arena += m_key;
+    ++m_count;
+
+    // Rebuild the filter at twice the size from the stored hashes once it
+    // holds more keys than it was sized for.
+    if ( m_count > m_bloom.GetCapacity() ) {
+        m_bloom.Reset( 2 * m_bloom.GetCapacity() );
+        for ( size_t s = 0; s < m_slots.size(); ++s ) {
+            if ( m_slots[s].offset != 0 )
+                m_bloom.Insert( m_slots[s].hash );
+        }
+    }
+    else {
+        m_bloom.Insert( hash );
+    }
+}
+
+inline void Deduplicator::Grow()
+{
+    std::vector<Slot> old( m_slots.size() * 2 );
+    old.swap( m_slots );
+    const size_t mask = m_slots.size() - 1;
+    for ( size_t s = 0; s < old.size(); ++s ) {
+        if ( old[s].offset == 0 )
+            continue;
+        size_t i = old[s].hash & mask;
+        while ( m_slots[i].offset != 0 )
+            i = ( i + 1 ) & mask;
+        m_slots[i] = old[s];
+    }
+}
+
+// -----------------------------------------------------------------------
+// DedupStage methods
+// -----------------------------------------------------------------------
+
+inline DedupStage::DedupStage(
+    const std::vector<int>& keyColumns,
+    size_t expectedKeys,
+    size_t queueBatches
+) : m_dedup(keyColumns, expectedKeys),
+    m_input(queueBatches),
+    m_output(queueBatches),
+    m_thread(&DedupStage::Run, this)
+{
+}
+
+inline DedupStage::~DedupStage()
+{
+    m_input.Close();
+    m_output.Close();
+    m_thread.join();
+}
+
+inline void DedupStage::Run()
+{
+    Batch batch;
+    while ( m_input.Pop( batch ) ) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        for ( size_t i = 0; i < batch.size(); ++i ) {
+            if ( m_dedup.Insert( batch[i] ) ) {
+                if ( kept != i )
+                    batch[kept].swap( batch[i] );
+                ++kept;
+            }
+        }
+        batch.resize( kept );
+        m_dedup.GetStats().busySeconds +=
+            std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+        if ( !batch.empty() && !m_output.Push( std::move( batch ) ) )
+            break;
+        batch = Batch();
+    }
+    m_output.Close();
+}
+
+} // namespace Tableau
+#endif // TableauDeduplicator_CPP_H
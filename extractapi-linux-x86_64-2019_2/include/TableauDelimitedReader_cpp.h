@@ -0,0 +1,297 @@
+// -----------------------------------------------------------------------
+// TableauDelimitedReader_cpp.h
+// -----------------------------------------------------------------------
+// Buffered reader for CSV and other delimited text files.
+
+#ifndef TableauDelimitedReader_CPP_H
+#define TableauDelimitedReader_CPP_H
+
+#include "TableauCommon_cpp.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  FieldView
+
+  The bytes of one field, pointing into the reader's buffer.
+
+  ------------------------------------------------------------------------*/
+
+struct FieldView
+{
+    FieldView() : begin(nullptr), end(nullptr) {}
+    FieldView( const char* begin, const char* end ) : begin(begin), end(end) {}
+
+    size_t Size() const { return end - begin; }
+    bool Equals( const std::string& text ) const
+    {
+        return Size() == text.size() && std::memcmp( begin, text.data(), text.size() ) == 0;
+    }
+
+    const char* begin;
+    const char* end;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  DelimitedReader
+
+  Reads records of delimiter-separated fields. Fields may be enclosed in
+  quotes, in which case they may contain delimiters, line breaks and
+  doubled quotes. Records end at a line feed outside quotes; a preceding
+  carriage return is dropped. Empty lines are skipped.
+
+  Fields are returned as views into the read buffer and are only valid
+  until the next call to <b>Next</b>. Quoted fields are unescaped in
+  place, so reading never allocates per field.
+
+  With a projection set, fields outside it are returned empty without
+  being unescaped, and splitting a record stops after the last projected
+  field, so wide records cost little beyond finding their end.
+
+  ------------------------------------------------------------------------*/
+
+class DelimitedReader
+{
+  public:
+    /// Opens a file.
+    /// @param path The file to read.
+    /// @param delimiter The field separator.
+    /// @param quote The quote character.
+    DelimitedReader(
+        const std::string& path,
+        char delimiter = ',',
+        char quote = '"'
+    );
+
+    /// Closes the file.
+    ~DelimitedReader();
+
+    /// Reads the next record.
+    /// @param fields Receives the fields of the record.
+    /// @return False at the end of the file.
+    bool Next( std::vector<FieldView>& fields );
+
+    /// Restricts the fields returned by <b>Next</b>.
+    /// @param projected True for each field to return; fields beyond its end are dropped. Empty returns all fields.
+    void SetProjection( const std::vector<bool>& projected ) { m_projection = projected; }
+
+    /// Returns the number of the line the last record started on (one-based).
+    uint64_t GetLineNumber() const { return m_recordLine; }
+
+    /// Returns the number of bytes consumed so far.
+    uint64_t GetBytesRead() const { return m_consumed; }
+
+    /// Returns the size of the file, or zero if it is not a regular file.
+    uint64_t GetFileSize() const
+    {
+        struct stat status;
+        return fstat( m_fd, &status ) == 0 && S_ISREG( status.st_mode ) ? status.st_size : 0;
+    }
+
+  private:
+    bool Fill();
+    const char* FindRecordEnd( const char* pos, uint64_t& lines ) const;
+    void SplitFields( char* begin, char* end, std::vector<FieldView>& fields ) const;
+
+    int m_fd;
+    std::string m_path;
+    char m_delimiter;
+    char m_quote;
+    std::vector<bool> m_projection;
+    std::vector<char> m_buffer;
+    size_t m_begin;   // start of unread data in m_buffer
+    size_t m_end;     // end of valid data in m_buffer
+    bool m_eof;
+    uint64_t m_line;
+    uint64_t m_recordLine;
+    uint64_t m_consumed;
+
+    // Forbidden:
+    DelimitedReader( const DelimitedReader& );
+    DelimitedReader& operator=( const DelimitedReader& );
+};
+
+// -----------------------------------------------------------------------
+// DelimitedReader methods
+// -----------------------------------------------------------------------
+
+inline DelimitedReader::DelimitedReader(
+    const std::string& path,
+    char delimiter,
+    char quote
+) : m_fd(open( path.c_str(), O_RDONLY | O_CLOEXEC )),
+    m_path(path),
+    m_delimiter(delimiter),
+    m_quote(quote),
+    m_buffer(1 << 20),
+    m_begin(0),
+    m_end(0),
+    m_eof(false),
+    m_line(1),
+    m_recordLine(0),
+    m_consumed(0)
+{
+    if ( m_fd < 0 )
+        throw TableauException( errno != 0 ? errno : TAB_RESULT_FileNotFound,
+                                L"Could not open " + std::wstring( path.begin(), path.end() ) );
+}
+
+inline DelimitedReader::~DelimitedReader()
+{
+    close( m_fd );
+}
+
+inline bool DelimitedReader::Next( std::vector<FieldView>& fields )
+{
+    for ( ;; ) {
+        uint64_t lines = 0;
+        const char* recordEnd = FindRecordEnd( &m_buffer[0] + m_begin, lines );
+        if ( recordEnd == nullptr ) {
+            // The record continues beyond the buffered data.
+            if ( m_eof ) {
+                if ( m_begin == m_end )
+                    return false;
+                recordEnd = &m_buffer[0] + m_end;   // last record without a line feed
+            }
+            else {
+                Fill();
+                continue;
+            }
+        }
+
+        char* begin = &m_buffer[0] + m_begin;
+        char* end = const_cast<char*>( recordEnd );
+        const size_t consumed = ( end - begin ) + ( end < &m_buffer[0] + m_end ? 1 : 0 );
+        m_begin += consumed;
+        m_consumed += consumed;
+        m_recordLine = m_line;
+        m_line += lines + 1;
+
+        if ( end > begin && end[-1] == '\r' )
+            --end;
+        if ( end == begin )
+            continue;   // empty line
+        SplitFields( begin, end, fields );
+        return true;
+    }
+}
+
+inline bool DelimitedReader::Fill()
+{
+    // Move the partial record to the front and grow the buffer if it is full.
+    if ( m_begin > 0 ) {
+        std::memmove( &m_buffer[0], &m_buffer[0] + m_begin, m_end - m_begin );
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if ( m_end == m_buffer.size() )
+        m_buffer.resize( m_buffer.size() * 2 );
+
+    for ( ;; ) {
+        const ssize_t got = read( m_fd, &m_buffer[0] + m_end, m_buffer.size() - m_end );
+        if ( got > 0 ) {
+            m_end += got;
+            return true;
+        }
+        if ( got == 0 ) {
+            m_eof = true;
+            return false;
+        }
+        if ( errno != EINTR )
+            throw TableauException( errno, L"Could not read " + std::wstring( m_path.begin(), m_path.end() ) );
+    }
+}
+
+// Returns the line feed that ends the record starting at pos, or null if
+// the buffered data ends first. Records without quotes are found with
+// memchr; from the first quote on, bytes are inspected one by one.
+inline const char* DelimitedReader::FindRecordEnd( const char* pos, uint64_t& lines ) const
+{
+    const char* end = &m_buffer[0] + m_end;
+    const char* lineFeed = static_cast<const char*>( std::memchr( pos, '\n', end - pos ) );
+    const char* quote = static_cast<const char*>( std::memchr( pos, m_quote, ( lineFeed != nullptr ? lineFeed : end ) - pos ) );
+    if ( quote == nullptr )
+        return lineFeed;
+    bool quoted = false;
+    for ( pos = quote; pos < end; ++pos ) {
+        if ( *pos == m_quote ) {
+            quoted = !quoted;
+        }
+        else if ( *pos == '\n' ) {
+            if ( !quoted )
+                return pos;
+            ++lines;
+        }
+    }
+    return nullptr;
+}
+
+inline void DelimitedReader::SplitFields( char* begin, char* end, std::vector<FieldView>& fields ) const
+{
+    fields.clear();
+    const size_t limit = m_projection.empty() ? static_cast<size_t>( -1 ) : m_projection.size();
+    char* pos = begin;
+    for ( ;; ) {
+        if ( !m_projection.empty() && !m_projection[fields.size()] ) {
+            // Skip up to the next projected field in one pass, only tracking quotes.
+            bool quoted = false;
+            for ( ; pos < end; ++pos ) {
+                if ( *pos == m_quote ) {
+                    quoted = !quoted;
+                }
+                else if ( *pos == m_delimiter && !quoted ) {
+                    fields.push_back( FieldView() );
+                    if ( fields.size() == limit || m_projection[fields.size()] )
+                        break;
+                }
+            }
+            if ( pos >= end )
+                fields.push_back( FieldView() );
+        }
+        else if ( pos < end && *pos == m_quote ) {
+            // Unescape in place: the content shifts left over the opening quote and doubled quotes.
+            char* out = pos;
+            char* in = pos + 1;
+            const char* fieldBegin = out;
+            while ( in < end ) {
+                if ( *in == m_quote ) {
+                    if ( in + 1 < end && in[1] == m_quote ) {
+                        *out++ = m_quote;
+                        in += 2;
+                        continue;
+                    }
+                    ++in;
+                    break;
+                }
+                *out++ = *in++;
+            }
+            fields.push_back( FieldView( fieldBegin, out ) );
+            // Anything between the closing quote and the delimiter is ignored.
+            while ( in < end && *in != m_delimiter )
+                ++in;
+            pos = in;
+        }
+        else {
+            char* fieldEnd = pos < end ? static_cast<char*>( std::memchr( pos, m_delimiter, end - pos ) ) : nullptr;
+            if ( fieldEnd == nullptr )
+                fieldEnd = end;
+            fields.push_back( FieldView( pos, fieldEnd ) );
+            pos = fieldEnd;
+        }
+        if ( pos >= end || fields.size() == limit )
+            return;
+        ++pos;   // skip the delimiter
+    }
+}
+
+} // namespace Tableau
+#endif // TableauDelimitedReader_CPP_H
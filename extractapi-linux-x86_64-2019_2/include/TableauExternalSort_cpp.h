@@ -0,0 +1,629 @@
+// -----------------------------------------------------------------------
+// TableauExternalSort_cpp.h
+// -----------------------------------------------------------------------
+// Memory-bounded external sort in front of Table::Insert.
+
+#ifndef TableauExternalSort_CPP_H
+#define TableauExternalSort_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauStickyRow_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  SortKey
+
+  One column of a sort order. Strings sort by code point, not by the
+  column collation.
+
+  ------------------------------------------------------------------------*/
+
+struct SortKey
+{
+    SortKey( int column, bool descending = false ) : column(column), descending(descending) {}
+
+    int column;
+    bool descending;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  ExternalSorter
+
+  Sorts rows by a list of key columns under a fixed memory budget before
+  they are inserted into a table. Buffered rows are sorted with an LSD
+  radix sort on a normalized 64-bit prefix of the first key, with ties
+  broken by an introsort on the full keys. When the buffer exceeds the
+  budget it is written to a temporary run file. <b>Insert</b> merges all
+  runs with a loser tree and streams the result into the table.
+
+  The sort is stable: rows with equal keys keep their insertion order.
+
+  ------------------------------------------------------------------------*/
+
+class ExternalSorter
+{
+  public:
+    /// Initializes an empty sorter.
+    /// @param keys The sort order.
+    /// @param memoryBudget The approximate number of bytes buffered rows may take before a run is spilled.
+    /// @param tempDirectory The directory for run files.
+    ExternalSorter(
+        const std::vector<SortKey>& keys,
+        size_t memoryBudget,
+        const std::string& tempDirectory = "/tmp"
+    );
+
+    /// Removes any remaining run files.
+    ~ExternalSorter();
+
+    /// Adds a row to the sort.
+    void Add( const ValueRow& row );
+
+    /// Sorts all added rows and calls sink( const ValueRow& ) for each of them in order. The sorter is empty afterwards.
+    template <class Sink>
+    void Drain( Sink sink );
+
+    /// Sorts all added rows and inserts them into the table in order. The sorter is empty afterwards.
+    /// @param table The table to insert into; its schema must match the rows.
+    void Insert( Table& table );
+
+    /// Returns the number of runs spilled to disk so far.
+    size_t GetSpilledRunCount() const { return m_spilledRuns; }
+
+    /// Returns the number of bytes written to run files so far.
+    size_t GetSpilledBytes() const { return m_spilledBytes; }
+
+  private:
+    struct Entry
+    {
+        uint64_t prefix;
+        uint32_t index;
+    };
+
+    class RunReader;
+    class Cursor;
+    struct CursorLess;
+
+    uint64_t Prefix( const ValueRow& row ) const;
+    int CompareRows( const ValueRow& a, const ValueRow& b ) const;
+    void SortBuffer();
+    void SpillBuffer();
+    std::string WriteRun( const std::vector<Entry>& order, const std::vector<ValueRow>& rows );
+    Cursor* OpenRun( const std::string& path, size_t bufferSize );
+    std::string MergeToRun( std::vector<Cursor*>& cursors );
+    void Throw( const wchar_t* message ) const;
+
+    std::vector<SortKey> m_keys;
+    size_t m_memoryBudget;
+    std::string m_tempDirectory;
+    std::vector<ValueRow> m_rows;
+    std::vector<Entry> m_order;
+    std::vector<std::string> m_runs;
+    size_t m_bufferedBytes;
+    size_t m_spilledRuns;
+    size_t m_spilledBytes;
+
+    // Forbidden:
+    ExternalSorter( const ExternalSorter& );
+    ExternalSorter& operator=( const ExternalSorter& );
+};
+
+/*------------------------------------------------------------------------
+  ExternalSorter::RunReader
+
+  Buffered sequential reader of one run file.
+
+  ------------------------------------------------------------------------*/
+
+class ExternalSorter::RunReader
+{
+  public:
+    RunReader( const std::string& path, size_t bufferSize )
+        : m_file(std::fopen(path.c_str(), "rb")), m_buffer(bufferSize), m_pos(0), m_end(0) {}
+
+    ~RunReader() { if ( m_file ) std::fclose( m_file ); }
+
+    bool IsOpen() const { return m_file != nullptr; }
+
+    // Reads the next row; returns false at the end of the run.
+    bool Next( ValueRow& row )
+    {
+        uint64_t length;
+        const char* pos;
+        for ( ;; ) {
+            pos = &m_buffer[0] + m_pos;
+            const char* header = pos;
+            if ( ReadVarint( pos, &m_buffer[0] + m_end, length )
+                && static_cast<uint64_t>( &m_buffer[0] + m_end - pos ) >= length ) {
+                m_pos += ( pos - header ) + length;
+                break;
+            }
+            if ( !Fill( 10 + length ) ) {
+                if ( m_end != 0 )
+                    throw TableauException( TAB_RESULT_InvalidFile, L"Truncated sort run file" );
+                return false;
+            }
+        }
+        if ( !DeserializeRow( pos, pos + length, row ) )
+            throw TableauException( TAB_RESULT_InvalidFile, L"Corrupt sort run file" );
+        return true;
+    }
+
+  private:
+    // Moves the unread bytes to the front and reads more; grows the buffer
+    // for rows larger than it.
+    bool Fill( size_t needed )
+    {
+        std::copy( m_buffer.begin() + m_pos, m_buffer.begin() + m_end, m_buffer.begin() );
+        m_end -= m_pos;
+        m_pos = 0;
+        if ( m_buffer.size() < needed )
+            m_buffer.resize( needed );
+        const size_t read = std::fread( &m_buffer[0] + m_end, 1, m_buffer.size() - m_end, m_file );
+        m_end += read;
+        return read > 0;
+    }
+
+    std::FILE* m_file;
+    std::vector<char> m_buffer;
+    size_t m_pos;
+    size_t m_end;
+};
+
+/*------------------------------------------------------------------------
+  ExternalSorter::Cursor
+
+  The current row of one merge input: a run file or the in-memory buffer.
+
+  ------------------------------------------------------------------------*/
+
+class ExternalSorter::Cursor
+{
+  public:
+    Cursor( const ExternalSorter& sorter, RunReader* reader )
+        : m_sorter(sorter), m_reader(reader), m_memory(nullptr), m_next(0), m_done(false) { Advance(); }
+
+    Cursor( const ExternalSorter& sorter, std::vector<ValueRow>* rows, const std::vector<Entry>* order )
+        : m_sorter(sorter), m_reader(nullptr), m_memory(rows), m_order(order), m_next(0), m_done(false) { Advance(); }
+
+    ~Cursor() { delete m_reader; }
+
+    bool IsDone() const { return m_done; }
+    uint64_t GetPrefix() const { return m_prefix; }
+    ValueRow& GetRow() { return m_memory ? ( *m_memory )[m_current] : m_row; }
+
+    void Advance()
+    {
+        if ( m_memory ) {
+            m_done = m_next == m_order->size();
+            if ( !m_done ) {
+                m_current = ( *m_order )[m_next].index;
+                m_prefix = ( *m_order )[m_next++].prefix;
+            }
+        }
+        else {
+            m_done = !m_reader->Next( m_row );
+            if ( !m_done )
+                m_prefix = m_sorter.Prefix( m_row );
+        }
+    }
+
+  private:
+    const ExternalSorter& m_sorter;
+    RunReader* m_reader;
+    std::vector<ValueRow>* m_memory;
+    const std::vector<Entry>* m_order;
+    size_t m_next;
+    size_t m_current;
+    ValueRow m_row;
+    uint64_t m_prefix;
+    bool m_done;
+};
+
+/*------------------------------------------------------------------------
+  ExternalSorter::CursorLess
+
+  Merge order of two cursors. Exhausted cursors lose; cursors are numbered
+  in insertion order, so breaking ties by number keeps the merge stable.
+
+  ------------------------------------------------------------------------*/
+
+struct ExternalSorter::CursorLess
+{
+    CursorLess( const ExternalSorter& sorter, std::vector<Cursor*>& cursors ) : m_sorter(sorter), m_cursors(cursors) {}
+
+    bool operator()( int a, int b ) const
+    {
+        Cursor& x = *m_cursors[a];
+        Cursor& y = *m_cursors[b];
+        if ( x.IsDone() || y.IsDone() )
+            return !x.IsDone() || ( y.IsDone() && a < b );
+        if ( x.GetPrefix() != y.GetPrefix() )
+            return x.GetPrefix() < y.GetPrefix();
+        const int c = m_sorter.CompareRows( x.GetRow(), y.GetRow() );
+        return c != 0 ? c < 0 : a < b;
+    }
+
+    const ExternalSorter& m_sorter;
+    std::vector<Cursor*>& m_cursors;
+};
+
+namespace {
+
+    /*--------------------------------------------------------------------
+      LoserTree
+
+      Tournament tree over k sorted inputs. Internal nodes keep the loser
+      of their match, so replacing the winner only replays the matches on
+      its path to the root: log2(k) comparisons per row.
+
+      --------------------------------------------------------------------*/
+    template <class Less>
+    class LoserTree
+    {
+      public:
+        LoserTree( size_t k, Less less ) : m_k(k), m_tree(k, static_cast<int>(k)), m_less(less)
+        {
+            // Index k is a virtual input that beats every other one; all of
+            // them are pushed out of the tree while it is built.
+            for ( size_t i = k; i-- > 0; )
+                Replay( static_cast<int>( i ) );
+        }
+
+        int Winner() const { return m_tree[0]; }
+
+        // Replays the matches after the winner's input advanced.
+        void Replay( int leaf )
+        {
+            int winner = leaf;
+            for ( size_t node = ( leaf + m_k ) / 2; node > 0; node /= 2 ) {
+                if ( Beats( m_tree[node], winner ) )
+                    std::swap( m_tree[node], winner );
+            }
+            m_tree[0] = winner;
+        }
+
+      private:
+        bool Beats( int a, int b ) const
+        {
+            if ( a == static_cast<int>( m_k ) || b == static_cast<int>( m_k ) )
+                return a == static_cast<int>( m_k );
+            return m_less( a, b );
+        }
+
+        size_t m_k;
+        std::vector<int> m_tree;
+        Less m_less;
+    };
+
+    // Maps a value to an unsigned integer whose order matches Value::Compare
+    // (ties are possible and resolved by the full comparison).
+    inline uint64_t NormalizedPrefix( const Value& value )
+    {
+        if ( value.IsNull() )
+            return 0;
+
+        const uint64_t signBit = uint64_t( 1 ) << 63;
+        uint64_t prefix = 0;
+        switch ( value.GetType() ) {
+            case Type_Double: {
+                const uint64_t bits = static_cast<uint64_t>( value.GetPacked() );
+                return ( bits & signBit ) ? ~bits : ( bits | signBit );
+            }
+            case Type_CharString:
+            case Type_Spatial: {
+                const std::string& s = value.GetCharString();
+                for ( size_t i = 0; i < 8; ++i )
+                    prefix = ( prefix << 8 ) | ( i < s.size() ? static_cast<uint8_t>( s[i] ) : 0 );
+                return prefix;
+            }
+            case Type_UnicodeString: {
+                const std::wstring& s = value.GetString();
+                for ( size_t i = 0; i < 4; ++i ) {
+                    const uint32_t c = i < s.size() ? static_cast<uint32_t>( s[i] ) : 0;
+                    prefix = ( prefix << 16 ) | std::min<uint32_t>( c, 0xFFFF );
+                }
+                return prefix;
+            }
+            default:
+                return static_cast<uint64_t>( value.GetPacked() ) ^ signBit;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// ExternalSorter methods
+// -----------------------------------------------------------------------
+
+inline ExternalSorter::ExternalSorter(
+    const std::vector<SortKey>& keys,
+    size_t memoryBudget,
+    const std::string& tempDirectory
+) : m_keys(keys),
+    m_memoryBudget(memoryBudget),
+    m_tempDirectory(tempDirectory),
+    m_bufferedBytes(0),
+    m_spilledRuns(0),
+    m_spilledBytes(0)
+{
+    if ( m_keys.empty() )
+        throw TableauException( TAB_RESULT_InvalidArgument, L"ExternalSorter needs at least one sort key" );
+}
+
+inline ExternalSorter::~ExternalSorter()
+{
+    for ( size_t i = 0; i < m_runs.size(); ++i )
+        std::remove( m_runs[i].c_str() );
+}
+
+inline void ExternalSorter::Add( const ValueRow& row )
+{
+    size_t bytes = sizeof( ValueRow ) + sizeof( Entry ) + row.size() * sizeof( Value );
+    for ( size_t i = 0; i < row.size(); ++i )
+        bytes += row[i].GetCharString().capacity() + row[i].GetString().capacity() * sizeof( wchar_t );
+
+    if ( m_bufferedBytes + bytes > m_memoryBudget && !m_rows.empty() )
+        SpillBuffer();
+
+    m_rows.push_back( row );
+    m_bufferedBytes += bytes;
+}
+
+inline uint64_t ExternalSorter::Prefix( const ValueRow& row ) const
+{
+    const uint64_t prefix = NormalizedPrefix( row[m_keys[0].column] );
+    return m_keys[0].descending ? ~prefix : prefix;
+}
+
+inline int ExternalSorter::CompareRows( const ValueRow& a, const ValueRow& b ) const
+{
+    for ( size_t i = 0; i < m_keys.size(); ++i ) {
+        const int c = a[m_keys[i].column].Compare( b[m_keys[i].column] );
+        if ( c != 0 )
+            return m_keys[i].descending ? -c : c;
+    }
+    return 0;
+}
+
+inline void ExternalSorter::SortBuffer()
+{
+    const size_t n = m_rows.size();
+    m_order.resize( n );
+    for ( size_t i = 0; i < n; ++i ) {
+        m_order[i].prefix = Prefix( m_rows[i] );
+        m_order[i].index = static_cast<uint32_t>( i );
+    }
+
+    // LSD radix sort on the prefix, one byte per pass; passes where every
+    // entry has the same byte are skipped. Being stable, it keeps equal
+    // prefixes in insertion order.
+    std::vector<Entry> scratch( n );
+    for ( int shift = 0; shift < 64; shift += 8 ) {
+        size_t counts[257] = { 0 };
+        for ( size_t i = 0; i < n; ++i )
+            ++counts[( ( m_order[i].prefix >> shift ) & 0xFF ) + 1];
+        if ( n == 0 || counts[( ( m_order[0].prefix >> shift ) & 0xFF ) + 1] == n )
+            continue;
+        for ( int b = 0; b < 256; ++b )
+            counts[b + 1] += counts[b];
+        for ( size_t i = 0; i < n; ++i )
+            scratch[counts[( m_order[i].prefix >> shift ) & 0xFF]++] = m_order[i];
+        m_order.swap( scratch );
+    }
+
+    // Runs of equal prefixes are ordered by the full keys; the index keeps
+    // the result stable.
+    for ( size_t begin = 0; begin < n; ) {
+        size_t end = begin + 1;
+        while ( end < n && m_order[end].prefix == m_order[begin].prefix )
+            ++end;
+        if ( end - begin > 1 ) {
+            std::sort( m_order.begin() + begin, m_order.begin() + end, [this]( const Entry& a, const Entry& b ) {
+                const int c = CompareRows( m_rows[a.index], m_rows[b.index] );
+                return c != 0 ? c < 0 : a.index < b.index;
+            } );
+        }
+        begin = end;
+    }
+}
+
+inline void ExternalSorter::SpillBuffer()
+{
+    SortBuffer();
+    m_runs.push_back( WriteRun( m_order, m_rows ) );
+    m_rows.clear();
+    m_order.clear();
+    m_bufferedBytes = 0;
+}
+
+inline std::string ExternalSorter::WriteRun( const std::vector<Entry>& order, const std::vector<ValueRow>& rows )
+{
+    std::string path = m_tempDirectory + "/tableau-sort-XXXXXX";
+    const int fd = mkstemp( &path[0] );
+    std::FILE* file = fd < 0 ? nullptr : fdopen( fd, "wb" );
+    if ( file == nullptr )
+        Throw( L"Could not create a sort run file" );
+
+    std::string record, buffer;
+    for ( size_t i = 0; i < order.size(); ++i ) {
+        record.clear();
+        SerializeRow( rows[order[i].index], record );
+        AppendVarint( buffer, record.size() );
+        buffer += record;
+        if ( buffer.size() >= ( 1 << 20 ) || i + 1 == order.size() ) {
+            if ( std::fwrite( buffer.data(), 1, buffer.size(), file ) != buffer.size() ) {
+                std::fclose( file );
+                std::remove( path.c_str() );
+                Throw( L"Could not write a sort run file" );
+            }
+            m_spilledBytes += buffer.size();
+            buffer.clear();
+        }
+    }
+    if ( std::fclose( file ) != 0 ) {
+        std::remove( path.c_str() );
+        Throw( L"Could not write a sort run file" );
+    }
+    ++m_spilledRuns;
+    return path;
+}
+
+template <class Sink>
+inline void ExternalSorter::Drain( Sink sink )
+{
+    // Each open run gets a read buffer of at least 64 KiB; if there are more
+    // runs than the budget allows buffers for, merge groups of them into
+    // longer runs first.
+    const size_t minBuffer = 64 * 1024;
+    const size_t fanIn = std::max<size_t>( 2, m_memoryBudget / minBuffer );
+    // Each pass merges consecutive groups, so the runs stay in insertion
+    // order and the tie-breaking by run number stays valid.
+    while ( m_runs.size() + 1 > fanIn ) {
+        std::vector<std::string> merged;
+        for ( size_t group = 0; group < m_runs.size(); group += fanIn ) {
+            const size_t groupEnd = std::min( m_runs.size(), group + fanIn );
+            if ( groupEnd - group == 1 ) {
+                merged.push_back( m_runs[group] );
+                continue;
+            }
+            std::vector<Cursor*> cursors;
+            try {
+                for ( size_t i = group; i < groupEnd; ++i )
+                    cursors.push_back( OpenRun( m_runs[i], m_memoryBudget / fanIn ) );
+            }
+            catch ( ... ) {
+                for ( size_t i = 0; i < cursors.size(); ++i )
+                    delete cursors[i];
+                throw;
+            }
+            merged.push_back( MergeToRun( cursors ) );
+            // Point the merged entries at the new run so the destructor
+            // still removes it if a later group fails.
+            for ( size_t i = group; i < groupEnd; ++i ) {
+                std::remove( m_runs[i].c_str() );
+                m_runs[i] = merged.back();
+            }
+        }
+        m_runs.swap( merged );
+    }
+
+    SortBuffer();
+    std::vector<Cursor*> cursors;
+    const size_t bufferSize = std::max( minBuffer, m_memoryBudget / ( m_runs.size() + 1 ) / 2 );
+    try {
+        for ( size_t i = 0; i < m_runs.size(); ++i )
+            cursors.push_back( OpenRun( m_runs[i], bufferSize ) );
+        // The last buffer is merged straight from memory.
+        cursors.push_back( new Cursor( *this, &m_rows, &m_order ) );
+
+        LoserTree<CursorLess> tree( cursors.size(), CursorLess( *this, cursors ) );
+        while ( !cursors[tree.Winner()]->IsDone() ) {
+            const int winner = tree.Winner();
+            sink( const_cast<const ValueRow&>( cursors[winner]->GetRow() ) );
+            cursors[winner]->Advance();
+            tree.Replay( winner );
+        }
+    }
+    catch ( ... ) {
+        for ( size_t i = 0; i < cursors.size(); ++i )
+            delete cursors[i];
+        throw;
+    }
+
+    for ( size_t i = 0; i < cursors.size(); ++i )
+        delete cursors[i];
+    for ( size_t i = 0; i < m_runs.size(); ++i )
+        std::remove( m_runs[i].c_str() );
+    m_runs.clear();
+    m_rows.clear();
+    m_order.clear();
+    m_bufferedBytes = 0;
+}
+
+inline ExternalSorter::Cursor* ExternalSorter::OpenRun( const std::string& path, size_t bufferSize )
+{
+    RunReader* reader = new RunReader( path, bufferSize );
+    if ( !reader->IsOpen() ) {
+        delete reader;
+        Throw( L"Could not open a sort run file" );
+    }
+    try {
+        return new Cursor( *this, reader );
+    }
+    catch ( ... ) {
+        delete reader;
+        throw;
+    }
+}
+
+inline std::string ExternalSorter::MergeToRun( std::vector<Cursor*>& cursors )
+{
+    std::string path = m_tempDirectory + "/tableau-sort-XXXXXX";
+    const int fd = mkstemp( &path[0] );
+    std::FILE* file = fd < 0 ? nullptr : fdopen( fd, "wb" );
+    if ( file == nullptr ) {
+        for ( size_t i = 0; i < cursors.size(); ++i )
+            delete cursors[i];
+        Throw( L"Could not create a sort run file" );
+    }
+
+    bool ok = true;
+    std::string record, buffer;
+    LoserTree<CursorLess> tree( cursors.size(), CursorLess( *this, cursors ) );
+    while ( ok && !cursors[tree.Winner()]->IsDone() ) {
+        const int winner = tree.Winner();
+        record.clear();
+        SerializeRow( cursors[winner]->GetRow(), record );
+        AppendVarint( buffer, record.size() );
+        buffer += record;
+        cursors[winner]->Advance();
+        tree.Replay( winner );
+        if ( buffer.size() >= ( 1 << 20 ) || cursors[tree.Winner()]->IsDone() ) {
+            ok = std::fwrite( buffer.data(), 1, buffer.size(), file ) == buffer.size();
+            m_spilledBytes += buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = std::fclose( file ) == 0 && ok;
+
+    for ( size_t i = 0; i < cursors.size(); ++i )
+        delete cursors[i];
+    if ( !ok ) {
+        std::remove( path.c_str() );
+        Throw( L"Could not write a sort run file" );
+    }
+    ++m_spilledRuns;
+    return path;
+}
+
+inline void ExternalSorter::Insert( Table& table )
+{
+    // Sorted output repeats key values in consecutive rows, which StickyRow
+    // turns into skipped cells.
+    std::shared_ptr<TableDefinition> schema = table.GetTableDefinition();
+    StickyRow row( *schema );
+    Drain( [&table, &row]( const ValueRow& values ) {
+        for ( size_t i = 0; i < values.size(); ++i )
+            row.SetValue( static_cast<int>( i ), values[i] );
+        table.Insert( row.GetRow() );
+    } );
+}
+
+inline void ExternalSorter::Throw( const wchar_t* message ) const
+{
+    throw TableauException( errno != 0 ? errno : TAB_RESULT_InternalError, message );
+}
+
+} // namespace Tableau
+#endif // TableauExternalSort_CPP_H
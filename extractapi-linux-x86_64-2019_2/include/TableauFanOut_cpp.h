@@ -0,0 +1,522 @@
+// -----------------------------------------------------------------------
+// TableauFanOut_cpp.h
+// -----------------------------------------------------------------------
+// Loads one pass over delimited feeds into several extracts at once.
+
+#ifndef TableauFanOut_CPP_H
+#define TableauFanOut_CPP_H
+
+#include "TableauBoundedQueue_cpp.h"
+#include "TableauCancellation_cpp.h"
+#include "TableauDelimitedReader_cpp.h"
+#include "TableauFeedLoader_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchemaFile_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauValue_cpp.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  FanOutOptions
+
+  Batching of a FanOutLoader. Each output may fall up to queueBatches
+  batches behind the parser before the parser waits for it.
+
+  ------------------------------------------------------------------------*/
+
+struct FanOutOptions
+{
+    FanOutOptions() : batchRecords(4096), queueBatches(8) {}
+
+    size_t batchRecords;    // records parsed and converted before they are handed to the outputs
+    size_t queueBatches;    // batches queued per output
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  FanOutLoader
+
+  Loads delimited files into several extracts, each described by its own
+  schema file, while reading and splitting the input only once. Fields
+  that several schemas read with the same type and null tokens are also
+  converted only once; the collation of a column does not matter for
+  this, as it only applies in the extract.
+
+  The records are converted into batches of Values on the calling thread.
+  Every output has a writer thread that sets the values of its columns in
+  its rows and inserts them, so the outputs are written in parallel. The
+  queues to the writers are bounded: the slowest output decides the pace
+  of the load, and the others run ahead of it by at most
+  FanOutOptions::queueBatches batches.
+
+  An output whose writer fails, e.g. on a full disk, stops taking batches
+  and its partial extract is deleted; the other outputs are still loaded
+  to the end and kept, and <b>Load</b> then throws the first error. An
+  input that cannot be read fails the whole load, and all partial
+  extracts are deleted, as they are when the load is cancelled. So are
+  the extracts already created when another output's extract or table
+  cannot be created; Load throws before reading any input then.
+
+  ------------------------------------------------------------------------*/
+
+class FanOutLoader
+{
+  public:
+    /// Initializes a loader without outputs.
+    explicit FanOutLoader( const FanOutOptions& options = FanOutOptions() );
+
+    /// Adds an extract to load.
+    /// @param schema The schema of the extract's table; all outputs must agree on the delimiter and the header.
+    /// @param extractPath The path of the extract to create.
+    /// @return The index of the output in the stats Load returns.
+    size_t AddOutput( const SchemaFile& schema, const std::wstring& extractPath );
+
+    /// Loads files into all outputs and closes their extracts.
+    /// @param inputPaths The files, read in order.
+    /// @param token Checked every FeedLoader::CANCEL_CHECK_RECORDS records; once cancelled, the partial extracts are closed and deleted.
+    /// @return The stats of each output.
+    /// @throws TableauException The first error of the input or an output, once every output has finished.
+    std::vector<LoadStats> Load( const std::vector<std::string>& inputPaths, const CancellationToken& token = CancellationToken() );
+
+    /// Returns the number of outputs.
+    size_t GetOutputCount() const { return m_outputs.size(); }
+
+    /// Returns the number of distinct conversions per record, which the outputs share.
+    size_t GetConversionCount() const { return m_slots.size(); }
+
+  private:
+    // A converted input field, shared by all columns that read it alike.
+    struct Slot
+    {
+        std::string source;
+        long sourceIndex;
+        Type type;
+        std::vector<std::string> nullTokens;
+        ValueConverter convert;
+    };
+
+    // Converted records, one Value per slot, and whether each conversion failed.
+    struct Batch
+    {
+        explicit Batch( size_t values ) : values(values), failed(values), records(0), bytes(0), target(this->values) {}
+
+        ValueRow values;
+        std::vector<char> failed;
+        size_t records;
+        uint64_t bytes;         // input bytes read for the records
+        ValueRowTarget target;
+    };
+
+    // Recycles batches once every output has written them.
+    class BatchPool
+    {
+      public:
+        explicit BatchPool( size_t values ) : m_values(values) {}
+
+        std::shared_ptr<Batch> Acquire();
+
+      private:
+        size_t m_values;
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<Batch> > m_batches;
+        std::vector<Batch*> m_free;
+    };
+
+    struct Output
+    {
+        std::wstring tableName;
+        std::vector<ColumnSpec> columns;
+        std::wstring path;
+        std::vector<size_t> slots;      // slot of each column
+
+        std::unique_ptr<TableDefinition> tableDefinition;
+        std::unique_ptr<Extract> extract;
+        std::shared_ptr<Table> table;
+        std::unique_ptr<BoundedQueue<std::shared_ptr<const Batch> > > queue;
+        std::thread writer;
+        std::exception_ptr error;
+        LoadStats stats;
+    };
+
+    void Parse( const std::string& inputPath, BatchPool& pool, std::shared_ptr<Batch>& batch, uint64_t& records,
+                const CancellationToken& token, bool& cancelled );
+    void Dispatch( std::shared_ptr<Batch>& batch );
+    void Write( Output& output, const std::atomic<bool>& discard );
+    static void Abandon( Output& output );
+
+    FanOutOptions m_options;
+    char m_delimiter;
+    bool m_header;
+    std::vector<Slot> m_slots;
+    std::vector<std::unique_ptr<Output> > m_outputs;
+
+    // Forbidden:
+    FanOutLoader( const FanOutLoader& );
+    FanOutLoader& operator=( const FanOutLoader& );
+};
+
+// -----------------------------------------------------------------------
+// FanOutLoader methods
+// -----------------------------------------------------------------------
+
+inline FanOutLoader::FanOutLoader(
+    const FanOutOptions& options
+) : m_options(options),
+    m_delimiter(','),
+    m_header(true)
+{
+    m_options.batchRecords = std::max<size_t>( m_options.batchRecords, 1 );
+}
+
+inline size_t FanOutLoader::AddOutput(
+    const SchemaFile& schema,
+    const std::wstring& extractPath
+)
+{
+    if ( m_outputs.empty() ) {
+        m_delimiter = schema.GetDelimiter();
+        m_header = schema.HasHeader();
+    }
+    else if ( schema.GetDelimiter() != m_delimiter || schema.HasHeader() != m_header ) {
+        throw TableauException( TAB_RESULT_InvalidArgument, L"Outputs read the input with different delimiters or headers" );
+    }
+
+    std::unique_ptr<Output> output( new Output );
+    output->tableName = schema.GetTableName();
+    output->columns = schema.GetColumns();
+    output->path = extractPath;
+    const std::vector<SchemaField>& fields = schema.GetFields();
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        const SchemaField& field = fields[i];
+        size_t s = 0;
+        while ( s < m_slots.size() && !( m_slots[s].sourceIndex == field.sourceIndex && m_slots[s].source == field.source &&
+                                         m_slots[s].type == field.column.type && m_slots[s].nullTokens == field.nullTokens ) )
+            ++s;
+        if ( s == m_slots.size() ) {
+            Slot slot;
+            slot.source = field.source;
+            slot.sourceIndex = field.sourceIndex;
+            slot.type = field.column.type;
+            slot.nullTokens = field.nullTokens;
+            slot.convert = ConverterFor<ValueRowTarget>( field.column.type );
+            m_slots.push_back( slot );
+        }
+        output->slots.push_back( s );
+    }
+    m_outputs.push_back( std::move( output ) );
+    return m_outputs.size() - 1;
+}
+
+inline std::vector<LoadStats>
+FanOutLoader::Load(
+    const std::vector<std::string>& inputPaths,
+    const CancellationToken& token
+)
+{
+    uint64_t expected = 0;
+    for ( size_t i = 0; i < inputPaths.size(); ++i ) {
+        struct stat info;
+        if ( ::stat( inputPaths[i].c_str(), &info ) == 0 )
+            expected += static_cast<uint64_t>( info.st_size );
+    }
+
+    // Table definitions are not safe to build concurrently, so the tables
+    // are all created here before the writers start.
+    size_t created = 0;
+    try {
+        for ( ; created < m_outputs.size(); ++created ) {
+            Output& output = *m_outputs[created];
+            output.stats = LoadStats();
+            output.error = std::exception_ptr();
+            output.tableDefinition.reset( new TableDefinition );
+            AddColumns( *output.tableDefinition, output.columns );
+            output.extract.reset( new Extract( output.path ) );
+            output.table = output.extract->AddTable( output.tableName, *output.tableDefinition );
+            output.table->GetProgressCounters().AddExpected( 0, expected );
+            output.queue.reset( new BoundedQueue<std::shared_ptr<const Batch> >( m_options.queueBatches ) );
+        }
+    }
+    catch ( ... ) {
+        // The extracts created so far are deleted. The failed output's
+        // extract is only closed, as its file may have existed before.
+        Output& failed = *m_outputs[created];
+        failed.table.reset();
+        try {
+            if ( failed.extract )
+                failed.extract->Close();
+        }
+        catch ( ... ) {
+            // The first error is the one reported.
+        }
+        failed.extract.reset();
+        failed.queue.reset();
+        failed.tableDefinition.reset();
+        for ( size_t i = 0; i < created; ++i ) {
+            Abandon( *m_outputs[i] );
+            m_outputs[i]->queue.reset();
+            m_outputs[i]->tableDefinition.reset();
+        }
+        throw;
+    }
+
+    // Declared before the writers start, as they release batches until they are joined.
+    BatchPool pool( m_options.batchRecords * m_slots.size() );
+    std::atomic<bool> discard( false );
+    size_t started = 0;
+    try {
+        for ( ; started < m_outputs.size(); ++started )
+            m_outputs[started]->writer = std::thread( &FanOutLoader::Write, this, std::ref( *m_outputs[started] ), std::cref( discard ) );
+    }
+    catch ( ... ) {
+        // The started writers delete their extracts, the others are deleted here.
+        discard = true;
+        for ( size_t i = 0; i < m_outputs.size(); ++i )
+            m_outputs[i]->queue->Close();
+        for ( size_t i = 0; i < m_outputs.size(); ++i ) {
+            if ( i < started )
+                m_outputs[i]->writer.join();
+            else
+                Abandon( *m_outputs[i] );
+            m_outputs[i]->queue.reset();
+            m_outputs[i]->tableDefinition.reset();
+        }
+        throw;
+    }
+
+    std::exception_ptr error;
+    bool cancelled = token.IsCancelled();
+    try {
+        std::shared_ptr<Batch> batch;
+        uint64_t records = 0;
+        for ( size_t i = 0; i < inputPaths.size() && !cancelled; ++i )
+            Parse( inputPaths[i], pool, batch, records, token, cancelled );
+        if ( batch && !cancelled )
+            Dispatch( batch );
+    }
+    catch ( ... ) {
+        error = std::current_exception();
+    }
+
+    // Closing the queues lets the writers finish; they close their extracts,
+    // and delete them if the load failed or their own writer did.
+    discard = cancelled || error;
+    for ( size_t i = 0; i < m_outputs.size(); ++i )
+        m_outputs[i]->queue->Close();
+    std::vector<LoadStats> stats;
+    for ( size_t i = 0; i < m_outputs.size(); ++i ) {
+        Output& output = *m_outputs[i];
+        output.writer.join();
+        if ( !error )
+            error = output.error;
+        output.stats.cancelled = cancelled;
+        stats.push_back( output.stats );
+        output.queue.reset();
+        output.tableDefinition.reset();
+    }
+    if ( error )
+        std::rethrow_exception( error );
+    return stats;
+}
+
+inline void FanOutLoader::Parse(
+    const std::string& inputPath,
+    BatchPool& pool,
+    std::shared_ptr<Batch>& batch,
+    uint64_t& records,
+    const CancellationToken& token,
+    bool& cancelled
+)
+{
+    DelimitedReader reader( inputPath, m_delimiter );
+    std::vector<FieldView> fields;
+    std::vector<std::string> header;
+    if ( m_header ) {
+        if ( !reader.Next( fields ) )
+            return;
+        for ( size_t i = 0; i < fields.size(); ++i )
+            header.push_back( std::string( fields[i].begin, fields[i].end ) );
+    }
+
+    // The slots are resolved against each file's header, like a ConversionPlan.
+    std::vector<size_t> fieldOf( m_slots.size() );
+    std::vector<bool> projection;
+    for ( size_t s = 0; s < m_slots.size(); ++s ) {
+        size_t field = 0;
+        if ( m_slots[s].sourceIndex >= 0 ) {
+            field = static_cast<size_t>( m_slots[s].sourceIndex );
+        }
+        else {
+            while ( field < header.size() && header[field] != m_slots[s].source )
+                ++field;
+            if ( field == header.size() )
+                throw TableauException( TAB_RESULT_InvalidArgument,
+                                        L"Input has no field '" + WidenUtf8( m_slots[s].source ) + L"'" );
+        }
+        fieldOf[s] = field;
+        if ( projection.size() <= field )
+            projection.resize( field + 1, false );
+        projection[field] = true;
+    }
+    reader.SetProjection( projection );
+
+    ConversionScratch scratch;
+    uint64_t reported = 0;
+    while ( reader.Next( fields ) ) {
+        if ( ++records % FeedLoader::CANCEL_CHECK_RECORDS == 0 && token.IsCancelled() ) {
+            cancelled = true;
+            return;
+        }
+        if ( !batch )
+            batch = pool.Acquire();
+        const size_t base = batch->records * m_slots.size();
+        for ( size_t s = 0; s < m_slots.size(); ++s ) {
+            const Slot& slot = m_slots[s];
+            const int index = static_cast<int>( base + s );
+            if ( fieldOf[s] >= fields.size() ) {
+                batch->failed[index] = true;
+                continue;
+            }
+            const FieldView& field = fields[fieldOf[s]];
+            bool null = false;
+            for ( size_t j = 0; j < slot.nullTokens.size() && !null; ++j )
+                null = field.Equals( slot.nullTokens[j] );
+            if ( null ) {
+                batch->values[index].SetNull( slot.type );
+                batch->failed[index] = false;
+            }
+            else {
+                batch->failed[index] = !slot.convert( batch->target, index, field, scratch );
+            }
+        }
+        batch->bytes += reader.GetBytesRead() - reported;
+        reported = reader.GetBytesRead();
+        if ( ++batch->records == m_options.batchRecords )
+            Dispatch( batch );
+    }
+    if ( reader.GetBytesRead() > reported ) {
+        if ( !batch )
+            batch = pool.Acquire();
+        batch->bytes += reader.GetBytesRead() - reported;
+    }
+}
+
+inline void FanOutLoader::Dispatch(
+    std::shared_ptr<Batch>& batch
+)
+{
+    std::shared_ptr<const Batch> shared( std::move( batch ) );
+    // A failed writer closes its queue, so pushes to it fail and the
+    // other outputs carry on.
+    for ( size_t i = 0; i < m_outputs.size(); ++i )
+        m_outputs[i]->queue->Push( shared );
+}
+
+inline void FanOutLoader::Write(
+    Output& output,
+    const std::atomic<bool>& discard
+)
+{
+    try {
+        Row row( *output.tableDefinition );
+        ProgressCounters& progress = output.table->GetProgressCounters();
+        const size_t width = m_slots.size();
+        std::shared_ptr<const Batch> batch;
+        while ( output.queue->Pop( batch ) ) {
+            if ( discard )
+                continue;
+            for ( size_t r = 0; r < batch->records; ++r ) {
+                const size_t base = r * width;
+                size_t c = 0;
+                while ( c < output.slots.size() && !batch->failed[base + output.slots[c]] )
+                    ++c;
+                if ( c < output.slots.size() ) {
+                    ++output.stats.rejected;
+                    continue;
+                }
+                for ( c = 0; c < output.slots.size(); ++c )
+                    batch->values[base + output.slots[c]].SetInRow( row, static_cast<int>( c ) );
+                output.table->Insert( row );
+                ++output.stats.rows;
+            }
+            output.stats.bytes += batch->bytes;
+            progress.AddInputBytes( batch->bytes );
+            batch.reset();
+        }
+    }
+    catch ( ... ) {
+        output.error = std::current_exception();
+        output.queue->Close();
+    }
+
+    try {
+        output.table.reset();
+        output.extract->Close();
+    }
+    catch ( ... ) {
+        if ( !output.error )
+            output.error = std::current_exception();
+    }
+    output.extract.reset();
+    if ( discard || output.error ) {
+        // The API cannot abandon an extract, so it is saved and then deleted.
+        RemoveFile( output.path );
+        output.stats.discarded = true;
+    }
+}
+
+inline void FanOutLoader::Abandon(
+    Output& output
+)
+{
+    try {
+        output.table.reset();
+        output.extract->Close();
+    }
+    catch ( ... ) {
+        // The file is deleted either way.
+    }
+    output.extract.reset();
+    RemoveFile( output.path );
+}
+
+// -----------------------------------------------------------------------
+// FanOutLoader::BatchPool methods
+// -----------------------------------------------------------------------
+
+inline std::shared_ptr<FanOutLoader::Batch> FanOutLoader::BatchPool::Acquire()
+{
+    Batch* batch;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if ( m_free.empty() ) {
+            m_batches.push_back( std::unique_ptr<Batch>( new Batch( m_values ) ) );
+            batch = m_batches.back().get();
+        }
+        else {
+            batch = m_free.back();
+            m_free.pop_back();
+        }
+    }
+    batch->records = 0;
+    batch->bytes = 0;
+    // The last output to drop the batch hands it back to the pool.
+    return std::shared_ptr<Batch>( batch, [this]( Batch* released ) {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_free.push_back( released );
+    } );
+}
+
+} // namespace Tableau
+#endif // TableauFanOut_CPP_H
@@ -0,0 +1,778 @@
+// -----------------------------------------------------------------------
+// TableauFeedLoader_cpp.h
+// -----------------------------------------------------------------------
+// Loads delimited feeds into extracts through precompiled conversion plans.
+
+#ifndef TableauFeedLoader_CPP_H
+#define TableauFeedLoader_CPP_H
+
+#include "TableauCancellation_cpp.h"
+#include "TableauDelimitedReader_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSampling_cpp.h"
+#include "TableauSchemaFile_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ConversionScratch
+
+  Buffers a converter may use while setting a value. Each loading thread
+  owns one, so the plans themselves stay immutable and shareable.
+
+  ------------------------------------------------------------------------*/
+
+struct ConversionScratch
+{
+    std::string text;
+    std::vector<TableauWChar> utf16;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  ValueRowTarget
+
+  Receives converted fields in place of a Row and keeps them in a
+  ValueRow, so one conversion of a record can be written to the rows of
+  several tables.
+
+  ------------------------------------------------------------------------*/
+
+class ValueRowTarget
+{
+  public:
+    /// @param values The row to set; it needs one value per column.
+    explicit ValueRowTarget( ValueRow& values ) : m_values(values) {}
+
+    void SetNull( int columnNumber, Type type ) { m_values[columnNumber].SetNull( type ); }
+    void SetLongInteger( int columnNumber, int64_t value ) { m_values[columnNumber].SetInteger( value ); }
+    void SetDouble( int columnNumber, double value ) { m_values[columnNumber].SetDouble( value ); }
+    void SetBoolean( int columnNumber, bool value ) { m_values[columnNumber].SetBoolean( value ); }
+    void SetDate( int columnNumber, int year, int month, int day ) { m_values[columnNumber].SetDate( year, month, day ); }
+    void SetDateTime( int columnNumber, int year, int month, int day, int hour, int min, int sec, int frac )
+    {
+        m_values[columnNumber].SetDateTime( year, month, day, hour, min, sec, frac );
+    }
+    void SetDuration( int columnNumber, int day, int hour, int minute, int second, int frac )
+    {
+        m_values[columnNumber].SetDuration( day, hour, minute, second, frac );
+    }
+    void SetCharString( int columnNumber, const std::string& value ) { m_values[columnNumber].SetCharString( value ); }
+    void SetSpatial( int columnNumber, const std::string& value ) { m_values[columnNumber].SetSpatial( value ); }
+
+    /// Takes a zero-terminated UTF-16 string, as the UnicodeString converter produces it.
+    void SetTableauString( int columnNumber, const TableauWChar* value )
+    {
+        m_text.clear();
+        for ( ; *value != 0; ++value ) {
+            const unsigned int unit = *value;
+            if ( unit >= 0xD800 && unit < 0xDC00 && value[1] >= 0xDC00 && value[1] < 0xE000 ) {
+                m_text.push_back( static_cast<wchar_t>( 0x10000 + ( ( unit - 0xD800 ) << 10 ) + ( value[1] - 0xDC00 ) ) );
+                ++value;
+            }
+            else {
+                m_text.push_back( static_cast<wchar_t>( unit ) );
+            }
+        }
+        m_values[columnNumber].SetString( m_text );
+    }
+
+  private:
+    ValueRow& m_values;
+    std::wstring m_text;
+};
+
+/// Parses a field and sets it in the specified column of a row.
+/// @return False if the field is not a valid value of the column's type.
+typedef bool (*FieldConverter)( Row& row, int columnNumber, const FieldView& field, ConversionScratch& scratch );
+
+/// Parses a field and sets it in the specified column of a ValueRow.
+/// @return False if the field is not a valid value of the column's type.
+typedef bool (*ValueConverter)( ValueRowTarget& values, int columnNumber, const FieldView& field, ConversionScratch& scratch );
+
+/*------------------------------------------------------------------------
+  CLASS
+  ConversionPlan
+
+  A schema resolved against one input layout: for each column, the input
+  field it reads, its null tokens, and the converter for its type. Applying
+  the plan to a record runs straight through this flat list, without any
+  name lookups or type dispatch per row.
+
+  ------------------------------------------------------------------------*/
+
+class ConversionPlan
+{
+  public:
+    /// Resolves the schema's sources against a header.
+    /// @param schema The schema.
+    /// @param header The field names of the input; empty if the input has no header.
+    ConversionPlan( const SchemaFile& schema, const std::vector<std::string>& header );
+
+    /// Builds the plan for records of one field per column, in column order, as <b>Select</b> picks them.
+    /// @param schema The schema.
+    explicit ConversionPlan( const SchemaFile& schema );
+
+    /// Sets the columns of a row from the fields of one record.
+    /// @param row The row to set the values in.
+    /// @param fields The fields of the record.
+    /// @param scratch Buffers owned by the calling thread.
+    /// @return False if the record is too short or a field does not convert; the row must not be inserted then.
+    bool Apply( Row& row, const std::vector<FieldView>& fields, ConversionScratch& scratch ) const;
+
+    /// Returns the number of fields a record needs.
+    size_t GetRequiredFieldCount() const { return m_requiredFields; }
+
+    /// Returns true for each input field a column reads, up to the last one.
+    std::vector<bool> GetProjection() const;
+
+    /// Returns the input field a column reads.
+    size_t GetField( int column ) const { return m_steps[column].field; }
+
+    /// Picks the fields the columns read out of a record, in column order.
+    /// @param fields The fields of the record; at least <b>GetRequiredFieldCount</b>.
+    /// @param selected Receives one field per column.
+    void Select( const std::vector<FieldView>& fields, std::vector<FieldView>& selected ) const;
+
+  private:
+    struct Step
+    {
+        FieldConverter convert;
+        int column;
+        size_t field;
+        std::vector<std::string> nullTokens;
+    };
+
+    std::vector<Step> m_steps;
+    size_t m_requiredFields;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  PlanCache
+
+  Keeps the conversion plans built so far, keyed by schema fingerprint and
+  header, so that a loader reading many files of the same feed resolves
+  the schema only once. Safe to use from several threads.
+
+  ------------------------------------------------------------------------*/
+
+class PlanCache
+{
+  public:
+    PlanCache() : m_builds(0) {}
+
+    /// Returns the plan for a schema and header, building it on first use.
+    std::shared_ptr<const ConversionPlan> Get( const SchemaFile& schema, const std::vector<std::string>& header );
+
+    /// Returns the number of plans built, i.e. cache misses.
+    size_t GetBuildCount() const;
+
+    /// Returns the process-wide cache.
+    static PlanCache& Global()
+    {
+        static PlanCache cache;
+        return cache;
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::shared_ptr<const ConversionPlan> > m_plans;
+    size_t m_builds;
+
+    // Forbidden:
+    PlanCache( const PlanCache& );
+    PlanCache& operator=( const PlanCache& );
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  LoadStats
+
+  Outcome of loading one input file.
+
+  ------------------------------------------------------------------------*/
+
+struct LoadStats
+{
+    LoadStats() : rows(0), rejected(0), bytes(0), previewRows(0), cancelled(false), discarded(false) {}
+
+    uint64_t rows;          // records inserted
+    uint64_t rejected;      // records skipped because they were short or did not convert
+    uint64_t bytes;         // input bytes read
+    uint64_t previewRows;   // rows in the published preview extract
+    bool cancelled;         // the load stopped early because its token was cancelled
+    bool discarded;         // the partial extract was closed and deleted
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  PreviewOptions
+
+  Asks FeedLoader for a preview extract of sampled rows next to the full
+  one. No preview is built while rows is zero.
+
+  ------------------------------------------------------------------------*/
+
+struct PreviewOptions
+{
+    PreviewOptions() : rows(0), strataColumn(-1), seed(1) {}
+
+    size_t rows;            // sample size, per stratum if stratified
+    int strataColumn;       // schema column whose value selects the stratum; -1 samples uniformly
+    uint64_t seed;
+    std::wstring path;      // empty puts "-preview" before the extension of the extract path
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  FeedLoader
+
+  Loads delimited files described by a schema file into extracts. Only
+  the fields the schema reads are split out of the records and converted.
+
+  A load can also fill a RecordSampler with the records it inserts, for a
+  small preview extract that is published as soon as the input has been
+  read, long before the full extract is closed. Skipped records cost the
+  sampler a counter comparison (a stratum lookup if stratified); sampled
+  ones are copied as text and converted again when the preview is built.
+
+  ------------------------------------------------------------------------*/
+
+class FeedLoader
+{
+  public:
+    /// Initializes a loader.
+    /// @param schema The schema of the input files.
+    /// @param cache The cache to take conversion plans from.
+    FeedLoader( const SchemaFile& schema, PlanCache& cache = PlanCache::Global() )
+        : m_schema(schema), m_cache(cache) {}
+
+    /// Loads a file into an existing table created with the schema's columns.
+    /// @param inputPath The file to read.
+    /// @param table The table to insert into.
+    /// @param tableDefinition The definition the table was created with.
+    /// @param token Checked every CANCEL_CHECK_RECORDS records; once cancelled, the load returns with the rows inserted so far.
+    /// @param preview Receives a sample of the inserted records in column order; may be null.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, Table& table, TableDefinition& tableDefinition,
+                    const CancellationToken& token = CancellationToken(), RecordSampler* preview = nullptr );
+
+    /// Loads a file into a new extract.
+    /// @param inputPath The file to read.
+    /// @param extractPath The extract to create.
+    /// @param token Checked every CANCEL_CHECK_RECORDS records; once cancelled, the partial extract is closed and deleted.
+    /// @param preview The preview to publish before the extract is closed, unless the load was cancelled.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, const std::wstring& extractPath,
+                    const CancellationToken& token = CancellationToken(),
+                    const PreviewOptions& preview = PreviewOptions() );
+
+    /// Writes a sample filled by <b>Load</b> into a new extract and publishes it atomically.
+    /// @param sample The sample.
+    /// @param extractPath The path of the preview extract.
+    /// @return The number of rows written.
+    uint64_t PublishPreview( const RecordSampler& sample, const std::wstring& extractPath );
+
+    /// The number of records between two checks of the cancellation token.
+    static const uint64_t CANCEL_CHECK_RECORDS = 4096;
+
+  private:
+    void CheckStrataColumn( int strataColumn ) const;
+
+    SchemaFile m_schema;
+    PlanCache& m_cache;
+};
+
+namespace {
+
+    inline bool ParseDigits( const char*& pos, const char* end, int count, int& value )
+    {
+        value = 0;
+        for ( int i = 0; i < count; ++i, ++pos ) {
+            if ( pos == end || *pos < '0' || *pos > '9' )
+                return false;
+            value = value * 10 + ( *pos - '0' );
+        }
+        return true;
+    }
+
+    // Parses ".ffff" into 1/10000 seconds, ignoring digits beyond the fourth.
+    inline bool ParseFraction( const char*& pos, const char* end, int& frac )
+    {
+        frac = 0;
+        if ( pos == end || *pos != '.' )
+            return true;
+        ++pos;
+        int digits = 0;
+        for ( ; pos < end && *pos >= '0' && *pos <= '9'; ++pos, ++digits ) {
+            if ( digits < 4 )
+                frac = frac * 10 + ( *pos - '0' );
+        }
+        for ( ; digits < 4; ++digits )
+            frac *= 10;
+        return true;
+    }
+
+    inline bool ParseTime( const char*& pos, const char* end, int& hour, int& min, int& sec, int& frac )
+    {
+        return ParseDigits( pos, end, 2, hour ) && pos < end && *pos++ == ':'
+            && ParseDigits( pos, end, 2, min ) && pos < end && *pos++ == ':'
+            && ParseDigits( pos, end, 2, sec ) && ParseFraction( pos, end, frac );
+    }
+
+    inline bool ParseDate( const char*& pos, const char* end, int& year, int& month, int& day )
+    {
+        return ParseDigits( pos, end, 4, year ) && pos < end && *pos++ == '-'
+            && ParseDigits( pos, end, 2, month ) && pos < end && *pos++ == '-'
+            && ParseDigits( pos, end, 2, day ) && month >= 1 && month <= 12 && day >= 1 && day <= 31;
+    }
+
+    template <class Target>
+    inline bool ConvertInteger( Target& row, int columnNumber, const FieldView& field, ConversionScratch& )
+    {
+        const char* pos = field.begin;
+        const bool negative = pos < field.end && *pos == '-';
+        if ( pos < field.end && ( *pos == '-' || *pos == '+' ) )
+            ++pos;
+        if ( pos == field.end )
+            return false;
+        uint64_t value = 0;
+        for ( ; pos < field.end; ++pos ) {
+            const unsigned digit = static_cast<unsigned>( *pos - '0' );
+            if ( digit > 9 || value > ( UINT64_C( 9223372036854775808 ) - digit ) / 10 )
+                return false;
+            value = value * 10 + digit;
+        }
+        if ( !negative && value > UINT64_C( 9223372036854775807 ) )
+            return false;
+        row.SetLongInteger( columnNumber, negative ? static_cast<int64_t>( 0 - value ) : static_cast<int64_t>( value ) );
+        return true;
+    }
+
+    template <class Target>
+    inline bool ConvertDouble( Target& row, int columnNumber, const FieldView& field, ConversionScratch& scratch )
+    {
+        // strtod needs a terminated string.
+        scratch.text.assign( field.begin, field.end );
+        const char* begin = scratch.text.c_str();
+        char* end = nullptr;
+        const double value = std::strtod( begin, &end );
+        if ( end == begin || *end != '\0' )
+            return false;
+        row.SetDouble( columnNumber, value );
+        return true;
+    }
+
+    template <class Target>
+    inline bool ConvertBoolean( Target& row, int columnNumber, const FieldView& field, ConversionScratch& )
+    {
+        static const char* const trueTokens[] = { "1", "true", "t", "yes", "y" };
+        static const char* const falseTokens[] = { "0", "false", "f", "no", "n" };
+        char lower[8];
+        const size_t size = field.Size();
+        if ( size == 0 || size >= sizeof( lower ) )
+            return false;
+        for ( size_t i = 0; i < size; ++i )
+            lower[i] = ( field.begin[i] >= 'A' && field.begin[i] <= 'Z' ) ? field.begin[i] - 'A' + 'a' : field.begin[i];
+        lower[size] = '\0';
+        for ( size_t i = 0; i < sizeof( trueTokens ) / sizeof( trueTokens[0] ); ++i ) {
+            if ( std::strcmp( lower, trueTokens[i] ) == 0 ) {
+                row.SetBoolean( columnNumber, true );
+                return true;
+            }
+            if ( std::strcmp( lower, falseTokens[i] ) == 0 ) {
+                row.SetBoolean( columnNumber, false );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // YYYY-MM-DD
+    template <class Target>
+    inline bool ConvertDate( Target& row, int columnNumber, const FieldView& field, ConversionScratch& )
+    {
+        const char* pos = field.begin;
+        int year, month, day;
+        if ( !ParseDate( pos, field.end, year, month, day ) || pos != field.end )
+            return false;
+        row.SetDate( columnNumber, year, month, day );
+        return true;
+    }
+
+    // YYYY-MM-DD[( |T)HH:MM:SS[.ffff]]
+    template <class Target>
+    inline bool ConvertDateTime( Target& row, int columnNumber, const FieldView& field, ConversionScratch& )
+    {
+        const char* pos = field.begin;
+        int year, month, day;
+        int hour = 0, min = 0, sec = 0, frac = 0;
+        if ( !ParseDate( pos, field.end, year, month, day ) )
+            return false;
+        if ( pos < field.end ) {
+            if ( *pos != ' ' && *pos != 'T' )
+                return false;
+            ++pos;
+            if ( !ParseTime( pos, field.end, hour, min, sec, frac ) )
+                return false;
+        }
+        if ( pos != field.end )
+            return false;
+        row.SetDateTime( columnNumber, year, month, day, hour, min, sec, frac );
+        return true;
+    }
+
+    // [D ]HH:MM:SS[.ffff]
+    template <class Target>
+    inline bool ConvertDuration( Target& row, int columnNumber, const FieldView& field, ConversionScratch& )
+    {
+        const char* pos = field.begin;
+        int day = 0;
+        const char* space = static_cast<const char*>( std::memchr( pos, ' ', field.Size() ) );
+        if ( space != nullptr ) {
+            if ( space == pos )
+                return false;
+            for ( ; pos < space; ++pos ) {
+                if ( *pos < '0' || *pos > '9' || day > 100000000 )
+                    return false;
+                day = day * 10 + ( *pos - '0' );
+            }
+            ++pos;
+        }
+        int hour, min, sec, frac;
+        if ( !ParseTime( pos, field.end, hour, min, sec, frac ) || pos != field.end )
+            return false;
+        row.SetDuration( columnNumber, day, hour, min, sec, frac );
+        return true;
+    }
+
+    template <class Target>
+    inline bool ConvertCharString( Target& row, int columnNumber, const FieldView& field, ConversionScratch& scratch )
+    {
+        scratch.text.assign( field.begin, field.end );
+        row.SetCharString( columnNumber, scratch.text );
+        return true;
+    }
+
+    // Transcodes UTF-8 straight to UTF-16, skipping the wstring round trip of Row::SetString.
+    template <class Target>
+    inline bool ConvertUnicodeString( Target& row, int columnNumber, const FieldView& field, ConversionScratch& scratch )
+    {
+        scratch.utf16.resize( field.Size() + 1 );
+        TableauWChar* out = &scratch.utf16[0];
+        const char* pos = field.begin;
+        while ( pos < field.end ) {
+            if ( static_cast<unsigned char>( *pos ) < 0x80 ) {
+                *out++ = static_cast<TableauWChar>( *pos++ );
+                continue;
+            }
+            const unsigned int codePoint = DecodeUtf8( pos, field.end );
+            if ( codePoint >= 0x10000 ) {
+                // Four UTF-8 bytes become two UTF-16 units, so the buffer is large enough.
+                *out++ = static_cast<TableauWChar>( 0xD800 + ( ( codePoint - 0x10000 ) >> 10 ) );
+                *out++ = static_cast<TableauWChar>( 0xDC00 + ( ( codePoint - 0x10000 ) & 0x3FF ) );
+            }
+            else {
+                *out++ = static_cast<TableauWChar>( codePoint );
+            }
+        }
+        *out = 0;
+        row.SetTableauString( columnNumber, &scratch.utf16[0] );
+        return true;
+    }
+
+    template <class Target>
+    inline bool ConvertSpatial( Target& row, int columnNumber, const FieldView& field, ConversionScratch& scratch )
+    {
+        scratch.text.assign( field.begin, field.end );
+        row.SetSpatial( columnNumber, scratch.text );
+        return true;
+    }
+
+    template <class Target = Row>
+    inline bool ( *ConverterFor( Type type ) )( Target&, int, const FieldView&, ConversionScratch& )
+    {
+        switch ( type ) {
+            case Type_Integer:       return &ConvertInteger<Target>;
+            case Type_Double:        return &ConvertDouble<Target>;
+            case Type_Boolean:       return &ConvertBoolean<Target>;
+            case Type_Date:          return &ConvertDate<Target>;
+            case Type_DateTime:      return &ConvertDateTime<Target>;
+            case Type_Duration:      return &ConvertDuration<Target>;
+            case Type_CharString:    return &ConvertCharString<Target>;
+            case Type_UnicodeString: return &ConvertUnicodeString<Target>;
+            case Type_Spatial:       return &ConvertSpatial<Target>;
+        }
+        throw TableauException( TAB_RESULT_InvalidArgument, L"Unsupported column type" );
+    }
+
+}
+
+// -----------------------------------------------------------------------
+// ConversionPlan methods
+// -----------------------------------------------------------------------
+
+inline ConversionPlan::ConversionPlan(
+    const SchemaFile& schema,
+    const std::vector<std::string>& header
+) : m_requiredFields(0)
+{
+    const std::vector<SchemaField>& fields = schema.GetFields();
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        Step step;
+        step.convert = ConverterFor( fields[i].column.type );
+        step.column = static_cast<int>( i );
+        step.nullTokens = fields[i].nullTokens;
+        if ( fields[i].sourceIndex >= 0 ) {
+            step.field = static_cast<size_t>( fields[i].sourceIndex );
+        }
+        else {
+            step.field = 0;
+            while ( step.field < header.size() && header[step.field] != fields[i].source )
+                ++step.field;
+            if ( step.field == header.size() )
+                throw TableauException( TAB_RESULT_InvalidArgument,
+                                        L"Input has no field '" + WidenUtf8( fields[i].source ) + L"'" );
+        }
+        m_requiredFields = std::max( m_requiredFields, step.field + 1 );
+        m_steps.push_back( step );
+    }
+}
+
+inline ConversionPlan::ConversionPlan(
+    const SchemaFile& schema
+) : m_requiredFields(schema.GetFields().size())
+{
+    const std::vector<SchemaField>& fields = schema.GetFields();
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        Step step;
+        step.convert = ConverterFor( fields[i].column.type );
+        step.column = static_cast<int>( i );
+        step.field = i;
+        step.nullTokens = fields[i].nullTokens;
+        m_steps.push_back( step );
+    }
+}
+
+inline bool ConversionPlan::Apply(
+    Row& row,
+    const std::vector<FieldView>& fields,
+    ConversionScratch& scratch
+) const
+{
+    if ( fields.size() < m_requiredFields )
+        return false;
+    for ( size_t i = 0; i < m_steps.size(); ++i ) {
+        const Step& step = m_steps[i];
+        const FieldView& field = fields[step.field];
+        bool null = false;
+        for ( size_t j = 0; j < step.nullTokens.size() && !null; ++j )
+            null = field.Equals( step.nullTokens[j] );
+        if ( null )
+            row.SetNull( step.column );
+        else if ( !step.convert( row, step.column, field, scratch ) )
+            return false;
+    }
+    return true;
+}
+
+inline std::vector<bool> ConversionPlan::GetProjection() const
+{
+    std::vector<bool> projected( m_requiredFields, false );
+    for ( size_t i = 0; i < m_steps.size(); ++i )
+        projected[m_steps[i].field] = true;
+    return projected;
+}
+
+inline void ConversionPlan::Select( const std::vector<FieldView>& fields, std::vector<FieldView>& selected ) const
+{
+    selected.resize( m_steps.size() );
+    for ( size_t i = 0; i < m_steps.size(); ++i )
+        selected[i] = fields[m_steps[i].field];
+}
+
+// -----------------------------------------------------------------------
+// PlanCache methods
+// -----------------------------------------------------------------------
+
+inline std::shared_ptr<const ConversionPlan>
+PlanCache::Get(
+    const SchemaFile& schema,
+    const std::vector<std::string>& header
+)
+{
+    std::string key = schema.GetFingerprint();
+    for ( size_t i = 0; i < header.size(); ++i )
+        AppendFingerprint( key, header[i] );
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    std::shared_ptr<const ConversionPlan>& plan = m_plans[key];
+    if ( !plan ) {
+        plan = std::make_shared<const ConversionPlan>( schema, header );
+        ++m_builds;
+    }
+    return plan;
+}
+
+inline size_t PlanCache::GetBuildCount() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_builds;
+}
+
+// -----------------------------------------------------------------------
+// FeedLoader methods
+// -----------------------------------------------------------------------
+
+inline LoadStats
+FeedLoader::Load(
+    const std::string& inputPath,
+    Table& table,
+    TableDefinition& tableDefinition,
+    const CancellationToken& token,
+    RecordSampler* preview
+)
+{
+    if ( preview != nullptr )
+        CheckStrataColumn( preview->GetStrataField() );
+    LoadStats stats;
+    DelimitedReader reader( inputPath, m_schema.GetDelimiter() );
+    ProgressCounters& progress = table.GetProgressCounters();
+    progress.AddExpected( 0, reader.GetFileSize() );
+    std::vector<FieldView> fields;
+    std::vector<std::string> header;
+    if ( m_schema.HasHeader() ) {
+        if ( !reader.Next( fields ) )
+            return stats;
+        for ( size_t i = 0; i < fields.size(); ++i )
+            header.push_back( std::string( fields[i].begin, fields[i].end ) );
+    }
+
+    std::shared_ptr<const ConversionPlan> plan = m_cache.Get( m_schema, header );
+    reader.SetProjection( plan->GetProjection() );
+    ConversionScratch scratch;
+    Row row( tableDefinition );
+    std::vector<FieldView> selected;
+    const int strataColumn = preview != nullptr ? preview->GetStrataField() : -1;
+    const size_t strataField = strataColumn >= 0 ? plan->GetField( strataColumn ) : 0;
+    uint64_t reported = 0;
+    for ( uint64_t records = 1; reader.Next( fields ); ++records ) {
+        if ( records % CANCEL_CHECK_RECORDS == 0 && token.IsCancelled() ) {
+            stats.cancelled = true;
+            break;
+        }
+        if ( plan->Apply( row, fields, scratch ) ) {
+            table.Insert( row );
+            ++stats.rows;
+            if ( preview != nullptr && preview->Offer( strataColumn >= 0 ? fields[strataField] : FieldView() ) ) {
+                plan->Select( fields, selected );
+                preview->Store( selected );
+            }
+        }
+        else {
+            ++stats.rejected;
+        }
+        progress.AddInputBytes( reader.GetBytesRead() - reported );
+        reported = reader.GetBytesRead();
+    }
+    stats.bytes = reader.GetBytesRead();
+    progress.AddInputBytes( stats.bytes - reported );
+    return stats;
+}
+
+inline LoadStats
+FeedLoader::Load(
+    const std::string& inputPath,
+    const std::wstring& extractPath,
+    const CancellationToken& token,
+    const PreviewOptions& preview
+)
+{
+    if ( token.IsCancelled() ) {
+        LoadStats stats;
+        stats.cancelled = true;
+        return stats;
+    }
+    if ( preview.rows > 0 )
+        CheckStrataColumn( preview.strataColumn );   // before the extract is created
+    TableDefinition tableDefinition;
+    AddColumns( tableDefinition, m_schema.GetColumns() );
+    Extract extract( extractPath );
+    std::shared_ptr<Table> table = extract.AddTable( m_schema.GetTableName(), tableDefinition );
+    std::unique_ptr<RecordSampler> sample;
+    if ( preview.rows > 0 )
+        sample.reset( new RecordSampler( preview.rows, preview.strataColumn, preview.seed ) );
+    LoadStats stats = Load( inputPath, *table, tableDefinition, token, sample.get() );
+    if ( sample && !stats.cancelled ) {
+        std::wstring previewPath = preview.path;
+        if ( previewPath.empty() ) {
+            const size_t dot = extractPath.rfind( L'.' );
+            const size_t slash = extractPath.rfind( L'/' );
+            const size_t stem = dot != std::wstring::npos && ( slash == std::wstring::npos || dot > slash ) ? dot : extractPath.size();
+            previewPath = extractPath.substr( 0, stem ) + L"-preview" + extractPath.substr( stem );
+        }
+        stats.previewRows = PublishPreview( *sample, previewPath );
+    }
+    table.reset();
+    extract.Close();
+    if ( stats.cancelled ) {
+        // The API cannot abandon an extract, so it is saved and then deleted.
+        RemoveFile( extractPath );
+        stats.discarded = true;
+    }
+    return stats;
+}
+
+inline uint64_t
+FeedLoader::PublishPreview(
+    const RecordSampler& sample,
+    const std::wstring& extractPath
+)
+{
+    CheckStrataColumn( sample.GetStrataField() );
+
+    // Built next to its destination, so publishing is a rename.
+    const size_t slash = extractPath.rfind( L'/' );
+    StagedOutput output( extractPath, slash == std::wstring::npos ? L"." : extractPath.substr( 0, slash == 0 ? 1 : slash ) );
+    Extract extract( output.GetStagingPath() );
+    TableDefinition tableDefinition;
+    AddColumns( tableDefinition, m_schema.GetColumns() );
+    std::shared_ptr<Table> table = extract.AddTable( m_schema.GetTableName(), tableDefinition );
+
+    const ConversionPlan plan( m_schema );
+    ConversionScratch scratch;
+    Row row( tableDefinition );
+    uint64_t rows = 0;
+    sample.ForEach( [&]( const std::vector<FieldView>& fields ) {
+        if ( plan.Apply( row, fields, scratch ) ) {
+            table->Insert( row );
+            ++rows;
+        }
+    } );
+    table.reset();
+    output.Publish( extract );
+    return rows;
+}
+
+inline void FeedLoader::CheckStrataColumn( int strataColumn ) const
+{
+    // -1 samples uniformly; other columns index the conversion plan.
+    if ( strataColumn < -1 || strataColumn >= static_cast<int>( m_schema.GetFields().size() ) )
+        throw TableauException( TAB_RESULT_BadIndex, L"Preview strata column out of range" );
+}
+
+} // namespace Tableau
+#endif // TableauFeedLoader_CPP_H
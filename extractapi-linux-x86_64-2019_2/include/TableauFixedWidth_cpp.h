@@ -0,0 +1,934 @@
+// -----------------------------------------------------------------------
+// TableauFixedWidth_cpp.h
+// -----------------------------------------------------------------------
+// Loads fixed-width binary records from memory-mapped files.
+
+#ifndef TableauFixedWidth_CPP_H
+#define TableauFixedWidth_CPP_H
+
+#include "TableauCancellation_cpp.h"
+#include "TableauDataGenerator_cpp.h"
+#include "TableauFeedLoader_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauMappedFile_cpp.h"
+#include "TableauSchemaFile_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/// How the bytes of a field encode its value.
+enum FieldEncoding
+{
+    FieldEncoding_Binary,     // two's complement integer of 1 to 8 bytes
+    FieldEncoding_Unsigned,   // unsigned integer of 1 to 8 bytes
+    FieldEncoding_Float,      // IEEE 754 number of 4 or 8 bytes
+    FieldEncoding_Packed,     // packed decimal (COMP-3): two digits per byte, the sign in the last nibble
+    FieldEncoding_Zoned,      // zoned decimal: one digit per byte, the sign in the zone of the last byte
+    FieldEncoding_Text,       // ASCII or UTF-8 text padded with spaces
+    FieldEncoding_Ebcdic      // EBCDIC (code page 037) text padded with spaces
+};
+
+/// How the number of a Date or DateTime field encodes the point in time.
+enum DateEncoding
+{
+    DateEncoding_Default,          // YYYYMMDD for dates, YYYYMMDDHHMMSS for date times
+    DateEncoding_YYYYMMDD,
+    DateEncoding_CYYMMDD,          // C is 0 for the 1900s and 1 for the 2000s
+    DateEncoding_DaysSince1900,    // day 0 is 1900-01-01
+    DateEncoding_DaysSince1970,
+    DateEncoding_YYYYMMDDHHMMSS,
+    DateEncoding_UnixSeconds       // seconds since 1970-01-01 00:00:00
+};
+
+/// The byte order of Binary, Unsigned and Float fields.
+enum ByteOrder
+{
+    ByteOrder_Big,
+    ByteOrder_Little
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  RecordField
+
+  One field of a fixed-width record and the column it loads into.
+
+  ------------------------------------------------------------------------*/
+
+struct RecordField
+{
+    RecordField( const ColumnSpec& column, size_t offset, size_t width, FieldEncoding encoding )
+        : column(column), offset(offset), width(width), encoding(encoding),
+          byteOrder(ByteOrder_Big), scale(0), date(DateEncoding_Default) {}
+
+    ColumnSpec column;
+    size_t offset;            // bytes from the start of the record
+    size_t width;             // bytes
+    FieldEncoding encoding;
+    ByteOrder byteOrder;
+    int scale;                // implied decimal places of numbers
+    DateEncoding date;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  RecordLayout
+
+  Describes a file of fixed-width records and the table it loads into.
+  A layout file uses the line format of schema files:
+
+      table Accounts
+      record 64                 # bytes per record, including any terminator
+      skip 128                  # bytes of file header before the first record
+      byteorder little          # default of binary fields: big or little
+      field Id Integer offset=0 width=4 encoding=binary
+      field Balance Double offset=4 width=6 encoding=packed scale=2
+      field Opened Date offset=10 width=4 encoding=packed date=cyymmdd
+      field Name UnicodeString offset=14 width=30 encoding=ebcdic
+      field Updated DateTime offset=44 width=8 encoding=binary date=unix
+
+  Encodings are binary, unsigned, float, packed, zoned, text and ebcdic;
+  dates are yyyymmdd, cyymmdd, days1900, days1970, yyyymmddhhmmss and
+  unix. Text fields are trimmed of trailing blanks; empty text and packed
+  or zoned fields filled with blanks load as null into columns that are
+  not strings.
+
+  ------------------------------------------------------------------------*/
+
+class RecordLayout
+{
+  public:
+    /// Initializes a layout without fields.
+    /// @param tableName The table to create.
+    /// @param recordLength The bytes per record.
+    RecordLayout( const std::wstring& tableName = L"Extract", size_t recordLength = 0 );
+
+    /// Reads a layout file.
+    /// @param path The file to read.
+    /// @return The layout. Throws a TableauException for unreadable or malformed files.
+    static RecordLayout Load( const std::string& path );
+
+    /// Parses the text of a layout file.
+    /// @param text The layout.
+    /// @param origin The name used in error messages.
+    /// @return The layout. Throws a TableauException naming the line of the first error.
+    static RecordLayout Parse( const std::string& text, const std::string& origin = "layout" );
+
+    /// Adds a field. Throws a TableauException if it does not fit the record or its column.
+    void AddField( const RecordField& field );
+
+    /// Sets the bytes of file header before the first record.
+    void SetSkip( size_t bytes ) { m_skip = bytes; }
+
+    const std::wstring& GetTableName() const { return m_tableName; }
+    size_t GetRecordLength() const { return m_recordLength; }
+    size_t GetSkip() const { return m_skip; }
+    const std::vector<RecordField>& GetFields() const { return m_fields; }
+
+    /// Returns the columns of the table to create, in field order.
+    std::vector<ColumnSpec> GetColumns() const;
+
+  private:
+    // Returns why the field is invalid, or an empty string.
+    std::string Check( const RecordField& field ) const;
+
+    std::wstring m_tableName;
+    size_t m_recordLength;
+    size_t m_skip;
+    std::vector<RecordField> m_fields;
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  FixedWidthOptions
+
+  Threads and batch size of a FixedWidthLoader.
+
+  ------------------------------------------------------------------------*/
+
+struct FixedWidthOptions
+{
+    FixedWidthOptions()
+        : threads(std::max( 1u, std::thread::hardware_concurrency() )), batchRecords(16384) {}
+
+    size_t threads;        // decoding threads; 1 decodes on the inserting thread
+    size_t batchRecords;   // records per batch, also the granularity of cancellation
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  FixedWidthLoader
+
+  Loads files of fixed-width records described by a RecordLayout. The
+  file is mapped, and batches of records are decoded on several threads
+  straight from the mapped pages into typed cells while the previous
+  batch is inserted. Numbers and dates are never turned into text;
+  strings are only copied into the null-terminated buffer the Row
+  setters need. Pages of inserted batches are released.
+
+  A record with an invalid field, e.g. a packed decimal with a digit
+  above 9, a date with month 13 or a float that is not a finite number
+  in the range of an integer column, is rejected, as is a trailing
+  partial record.
+
+  ------------------------------------------------------------------------*/
+
+class FixedWidthLoader
+{
+  public:
+    /// Initializes a loader.
+    /// @param layout The layout of the input files.
+    /// @param options The threads and batch size.
+    FixedWidthLoader( const RecordLayout& layout, const FixedWidthOptions& options = FixedWidthOptions() )
+        : m_layout(layout), m_options(options) {}
+
+    /// Loads a file into an existing table created with the layout's columns.
+    /// @param inputPath The file to read.
+    /// @param table The table to insert into.
+    /// @param tableDefinition The definition the table was created with.
+    /// @param token Checked before every batch; once cancelled, the load returns with the rows inserted so far.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, Table& table, TableDefinition& tableDefinition,
+                    const CancellationToken& token = CancellationToken() );
+
+    /// Loads a file into a new extract.
+    /// @param inputPath The file to read.
+    /// @param extractPath The extract to create.
+    /// @param token Checked before every batch; once cancelled, the partial extract is closed and deleted.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, const std::wstring& extractPath,
+                    const CancellationToken& token = CancellationToken() );
+
+  private:
+    RecordLayout m_layout;
+    FixedWidthOptions m_options;
+};
+
+namespace {
+
+    // Latin-1 code points of the EBCDIC code page 037.
+    const unsigned char Cp037ToLatin1[256] = {
+        0x00, 0x01, 0x02, 0x03, 0x9C, 0x09, 0x86, 0x7F, 0x97, 0x8D, 0x8E, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+        0x10, 0x11, 0x12, 0x13, 0x9D, 0x85, 0x08, 0x87, 0x18, 0x19, 0x92, 0x8F, 0x1C, 0x1D, 0x1E, 0x1F,
+        0x80, 0x81, 0x82, 0x83, 0x84, 0x0A, 0x17, 0x1B, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x05, 0x06, 0x07,
+        0x90, 0x91, 0x16, 0x93, 0x94, 0x95, 0x96, 0x04, 0x98, 0x99, 0x9A, 0x9B, 0x14, 0x15, 0x9E, 0x1A,
+        0x20, 0xA0, 0xE2, 0xE4, 0xE0, 0xE1, 0xE3, 0xE5, 0xE7, 0xF1, 0xA2, 0x2E, 0x3C, 0x28, 0x2B, 0x7C,
+        0x26, 0xE9, 0xEA, 0xEB, 0xE8, 0xED, 0xEE, 0xEF, 0xEC, 0xDF, 0x21, 0x24, 0x2A, 0x29, 0x3B, 0xAC,
+        0x2D, 0x2F, 0xC2, 0xC4, 0xC0, 0xC1, 0xC3, 0xC5, 0xC7, 0xD1, 0xA6, 0x2C, 0x25, 0x5F, 0x3E, 0x3F,
+        0xF8, 0xC9, 0xCA, 0xCB, 0xC8, 0xCD, 0xCE, 0xCF, 0xCC, 0x60, 0x3A, 0x23, 0x40, 0x27, 0x3D, 0x22,
+        0xD8, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0xAB, 0xBB, 0xF0, 0xFD, 0xFE, 0xB1,
+        0xB0, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F, 0x70, 0x71, 0x72, 0xAA, 0xBA, 0xE6, 0xB8, 0xC6, 0xA4,
+        0xB5, 0x7E, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0xA1, 0xBF, 0xD0, 0xDD, 0xDE, 0xAE,
+        0x5E, 0xA3, 0xA5, 0xB7, 0xA9, 0xA7, 0xB6, 0xBC, 0xBD, 0xBE, 0x5B, 0x5D, 0xAF, 0xA8, 0xB4, 0xD7,
+        0x7B, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0xAD, 0xF4, 0xF6, 0xF2, 0xF3, 0xF5,
+        0x7D, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0xB9, 0xFB, 0xFC, 0xF9, 0xFA, 0xFF,
+        0x5C, 0xF7, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0xB2, 0xD4, 0xD6, 0xD2, 0xD3, 0xD5,
+        0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0xB3, 0xDB, 0xDC, 0xD9, 0xDA, 0x9F
+    };
+
+    const int64_t PowersOf10[19] = {
+        1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+        10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+        1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+    };
+
+    const char* const FieldEncodingNames[] = { "binary", "unsigned", "float", "packed", "zoned", "text", "ebcdic" };
+    const char* const DateEncodingNames[] = { "default", "yyyymmdd", "cyymmdd", "days1900", "days1970", "yyyymmddhhmmss", "unix" };
+
+    // One decoded field: a number, the bits of a double, a packed date or
+    // date time, or text in the mapped file.
+    struct DecodedCell
+    {
+        int64_t bits;
+        const char* text;
+        uint32_t size;
+        bool null;
+    };
+
+    // Records decoded by the threads of a FixedWidthLoader, cells in row-major order.
+    struct DecodedBatch
+    {
+        uint64_t first;
+        size_t count;
+        std::vector<DecodedCell> cells;
+        std::vector<char> valid;
+        std::vector<std::future<void> > decoded;
+    };
+
+    inline bool IsStringType( Type type )
+    {
+        return type == Type_CharString || type == Type_UnicodeString || type == Type_Spatial;
+    }
+
+    inline uint64_t ReadUnsigned( const unsigned char* p, size_t width, ByteOrder order )
+    {
+        uint64_t value = 0;
+        if ( order == ByteOrder_Big ) {
+            for ( size_t i = 0; i < width; ++i )
+                value = ( value << 8 ) | p[i];
+        }
+        else {
+            for ( size_t i = width; i-- > 0; )
+                value = ( value << 8 ) | p[i];
+        }
+        return value;
+    }
+
+    inline bool ReadPacked( const unsigned char* p, size_t width, int64_t& value )
+    {
+        value = 0;
+        for ( size_t i = 0; i < width; ++i ) {
+            const int high = p[i] >> 4;
+            const int low = p[i] & 0x0F;
+            if ( high > 9 )
+                return false;
+            value = value * 10 + high;
+            if ( i + 1 < width ) {
+                if ( low > 9 )
+                    return false;
+                value = value * 10 + low;
+            }
+            else if ( low < 0x0A ) {
+                return false;   // no sign nibble
+            }
+            else if ( low == 0x0B || low == 0x0D ) {
+                value = -value;
+            }
+        }
+        return true;
+    }
+
+    inline bool ReadZoned( const unsigned char* p, size_t width, int64_t& value )
+    {
+        value = 0;
+        for ( size_t i = 0; i < width; ++i ) {
+            const int digit = p[i] & 0x0F;
+            if ( digit > 9 )
+                return false;
+            value = value * 10 + digit;
+        }
+        const int zone = p[width - 1] >> 4;
+        if ( zone == 0x0B || zone == 0x0D )
+            value = -value;
+        return true;
+    }
+
+    // Parses [sign]digits[.digits] surrounded by blanks, in ASCII or EBCDIC.
+    inline bool ReadTextNumber( const unsigned char* p, size_t size, bool ebcdic, int64_t& value, int& decimals )
+    {
+        value = 0;
+        decimals = 0;
+        size_t i = 0;
+        const unsigned char blank = ebcdic ? 0x40 : ' ';
+        while ( i < size && p[i] == blank )
+            ++i;
+        bool negative = false;
+        if ( i < size && ( p[i] == ( ebcdic ? 0x60 : '-' ) || p[i] == ( ebcdic ? 0x4E : '+' ) ) ) {
+            negative = p[i] == ( ebcdic ? 0x60 : '-' );
+            ++i;
+        }
+        const unsigned char zero = ebcdic ? 0xF0 : '0';
+        const unsigned char point = ebcdic ? 0x4B : '.';
+        bool digits = false;
+        bool fraction = false;
+        for ( ; i < size; ++i ) {
+            if ( p[i] >= zero && p[i] <= zero + 9 ) {
+                if ( value > ( INT64_MAX - 9 ) / 10 )
+                    return false;
+                value = value * 10 + ( p[i] - zero );
+                decimals += fraction ? 1 : 0;
+                digits = true;
+            }
+            else if ( p[i] == point && !fraction ) {
+                fraction = true;
+            }
+            else {
+                break;
+            }
+        }
+        while ( i < size && p[i] == blank )
+            ++i;
+        if ( negative )
+            value = -value;
+        return digits && i == size;
+    }
+
+    // Packs a date like Value::SetDate, validating the ranges.
+    inline bool PackDate( int64_t year, int64_t month, int64_t day, int64_t& packed )
+    {
+        if ( year < 1 || year > 9999 || month < 1 || month > 12 || day < 1 || day > 31 )
+            return false;
+        packed = ( year * 100 + month ) * 100 + day;
+        return true;
+    }
+
+    inline bool DecodeDate( int64_t value, DateEncoding encoding, int64_t& packed )
+    {
+        int year, month, day;
+        switch ( encoding ) {
+            case DateEncoding_CYYMMDD:
+                return value >= 0 && PackDate( 1900 + value / 10000, value / 100 % 100, value % 100, packed );
+            case DateEncoding_DaysSince1900:
+                CivilFromDays( value - 25567, year, month, day );
+                return PackDate( year, month, day, packed );
+            case DateEncoding_DaysSince1970:
+                CivilFromDays( value, year, month, day );
+                return PackDate( year, month, day, packed );
+            default:
+                return value >= 0 && PackDate( value / 10000, value / 100 % 100, value % 100, packed );
+        }
+    }
+
+    // Packs a date time as YYYYMMDDHHMMSS.
+    inline bool DecodeDateTime( int64_t value, DateEncoding encoding, int64_t& packed )
+    {
+        int64_t date;
+        int64_t time = 0;
+        switch ( encoding ) {
+            case DateEncoding_UnixSeconds: {
+                const int64_t days = ( value >= 0 ? value : value - 86399 ) / 86400;
+                time = value - days * 86400;
+                if ( !DecodeDate( days, DateEncoding_DaysSince1970, date ) )
+                    return false;
+                time = time / 3600 * 10000 + time / 60 % 60 * 100 + time % 60;
+                break;
+            }
+            case DateEncoding_Default:
+            case DateEncoding_YYYYMMDDHHMMSS:
+                if ( value < 0 || !DecodeDate( value / 1000000, DateEncoding_YYYYMMDD, date ) )
+                    return false;
+                time = value % 1000000;
+                if ( time / 10000 > 23 || time / 100 % 100 > 59 || time % 100 > 59 )
+                    return false;
+                break;
+            default:
+                if ( !DecodeDate( value, encoding, date ) )
+                    return false;
+        }
+        packed = date * 1000000 + time;
+        return true;
+    }
+
+    // Stores a number with implied decimals in the cell of the field's column type.
+    inline bool DecodeNumber( const RecordField& field, int64_t value, int decimals, DecodedCell& cell )
+    {
+        switch ( field.column.type ) {
+            case Type_Integer:
+                cell.bits = decimals > 0 ? value / PowersOf10[std::min( decimals, 18 )] : value;
+                return true;
+            case Type_Double: {
+                const double number = decimals > 0 ? double( value ) / PowersOf10[std::min( decimals, 18 )] : double( value );
+                std::memcpy( &cell.bits, &number, sizeof( number ) );
+                return true;
+            }
+            case Type_Boolean:
+                cell.bits = value != 0;
+                return true;
+            case Type_Date:
+                return DecodeDate( value, field.date, cell.bits );
+            case Type_DateTime:
+                return DecodeDateTime( value, field.date, cell.bits );
+            default:
+                return false;
+        }
+    }
+
+    inline bool DecodeFloat( const RecordField& field, const unsigned char* p, DecodedCell& cell )
+    {
+        const uint64_t raw = ReadUnsigned( p, field.width, field.byteOrder );
+        double number;
+        if ( field.width == 4 ) {
+            const uint32_t narrow = static_cast<uint32_t>( raw );
+            float single;
+            std::memcpy( &single, &narrow, sizeof( single ) );
+            number = single;
+        }
+        else {
+            std::memcpy( &number, &raw, sizeof( number ) );
+        }
+        switch ( field.column.type ) {
+            case Type_Integer:
+                // NaN, infinities and values outside the int64 range have no integer value.
+                if ( !( number >= -9223372036854775808.0 && number < 9223372036854775808.0 ) )
+                    return false;
+                cell.bits = static_cast<int64_t>( number );
+                return true;
+            case Type_Boolean: cell.bits = number != 0; return true;
+            default: std::memcpy( &cell.bits, &number, sizeof( number ) ); return true;
+        }
+    }
+
+    inline bool IsBlank( const unsigned char* p, size_t width )
+    {
+        for ( size_t i = 0; i < width; ++i ) {
+            if ( p[i] != 0x40 && p[i] != 0x20 )
+                return false;
+        }
+        return true;
+    }
+
+    inline bool DecodeField( const unsigned char* record, const RecordField& field, DecodedCell& cell )
+    {
+        const unsigned char* p = record + field.offset;
+        cell.null = false;
+        int64_t value = 0;
+        switch ( field.encoding ) {
+            case FieldEncoding_Text:
+            case FieldEncoding_Ebcdic: {
+                const bool ebcdic = field.encoding == FieldEncoding_Ebcdic;
+                size_t size = field.width;
+                while ( size > 0 && ( p[size - 1] == ( ebcdic ? 0x40 : ' ' ) || p[size - 1] == 0 ) )
+                    --size;
+                if ( IsStringType( field.column.type ) ) {
+                    cell.text = reinterpret_cast<const char*>( p );
+                    cell.size = static_cast<uint32_t>( size );
+                    return true;
+                }
+                if ( size == 0 ) {
+                    cell.null = true;
+                    return true;
+                }
+                if ( field.column.type == Type_Boolean ) {
+                    const unsigned char c = ebcdic ? Cp037ToLatin1[p[0]] : p[0];
+                    cell.bits = c == 'Y' || c == 'y' || c == 'T' || c == 't' || c == '1';
+                    return true;
+                }
+                int decimals;
+                return ReadTextNumber( p, size, ebcdic, value, decimals ) && DecodeNumber( field, value, decimals + field.scale, cell );
+            }
+            case FieldEncoding_Float:
+                return DecodeFloat( field, p, cell );
+            case FieldEncoding_Binary: {
+                const uint64_t raw = ReadUnsigned( p, field.width, field.byteOrder );
+                const int shift = static_cast<int>( 64 - 8 * field.width );
+                value = shift > 0 ? static_cast<int64_t>( raw << shift ) >> shift : static_cast<int64_t>( raw );
+                break;
+            }
+            case FieldEncoding_Unsigned:
+                value = static_cast<int64_t>( ReadUnsigned( p, field.width, field.byteOrder ) );
+                break;
+            case FieldEncoding_Packed:
+            case FieldEncoding_Zoned:
+                if ( IsBlank( p, field.width ) ) {
+                    cell.null = true;
+                    return true;
+                }
+                if ( !( field.encoding == FieldEncoding_Packed ? ReadPacked( p, field.width, value ) : ReadZoned( p, field.width, value ) ) )
+                    return false;
+                break;
+        }
+        return DecodeNumber( field, value, field.scale, cell );
+    }
+
+    // Copies a text field into the null-terminated scratch buffer, as UTF-8.
+    inline const std::string& FieldText( const RecordField& field, const DecodedCell& cell, ConversionScratch& scratch )
+    {
+        if ( field.encoding != FieldEncoding_Ebcdic ) {
+            scratch.text.assign( cell.text, cell.size );
+            return scratch.text;
+        }
+        scratch.text.clear();
+        for ( uint32_t i = 0; i < cell.size; ++i ) {
+            const unsigned char c = Cp037ToLatin1[static_cast<unsigned char>( cell.text[i] )];
+            if ( c < 0x80 ) {
+                scratch.text.push_back( static_cast<char>( c ) );
+            }
+            else {
+                scratch.text.push_back( static_cast<char>( 0xC0 | ( c >> 6 ) ) );
+                scratch.text.push_back( static_cast<char>( 0x80 | ( c & 0x3F ) ) );
+            }
+        }
+        return scratch.text;
+    }
+
+    inline void SetDecodedCell( Row& row, int columnNumber, const RecordField& field, const DecodedCell& cell, ConversionScratch& scratch )
+    {
+        if ( cell.null ) {
+            row.SetNull( columnNumber );
+            return;
+        }
+        switch ( field.column.type ) {
+            case Type_Integer:
+                row.SetLongInteger( columnNumber, cell.bits );
+                break;
+            case Type_Double: {
+                double number;
+                std::memcpy( &number, &cell.bits, sizeof( number ) );
+                row.SetDouble( columnNumber, number );
+                break;
+            }
+            case Type_Boolean:
+                row.SetBoolean( columnNumber, cell.bits != 0 );
+                break;
+            case Type_Date:
+                row.SetDate( columnNumber, static_cast<int>( cell.bits / 10000 ), static_cast<int>( cell.bits / 100 % 100 ),
+                             static_cast<int>( cell.bits % 100 ) );
+                break;
+            case Type_DateTime: {
+                const int64_t date = cell.bits / 1000000;
+                const int64_t time = cell.bits % 1000000;
+                row.SetDateTime( columnNumber, static_cast<int>( date / 10000 ), static_cast<int>( date / 100 % 100 ),
+                                 static_cast<int>( date % 100 ), static_cast<int>( time / 10000 ),
+                                 static_cast<int>( time / 100 % 100 ), static_cast<int>( time % 100 ), 0 );
+                break;
+            }
+            case Type_CharString:
+                row.SetCharString( columnNumber, FieldText( field, cell, scratch ) );
+                break;
+            case Type_Spatial:
+                row.SetSpatial( columnNumber, FieldText( field, cell, scratch ) );
+                break;
+            case Type_UnicodeString:
+                if ( field.encoding == FieldEncoding_Ebcdic ) {
+                    // Latin-1 code points are UTF-16 units.
+                    scratch.utf16.resize( cell.size + 1 );
+                    for ( uint32_t i = 0; i < cell.size; ++i )
+                        scratch.utf16[i] = Cp037ToLatin1[static_cast<unsigned char>( cell.text[i] )];
+                    scratch.utf16[cell.size] = 0;
+                    row.SetTableauString( columnNumber, &scratch.utf16[0] );
+                }
+                else {
+                    ConvertUnicodeString( row, columnNumber, FieldView( cell.text, cell.text + cell.size ), scratch );
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+}
+
+// -----------------------------------------------------------------------
+// RecordLayout methods
+// -----------------------------------------------------------------------
+
+inline RecordLayout::RecordLayout( const std::wstring& tableName, size_t recordLength )
+    : m_tableName(tableName),
+      m_recordLength(recordLength),
+      m_skip(0)
+{
+}
+
+inline RecordLayout RecordLayout::Load( const std::string& path )
+{
+    std::ifstream in( path.c_str(), std::ios::binary );
+    if ( !in )
+        throw TableauException( TAB_RESULT_FileNotFound, L"Could not open layout file " + WidenUtf8( path ) );
+    std::ostringstream text;
+    text << in.rdbuf();
+    return Parse( text.str(), path );
+}
+
+inline RecordLayout RecordLayout::Parse( const std::string& text, const std::string& origin )
+{
+    RecordLayout layout;
+    ByteOrder byteOrder = ByteOrder_Big;
+    std::vector<std::string> tokens;
+    std::istringstream lines( text );
+    std::string line;
+    int number = 0;
+    while ( std::getline( lines, line ) ) {
+        ++number;
+        if ( !TokenizeSchemaLine( line, tokens ) )
+            ThrowSchemaError( origin, number, "unterminated quote" );
+        if ( tokens.empty() )
+            continue;
+
+        const std::string& keyword = tokens[0];
+        char* end = nullptr;
+        if ( keyword == "table" ) {
+            if ( tokens.size() != 2 )
+                ThrowSchemaError( origin, number, "expected: table <name>" );
+            layout.m_tableName = WidenUtf8( tokens[1] );
+        }
+        else if ( keyword == "record" || keyword == "skip" ) {
+            const long bytes = tokens.size() == 2 ? std::strtol( tokens[1].c_str(), &end, 10 ) : -1;
+            if ( bytes < ( keyword == "record" ? 1 : 0 ) || *end != '\0' )
+                ThrowSchemaError( origin, number, "expected: " + keyword + " <bytes>" );
+            ( keyword == "record" ? layout.m_recordLength : layout.m_skip ) = static_cast<size_t>( bytes );
+        }
+        else if ( keyword == "byteorder" ) {
+            if ( tokens.size() != 2 || ( tokens[1] != "big" && tokens[1] != "little" ) )
+                ThrowSchemaError( origin, number, "expected: byteorder big|little" );
+            byteOrder = tokens[1] == "big" ? ByteOrder_Big : ByteOrder_Little;
+        }
+        else if ( keyword == "field" ) {
+            if ( tokens.size() < 3 )
+                ThrowSchemaError( origin, number, "expected: field <name> <type> offset=<bytes> width=<bytes> encoding=<encoding> [option=<value>...]" );
+
+            size_t type = 0;
+            while ( type < sizeof( TypeNames ) / sizeof( TypeNames[0] ) && tokens[2] != TypeNames[type] )
+                ++type;
+            if ( type == sizeof( TypeNames ) / sizeof( TypeNames[0] ) )
+                ThrowSchemaError( origin, number, "unknown type '" + tokens[2] + "'" );
+
+            RecordField field( ColumnSpec( WidenUtf8( tokens[1] ), TypeValues[type] ), 0, 0, FieldEncoding_Text );
+            field.byteOrder = byteOrder;
+            bool hasOffset = false, hasWidth = false, hasEncoding = false;
+            for ( size_t i = 3; i < tokens.size(); ++i ) {
+                const size_t equals = tokens[i].find( '=' );
+                if ( equals == std::string::npos )
+                    ThrowSchemaError( origin, number, "expected <option>=<value>, got '" + tokens[i] + "'" );
+                const std::string key = tokens[i].substr( 0, equals );
+                const std::string value = tokens[i].substr( equals + 1 );
+                if ( key == "offset" || key == "width" || key == "scale" ) {
+                    const long n = std::strtol( value.c_str(), &end, 10 );
+                    if ( value.empty() || *end != '\0' || n < 0 )
+                        ThrowSchemaError( origin, number, "invalid " + key + " '" + value + "'" );
+                    if ( key == "offset" ) {
+                        field.offset = static_cast<size_t>( n );
+                        hasOffset = true;
+                    }
+                    else if ( key == "width" ) {
+                        field.width = static_cast<size_t>( n );
+                        hasWidth = true;
+                    }
+                    else {
+                        field.scale = static_cast<int>( n );
+                    }
+                }
+                else if ( key == "encoding" ) {
+                    size_t encoding = 0;
+                    while ( encoding < sizeof( FieldEncodingNames ) / sizeof( FieldEncodingNames[0] ) && value != FieldEncodingNames[encoding] )
+                        ++encoding;
+                    if ( encoding == sizeof( FieldEncodingNames ) / sizeof( FieldEncodingNames[0] ) )
+                        ThrowSchemaError( origin, number, "unknown encoding '" + value + "'" );
+                    field.encoding = static_cast<FieldEncoding>( encoding );
+                    hasEncoding = true;
+                }
+                else if ( key == "date" ) {
+                    size_t date = 1;
+                    while ( date < sizeof( DateEncodingNames ) / sizeof( DateEncodingNames[0] ) && value != DateEncodingNames[date] )
+                        ++date;
+                    if ( date == sizeof( DateEncodingNames ) / sizeof( DateEncodingNames[0] ) )
+                        ThrowSchemaError( origin, number, "unknown date encoding '" + value + "'" );
+                    field.date = static_cast<DateEncoding>( date );
+                }
+                else if ( key == "byteorder" ) {
+                    if ( value != "big" && value != "little" )
+                        ThrowSchemaError( origin, number, "expected byteorder=big|little" );
+                    field.byteOrder = value == "big" ? ByteOrder_Big : ByteOrder_Little;
+                }
+                else if ( key == "collation" ) {
+                    size_t collation = 0;
+                    while ( collation < sizeof( CollationNames ) / sizeof( CollationNames[0] ) && value != CollationNames[collation] )
+                        ++collation;
+                    if ( collation == sizeof( CollationNames ) / sizeof( CollationNames[0] ) )
+                        ThrowSchemaError( origin, number, "unknown collation '" + value + "'" );
+                    field.column.collation = static_cast<Collation>( collation );
+                }
+                else {
+                    ThrowSchemaError( origin, number, "unknown option '" + key + "'" );
+                }
+            }
+            if ( !hasOffset || !hasWidth || !hasEncoding )
+                ThrowSchemaError( origin, number, "field '" + tokens[1] + "' needs offset, width and encoding" );
+            if ( layout.m_recordLength == 0 )
+                ThrowSchemaError( origin, number, "record must come before the fields" );
+            const std::string error = layout.Check( field );
+            if ( !error.empty() )
+                ThrowSchemaError( origin, number, error );
+            layout.m_fields.push_back( field );
+        }
+        else {
+            ThrowSchemaError( origin, number, "unknown keyword '" + keyword + "'" );
+        }
+    }
+
+    if ( layout.m_fields.empty() )
+        ThrowSchemaError( origin, number, "no fields" );
+    return layout;
+}
+
+inline void RecordLayout::AddField( const RecordField& field )
+{
+    const std::string error = Check( field );
+    if ( !error.empty() )
+        throw TableauException( TAB_RESULT_InvalidArgument, WidenUtf8( error ) );
+    m_fields.push_back( field );
+}
+
+inline std::vector<ColumnSpec> RecordLayout::GetColumns() const
+{
+    std::vector<ColumnSpec> columns;
+    for ( size_t i = 0; i < m_fields.size(); ++i )
+        columns.push_back( m_fields[i].column );
+    return columns;
+}
+
+inline std::string RecordLayout::Check( const RecordField& field ) const
+{
+    const Type type = field.column.type;
+    const bool text = field.encoding == FieldEncoding_Text || field.encoding == FieldEncoding_Ebcdic;
+    if ( field.width == 0 || field.offset + field.width > m_recordLength )
+        return "field does not fit into a record of " + std::to_string( m_recordLength ) + " bytes";
+    if ( ( field.encoding == FieldEncoding_Binary || field.encoding == FieldEncoding_Unsigned ) && field.width > 8 )
+        return "binary fields are 1 to 8 bytes wide";
+    if ( field.encoding == FieldEncoding_Float && field.width != 4 && field.width != 8 )
+        return "float fields are 4 or 8 bytes wide";
+    if ( ( field.encoding == FieldEncoding_Packed && field.width > 9 ) || ( field.encoding == FieldEncoding_Zoned && field.width > 18 ) )
+        return "decimal fields hold at most 18 digits";
+    if ( IsStringType( type ) && !text )
+        return "string columns need text or ebcdic fields";
+    if ( type == Type_Duration )
+        return "Duration columns are not supported";
+    if ( field.scale > 18 )
+        return "scale is at most 18";
+    if ( ( type == Type_Date || type == Type_DateTime ) && field.encoding == FieldEncoding_Float )
+        return "dates cannot be float fields";
+    if ( field.date != DateEncoding_Default && type != Type_DateTime && type != Type_Date )
+        return "only Date and DateTime columns have a date encoding";
+    if ( type == Type_Date && ( field.date == DateEncoding_YYYYMMDDHHMMSS || field.date == DateEncoding_UnixSeconds ) )
+        return "Date columns cannot have a date time encoding";
+    return std::string();
+}
+
+// -----------------------------------------------------------------------
+// FixedWidthLoader methods
+// -----------------------------------------------------------------------
+
+inline LoadStats
+FixedWidthLoader::Load(
+    const std::string& inputPath,
+    Table& table,
+    TableDefinition& tableDefinition,
+    const CancellationToken& token
+)
+{
+    LoadStats stats;
+    MappedFile file( inputPath );
+    const std::vector<RecordField>& fields = m_layout.GetFields();
+    const size_t width = fields.size();
+    const size_t recordLength = m_layout.GetRecordLength();
+    const uint64_t body = file.GetSize() > m_layout.GetSkip() ? file.GetSize() - m_layout.GetSkip() : 0;
+    const uint64_t records = body / recordLength;
+    const unsigned char* base = file.GetData() + std::min<uint64_t>( m_layout.GetSkip(), file.GetSize() );
+    const size_t batchRecords = std::max<size_t>( 1, m_options.batchRecords );
+
+    ProgressCounters& progress = table.GetProgressCounters();
+    progress.AddExpected( records, file.GetSize() );
+    stats.bytes = file.GetSize() - body;   // the header
+    progress.AddInputBytes( stats.bytes );
+
+    DecodedBatch batches[2];
+    auto decode = [&fields, width, base, recordLength]( DecodedBatch& batch, size_t begin, size_t end ) {
+        for ( size_t i = begin; i < end; ++i ) {
+            const unsigned char* record = base + ( batch.first + i ) * recordLength;
+            DecodedCell* cells = &batch.cells[i * width];
+            bool valid = true;
+            for ( size_t c = 0; c < width && valid; ++c )
+                valid = DecodeField( record, fields[c], cells[c] );
+            batch.valid[i] = valid;
+        }
+    };
+
+    // Declared after the batches and the decoder, so its threads are joined before they go away.
+    std::unique_ptr<ThreadPool> pool( m_options.threads > 1 ? new ThreadPool( m_options.threads ) : nullptr );
+
+    // Starts decoding the records after the previous batch.
+    uint64_t next = 0;
+    auto start = [&]( DecodedBatch& batch ) {
+        batch.first = next;
+        batch.count = static_cast<size_t>( std::min<uint64_t>( batchRecords, records - next ) );
+        batch.decoded.clear();
+        next += batch.count;
+        batch.cells.resize( batch.count * width );
+        batch.valid.resize( batch.count );
+        if ( !pool || batch.count < 2 * m_options.threads ) {
+            decode( batch, 0, batch.count );
+            return;
+        }
+        for ( size_t s = 0; s < m_options.threads; ++s ) {
+            const size_t begin = batch.count * s / m_options.threads;
+            const size_t end = batch.count * ( s + 1 ) / m_options.threads;
+            DecodedBatch* target = &batch;
+            batch.decoded.push_back( pool->Submit( [&decode, target, begin, end] { decode( *target, begin, end ); } ) );
+        }
+    };
+
+    Row row( tableDefinition );
+    ConversionScratch scratch;
+    start( batches[0] );
+    for ( int current = 0; batches[current].count > 0; current ^= 1 ) {
+        DecodedBatch& batch = batches[current];
+        for ( size_t s = 0; s < batch.decoded.size(); ++s )
+            batch.decoded[s].get();
+        if ( token.IsCancelled() ) {
+            stats.cancelled = true;
+            break;
+        }
+        start( batches[current ^ 1] );
+
+        for ( size_t i = 0; i < batch.count; ++i ) {
+            if ( !batch.valid[i] ) {
+                ++stats.rejected;
+                continue;
+            }
+            const DecodedCell* cells = &batch.cells[i * width];
+            for ( size_t c = 0; c < width; ++c )
+                SetDecodedCell( row, static_cast<int>( c ), fields[c], cells[c], scratch );
+            table.Insert( row );
+            ++stats.rows;
+        }
+
+        const uint64_t offset = m_layout.GetSkip() + batch.first * recordLength;
+        const uint64_t length = batch.count * static_cast<uint64_t>( recordLength );
+        file.Release( offset, length );
+        stats.bytes += length;
+        progress.AddInputBytes( length );
+    }
+
+    // Wait for a batch still being decoded before the mapping goes away.
+    for ( int b = 0; b < 2; ++b ) {
+        for ( size_t s = 0; s < batches[b].decoded.size(); ++s ) {
+            if ( batches[b].decoded[s].valid() )
+                batches[b].decoded[s].wait();
+        }
+    }
+    if ( !stats.cancelled && body % recordLength != 0 ) {
+        ++stats.rejected;   // trailing partial record
+        stats.bytes += body % recordLength;
+        progress.AddInputBytes( body % recordLength );
+    }
+    return stats;
+}
+
+inline LoadStats
+FixedWidthLoader::Load(
+    const std::string& inputPath,
+    const std::wstring& extractPath,
+    const CancellationToken& token
+)
+{
+    if ( token.IsCancelled() ) {
+        LoadStats stats;
+        stats.cancelled = true;
+        return stats;
+    }
+    TableDefinition tableDefinition;
+    AddColumns( tableDefinition, m_layout.GetColumns() );
+    Extract extract( extractPath );
+    std::shared_ptr<Table> table = extract.AddTable( m_layout.GetTableName(), tableDefinition );
+    LoadStats stats = Load( inputPath, *table, tableDefinition, token );
+    table.reset();
+    extract.Close();
+    if ( stats.cancelled ) {
+        RemoveFile( extractPath );
+        stats.discarded = true;
+    }
+    return stats;
+}
+
+} // namespace Tableau
+#endif // TableauFixedWidth_CPP_H
@@ -16,7 +16,11 @@
 
 #include "TableauHyperExtract.h"
 #include "TableauCommon_cpp.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace Tableau {
 
@@ -200,6 +204,15 @@ class Row
         std::wstring value
     );
 
+    /// Sets the specified column in the row to a string value that is already in TableauString (UTF-16) form. Use this to skip the per-call conversion done by <b>SetString</b>.
+    /// @param columnNumber The column number (zero-based) to set a value for.
+    /// @param value The null-terminated string value.
+    void
+    SetTableauString(
+        int columnNumber,
+        TableauString value
+    );
+
     /// Sets the specified column in the row to a string value.
     /// @param columnNumber The column number (zero-based) to set a value for.
     /// @param value The string value.
@@ -280,6 +293,91 @@ class Row
     friend class Table;
 };
 
+/*------------------------------------------------------------------------
+  STRUCT
+  InsertProgress
+
+  Counts of a load at one point in time, see <b>Table::GetProgress</b> and
+  <b>Extract::GetProgress</b>. Expected totals are zero when unknown.
+
+  ------------------------------------------------------------------------*/
+
+struct InsertProgress
+{
+    InsertProgress() : rows(0), inputBytes(0), expectedRows(0), expectedBytes(0), closing(false) {}
+
+    /// Returns true once the expected input, else the expected rows, is all consumed; false while neither is known.
+    bool IsFinished() const
+    {
+        if ( expectedBytes > 0 )
+            return inputBytes >= expectedBytes;
+        return expectedRows > 0 && rows >= expectedRows;
+    }
+
+    uint64_t rows;            // rows inserted
+    uint64_t inputBytes;      // input consumed by the loader feeding the table
+    uint64_t expectedRows;
+    uint64_t expectedBytes;
+    bool closing;             // the extract is being or has been saved
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  ProgressCounters
+
+  The progress counters of one table. They are written by the thread that
+  inserts into the table, which lets every update be a plain load and
+  store, and may be read from any thread at any time.
+
+  ------------------------------------------------------------------------*/
+
+class ProgressCounters
+{
+  public:
+    ProgressCounters() : m_rows(0), m_inputBytes(0), m_expectedRows(0), m_expectedBytes(0), m_next(nullptr) {}
+
+    /// Counts inserted rows. Called by <b>Table::Insert</b>.
+    void AddRows( uint64_t rows ) { Add( m_rows, rows ); }
+
+    /// Counts consumed input, e.g. bytes of a file a loader has parsed.
+    void AddInputBytes( uint64_t bytes ) { Add( m_inputBytes, bytes ); }
+
+    /// Adds to the expected totals, e.g. the size of an input file before loading it.
+    void AddExpected( uint64_t rows, uint64_t bytes )
+    {
+        Add( m_expectedRows, rows );
+        Add( m_expectedBytes, bytes );
+    }
+
+    /// Adds the current counts to a progress.
+    void AddTo( InsertProgress& progress ) const
+    {
+        progress.rows += m_rows.load( std::memory_order_relaxed );
+        progress.inputBytes += m_inputBytes.load( std::memory_order_relaxed );
+        progress.expectedRows += m_expectedRows.load( std::memory_order_relaxed );
+        progress.expectedBytes += m_expectedBytes.load( std::memory_order_relaxed );
+    }
+
+  private:
+    // Only one thread writes, so no read-modify-write instruction is needed.
+    static void Add( std::atomic<uint64_t>& counter, uint64_t value )
+    {
+        counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+    }
+
+    std::atomic<uint64_t> m_rows;
+    std::atomic<uint64_t> m_inputBytes;
+    std::atomic<uint64_t> m_expectedRows;
+    std::atomic<uint64_t> m_expectedBytes;
+    const ProgressCounters* m_next;   // the previously opened table of the same extract
+
+    // Forbidden:
+    ProgressCounters( const ProgressCounters& );
+    ProgressCounters& operator=( const ProgressCounters& );
+
+    friend class Extract;
+};
+
 /*------------------------------------------------------------------------
   CLASS
   Table
@@ -298,17 +396,55 @@ class Table
         Row& row
     );
 
+    /// Inserts a range of tuples with one value per column, in order. The values are converted on several threads; only setting them and queueing the rows happens on the calling thread. Requires TableauRangeInsert_cpp.h.
+    /// @param first The first tuple.
+    /// @param last The end of the range.
+    template <class Iterator>
+    void
+    Insert(
+        Iterator first,
+        Iterator last
+    );
+
+    /// Inserts a range of structs or tuples like Insert(first, last), mapping each element to a tuple with one value per column. Requires TableauRangeInsert_cpp.h.
+    /// @param first The first element.
+    /// @param last The end of the range.
+    /// @param projection Maps an element to its tuple; called concurrently from several threads.
+    template <class Iterator, class Projection>
+    void
+    Insert(
+        Iterator first,
+        Iterator last,
+        Projection projection
+    );
+
     /// Gets the table's schema.
    /// @return A copy of the table's schema, which must be closed.
     std::shared_ptr<TableDefinition>
     GetTableDefinition(
     );
 
+    /// Gets the rows inserted into the table so far and the input its loader reported. May be called from any thread.
+    /// @return The current counts.
+    InsertProgress
+    GetProgress(
+    ) const;
+
+    /// Gets the table's counters, for loaders to report consumed and expected input. Only the thread inserting into the table may update them.
+    /// @return The counters.
+    ProgressCounters&
+    GetProgressCounters(
+    )
+    {
+        return *m_progress;
+    }
+
 
   private:
     TAB_HANDLE m_handle;
+    std::shared_ptr<ProgressCounters> m_progress;
 
-    Table() : m_handle(nullptr) {}
+    Table() : m_handle(nullptr), m_progress(new ProgressCounters) {}
 
     // Forbidden:
     Table( const Table& );
@@ -366,9 +502,23 @@ class Extract
         std::wstring name
     );
 
+    /// Gets the progress summed over all tables added or opened through this object, and whether it is being closed. May be called from any thread, also during and after Close().
+    /// @return The current counts.
+    InsertProgress
+    GetProgress(
+    ) const;
+
 
   private:
     TAB_HANDLE m_handle;
+    std::atomic<const ProgressCounters*> m_progress;   // the most recently opened table; each links to the one before
+    std::vector<std::shared_ptr<ProgressCounters> > m_tableProgress;
+    std::atomic<bool> m_closing;
+
+    std::shared_ptr<Table> WrapTable( TAB_HANDLE handle );
+
+    // Takes the handle over for CloseAsync (TableauCloseAsync_cpp.h).
+    friend struct AsyncClose;
 
     // Forbidden:
     Extract( const Extract& );
@@ -423,7 +573,7 @@ inline TableDefinition::TableDefinition(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Closes the TableDefinition object and frees associated memory.
@@ -439,7 +589,7 @@ inline void TableDefinition::Close()
         m_handle = nullptr;
 
         if ( result != TAB_RESULT_Success )
-            throw TableauException( result, TabGetLastErrorMessage() );
+            ThrowLastError( result );
     }
 }
 
@@ -454,7 +604,7 @@ TableDefinition::GetDefaultCollation(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return static_cast< Collation >( retval );
 }
@@ -470,7 +620,7 @@ TableDefinition::SetDefaultCollation(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Adds a column to the table definition. The order in which columns are added specifies their column number. String columns are defined with the current default collation.
@@ -486,7 +636,7 @@ TableDefinition::AddColumn(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Adds a column that has the specified collation.
@@ -504,7 +654,7 @@ TableDefinition::AddColumnWithCollation(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Returns the number of columns in the table definition.
@@ -518,7 +668,7 @@ TableDefinition::GetColumnCount(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return static_cast< int >( retval );
 }
@@ -536,7 +686,7 @@ TableDefinition::GetColumnName(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return ToStdString( retval );
 }
@@ -554,7 +704,7 @@ TableDefinition::GetColumnType(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return static_cast< Type >( retval );
 }
@@ -572,7 +722,7 @@ TableDefinition::GetColumnCollation(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return static_cast< Collation >( retval );
 }
@@ -594,7 +744,7 @@ inline Row::Row(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Closes the row and frees associated resources.
@@ -610,7 +760,7 @@ inline void Row::Close()
         m_handle = nullptr;
 
         if ( result != TAB_RESULT_Success )
-            throw TableauException( result, TabGetLastErrorMessage() );
+            ThrowLastError( result );
     }
 }
 
@@ -625,7 +775,7 @@ Row::SetNull(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a 32-bit unsigned integer value.
@@ -641,7 +791,7 @@ Row::SetInteger(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a 64-bit unsigned integer value.
@@ -657,7 +807,7 @@ Row::SetLongInteger(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a double value.
@@ -673,7 +823,7 @@ Row::SetDouble(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a Boolean value.
@@ -689,7 +839,7 @@ Row::SetBoolean(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a string value.
@@ -705,7 +855,23 @@ Row::SetString(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
+}
+
+// Sets the specified column in the row to a string value that is already in TableauString (UTF-16) form.
+inline void
+Row::SetTableauString(
+    int columnNumber,
+    TableauString value
+)
+{
+    TAB_RESULT result = TabRowSetString(m_handle
+        , columnNumber
+        , value
+    );
+
+    if ( result != TAB_RESULT_Success )
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a string value.
@@ -721,7 +887,7 @@ Row::SetCharString(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a date value.
@@ -741,7 +907,7 @@ Row::SetDate(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a datetime value.
@@ -769,7 +935,7 @@ Row::SetDateTime(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a duration value (time span).
@@ -793,7 +959,7 @@ Row::SetDuration(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Sets the specified column in the row to a geospatial value. Note that Z values are not supported.
@@ -809,7 +975,7 @@ Row::SetSpatial(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 
@@ -829,7 +995,32 @@ Table::Insert(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
+
+    m_progress->AddRows( 1 );
+}
+
+// Inserts a range of tuples. InsertRange is found by argument-dependent lookup in TableauRangeInsert_cpp.h.
+template <class Iterator>
+inline void
+Table::Insert(
+    Iterator first,
+    Iterator last
+)
+{
+    InsertRange( *this, first, last );
+}
+
+// Inserts a range of elements mapped to tuples. InsertRange is found by argument-dependent lookup in TableauRangeInsert_cpp.h.
+template <class Iterator, class Projection>
+inline void
+Table::Insert(
+    Iterator first,
+    Iterator last,
+    Projection projection
+)
+{
+    InsertRange( *this, first, last, projection );
 }
 
 // Gets the table's schema.
@@ -843,13 +1034,23 @@ Table::GetTableDefinition(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     std::shared_ptr<TableDefinition> ret = std::shared_ptr<TableDefinition>(new TableDefinition);
     ret->m_handle = retval;
     return ret;
 }
 
+// Gets the rows inserted into the table so far and the input its loader reported.
+inline InsertProgress
+Table::GetProgress(
+) const
+{
+    InsertProgress progress;
+    m_progress->AddTo( progress );
+    return progress;
+}
+
 
 
 // -----------------------------------------------------------------------
@@ -859,7 +1060,8 @@ Table::GetTableDefinition(
 // Initializes an extract object using a file system path and file name. If the extract file already exists, this method opens the extract. If the file does not already exist, the method initializes a new extract. You must explicitly close this object in order to save the extract to disk and release its resources.
 inline Extract::Extract(
     std::wstring path
-)
+) : m_progress(nullptr),
+    m_closing(false)
 {
     TAB_RESULT result = TabExtractCreate(
         &m_handle
@@ -867,7 +1069,7 @@ inline Extract::Extract(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Closes the extract and any open tables that it contains. You must call this method in order to save the extract to a .hyper file and to release its resources.
@@ -879,11 +1081,12 @@ inline Extract::~Extract()
 inline void Extract::Close()
 {
     if ( m_handle != nullptr ) {
+        m_closing = true;
         TAB_RESULT result = TabExtractClose( m_handle );
         m_handle = nullptr;
 
         if ( result != TAB_RESULT_Success )
-            throw TableauException( result, TabGetLastErrorMessage() );
+            ThrowLastError( result );
     }
 }
 
@@ -902,11 +1105,9 @@ Extract::AddTable(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
-    std::shared_ptr<Table> ret = std::shared_ptr<Table>(new Table);
-    ret->m_handle = retval;
-    return ret;
+    return WrapTable( retval );
 }
 
 // Opens the specified table in the extract.
@@ -922,11 +1123,9 @@ Extract::OpenTable(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
-    std::shared_ptr<Table> ret = std::shared_ptr<Table>(new Table);
-    ret->m_handle = retval;
-    return ret;
+    return WrapTable( retval );
 }
 
 // Determines whether the specified table exists in the extract.
@@ -942,11 +1141,37 @@ Extract::HasTable(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 
     return retval != 0;
 }
 
+// Gets the progress summed over all tables added or opened through this object.
+inline InsertProgress
+Extract::GetProgress(
+) const
+{
+    InsertProgress progress;
+    for ( const ProgressCounters* table = m_progress.load( std::memory_order_acquire ); table != nullptr; table = table->m_next )
+        table->AddTo( progress );
+    progress.closing = m_closing;
+    return progress;
+}
+
+// Wraps a table handle and links the table's counters into the extract's list.
+inline std::shared_ptr<Table>
+Extract::WrapTable(
+    TAB_HANDLE handle
+)
+{
+    std::shared_ptr<Table> ret = std::shared_ptr<Table>(new Table);
+    ret->m_handle = handle;
+    ret->m_progress->m_next = m_progress.load( std::memory_order_relaxed );
+    m_tableProgress.push_back( ret->m_progress );
+    m_progress.store( ret->m_progress.get(), std::memory_order_release );
+    return ret;
+}
+
 
 
 // -----------------------------------------------------------------------
@@ -962,7 +1187,7 @@ ExtractAPI::Initialize(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 // Shuts down the Extract API. This call is required only if you previously called the Initialize method.
@@ -974,7 +1199,7 @@ ExtractAPI::Cleanup(
     );
 
     if ( result != TAB_RESULT_Success )
-        throw TableauException( result, TabGetLastErrorMessage() );
+        ThrowLastError( result );
 }
 
 } // namespace Tableau
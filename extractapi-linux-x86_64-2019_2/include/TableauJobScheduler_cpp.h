@@ -0,0 +1,368 @@
+// -----------------------------------------------------------------------
+// TableauJobScheduler_cpp.h
+// -----------------------------------------------------------------------
+// Work-stealing scheduler for writing many extracts of mixed sizes.
+
+#ifndef TableauJobScheduler_CPP_H
+#define TableauJobScheduler_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  WorkStealingScheduler
+
+  Runs tasks on a fixed set of workers that each own a deque. A worker
+  takes its newest task from the back of its own deque and, when that is
+  empty, steals the oldest task from the front of another worker's. Tasks
+  submitted by a running task go to the current worker's deque, so a task
+  can queue its own continuation; other tasks are spread over the workers.
+
+  ------------------------------------------------------------------------*/
+
+class WorkStealingScheduler
+{
+  public:
+    typedef std::function<void()> Task;
+
+    /// Starts the workers.
+    /// @param workers The number of worker threads; zero uses one per hardware thread.
+    explicit WorkStealingScheduler( size_t workers = 0 );
+
+    /// Waits for the submitted tasks and joins the workers.
+    ~WorkStealingScheduler();
+
+    /// Queues a task.
+    void Submit( Task task );
+
+    /// Waits until all submitted tasks, including the ones they submitted, have run.
+    /// Rethrows the first exception a task threw.
+    void Wait();
+
+    /// Returns the number of workers.
+    size_t GetWorkerCount() const { return m_workers.size(); }
+
+    /// Returns the number of tasks that were stolen from another worker's deque.
+    size_t GetStealCount() const { return m_steals; }
+
+  private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void Run( size_t index );
+    bool Take( size_t index, Task& task );
+
+    // The scheduler and worker index of the calling thread, if it is a worker.
+    static WorkStealingScheduler*& CurrentScheduler()
+    {
+        static thread_local WorkStealingScheduler* scheduler = nullptr;
+        return scheduler;
+    }
+    static size_t& CurrentWorker()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    std::vector<std::unique_ptr<Worker> > m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_queued;    // tasks in the deques
+    std::atomic<size_t> m_pending;   // tasks submitted but not finished
+    std::atomic<size_t> m_steals;
+    std::atomic<size_t> m_next;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_stopping;
+    std::exception_ptr m_error;
+
+    // Forbidden:
+    WorkStealingScheduler( const WorkStealingScheduler& );
+    WorkStealingScheduler& operator=( const WorkStealingScheduler& );
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ExtractJob
+
+  One extract to write: its path, its number of rows, and a function that
+  sets the columns of the row with the given zero-based index.
+
+  ------------------------------------------------------------------------*/
+
+struct ExtractJob
+{
+    std::wstring path;
+    long rows;
+    std::function<void( Row& row, long index )> fill;
+};
+
+// -----------------------------------------------------------------------
+// WorkStealingScheduler methods
+// -----------------------------------------------------------------------
+
+inline WorkStealingScheduler::WorkStealingScheduler( size_t workers )
+    : m_queued(0),
+      m_pending(0),
+      m_steals(0),
+      m_next(0),
+      m_stopping(false)
+{
+    if ( workers == 0 )
+        workers = std::max( 1u, std::thread::hardware_concurrency() );
+    for ( size_t i = 0; i < workers; ++i )
+        m_workers.push_back( std::unique_ptr<Worker>( new Worker() ) );
+    for ( size_t i = 0; i < workers; ++i )
+        m_threads.push_back( std::thread( &WorkStealingScheduler::Run, this, i ) );
+}
+
+inline WorkStealingScheduler::~WorkStealingScheduler()
+{
+    try {
+        Wait();
+    }
+    catch ( ... ) {
+    }
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for ( size_t i = 0; i < m_threads.size(); ++i )
+        m_threads[i].join();
+}
+
+inline void WorkStealingScheduler::Submit( Task task )
+{
+    const size_t index = CurrentScheduler() == this ? CurrentWorker() : m_next++ % m_workers.size();
+    ++m_pending;
+    {
+        std::lock_guard<std::mutex> lock( m_workers[index]->mutex );
+        m_workers[index]->tasks.push_back( std::move( task ) );
+        ++m_queued;
+    }
+    {
+        // Pairs with the check in Run(), so a worker about to sleep sees the task.
+        std::lock_guard<std::mutex> lock( m_mutex );
+    }
+    m_wake.notify_one();
+}
+
+inline void WorkStealingScheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_done.wait( lock, [this] { return m_pending == 0; } );
+    if ( m_error ) {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception( error );
+    }
+}
+
+inline bool WorkStealingScheduler::Take( size_t index, Task& task )
+{
+    {
+        Worker& own = *m_workers[index];
+        std::lock_guard<std::mutex> lock( own.mutex );
+        if ( !own.tasks.empty() ) {
+            task = std::move( own.tasks.back() );
+            own.tasks.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+    for ( size_t i = 1; i < m_workers.size(); ++i ) {
+        Worker& victim = *m_workers[( index + i ) % m_workers.size()];
+        std::lock_guard<std::mutex> lock( victim.mutex );
+        if ( !victim.tasks.empty() ) {
+            task = std::move( victim.tasks.front() );
+            victim.tasks.pop_front();
+            --m_queued;
+            ++m_steals;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void WorkStealingScheduler::Run( size_t index )
+{
+    CurrentScheduler() = this;
+    CurrentWorker() = index;
+    for ( ;; ) {
+        Task task;
+        if ( Take( index, task ) ) {
+            try {
+                task();
+            }
+            catch ( ... ) {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                if ( !m_error )
+                    m_error = std::current_exception();
+            }
+            task = Task();
+            if ( --m_pending == 0 ) {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                m_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_wake.wait( lock, [this] { return m_stopping || m_queued > 0; } );
+        if ( m_stopping && m_queued == 0 )
+            return;
+    }
+}
+
+// -----------------------------------------------------------------------
+// Extract jobs
+// -----------------------------------------------------------------------
+
+// The open extract of a job that is written in chunks.
+struct ChunkedExtractJob
+{
+    const ExtractJob* job;
+    std::unique_ptr<Extract> extract;
+    std::unique_ptr<TableDefinition> schema;
+    std::shared_ptr<Table> table;
+    std::unique_ptr<Row> row;
+    long next;
+};
+
+namespace {
+
+    inline void InsertRows( const ExtractJob& job, Table& table, Row& row, long begin, long end )
+    {
+        for ( long i = begin; i < end; ++i ) {
+            job.fill( row, i );
+            table.Insert( row );
+        }
+    }
+
+    inline void RunExtractChunk(
+        WorkStealingScheduler& scheduler,
+        const std::wstring& tableName,
+        const std::vector<ColumnSpec>& columns,
+        std::shared_ptr<ChunkedExtractJob> state,
+        long chunkRows
+    )
+    {
+        const ExtractJob& job = *state->job;
+        if ( !state->extract ) {
+            state->extract.reset( new Extract( job.path ) );
+            state->schema.reset( new TableDefinition() );
+            AddColumns( *state->schema, columns );
+            state->table = state->extract->AddTable( tableName, *state->schema );
+            state->row.reset( new Row( *state->schema ) );
+        }
+
+        const long end = std::min( job.rows, state->next + chunkRows );
+        InsertRows( job, *state->table, *state->row, state->next, end );
+        state->next = end;
+
+        if ( end < job.rows ) {
+            scheduler.Submit( [&scheduler, &tableName, &columns, state, chunkRows] {
+                RunExtractChunk( scheduler, tableName, columns, state, chunkRows );
+            } );
+        }
+        else {
+            state->row.reset();
+            state->table.reset();
+            state->extract->Close();
+        }
+    }
+
+    inline void RunExtractBatch(
+        const std::wstring& tableName,
+        const std::vector<ColumnSpec>& columns,
+        const std::vector<const ExtractJob*>& batch
+    )
+    {
+        TableDefinition schema;
+        AddColumns( schema, columns );
+        Row row( schema );
+        for ( size_t j = 0; j < batch.size(); ++j ) {
+            Extract extract( batch[j]->path );
+            std::shared_ptr<Table> table = extract.AddTable( tableName, schema );
+            InsertRows( *batch[j], *table, row, 0, batch[j]->rows );
+            extract.Close();
+        }
+    }
+
+}
+
+/// Writes all jobs on the scheduler and waits for them. The largest jobs are
+/// started first. Jobs smaller than chunkRows are batched into tasks of about
+/// chunkRows rows that share one TableDefinition; larger jobs are inserted
+/// chunkRows rows per task, each chunk queueing the next, so no task runs
+/// much longer than the others and idle workers keep stealing the batches.
+/// Chunks of one extract run one after the other since a table cannot be
+/// inserted into concurrently.
+/// @param scheduler The scheduler to run on.
+/// @param tableName The table to create in every extract.
+/// @param columns The schema of the table.
+/// @param jobs The extracts to write.
+/// @param chunkRows The number of rows per task.
+inline void
+RunExtractJobs(
+    WorkStealingScheduler& scheduler,
+    const std::wstring& tableName,
+    const std::vector<ColumnSpec>& columns,
+    const std::vector<ExtractJob>& jobs,
+    long chunkRows = 65536
+)
+{
+    // Longest processing time first.
+    std::vector<const ExtractJob*> order;
+    for ( size_t j = 0; j < jobs.size(); ++j )
+        order.push_back( &jobs[j] );
+    std::stable_sort( order.begin(), order.end(), []( const ExtractJob* a, const ExtractJob* b ) {
+        return a->rows > b->rows;
+    } );
+
+    std::vector<const ExtractJob*> batch;
+    long batchRows = 0;
+    for ( size_t j = 0; j < order.size(); ++j ) {
+        if ( order[j]->rows >= chunkRows ) {
+            std::shared_ptr<ChunkedExtractJob> state( new ChunkedExtractJob() );
+            state->job = order[j];
+            state->next = 0;
+            scheduler.Submit( [&scheduler, &tableName, &columns, state, chunkRows] {
+                RunExtractChunk( scheduler, tableName, columns, state, chunkRows );
+            } );
+            continue;
+        }
+
+        batch.push_back( order[j] );
+        batchRows += order[j]->rows;
+        if ( batchRows >= chunkRows || j + 1 == order.size() ) {
+            scheduler.Submit( [&tableName, &columns, batch] {
+                RunExtractBatch( tableName, columns, batch );
+            } );
+            batch.clear();
+            batchRows = 0;
+        }
+    }
+    scheduler.Wait();
+}
+
+} // namespace Tableau
+#endif // TableauJobScheduler_CPP_H
@@ -0,0 +1,785 @@
+// -----------------------------------------------------------------------
+// TableauJsonLines_cpp.h
+// -----------------------------------------------------------------------
+// Loads newline-delimited JSON feeds with a vectorized structural scanner.
+
+#ifndef TableauJsonLines_CPP_H
+#define TableauJsonLines_CPP_H
+
+#include "TableauCancellation_cpp.h"
+#include "TableauFeedLoader_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauMappedFile_cpp.h"
+#include "TableauSchemaFile_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  JsonLinesOptions
+
+  Threads and chunk size of a JsonLinesLoader.
+
+  ------------------------------------------------------------------------*/
+
+struct JsonLinesOptions
+{
+    JsonLinesOptions()
+        : threads(std::max( 1u, std::thread::hardware_concurrency() )), chunkBytes(1 << 20), simd(true) {}
+
+    size_t threads;      // parsing threads; 1 parses on the inserting thread
+    size_t chunkBytes;   // bytes per chunk, extended to the end of its last line
+    bool simd;           // find structural characters with SSE2 where available; false scans byte by byte
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  JsonLinesLoader
+
+  Loads files of newline-delimited JSON (one object per line) described
+  by a schema file, whose column sources name top-level keys. Delimiter,
+  header and #N sources do not apply.
+
+  The file is mapped and cut into chunks that end at line breaks. Each
+  chunk is parsed on its own thread in two stages, like simdjson: the
+  first finds the quotes, brackets, colons, commas and line breaks that
+  are not inside strings, 64 bytes at a time with SSE2 and bit arithmetic
+  for escapes and string ranges; the second walks only these positions.
+  Keys that no column reads are skipped without looking at their values,
+  and once all keys the columns read have been found, the second stage
+  skips the rest of the line; of duplicate keys, the first one counts.
+  Integers and doubles are parsed with std::from_chars on the parsing
+  threads; other values are converted by the same converters as delimited
+  feeds when the inserting thread sets them.
+
+  Missing keys and JSON null load as null, as do strings equal to one of
+  a column's null tokens. Objects and arrays load as their JSON text into
+  string columns. Lines that are not objects, and records with a value
+  that does not convert, are rejected; blank lines are skipped. Needs
+  C++17.
+
+  ------------------------------------------------------------------------*/
+
+class JsonLinesLoader
+{
+  public:
+    /// Initializes a loader.
+    /// @param schema The schema of the input files; column sources are JSON keys.
+    /// @param options The threads and chunk size.
+    JsonLinesLoader( const SchemaFile& schema, const JsonLinesOptions& options = JsonLinesOptions() );
+
+    /// Loads a file into an existing table created with the schema's columns.
+    /// @param inputPath The file to read.
+    /// @param table The table to insert into.
+    /// @param tableDefinition The definition the table was created with.
+    /// @param token Checked before every batch of chunks; once cancelled, the load returns with the rows inserted so far.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, Table& table, TableDefinition& tableDefinition,
+                    const CancellationToken& token = CancellationToken() );
+
+    /// Loads a file into a new extract.
+    /// @param inputPath The file to read.
+    /// @param extractPath The extract to create.
+    /// @param token Checked before every batch of chunks; once cancelled, the partial extract is closed and deleted.
+    /// @return The number of rows inserted and rejected.
+    LoadStats Load( const std::string& inputPath, const std::wstring& extractPath,
+                    const CancellationToken& token = CancellationToken() );
+
+  private:
+    struct Key
+    {
+        std::string name;
+        std::vector<size_t> columns;
+    };
+
+    SchemaFile m_schema;
+    JsonLinesOptions m_options;
+    std::vector<Key> m_keys;
+    std::vector<FieldConverter> m_converters;
+};
+
+namespace {
+
+    enum JsonCellKind
+    {
+        JsonCell_Missing,
+        JsonCell_Null,
+        JsonCell_Number,    // bits holds the int64 or the double of an Integer or Double column
+        JsonCell_Text,      // text points into the mapped file
+        JsonCell_Escaped    // bits is the offset of the unescaped text in the chunk's arena
+    };
+
+    struct JsonCell
+    {
+        int64_t bits;
+        const char* text;
+        uint32_t size;
+        uint8_t kind;
+    };
+
+    // One line-aligned piece of the input and the records parsed from it.
+    struct JsonChunk
+    {
+        const char* begin;
+        const char* end;
+        std::vector<uint32_t> structurals;
+        std::vector<JsonCell> cells;   // one row of cells per record
+        std::vector<char> valid;
+        std::string arena;
+        size_t records;
+        std::future<void> parsed;
+    };
+
+    // Quotes, backslashes, line feeds and the other structural characters of 64 bytes, one bit per byte.
+    struct JsonBlockMasks
+    {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t newline;
+        uint64_t op;
+    };
+
+    // Carried from one block to the next.
+    struct JsonScanState
+    {
+        JsonScanState() : escaped(0), inString(0) {}
+
+        uint64_t escaped;    // 1 if the first byte of the next block is escaped
+        uint64_t inString;   // all ones if the next block starts inside a string
+    };
+
+    inline bool IsJsonOperator( unsigned char c )
+    {
+        return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+    }
+
+    inline void ClassifyJsonBlock( const unsigned char* p, JsonBlockMasks& masks )
+    {
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8( '"' );
+        const __m128i backslash = _mm_set1_epi8( '\\' );
+        const __m128i newline = _mm_set1_epi8( '\n' );
+        const __m128i colon = _mm_set1_epi8( ':' );
+        const __m128i comma = _mm_set1_epi8( ',' );
+        const __m128i caseBit = _mm_set1_epi8( 0x20 );
+        const __m128i openBrace = _mm_set1_epi8( '{' );
+        const __m128i closeBrace = _mm_set1_epi8( '}' );
+        masks.quote = masks.backslash = masks.newline = masks.op = 0;
+        for ( int i = 0; i < 4; ++i ) {
+            const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( p + 16 * i ) );
+            // '[' and ']' differ from '{' and '}' only in bit 5.
+            const __m128i folded = _mm_or_si128( bytes, caseBit );
+            const __m128i op = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( folded, openBrace ), _mm_cmpeq_epi8( folded, closeBrace ) ),
+                                             _mm_or_si128( _mm_cmpeq_epi8( bytes, colon ), _mm_cmpeq_epi8( bytes, comma ) ) );
+            const int shift = 16 * i;
+            masks.quote |= static_cast<uint64_t>( static_cast<uint16_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, quote ) ) ) ) << shift;
+            masks.backslash |= static_cast<uint64_t>( static_cast<uint16_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, backslash ) ) ) ) << shift;
+            masks.newline |= static_cast<uint64_t>( static_cast<uint16_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, newline ) ) ) ) << shift;
+            masks.op |= static_cast<uint64_t>( static_cast<uint16_t>( _mm_movemask_epi8( op ) ) ) << shift;
+        }
+#else
+        masks.quote = masks.backslash = masks.newline = masks.op = 0;
+        for ( int i = 0; i < 64; ++i ) {
+            const uint64_t bit = uint64_t( 1 ) << i;
+            if ( p[i] == '"' )
+                masks.quote |= bit;
+            else if ( p[i] == '\\' )
+                masks.backslash |= bit;
+            else if ( p[i] == '\n' )
+                masks.newline |= bit;
+            else if ( IsJsonOperator( p[i] ) )
+                masks.op |= bit;
+        }
+#endif
+    }
+
+    // Bit i of the result is the parity of bits 0..i.
+    inline uint64_t PrefixXor( uint64_t bits )
+    {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    // Returns the bytes escaped by a backslash: those after an odd-length run of backslashes.
+    inline uint64_t FindEscapedBytes( uint64_t backslash, uint64_t& prevEscaped )
+    {
+        const uint64_t evenBits = 0x5555555555555555ULL;
+        backslash &= ~prevEscaped;
+        const uint64_t followsEscape = backslash << 1 | prevEscaped;
+        const uint64_t oddStarts = backslash & ~evenBits & ~followsEscape;
+        const uint64_t evenStartsCarry = oddStarts + backslash;
+        prevEscaped = evenStartsCarry < oddStarts ? 1 : 0;
+        return ( evenBits ^ ( evenStartsCarry << 1 ) ) & followsEscape;
+    }
+
+    inline void AppendBits( uint64_t bits, uint32_t base, std::vector<uint32_t>& out )
+    {
+        while ( bits != 0 ) {
+            out.push_back( base + static_cast<uint32_t>( __builtin_ctzll( bits ) ) );
+            bits &= bits - 1;
+        }
+    }
+
+    // Scans byte by byte. A line feed always ends a line, even inside a
+    // string, where JSON does not allow it, so one bad line cannot spoil
+    // the lines after it.
+    inline void ScanJsonBytes( const unsigned char* p, size_t size, uint32_t base, JsonScanState& state,
+                               std::vector<uint32_t>& out )
+    {
+        bool inString = state.inString != 0;
+        bool escaped = state.escaped != 0;
+        for ( size_t i = 0; i < size; ++i ) {
+            const unsigned char c = p[i];
+            if ( c == '\n' ) {
+                inString = escaped = false;
+                out.push_back( base + static_cast<uint32_t>( i ) );
+            }
+            else if ( escaped ) {
+                escaped = false;
+            }
+            else if ( inString ) {
+                if ( c == '\\' ) {
+                    escaped = true;
+                }
+                else if ( c == '"' ) {
+                    inString = false;
+                    out.push_back( base + static_cast<uint32_t>( i ) );
+                }
+            }
+            else if ( c == '"' ) {
+                inString = true;
+                out.push_back( base + static_cast<uint32_t>( i ) );
+            }
+            else if ( IsJsonOperator( c ) ) {
+                out.push_back( base + static_cast<uint32_t>( i ) );
+            }
+        }
+        state.inString = inString ? ~uint64_t( 0 ) : 0;
+        state.escaped = escaped ? 1 : 0;
+    }
+
+    // Appends the offsets of the structural characters outside strings,
+    // and of all quotes that delimit strings.
+    inline void FindJsonStructurals( const char* data, size_t size, bool simd, std::vector<uint32_t>& out )
+    {
+        out.clear();
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>( data );
+        JsonScanState state;
+        if ( !simd ) {
+            ScanJsonBytes( bytes, size, 0, state, out );
+            return;
+        }
+        unsigned char padded[64];
+        for ( size_t offset = 0; offset < size; offset += 64 ) {
+            const unsigned char* block = bytes + offset;
+            const size_t length = std::min<size_t>( 64, size - offset );
+            if ( length < 64 ) {
+                std::memset( padded, ' ', sizeof( padded ) );
+                std::memcpy( padded, block, length );
+                block = padded;
+            }
+            JsonBlockMasks masks;
+            ClassifyJsonBlock( block, masks );
+            const JsonScanState start = state;
+            const uint64_t escaped = FindEscapedBytes( masks.backslash, state.escaped );
+            const uint64_t quotes = masks.quote & ~escaped;
+            const uint64_t inString = PrefixXor( quotes ) ^ state.inString;
+            if ( ( masks.newline & inString ) != 0 ) {
+                // A line break inside a string: only malformed lines get here.
+                state = start;
+                ScanJsonBytes( block, length, static_cast<uint32_t>( offset ), state, out );
+                continue;
+            }
+            state.inString = static_cast<uint64_t>( static_cast<int64_t>( inString ) >> 63 );
+            AppendBits( ( ( masks.op & ~inString ) | quotes | masks.newline ) & ( length < 64 ? ( uint64_t( 1 ) << length ) - 1 : ~uint64_t( 0 ) ),
+                        static_cast<uint32_t>( offset ), out );
+        }
+    }
+
+    inline void AppendUtf8CodePoint( std::string& out, unsigned int codePoint )
+    {
+        if ( codePoint < 0x80 ) {
+            out.push_back( static_cast<char>( codePoint ) );
+        }
+        else if ( codePoint < 0x800 ) {
+            out.push_back( static_cast<char>( 0xC0 | ( codePoint >> 6 ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+        }
+        else if ( codePoint < 0x10000 ) {
+            out.push_back( static_cast<char>( 0xE0 | ( codePoint >> 12 ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+        }
+        else {
+            out.push_back( static_cast<char>( 0xF0 | ( codePoint >> 18 ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) ) );
+            out.push_back( static_cast<char>( 0x80 | ( codePoint & 0x3F ) ) );
+        }
+    }
+
+    inline bool ParseHex4( const char*& pos, const char* end, unsigned int& value )
+    {
+        if ( end - pos < 4 )
+            return false;
+        unsigned int result = 0;
+        const char* ptr = std::from_chars( pos, pos + 4, result, 16 ).ptr;
+        if ( ptr != pos + 4 )
+            return false;
+        pos += 4;
+        value = result;
+        return true;
+    }
+
+    // Appends the UTF-8 text of a JSON string body with escapes.
+    inline bool UnescapeJsonString( const char* pos, const char* end, std::string& out )
+    {
+        while ( pos < end ) {
+            const char* backslash = static_cast<const char*>( std::memchr( pos, '\\', end - pos ) );
+            if ( backslash == nullptr )
+                backslash = end;
+            out.append( pos, backslash );
+            pos = backslash;
+            if ( pos == end )
+                return true;
+            if ( ++pos == end )
+                return false;
+            switch ( *pos++ ) {
+                case '"': out.push_back( '"' ); break;
+                case '\\': out.push_back( '\\' ); break;
+                case '/': out.push_back( '/' ); break;
+                case 'b': out.push_back( '\b' ); break;
+                case 'f': out.push_back( '\f' ); break;
+                case 'n': out.push_back( '\n' ); break;
+                case 'r': out.push_back( '\r' ); break;
+                case 't': out.push_back( '\t' ); break;
+                case 'u': {
+                    unsigned int codePoint;
+                    if ( !ParseHex4( pos, end, codePoint ) )
+                        return false;
+                    if ( codePoint >= 0xD800 && codePoint < 0xDC00 ) {
+                        unsigned int low;
+                        if ( end - pos < 6 || pos[0] != '\\' || pos[1] != 'u' )
+                            return false;
+                        pos += 2;
+                        if ( !ParseHex4( pos, end, low ) || low < 0xDC00 || low >= 0xE000 )
+                            return false;
+                        codePoint = 0x10000 + ( ( codePoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+                    }
+                    else if ( codePoint >= 0xDC00 && codePoint < 0xE000 ) {
+                        return false;
+                    }
+                    AppendUtf8CodePoint( out, codePoint );
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool ParseJsonNumber( Type type, const char* begin, const char* end, int64_t& bits )
+    {
+        if ( type == Type_Integer ) {
+            const std::from_chars_result result = std::from_chars( begin, end, bits );
+            return result.ec == std::errc() && result.ptr == end;
+        }
+        double value;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        const std::from_chars_result result = std::from_chars( begin, end, value );
+        if ( result.ec != std::errc() || result.ptr != end )
+            return false;
+#else
+        // Without floating-point from_chars, strtod needs a terminated copy.
+        const std::string text( begin, end );
+        char* parsed = nullptr;
+        value = std::strtod( text.c_str(), &parsed );
+        if ( parsed == text.c_str() || *parsed != '\0' )
+            return false;
+#endif
+        std::memcpy( &bits, &value, sizeof( value ) );
+        return true;
+    }
+
+    inline bool IsJsonSpace( char c )
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+}
+
+// -----------------------------------------------------------------------
+// JsonLinesLoader methods
+// -----------------------------------------------------------------------
+
+inline JsonLinesLoader::JsonLinesLoader(
+    const SchemaFile& schema,
+    const JsonLinesOptions& options
+) : m_schema(schema),
+    m_options(options)
+{
+    const std::vector<SchemaField>& fields = schema.GetFields();
+    for ( size_t i = 0; i < fields.size(); ++i ) {
+        if ( fields[i].sourceIndex >= 0 )
+            throw TableauException( TAB_RESULT_InvalidArgument,
+                                    L"JSON fields are addressed by key, not by index: column '" + fields[i].column.name + L"'" );
+        m_converters.push_back( ConverterFor( fields[i].column.type ) );
+        size_t key = 0;
+        while ( key < m_keys.size() && m_keys[key].name != fields[i].source )
+            ++key;
+        if ( key == m_keys.size() ) {
+            m_keys.push_back( Key() );
+            m_keys.back().name = fields[i].source;
+        }
+        m_keys[key].columns.push_back( i );
+    }
+}
+
+inline LoadStats
+JsonLinesLoader::Load(
+    const std::string& inputPath,
+    Table& table,
+    TableDefinition& tableDefinition,
+    const CancellationToken& token
+)
+{
+    LoadStats stats;
+    MappedFile file( inputPath );
+    const char* const fileBegin = reinterpret_cast<const char*>( file.GetData() );
+    const char* const fileEnd = fileBegin + file.GetSize();
+    const std::vector<SchemaField>& fields = m_schema.GetFields();
+    const size_t width = fields.size();
+    const size_t threads = std::max<size_t>( 1, m_options.threads );
+    // Structural offsets are 32 bits wide.
+    const size_t chunkBytes = std::min<size_t>( std::max<size_t>( 4096, m_options.chunkBytes ), 1u << 30 );
+    const bool simd = m_options.simd;
+    const std::vector<Key>& keys = m_keys;
+
+    ProgressCounters& progress = table.GetProgressCounters();
+    progress.AddExpected( 0, file.GetSize() );
+
+    // Stores the value of one key in the cells of its columns.
+    auto store = [&fields, width]( JsonChunk& chunk, JsonCell* cells, const Key& key, const char* begin, const char* end,
+                                   bool string ) {
+        JsonCell value;
+        value.bits = 0;
+        value.text = begin;
+        value.size = static_cast<uint32_t>( end - begin );
+        value.kind = JsonCell_Text;
+        if ( !string && value.size == 4 && std::memcmp( begin, "null", 4 ) == 0 ) {
+            value.kind = JsonCell_Null;
+        }
+        else if ( string && std::memchr( begin, '\\', end - begin ) != nullptr ) {
+            const size_t offset = chunk.arena.size();
+            if ( !UnescapeJsonString( begin, end, chunk.arena ) )
+                return false;
+            value.kind = JsonCell_Escaped;
+            value.bits = static_cast<int64_t>( offset );
+            value.size = static_cast<uint32_t>( chunk.arena.size() - offset );
+        }
+        for ( size_t i = 0; i < key.columns.size(); ++i ) {
+            const SchemaField& field = fields[key.columns[i]];
+            JsonCell& cell = cells[key.columns[i]];
+            cell = value;
+            if ( value.kind == JsonCell_Null )
+                continue;
+            const char* text = value.kind == JsonCell_Escaped ? chunk.arena.data() + value.bits : value.text;
+            const FieldView view( text, text + value.size );
+            bool null = false;
+            for ( size_t j = 0; j < field.nullTokens.size() && !null; ++j )
+                null = view.Equals( field.nullTokens[j] );
+            if ( null ) {
+                cell.kind = JsonCell_Null;
+            }
+            else if ( field.column.type == Type_Integer || field.column.type == Type_Double ) {
+                if ( !ParseJsonNumber( field.column.type, view.begin, view.end, cell.bits ) )
+                    return false;
+                cell.kind = JsonCell_Number;
+            }
+        }
+        return true;
+    };
+
+    // Parses the object that starts at structural k and ends the line at
+    // structural lineEnd. On success k is lineEnd. Once every mapped key
+    // has been seen, the rest of the line is skipped unparsed.
+    auto parseObject = [&keys, &store]( JsonChunk& chunk, size_t& k, size_t lineEnd, JsonCell* cells ) {
+        const char* data = chunk.begin;
+        const uint32_t* s = chunk.structurals.data();
+        const size_t n = chunk.structurals.size();
+        if ( k >= n || data[s[k]] != '{' )
+            return false;
+        ++k;
+        if ( k < n && data[s[k]] == '}' ) {
+            ++k;
+            return k == n || data[s[k]] == '\n';
+        }
+        size_t found = 0;
+        for ( ;; ) {
+            if ( k + 3 >= n || data[s[k]] != '"' || data[s[k + 1]] != '"' || data[s[k + 2]] != ':' )
+                return false;
+            const char* name = data + s[k] + 1;
+            const size_t nameSize = s[k + 1] - s[k] - 1;
+            const char* literal = data + s[k + 2] + 1;
+            k += 3;
+
+            const Key* key = nullptr;
+            for ( size_t i = 0; i < keys.size() && key == nullptr; ++i ) {
+                if ( keys[i].name.size() == nameSize && std::memcmp( keys[i].name.data(), name, nameSize ) == 0 )
+                    key = &keys[i];
+            }
+            if ( key != nullptr && cells[key->columns[0]].kind != JsonCell_Missing )
+                key = nullptr;   // the first of duplicate keys wins
+
+            const char* begin;
+            const char* end;
+            bool string = false;
+            const char c = data[s[k]];
+            if ( c == '"' ) {
+                if ( k + 1 >= n || data[s[k + 1]] != '"' )
+                    return false;
+                begin = data + s[k] + 1;
+                end = data + s[k + 1];
+                string = true;
+                k += 2;
+            }
+            else if ( c == '{' || c == '[' ) {
+                begin = data + s[k];
+                size_t depth = 0;
+                for ( ; k < n; ++k ) {
+                    const char nested = data[s[k]];
+                    if ( nested == '{' || nested == '[' )
+                        ++depth;
+                    else if ( ( nested == '}' || nested == ']' ) && --depth == 0 )
+                        break;
+                    else if ( nested == '\n' )
+                        return false;
+                }
+                if ( k == n )
+                    return false;
+                end = data + s[k] + 1;
+                ++k;
+            }
+            else {
+                begin = literal;
+                end = data + s[k];
+                while ( begin < end && IsJsonSpace( *begin ) )
+                    ++begin;
+                while ( end > begin && IsJsonSpace( end[-1] ) )
+                    --end;
+                if ( begin == end )
+                    return false;
+            }
+
+            if ( k >= n )
+                return false;
+            if ( key != nullptr ) {
+                if ( !store( chunk, cells, *key, begin, end, string ) )
+                    return false;
+                if ( ++found == keys.size() ) {
+                    k = lineEnd;
+                    return true;
+                }
+            }
+            const char separator = data[s[k++]];
+            if ( separator == '}' )
+                return k == n || data[s[k]] == '\n';
+            if ( separator != ',' )
+                return false;
+        }
+    };
+
+    // Stage 1 over the whole chunk, then stage 2 line by line.
+    auto parse = [&parseObject, width, simd]( JsonChunk& chunk ) {
+        chunk.arena.clear();
+        chunk.cells.clear();
+        chunk.valid.clear();
+        chunk.records = 0;
+        FindJsonStructurals( chunk.begin, chunk.end - chunk.begin, simd, chunk.structurals );
+        const char* data = chunk.begin;
+        const uint32_t* s = chunk.structurals.data();
+        const size_t n = chunk.structurals.size();
+        const char* line = data;
+        size_t k = 0;
+        while ( line < chunk.end ) {
+            // Every line feed is a structural, so the one ending the line is found by offset.
+            const char* lineFeed = static_cast<const char*>( std::memchr( line, '\n', chunk.end - line ) );
+            const size_t lineEnd = lineFeed != nullptr ? std::lower_bound( s + k, s + n, static_cast<uint32_t>( lineFeed - data ) ) - s : n;
+            const char* next = lineFeed != nullptr ? lineFeed + 1 : chunk.end;
+            const char* first = line;
+            while ( first < next && ( IsJsonSpace( *first ) || *first == '\n' ) )
+                ++first;
+            if ( first < next ) {
+                JsonCell missing;
+                missing.bits = 0;
+                missing.text = nullptr;
+                missing.size = 0;
+                missing.kind = JsonCell_Missing;
+                chunk.cells.resize( ( chunk.records + 1 ) * width, missing );
+                size_t pos = k;
+                const bool valid = lineEnd > k && data + s[k] == first && parseObject( chunk, pos, lineEnd, &chunk.cells[chunk.records * width] )
+                                   && pos == lineEnd;
+                chunk.valid.push_back( valid );
+                ++chunk.records;
+            }
+            k = lineEnd < n ? lineEnd + 1 : n;
+            line = next;
+        }
+    };
+
+    // Cuts the next chunk off the unread input at a line break.
+    const char* next = fileBegin;
+    auto cut = [&next, fileEnd, chunkBytes]( JsonChunk& chunk ) {
+        chunk.begin = next;
+        chunk.end = fileEnd;
+        if ( static_cast<size_t>( fileEnd - next ) > chunkBytes ) {
+            const char* lineFeed = static_cast<const char*>( std::memchr( next + chunkBytes, '\n', fileEnd - next - chunkBytes ) );
+            if ( lineFeed != nullptr )
+                chunk.end = lineFeed + 1;
+        }
+        next = chunk.end;
+    };
+
+    std::vector<JsonChunk> batches[2];
+    batches[0].resize( threads );
+    batches[1].resize( threads );
+
+    // Declared after the batches and the parser, so its threads are joined before they go away.
+    std::unique_ptr<ThreadPool> pool( threads > 1 ? new ThreadPool( threads ) : nullptr );
+
+    // Starts parsing up to one chunk per thread; returns the number of chunks.
+    auto start = [&]( std::vector<JsonChunk>& batch ) {
+        size_t count = 0;
+        for ( ; count < batch.size() && next < fileEnd; ++count ) {
+            JsonChunk& chunk = batch[count];
+            cut( chunk );
+            if ( pool ) {
+                JsonChunk* target = &chunk;
+                chunk.parsed = pool->Submit( [&parse, target] { parse( *target ); } );
+            }
+            else {
+                parse( chunk );
+            }
+        }
+        return count;
+    };
+
+    Row row( tableDefinition );
+    ConversionScratch scratch;
+    size_t counts[2] = { start( batches[0] ), 0 };
+    for ( int current = 0; counts[current] > 0; current ^= 1 ) {
+        std::vector<JsonChunk>& batch = batches[current];
+        for ( size_t c = 0; c < counts[current]; ++c ) {
+            if ( batch[c].parsed.valid() )
+                batch[c].parsed.get();
+        }
+        if ( token.IsCancelled() ) {
+            stats.cancelled = true;
+            break;
+        }
+        counts[current ^ 1] = start( batches[current ^ 1] );
+
+        for ( size_t c = 0; c < counts[current]; ++c ) {
+            const JsonChunk& chunk = batch[c];
+            for ( size_t r = 0; r < chunk.records; ++r ) {
+                bool valid = chunk.valid[r] != 0;
+                const JsonCell* cells = &chunk.cells[r * width];
+                for ( size_t i = 0; i < width && valid; ++i ) {
+                    const JsonCell& cell = cells[i];
+                    const int column = static_cast<int>( i );
+                    switch ( cell.kind ) {
+                        case JsonCell_Missing:
+                        case JsonCell_Null:
+                            row.SetNull( column );
+                            break;
+                        case JsonCell_Number:
+                            if ( fields[i].column.type == Type_Integer ) {
+                                row.SetLongInteger( column, cell.bits );
+                            }
+                            else {
+                                double value;
+                                std::memcpy( &value, &cell.bits, sizeof( value ) );
+                                row.SetDouble( column, value );
+                            }
+                            break;
+                        default: {
+                            const char* text = cell.kind == JsonCell_Escaped ? chunk.arena.data() + cell.bits : cell.text;
+                            valid = m_converters[i]( row, column, FieldView( text, text + cell.size ), scratch );
+                            break;
+                        }
+                    }
+                }
+                if ( valid ) {
+                    table.Insert( row );
+                    ++stats.rows;
+                }
+                else {
+                    ++stats.rejected;
+                }
+            }
+            const uint64_t length = chunk.end - chunk.begin;
+            file.Release( chunk.begin - fileBegin, length );
+            stats.bytes += length;
+            progress.AddInputBytes( length );
+        }
+    }
+
+    // Wait for chunks still being parsed before the mapping goes away.
+    for ( int b = 0; b < 2; ++b ) {
+        for ( size_t c = 0; c < batches[b].size(); ++c ) {
+            if ( batches[b][c].parsed.valid() )
+                batches[b][c].parsed.wait();
+        }
+    }
+    return stats;
+}
+
+inline LoadStats
+JsonLinesLoader::Load(
+    const std::string& inputPath,
+    const std::wstring& extractPath,
+    const CancellationToken& token
+)
+{
+    if ( token.IsCancelled() ) {
+        LoadStats stats;
+        stats.cancelled = true;
+        return stats;
+    }
+    TableDefinition tableDefinition;
+    AddColumns( tableDefinition, m_schema.GetColumns() );
+    Extract extract( extractPath );
+    std::shared_ptr<Table> table = extract.AddTable( m_schema.GetTableName(), tableDefinition );
+    LoadStats stats = Load( inputPath, *table, tableDefinition, token );
+    table.reset();
+    extract.Close();
+    if ( stats.cancelled ) {
+        RemoveFile( extractPath );
+        stats.discarded = true;
+    }
+    return stats;
+}
+
+} // namespace Tableau
+#endif // TableauJsonLines_CPP_H
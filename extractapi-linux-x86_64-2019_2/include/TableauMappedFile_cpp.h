@@ -0,0 +1,113 @@
+// -----------------------------------------------------------------------
+// TableauMappedFile_cpp.h
+// -----------------------------------------------------------------------
+// Read-only memory mapping of input files.
+
+#ifndef TableauMappedFile_CPP_H
+#define TableauMappedFile_CPP_H
+
+#include "TableauCommon_cpp.h"
+#include "TableauSchemaFile_cpp.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  MappedFile
+
+  A file mapped read-only into memory. The mapping is advised for
+  sequential access and, where the kernel supports it for the file
+  system, for transparent huge pages.
+
+  ------------------------------------------------------------------------*/
+
+class MappedFile
+{
+  public:
+    /// Maps a file.
+    /// @param path The file to map.
+    explicit MappedFile( const std::string& path );
+
+    /// Unmaps the file.
+    ~MappedFile();
+
+    /// Returns the first byte of the file; null for an empty file.
+    const unsigned char* GetData() const { return m_data; }
+
+    /// Returns the size of the file in bytes.
+    uint64_t GetSize() const { return m_size; }
+
+    /// Tells the kernel a range will not be read again, so its pages can be dropped early.
+    void Release( uint64_t offset, uint64_t length );
+
+  private:
+    unsigned char* m_data;
+    uint64_t m_size;
+
+    // Forbidden:
+    MappedFile( const MappedFile& );
+    MappedFile& operator=( const MappedFile& );
+};
+
+// -----------------------------------------------------------------------
+// MappedFile methods
+// -----------------------------------------------------------------------
+
+inline MappedFile::MappedFile( const std::string& path )
+    : m_data(nullptr),
+      m_size(0)
+{
+    const int fd = open( path.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+        throw TableauException( errno != 0 ? errno : TAB_RESULT_FileNotFound,
+                                L"Could not open " + WidenUtf8( path ) );
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 ) {
+        const int error = errno;
+        close( fd );
+        throw TableauException( error, L"Could not stat " + WidenUtf8( path ) );
+    }
+    m_size = status.st_size;
+    if ( m_size > 0 ) {
+        void* data = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        const int error = errno;
+        close( fd );
+        if ( data == MAP_FAILED )
+            throw TableauException( error, L"Could not map " + WidenUtf8( path ) );
+        m_data = static_cast<unsigned char*>( data );
+        madvise( m_data, m_size, MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+        madvise( m_data, m_size, MADV_HUGEPAGE );
+#endif
+    }
+    else {
+        close( fd );
+    }
+}
+
+inline MappedFile::~MappedFile()
+{
+    if ( m_data != nullptr )
+        munmap( m_data, m_size );
+}
+
+inline void MappedFile::Release( uint64_t offset, uint64_t length )
+{
+    // Only whole pages inside the range can be dropped.
+    const uint64_t page = static_cast<uint64_t>( sysconf( _SC_PAGESIZE ) );
+    const uint64_t begin = ( offset + page - 1 ) / page * page;
+    const uint64_t end = std::min( offset + length, m_size ) / page * page;
+    if ( m_data != nullptr && end > begin )
+        madvise( m_data + begin, end - begin, MADV_DONTNEED );
+}
+
+} // namespace Tableau
+#endif // TableauMappedFile_CPP_H
@@ -0,0 +1,334 @@
+// -----------------------------------------------------------------------
+// TableauPartitionedWriter_cpp.h
+// -----------------------------------------------------------------------
+// Fans one stream of rows out to one extract per partition key.
+
+#ifndef TableauPartitionedWriter_CPP_H
+#define TableauPartitionedWriter_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauStickyRow_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/// Maps the value of the partition column to the name of its partition.
+typedef std::function<std::wstring( const Value& )> Partitioner;
+
+namespace {
+
+    // Makes a partition name safe as a file name: path separators, '%',
+    // control characters and a leading '.' (as in "..") are written as %XX.
+    inline std::wstring EscapePartitionName( const std::wstring& name )
+    {
+        std::wstring escaped;
+        for ( size_t i = 0; i < name.size(); ++i ) {
+            const wchar_t c = name[i];
+            if ( c == L'/' || c == L'\\' || c == L'%' || ( c >= 0 && c < 0x20 ) || c == 0x7F || ( c == L'.' && i == 0 ) ) {
+                wchar_t code[4];
+                std::swprintf( code, 4, L"%%%02X", static_cast<unsigned int>( c ) );
+                escaped += code;
+            }
+            else {
+                escaped.push_back( c );
+            }
+        }
+        return escaped;
+    }
+}
+
+/// Partitions by the value itself, e.g. one extract per tenant. Null values go to partition "null".
+/// Characters that are not safe in a file name are escaped, so values cannot name files outside the output directory.
+inline Partitioner
+ValuePartitioner()
+{
+    return []( const Value& value ) -> std::wstring {
+        if ( value.IsNull() )
+            return L"null";
+        switch ( value.GetType() ) {
+            case Type_CharString:
+            case Type_Spatial:
+                return EscapePartitionName( WidenPath( value.GetCharString() ) );
+            case Type_UnicodeString:
+                return EscapePartitionName( value.GetString() );
+            case Type_Double:
+                return std::to_wstring( value.GetDouble() );
+            default:
+                return std::to_wstring( value.GetPacked() );
+        }
+    };
+}
+
+/// Partitions into a fixed number of buckets by a hash of the value; partitions are named "0" to "buckets - 1".
+inline Partitioner
+HashPartitioner(
+    size_t buckets
+)
+{
+    if ( buckets == 0 )
+        throw TableauException( TAB_RESULT_InvalidArgument, L"A hash partitioner needs at least one bucket" );
+    return [buckets]( const Value& value ) -> std::wstring {
+        std::string bytes;
+        value.Serialize( bytes );
+        return std::to_wstring( HashBytes( bytes.data(), bytes.size() ) % buckets );
+    };
+}
+
+/// Partitions by ranges: partition i holds the values below upperBounds[i] (sorted ascending) and not in an earlier partition; partition upperBounds.size() holds the rest.
+inline Partitioner
+RangePartitioner(
+    const std::vector<Value>& upperBounds
+)
+{
+    return [upperBounds]( const Value& value ) -> std::wstring {
+        size_t i = 0;
+        while ( i < upperBounds.size() && value.Compare( upperBounds[i] ) >= 0 )
+            ++i;
+        return std::to_wstring( i );
+    };
+}
+
+/// Partitions Date and DateTime values by month; partitions are named "YYYY-MM".
+inline Partitioner
+MonthPartitioner()
+{
+    return []( const Value& value ) -> std::wstring {
+        if ( value.IsNull() )
+            return L"null";
+        int year, month, day, hour, min, sec, frac;
+        if ( value.GetType() == Type_Date )
+            value.GetDate( year, month, day );
+        else
+            value.GetDateTime( year, month, day, hour, min, sec, frac );
+        wchar_t name[16];
+        std::swprintf( name, 16, L"%04d-%02d", year, month );
+        return name;
+    };
+}
+
+/*------------------------------------------------------------------------
+  CLASS
+  PartitionedWriter
+
+  Routes every row to the extract of its partition, so one pass over the
+  input produces all per-tenant or per-month extracts. Rows are buffered
+  per partition and written in blocks; at most maxOpenExtracts extracts are
+  open at a time, and the least recently used one is closed to make room.
+  A closed partition is continued later by opening its file again, which
+  the Extract constructor does for existing files.
+
+  ------------------------------------------------------------------------*/
+
+class PartitionedWriter
+{
+  public:
+    /// Initializes a writer without any open extracts. A partition file left over
+    /// from an earlier run is replaced when the partition is first written.
+    /// @param pathPrefix Partition files are named pathPrefix + partition + ".hyper".
+    /// @param tableName The table to write in every extract.
+    /// @param columns The schema of the table.
+    /// @param partitionColumn The column (zero-based) whose value selects the partition.
+    /// @param partitioner Maps the partition column value to a partition name.
+    /// @param maxOpenExtracts The maximum number of simultaneously open extracts.
+    /// @param bufferRows The number of rows buffered per partition before they are written.
+    PartitionedWriter(
+        const std::wstring& pathPrefix,
+        const std::wstring& tableName,
+        const std::vector<ColumnSpec>& columns,
+        int partitionColumn,
+        Partitioner partitioner,
+        size_t maxOpenExtracts = 16,
+        size_t bufferRows = 4096
+    );
+
+    /// Calls Close().
+    ~PartitionedWriter();
+
+    /// Buffers a row for its partition.
+    void Write( const ValueRow& row );
+
+    /// Writes all buffered rows and closes all extracts.
+    void Close();
+
+    /// Returns the paths of all partition files written so far.
+    std::vector<std::wstring> GetPaths() const;
+
+    /// Returns the number of times a partition extract was opened again after being closed.
+    size_t GetReopenCount() const { return m_reopens; }
+
+  private:
+    struct Partition
+    {
+        Partition() : opened(false) {}
+
+        std::wstring path;
+        std::vector<ValueRow> buffer;
+        std::unique_ptr<Extract> extract;
+        std::shared_ptr<Table> table;
+        std::unique_ptr<TableDefinition> schema;
+        std::unique_ptr<StickyRow> row;
+        std::list<Partition*>::iterator lru;
+        bool opened;
+    };
+
+    void Flush( Partition& partition );
+    void Open( Partition& partition );
+    void Evict( Partition& partition );
+
+    std::wstring m_pathPrefix;
+    std::wstring m_tableName;
+    std::vector<ColumnSpec> m_columns;
+    int m_partitionColumn;
+    Partitioner m_partitioner;
+    size_t m_maxOpen;
+    size_t m_bufferRows;
+    size_t m_maxBufferedRows;
+    size_t m_bufferedRows;
+    size_t m_reopens;
+    std::map<std::wstring, Partition> m_partitions;
+    std::list<Partition*> m_open;   // most recently used first
+
+    // Forbidden:
+    PartitionedWriter( const PartitionedWriter& );
+    PartitionedWriter& operator=( const PartitionedWriter& );
+};
+
+// -----------------------------------------------------------------------
+// PartitionedWriter methods
+// -----------------------------------------------------------------------
+
+inline PartitionedWriter::PartitionedWriter(
+    const std::wstring& pathPrefix,
+    const std::wstring& tableName,
+    const std::vector<ColumnSpec>& columns,
+    int partitionColumn,
+    Partitioner partitioner,
+    size_t maxOpenExtracts,
+    size_t bufferRows
+) : m_pathPrefix(pathPrefix),
+    m_tableName(tableName),
+    m_columns(columns),
+    m_partitionColumn(partitionColumn),
+    m_partitioner(partitioner),
+    m_maxOpen(std::max<size_t>( 1, maxOpenExtracts )),
+    m_bufferRows(std::max<size_t>( 1, bufferRows )),
+    m_maxBufferedRows(4 * m_maxOpen * m_bufferRows),
+    m_bufferedRows(0),
+    m_reopens(0)
+{
+}
+
+inline PartitionedWriter::~PartitionedWriter()
+{
+    try {
+        Close();
+    }
+    catch ( const TableauException& ) {
+    }
+}
+
+inline void PartitionedWriter::Write( const ValueRow& row )
+{
+    const std::wstring name = m_partitioner( row[m_partitionColumn] );
+    Partition& partition = m_partitions[name];
+    if ( partition.path.empty() )
+        partition.path = m_pathPrefix + name + L".hyper";
+
+    partition.buffer.push_back( row );
+    ++m_bufferedRows;
+    if ( partition.buffer.size() >= m_bufferRows ) {
+        Flush( partition );
+    }
+    else if ( m_bufferedRows > m_maxBufferedRows ) {
+        // Many partitions with partly filled buffers: write the largest.
+        Partition* largest = &partition;
+        for ( std::map<std::wstring, Partition>::iterator it = m_partitions.begin(); it != m_partitions.end(); ++it ) {
+            if ( it->second.buffer.size() > largest->buffer.size() )
+                largest = &it->second;
+        }
+        Flush( *largest );
+    }
+}
+
+inline void PartitionedWriter::Close()
+{
+    for ( std::map<std::wstring, Partition>::iterator it = m_partitions.begin(); it != m_partitions.end(); ++it )
+        Flush( it->second );
+    while ( !m_open.empty() )
+        Evict( *m_open.back() );
+}
+
+inline std::vector<std::wstring> PartitionedWriter::GetPaths() const
+{
+    std::vector<std::wstring> paths;
+    for ( std::map<std::wstring, Partition>::const_iterator it = m_partitions.begin(); it != m_partitions.end(); ++it )
+        paths.push_back( it->second.path );
+    return paths;
+}
+
+inline void PartitionedWriter::Flush( Partition& partition )
+{
+    if ( partition.buffer.empty() )
+        return;
+
+    if ( partition.extract )
+        m_open.splice( m_open.begin(), m_open, partition.lru );
+    else
+        Open( partition );
+
+    for ( size_t r = 0; r < partition.buffer.size(); ++r ) {
+        const ValueRow& values = partition.buffer[r];
+        for ( size_t c = 0; c < values.size(); ++c )
+            partition.row->SetValue( static_cast<int>( c ), values[c] );
+        partition.table->Insert( partition.row->GetRow() );
+    }
+    m_bufferedRows -= partition.buffer.size();
+    partition.buffer.clear();
+}
+
+inline void PartitionedWriter::Open( Partition& partition )
+{
+    if ( m_open.size() >= m_maxOpen )
+        Evict( *m_open.back() );
+
+    if ( partition.opened )
+        ++m_reopens;
+    else
+        RemoveFile( partition.path );
+
+    partition.extract.reset( new Extract( partition.path ) );
+    partition.schema.reset( new TableDefinition() );
+    AddColumns( *partition.schema, m_columns );
+    if ( partition.extract->HasTable( m_tableName ) )
+        partition.table = partition.extract->OpenTable( m_tableName );
+    else
+        partition.table = partition.extract->AddTable( m_tableName, *partition.schema );
+    partition.row.reset( new StickyRow( *partition.schema ) );
+    partition.opened = true;
+
+    m_open.push_front( &partition );
+    partition.lru = m_open.begin();
+}
+
+inline void PartitionedWriter::Evict( Partition& partition )
+{
+    m_open.erase( partition.lru );
+    partition.row.reset();
+    partition.table.reset();
+    partition.schema.reset();
+    std::unique_ptr<Extract> extract( std::move( partition.extract ) );
+    extract->Close();
+}
+
+} // namespace Tableau
+#endif // TableauPartitionedWriter_CPP_H
@@ -0,0 +1,256 @@
+// -----------------------------------------------------------------------
+// TableauProgress_cpp.h
+// -----------------------------------------------------------------------
+// Rates, remaining time and stall detection for running loads.
+
+#ifndef TableauProgress_CPP_H
+#define TableauProgress_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ProgressOptions
+
+  Sampling interval, rate windows and stall threshold of a ProgressMonitor.
+
+  ------------------------------------------------------------------------*/
+
+struct ProgressOptions
+{
+    ProgressOptions() : intervalSeconds(1), shortWindowSeconds(10), longWindowSeconds(60), stallSeconds(30) {}
+
+    double intervalSeconds;      // how often Start() samples and calls back
+    double shortWindowSeconds;   // window of rowsPerSecond
+    double longWindowSeconds;    // window of averageRowsPerSecond, bytesPerSecond and the estimate
+    double stallSeconds;         // a load that made no progress for this long is stalled
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ProgressSnapshot
+
+  The state of a load when it was sampled. Rates are computed over the
+  samples within a window, or since the first sample while the load is
+  younger than the window. Values that cannot be computed are -1.
+
+  ------------------------------------------------------------------------*/
+
+struct ProgressSnapshot
+{
+    ProgressSnapshot()
+        : elapsedSeconds(0), rowsPerSecond(0), averageRowsPerSecond(0), bytesPerSecond(0),
+          fractionDone(-1), remainingSeconds(-1), idleSeconds(0), finished(false), stalled(false) {}
+
+    InsertProgress progress;
+    double elapsedSeconds;         // since the monitor was created
+    double rowsPerSecond;          // over the short window
+    double averageRowsPerSecond;   // over the long window
+    double bytesPerSecond;         // over the long window
+    double fractionDone;           // of the expected bytes, else of the expected rows
+    double remainingSeconds;       // at the long-window rate
+    double idleSeconds;            // since rows or input bytes last advanced
+    bool finished;                 // all expected input or rows are consumed, see InsertProgress::IsFinished
+    bool stalled;                  // idle for stallSeconds, neither finished nor closing
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  ProgressMonitor
+
+  Samples the progress of a table or an extract, either when asked with
+  <b>Sample</b> or every interval on a thread of its own that passes each
+  snapshot to a callback. Reading the counters takes no locks and never
+  slows down the inserting thread; the monitor only keeps enough samples
+  to cover the long window.
+
+  The table or extract must outlive the monitor.
+
+  ------------------------------------------------------------------------*/
+
+class ProgressMonitor
+{
+  public:
+    typedef std::function<InsertProgress()> Source;
+    typedef std::function<void( const ProgressSnapshot& )> Callback;
+
+    /// Monitors the rows and input of one table.
+    ProgressMonitor( const Table& table, const ProgressOptions& options = ProgressOptions() );
+
+    /// Monitors all tables of an extract, including its close.
+    ProgressMonitor( const Extract& extract, const ProgressOptions& options = ProgressOptions() );
+
+    /// Monitors arbitrary counts.
+    ProgressMonitor( const Source& source, const ProgressOptions& options = ProgressOptions() );
+
+    /// Stops the sampling thread.
+    ~ProgressMonitor();
+
+    /// Samples the counts now. Thread-safe.
+    ProgressSnapshot Sample();
+
+    /// Starts calling back with a new sample every interval, on a thread of the monitor.
+    /// @param callback Called with each snapshot; must not call Stop().
+    void Start( const Callback& callback );
+
+    /// Stops calling back; returns after the last call has finished.
+    void Stop();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Point
+    {
+        double seconds;
+        uint64_t rows;
+        uint64_t bytes;
+    };
+
+    // Returns the newest sample at least a window old, or the first sample.
+    const Point& WindowStart( double now, double window ) const;
+    void Run( Callback callback );
+
+    Source m_source;
+    ProgressOptions m_options;
+    Clock::time_point m_start;
+    std::mutex m_mutex;
+    std::deque<Point> m_points;
+    double m_lastAdvance;
+    std::thread m_thread;
+    std::mutex m_stopMutex;
+    std::condition_variable m_stopWake;
+    bool m_stopping;
+
+    // Forbidden:
+    ProgressMonitor( const ProgressMonitor& );
+    ProgressMonitor& operator=( const ProgressMonitor& );
+};
+
+// -----------------------------------------------------------------------
+// ProgressMonitor methods
+// -----------------------------------------------------------------------
+
+inline ProgressMonitor::ProgressMonitor( const Table& table, const ProgressOptions& options )
+    : ProgressMonitor( Source( [&table] { return table.GetProgress(); } ), options )
+{
+}
+
+inline ProgressMonitor::ProgressMonitor( const Extract& extract, const ProgressOptions& options )
+    : ProgressMonitor( Source( [&extract] { return extract.GetProgress(); } ), options )
+{
+}
+
+inline ProgressMonitor::ProgressMonitor( const Source& source, const ProgressOptions& options )
+    : m_source(source),
+      m_options(options),
+      m_start(Clock::now()),
+      m_lastAdvance(0),
+      m_stopping(false)
+{
+    const InsertProgress progress = m_source();
+    const Point first = { 0, progress.rows, progress.inputBytes };
+    m_points.push_back( first );
+}
+
+inline ProgressMonitor::~ProgressMonitor()
+{
+    Stop();
+}
+
+inline ProgressSnapshot ProgressMonitor::Sample()
+{
+    // Counts only grow, so they are read under the lock to keep the samples ordered.
+    std::lock_guard<std::mutex> lock( m_mutex );
+    ProgressSnapshot snapshot;
+    snapshot.progress = m_source();
+    const InsertProgress& progress = snapshot.progress;
+    const double now = std::chrono::duration<double>( Clock::now() - m_start ).count();
+    const Point point = { now, progress.rows, progress.inputBytes };
+    if ( point.rows != m_points.back().rows || point.bytes != m_points.back().bytes )
+        m_lastAdvance = now;
+    m_points.push_back( point );
+    // Keep one sample older than the long window so that it is always covered.
+    while ( m_points.size() > 2 && m_points[1].seconds <= now - m_options.longWindowSeconds )
+        m_points.pop_front();
+
+    snapshot.elapsedSeconds = now;
+    const Point& recent = WindowStart( now, m_options.shortWindowSeconds );
+    if ( now > recent.seconds )
+        snapshot.rowsPerSecond = ( point.rows - recent.rows ) / ( now - recent.seconds );
+    const Point& window = WindowStart( now, m_options.longWindowSeconds );
+    if ( now > window.seconds ) {
+        snapshot.averageRowsPerSecond = ( point.rows - window.rows ) / ( now - window.seconds );
+        snapshot.bytesPerSecond = ( point.bytes - window.bytes ) / ( now - window.seconds );
+    }
+
+    // Bytes predict better than rows: row counts are rarely known before the input is parsed.
+    if ( progress.expectedBytes > 0 ) {
+        snapshot.fractionDone = std::min( 1.0, double( progress.inputBytes ) / progress.expectedBytes );
+        if ( snapshot.bytesPerSecond > 0 )
+            snapshot.remainingSeconds = ( progress.expectedBytes - std::min( progress.inputBytes, progress.expectedBytes ) ) / snapshot.bytesPerSecond;
+    }
+    else if ( progress.expectedRows > 0 ) {
+        snapshot.fractionDone = std::min( 1.0, double( progress.rows ) / progress.expectedRows );
+        if ( snapshot.averageRowsPerSecond > 0 )
+            snapshot.remainingSeconds = ( progress.expectedRows - std::min( progress.rows, progress.expectedRows ) ) / snapshot.averageRowsPerSecond;
+    }
+
+    snapshot.idleSeconds = now - m_lastAdvance;
+    // A finished load goes idle without being stuck; only one that still
+    // expects input can stall.
+    snapshot.finished = progress.IsFinished();
+    snapshot.stalled = snapshot.idleSeconds >= m_options.stallSeconds && !snapshot.finished && !progress.closing;
+    return snapshot;
+}
+
+inline void ProgressMonitor::Start( const Callback& callback )
+{
+    Stop();
+    m_stopping = false;
+    m_thread = std::thread( &ProgressMonitor::Run, this, callback );
+}
+
+inline void ProgressMonitor::Stop()
+{
+    if ( !m_thread.joinable() )
+        return;
+    {
+        std::lock_guard<std::mutex> lock( m_stopMutex );
+        m_stopping = true;
+    }
+    m_stopWake.notify_all();
+    m_thread.join();
+}
+
+inline const ProgressMonitor::Point& ProgressMonitor::WindowStart( double now, double window ) const
+{
+    for ( size_t i = m_points.size() - 1; i-- > 0; ) {
+        if ( m_points[i].seconds <= now - window )
+            return m_points[i];
+    }
+    return m_points.front();
+}
+
+inline void ProgressMonitor::Run( Callback callback )
+{
+    const std::chrono::duration<double> interval( m_options.intervalSeconds );
+    std::unique_lock<std::mutex> lock( m_stopMutex );
+    while ( !m_stopWake.wait_for( lock, interval, [this] { return m_stopping; } ) ) {
+        lock.unlock();
+        callback( Sample() );
+        lock.lock();
+    }
+}
+
+} // namespace Tableau
+#endif // TableauProgress_CPP_H
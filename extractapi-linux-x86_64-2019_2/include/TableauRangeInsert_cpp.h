@@ -0,0 +1,376 @@
+// -----------------------------------------------------------------------
+// TableauRangeInsert_cpp.h
+// -----------------------------------------------------------------------
+// Range insert with value conversion spread over several threads.
+
+#ifndef TableauRangeInsert_CPP_H
+#define TableauRangeInsert_CPP_H
+
+#include "TableauFeedLoader_cpp.h"
+#include "TableauHyperExtract_cpp.h"
+#include "TableauRowBinding_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  RangeInsertOptions
+
+  Tuning of InsertRange.
+
+  ------------------------------------------------------------------------*/
+
+struct RangeInsertOptions
+{
+    RangeInsertOptions() : threads(std::max( 1u, std::thread::hardware_concurrency() )), batchRows(8192) {}
+
+    size_t threads;     // converting threads; 1 converts on the calling thread
+    size_t batchRows;   // rows converted per batch; one batch is inserted while the next is converted
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  StagedCell
+
+  One value converted for its column and ready to be set in a row. Values
+  of Type_UnicodeString columns are kept in UTF-16, everything else as a
+  Value of the column's type.
+
+  ------------------------------------------------------------------------*/
+
+struct StagedCell
+{
+    StagedCell() : null(true) {}
+
+    bool null;
+    Value value;
+    std::basic_string<TableauWChar> utf16;
+};
+
+namespace {
+
+    inline void ThrowUnconvertible( size_t column, const wchar_t* what )
+    {
+        throw TableauException( TAB_RESULT_WrongType, L"Column " + std::to_wstring( column ) + L": cannot convert " + what );
+    }
+
+    inline void StageUtf8( const char* begin, const char* end, StagedCell& cell )
+    {
+        cell.utf16.resize( end - begin );
+        size_t size = 0;
+        for ( const char* pos = begin; pos < end; ) {
+            if ( static_cast<unsigned char>( *pos ) < 0x80 ) {
+                cell.utf16[size++] = static_cast<TableauWChar>( *pos++ );
+                continue;
+            }
+            const unsigned int codePoint = DecodeUtf8( pos, end );
+            if ( codePoint >= 0x10000 ) {
+                cell.utf16[size++] = static_cast<TableauWChar>( 0xD800 + ( ( codePoint - 0x10000 ) >> 10 ) );
+                cell.utf16[size++] = static_cast<TableauWChar>( 0xDC00 + ( ( codePoint - 0x10000 ) & 0x3FF ) );
+            }
+            else {
+                cell.utf16[size++] = static_cast<TableauWChar>( codePoint );
+            }
+        }
+        cell.utf16.resize( size );
+    }
+
+    // Text goes into string and spatial columns as it is, into Unicode
+    // columns as UTF-8, and into date and time columns in the formats of
+    // the feed loader (YYYY-MM-DD, YYYY-MM-DD HH:MM:SS.ffff, D HH:MM:SS.ffff).
+    inline void StageText( const char* begin, const char* end, Type type, size_t column, StagedCell& cell )
+    {
+        const char* pos = begin;
+        int year, month, day, hour = 0, min = 0, sec = 0, frac = 0;
+        switch ( type ) {
+            case Type_CharString:
+                cell.value.SetCharString( std::string( begin, end ) );
+                return;
+            case Type_Spatial:
+                cell.value.SetSpatial( std::string( begin, end ) );
+                return;
+            case Type_UnicodeString:
+                StageUtf8( begin, end, cell );
+                return;
+            case Type_Date:
+                if ( !ParseDate( pos, end, year, month, day ) || pos != end )
+                    ThrowUnconvertible( column, L"text to a date" );
+                cell.value.SetDate( year, month, day );
+                return;
+            case Type_DateTime:
+                if ( !ParseDate( pos, end, year, month, day )
+                    || ( pos < end && ( ( *pos != ' ' && *pos != 'T' ) || !ParseTime( ++pos, end, hour, min, sec, frac ) ) )
+                    || pos != end )
+                    ThrowUnconvertible( column, L"text to a datetime" );
+                cell.value.SetDateTime( year, month, day, hour, min, sec, frac );
+                return;
+            case Type_Duration:
+            {
+                const char* space = std::find( begin, end, ' ' );
+                day = 0;
+                if ( space != end ) {
+                    if ( !ParseDigits( pos, space, static_cast<int>( space - begin ), day ) )
+                        ThrowUnconvertible( column, L"text to a duration" );
+                    pos = space + 1;
+                }
+                if ( !ParseTime( pos, end, hour, min, sec, frac ) || pos != end )
+                    ThrowUnconvertible( column, L"text to a duration" );
+                cell.value.SetDuration( day, hour, min, sec, frac );
+                return;
+            }
+            default:
+                ThrowUnconvertible( column, L"text to a number or Boolean" );
+        }
+    }
+
+    template <class T>
+    inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+    StageValue( const T& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( type == Type_Double )
+            cell.value.SetDouble( static_cast<double>( value ) );
+        else if ( type == Type_Integer && std::is_integral<T>::value && !std::is_same<T, bool>::value )
+            cell.value.SetInteger( static_cast<int64_t>( value ) );
+        else if ( type == Type_Boolean && std::is_same<T, bool>::value )
+            cell.value.SetBoolean( value != 0 );
+        else
+            ThrowUnconvertible( column, L"a number" );
+    }
+
+    inline void StageValue( const std::string& value, Type type, size_t column, StagedCell& cell )
+    {
+        StageText( value.data(), value.data() + value.size(), type, column, cell );
+    }
+
+    inline void StageValue( const char* value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( value == nullptr )
+            cell.null = true;
+        else
+            StageText( value, value + std::strlen( value ), type, column, cell );
+    }
+
+    inline void StageValue( const std::wstring& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( type != Type_UnicodeString )
+            ThrowUnconvertible( column, L"a wide string" );
+        // Characters outside the BMP take two UTF-16 code units.
+        cell.utf16.resize( 2 * value.size() + 1 );
+        ToTableauString( value.c_str(), &cell.utf16[0] );
+        cell.utf16.resize( TableauStringLength( cell.utf16.c_str() ) );
+    }
+
+    inline void StageValue( const DateParts& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( type != Type_Date && type != Type_DateTime )
+            ThrowUnconvertible( column, L"a date" );
+        if ( type == Type_Date )
+            cell.value.SetDate( value.year, value.month, value.day );
+        else
+            cell.value.SetDateTime( value.year, value.month, value.day, 0, 0, 0, 0 );
+    }
+
+    inline void StageValue( const DateTimeParts& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( type != Type_DateTime )
+            ThrowUnconvertible( column, L"a datetime" );
+        cell.value.SetDateTime( value.year, value.month, value.day, value.hour, value.min, value.sec, value.frac );
+    }
+
+    inline void StageValue( const DurationParts& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( type != Type_Duration )
+            ThrowUnconvertible( column, L"a duration" );
+        cell.value.SetDuration( value.day, value.hour, value.minute, value.second, value.frac );
+    }
+
+    inline void StageValue( const Value& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( value.IsNull() )
+            cell.null = true;
+        else if ( value.GetType() != type )
+            ThrowUnconvertible( column, L"a value of another type" );
+        else if ( type == Type_UnicodeString )
+            StageValue( value.GetString(), type, column, cell );
+        else
+            cell.value = value;
+    }
+
+    inline void StageValue( std::nullptr_t, Type, size_t, StagedCell& cell )
+    {
+        cell.null = true;
+    }
+
+#if __cplusplus >= 201703L
+    template <class T>
+    inline void StageValue( const std::optional<T>& value, Type type, size_t column, StagedCell& cell )
+    {
+        if ( value )
+            StageValue( *value, type, column, cell );
+        else
+            cell.null = true;
+    }
+#endif
+
+    // Converts the elements of a tuple into consecutive cells.
+    template <size_t I, size_t N>
+    struct TupleStager
+    {
+        template <class Tuple>
+        static void Stage( const Tuple& tuple, const Type* types, StagedCell* cells )
+        {
+            cells[I].null = false;
+            StageValue( std::get<I>( tuple ), types[I], I, cells[I] );
+            TupleStager<I + 1, N>::Stage( tuple, types, cells );
+        }
+    };
+
+    template <size_t N>
+    struct TupleStager<N, N>
+    {
+        template <class Tuple>
+        static void Stage( const Tuple&, const Type*, StagedCell* ) {}
+    };
+
+    inline void SetStagedCell( Row& row, int columnNumber, Type type, const StagedCell& cell )
+    {
+        if ( cell.null )
+            row.SetNull( columnNumber );
+        else if ( type == Type_UnicodeString )
+            row.SetTableauString( columnNumber, cell.utf16.c_str() );
+        else
+            cell.value.SetInRow( row, columnNumber );
+    }
+
+    struct IdentityProjection
+    {
+        template <class T>
+        const T& operator()( const T& value ) const { return value; }
+    };
+
+}
+
+/// Inserts a range of elements into a table in order. Each element is mapped
+/// to a tuple with one value per column, whose values are converted for their
+/// columns on options.threads threads: text becomes UTF-16, dates or spatial
+/// WKT as the column requires. The calling thread only sets the converted
+/// values and queues the rows, inserting one batch while the next one is
+/// converted. Supported tuple element types are arithmetic types, std::string
+/// and const char* (UTF-8), std::wstring, DateParts, DateTimeParts,
+/// DurationParts, Value, nullptr and, from C++17, std::optional of these.
+/// Throws a TableauException with TAB_RESULT_WrongType for values that do not
+/// fit their column.
+/// @param table The table to insert into.
+/// @param first The first element; the iterator must be a forward iterator.
+/// @param last The end of the range.
+/// @param projection Maps an element to its tuple; called concurrently from several threads.
+/// @param options The number of threads and the batch size.
+template <class Iterator, class Projection>
+inline void
+InsertRange(
+    Table& table,
+    Iterator first,
+    Iterator last,
+    Projection projection,
+    const RangeInsertOptions& options = RangeInsertOptions()
+)
+{
+    typedef typename std::decay<decltype( projection( *first ) )>::type Tuple;
+    const size_t width = std::tuple_size<Tuple>::value;
+
+    std::shared_ptr<TableDefinition> tableDefinition = table.GetTableDefinition();
+    const std::vector<ColumnSpec> columns = GetColumns( *tableDefinition );
+    if ( columns.size() != width )
+        throw TableauException( TAB_RESULT_WrongType, L"Table has " + std::to_wstring( columns.size() )
+                                + L" columns, the tuples have " + std::to_wstring( width ) );
+    std::vector<Type> types;
+    for ( size_t c = 0; c < columns.size(); ++c )
+        types.push_back( columns[c].type );
+    Row row( *tableDefinition );
+    const size_t batchRows = std::max<size_t>( 1, options.batchRows );
+
+    struct Batch
+    {
+        std::vector<Iterator> elements;
+        std::vector<StagedCell> cells;
+        std::vector<std::future<void> > converted;
+    };
+    Batch batches[2];
+
+    auto convert = [&types, &projection]( Batch& batch, size_t begin, size_t end ) {
+        for ( size_t i = begin; i < end; ++i )
+            TupleStager<0, std::tuple_size<Tuple>::value>::Stage( projection( *batch.elements[i] ), &types[0], &batch.cells[i * width] );
+    };
+
+    // Declared after the batches and the converter the tasks use, so if an
+    // insert throws, the pool runs the queued tasks and joins its threads
+    // before those go away.
+    std::unique_ptr<ThreadPool> pool( options.threads > 1 ? new ThreadPool( options.threads ) : nullptr );
+
+    // Collects the next batch of elements and starts converting it.
+    auto start = [&]( Batch& batch ) {
+        batch.elements.clear();
+        batch.converted.clear();
+        for ( ; first != last && batch.elements.size() < batchRows; ++first )
+            batch.elements.push_back( first );
+        batch.cells.resize( batch.elements.size() * width );
+        if ( !pool ) {
+            convert( batch, 0, batch.elements.size() );
+            return;
+        }
+        const size_t slices = std::min( options.threads, batch.elements.size() );
+        for ( size_t s = 0; s < slices; ++s ) {
+            const size_t begin = batch.elements.size() * s / slices;
+            const size_t end = batch.elements.size() * ( s + 1 ) / slices;
+            Batch* target = &batch;
+            batch.converted.push_back( pool->Submit( [&convert, target, begin, end] { convert( *target, begin, end ); } ) );
+        }
+    };
+
+    start( batches[0] );
+    for ( int current = 0; !batches[current].elements.empty(); current ^= 1 ) {
+        Batch& batch = batches[current];
+        for ( size_t s = 0; s < batch.converted.size(); ++s )
+            batch.converted[s].get();
+        start( batches[current ^ 1] );
+
+        for ( size_t i = 0; i < batch.elements.size(); ++i ) {
+            const StagedCell* cells = &batch.cells[i * width];
+            for ( size_t c = 0; c < width; ++c )
+                SetStagedCell( row, static_cast<int>( c ), types[c], cells[c] );
+            table.Insert( row );
+        }
+    }
+}
+
+/// Inserts a range of tuples with one value per column; see the overload with a projection.
+template <class Iterator>
+inline void
+InsertRange(
+    Table& table,
+    Iterator first,
+    Iterator last,
+    const RangeInsertOptions& options = RangeInsertOptions()
+)
+{
+    InsertRange( table, first, last, IdentityProjection(), options );
+}
+
+} // namespace Tableau
+#endif // TableauRangeInsert_CPP_H
@@ -0,0 +1,334 @@
+// -----------------------------------------------------------------------
+// TableauRowBinding_cpp.h
+// -----------------------------------------------------------------------
+// Compile-time binding of C++ structs to extract rows.
+
+#ifndef TableauRowBinding_CPP_H
+#define TableauRowBinding_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCTS
+  DateParts, DateTimeParts, DurationParts
+
+  Struct members of these types bind to Type_Date, Type_DateTime and
+  Type_Duration columns. frac is in 1/10000 seconds.
+
+  ------------------------------------------------------------------------*/
+
+struct DateParts
+{
+    int year;
+    int month;
+    int day;
+};
+
+struct DateTimeParts
+{
+    int year;
+    int month;
+    int day;
+    int hour;
+    int min;
+    int sec;
+    int frac;
+};
+
+struct DurationParts
+{
+    int day;
+    int hour;
+    int minute;
+    int second;
+    int frac;
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  RowColumn
+
+  Maps the C++ type of a struct member to its column type and setter.
+  Only the types below are specialized, so a member of any other type is a
+  compile error rather than a conversion at run time.
+
+  ------------------------------------------------------------------------*/
+
+template <class T> struct RowColumn;
+
+template <> struct RowColumn<int>
+{
+    static Type GetType() { return Type_Integer; }
+    static void Set( Row& row, int column, int value ) { row.SetInteger( column, value ); }
+};
+
+template <> struct RowColumn<short>
+{
+    static Type GetType() { return Type_Integer; }
+    static void Set( Row& row, int column, short value ) { row.SetInteger( column, value ); }
+};
+
+template <> struct RowColumn<long>
+{
+    static Type GetType() { return Type_Integer; }
+    static void Set( Row& row, int column, long value ) { row.SetLongInteger( column, value ); }
+};
+
+template <> struct RowColumn<long long>
+{
+    static Type GetType() { return Type_Integer; }
+    static void Set( Row& row, int column, long long value ) { row.SetLongInteger( column, value ); }
+};
+
+template <> struct RowColumn<double>
+{
+    static Type GetType() { return Type_Double; }
+    static void Set( Row& row, int column, double value ) { row.SetDouble( column, value ); }
+};
+
+template <> struct RowColumn<float>
+{
+    static Type GetType() { return Type_Double; }
+    static void Set( Row& row, int column, float value ) { row.SetDouble( column, value ); }
+};
+
+template <> struct RowColumn<bool>
+{
+    static Type GetType() { return Type_Boolean; }
+    static void Set( Row& row, int column, bool value ) { row.SetBoolean( column, value ); }
+};
+
+template <> struct RowColumn<std::string>
+{
+    static Type GetType() { return Type_CharString; }
+    static void Set( Row& row, int column, const std::string& value ) { row.SetCharString( column, value ); }
+};
+
+template <> struct RowColumn<std::wstring>
+{
+    static Type GetType() { return Type_UnicodeString; }
+    static void Set( Row& row, int column, const std::wstring& value ) { row.SetString( column, value ); }
+};
+
+template <> struct RowColumn<DateParts>
+{
+    static Type GetType() { return Type_Date; }
+    static void Set( Row& row, int column, const DateParts& value )
+    {
+        row.SetDate( column, value.year, value.month, value.day );
+    }
+};
+
+template <> struct RowColumn<DateTimeParts>
+{
+    static Type GetType() { return Type_DateTime; }
+    static void Set( Row& row, int column, const DateTimeParts& value )
+    {
+        row.SetDateTime( column, value.year, value.month, value.day, value.hour, value.min, value.sec, value.frac );
+    }
+};
+
+template <> struct RowColumn<DurationParts>
+{
+    static Type GetType() { return Type_Duration; }
+    static void Set( Row& row, int column, const DurationParts& value )
+    {
+        row.SetDuration( column, value.day, value.hour, value.minute, value.second, value.frac );
+    }
+};
+
+#if __cplusplus >= 201703L
+// An empty optional sets the column to null.
+template <class T> struct RowColumn<std::optional<T> >
+{
+    static Type GetType() { return RowColumn<T>::GetType(); }
+    static void Set( Row& row, int column, const std::optional<T>& value )
+    {
+        if ( value )
+            RowColumn<T>::Set( row, column, *value );
+        else
+            row.SetNull( column );
+    }
+};
+#endif
+
+/// Returns the columns of a struct declared with TABLEAU_ROW, named after its members.
+template <class T>
+inline std::vector<ColumnSpec>
+RowColumns()
+{
+    std::vector<ColumnSpec> columns;
+    TableauRowColumns( static_cast<const T*>( nullptr ), columns );
+    return columns;
+}
+
+/// Sets all columns of a row from a struct declared with TABLEAU_ROW.
+/// @param row The row to set, created from a table definition with the struct's columns.
+/// @param value The struct.
+template <class T>
+inline void
+SetRow(
+    Row& row,
+    const T& value
+)
+{
+    TableauRowSet( row, value );
+}
+
+/*------------------------------------------------------------------------
+  CLASS
+  RowInserter
+
+  Inserts structs declared with TABLEAU_ROW into a table. The constructor
+  checks the table definition against the struct once, so a struct and
+  schema that have drifted apart fail before the first row.
+
+  ------------------------------------------------------------------------*/
+
+template <class T>
+class RowInserter
+{
+  public:
+    /// Binds the inserter to a table.
+    /// @param table The table to insert into.
+    /// @param tableDefinition The definition the table was created with. Throws a TableauException with TAB_RESULT_WrongType if it does not match the struct.
+    RowInserter( Table& table, TableDefinition& tableDefinition );
+
+    /// Inserts one struct.
+    void Insert( const T& value )
+    {
+        TableauRowSet( m_row, value );
+        m_table.Insert( m_row );
+    }
+
+    /// Inserts a range of structs.
+    template <class Iterator>
+    void InsertRange( Iterator first, Iterator last )
+    {
+        for ( ; first != last; ++first )
+            Insert( *first );
+    }
+
+    /// Inserts an array of structs.
+    void InsertRange( const T* values, size_t count ) { InsertRange( values, values + count ); }
+
+#if __cplusplus >= 202002L
+    /// Inserts a span of structs.
+    void InsertRange( std::span<const T> values ) { InsertRange( values.begin(), values.end() ); }
+#endif
+
+  private:
+    Table& m_table;
+    Row m_row;
+
+    // Forbidden:
+    RowInserter( const RowInserter& );
+    RowInserter& operator=( const RowInserter& );
+};
+
+// -----------------------------------------------------------------------
+// RowInserter methods
+// -----------------------------------------------------------------------
+
+template <class T>
+inline RowInserter<T>::RowInserter(
+    Table& table,
+    TableDefinition& tableDefinition
+) : m_table(table),
+    m_row(tableDefinition)
+{
+    const std::vector<ColumnSpec> expected = RowColumns<T>();
+    const std::vector<ColumnSpec> actual = GetColumns( tableDefinition );
+    if ( expected.size() != actual.size() )
+        throw TableauException( TAB_RESULT_WrongType, L"Table definition has " + std::to_wstring( actual.size() )
+                                + L" columns, the struct has " + std::to_wstring( expected.size() ) );
+    for ( size_t i = 0; i < expected.size(); ++i ) {
+        if ( expected[i].name != actual[i].name || expected[i].type != actual[i].type )
+            throw TableauException( TAB_RESULT_WrongType, L"Column " + std::to_wstring( i ) + L" is '" + actual[i].name
+                                    + L"' in the table definition but '" + expected[i].name + L"' in the struct" );
+    }
+}
+
+} // namespace Tableau
+
+// -----------------------------------------------------------------------
+// TABLEAU_ROW
+// -----------------------------------------------------------------------
+//
+// TABLEAU_ROW( Order, purchased, product, price, quantity )
+//
+// Binds the listed members of a struct, in order, to the columns of a
+// table; each column is named after its member and typed by RowColumn.
+// Write it after the struct, in the struct's namespace, so that RowColumns,
+// SetRow and RowInserter find the generated functions by argument-dependent
+// lookup. Every setter call has its column index and type fixed at compile
+// time. Up to 32 members are supported.
+
+#define TABLEAU_ROW( T, ... )                                                           \
+    inline void TableauRowColumns( const T*, std::vector<Tableau::ColumnSpec>& columns ) \
+    {                                                                                   \
+        TABLEAU_ROW_EACH( TABLEAU_ROW_COLUMN, T, __VA_ARGS__ )                          \
+    }                                                                                   \
+    inline void TableauRowSet( Tableau::Row& row, const T& value )                      \
+    {                                                                                   \
+        TABLEAU_ROW_EACH( TABLEAU_ROW_SET, T, __VA_ARGS__ )                             \
+    }
+
+#define TABLEAU_ROW_COLUMN( T, i, m ) \
+    columns.push_back( Tableau::ColumnSpec( L"" #m, Tableau::RowColumn<decltype( T::m )>::GetType() ) );
+#define TABLEAU_ROW_SET( T, i, m ) \
+    Tableau::RowColumn<decltype( T::m )>::Set( row, i, value.m );
+
+#define TABLEAU_ROW_EXPAND( x ) x
+#define TABLEAU_ROW_CAT( a, b ) TABLEAU_ROW_CAT_I( a, b )
+#define TABLEAU_ROW_CAT_I( a, b ) a##b
+#define TABLEAU_ROW_EACH( M, T, ... ) \
+    TABLEAU_ROW_EXPAND( TABLEAU_ROW_CAT( TABLEAU_ROW_EACH_, TABLEAU_ROW_COUNT( __VA_ARGS__ ) )( M, T, 0, __VA_ARGS__ ) )
+#define TABLEAU_ROW_COUNT(...) TABLEAU_ROW_EXPAND( TABLEAU_ROW_COUNT_N( __VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 ) )
+#define TABLEAU_ROW_COUNT_N( _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ... ) N
+#define TABLEAU_ROW_EACH_1( M, T, i, m ) M( T, i, m )
+#define TABLEAU_ROW_EACH_2( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_1( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_3( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_2( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_4( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_3( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_5( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_4( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_6( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_5( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_7( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_6( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_8( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_7( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_9( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_8( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_10( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_9( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_11( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_10( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_12( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_11( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_13( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_12( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_14( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_13( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_15( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_14( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_16( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_15( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_17( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_16( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_18( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_17( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_19( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_18( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_20( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_19( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_21( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_20( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_22( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_21( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_23( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_22( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_24( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_23( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_25( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_24( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_26( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_25( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_27( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_26( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_28( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_27( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_29( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_28( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_30( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_29( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_31( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_30( M, T, i + 1, __VA_ARGS__ ) )
+#define TABLEAU_ROW_EACH_32( M, T, i, m, ... ) M( T, i, m ) TABLEAU_ROW_EXPAND( TABLEAU_ROW_EACH_31( M, T, i + 1, __VA_ARGS__ ) )
+
+#endif // TableauRowBinding_CPP_H
@@ -0,0 +1,270 @@
+// -----------------------------------------------------------------------
+// TableauSampling_cpp.h
+// -----------------------------------------------------------------------
+// Reservoir samples of input records, e.g. for preview extracts.
+
+#ifndef TableauSampling_CPP_H
+#define TableauSampling_CPP_H
+
+#include "TableauDelimitedReader_cpp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  ReservoirSampler
+
+  Decides which items of a stream of unknown length enter a uniform
+  sample of fixed size, with Li's Algorithm L: after the reservoir is
+  full, the number of items to skip until the next replacement is drawn
+  directly, so skipped items cost one comparison and random numbers are
+  only drawn O(k log(n/k)) times.
+
+  ------------------------------------------------------------------------*/
+
+class ReservoirSampler
+{
+  public:
+    /// Initializes an empty reservoir.
+    /// @param capacity The sample size.
+    /// @param seed The seed; equal seeds select equal items.
+    explicit ReservoirSampler( size_t capacity, uint64_t seed = 1 );
+
+    /// Offers the next item.
+    /// @return The reservoir slot the item goes into, replacing the item there, or -1 to skip it.
+    ptrdiff_t Next()
+    {
+        const uint64_t item = m_seen++;
+        if ( item < m_capacity )
+            return static_cast<ptrdiff_t>( item );
+        if ( item != m_next )
+            return -1;
+        return Replace();
+    }
+
+    /// Returns the number of items offered.
+    uint64_t GetSeenCount() const { return m_seen; }
+
+    /// Returns the number of items in the sample.
+    size_t GetSize() const { return static_cast<size_t>( std::min<uint64_t>( m_seen, m_capacity ) ); }
+
+  private:
+    ptrdiff_t Replace();
+    void Skip();
+    double Uniform();
+
+    size_t m_capacity;
+    uint64_t m_seen;
+    uint64_t m_next;     // the next item that replaces one in the reservoir
+    double m_weight;     // W of Algorithm L
+    uint64_t m_state;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  RecordSampler
+
+  Keeps a uniform sample of records, or one per stratum if a strata field
+  is given, so that rare values of e.g. a region column are represented
+  as well as common ones. <b>Offer</b> only decides; the caller copies a
+  record in with <b>Store</b> when it was selected, so records that are
+  skipped are never copied.
+
+  ------------------------------------------------------------------------*/
+
+class RecordSampler
+{
+  public:
+    /// Initializes an empty sample.
+    /// @param rows The sample size, per stratum if stratified.
+    /// @param strataField The field of the stored records whose value selects the stratum, or -1 for a uniform sample.
+    /// @param seed The seed; equal seeds select equal records.
+    explicit RecordSampler(
+        size_t rows,
+        int strataField = -1,
+        uint64_t seed = 1
+    );
+
+    /// Decides whether the next record enters the sample.
+    /// @param stratum The value of the strata field; ignored by uniform samples.
+    /// @return True if the record should be passed to <b>Store</b>.
+    bool Offer( const FieldView& stratum );
+
+    /// Copies the record accepted by the last <b>Offer</b> into the sample.
+    /// An accepted record that is not stored leaves its slot empty, and <b>ForEach</b> skips it.
+    void Store( const std::vector<FieldView>& record );
+
+    /// Returns the strata field, or -1.
+    int GetStrataField() const { return m_strataField; }
+
+    /// Returns the number of records offered.
+    uint64_t GetOfferedCount() const { return m_offered; }
+
+    /// Returns the number of strata; 1 for uniform samples.
+    size_t GetStrataCount() const { return m_strata.size(); }
+
+    /// Calls visit( const std::vector<FieldView>& ) for every record in the sample, stratum by stratum.
+    template <class Visit>
+    void ForEach( Visit visit ) const;
+
+  private:
+    struct Stratum
+    {
+        Stratum( size_t rows, uint64_t seed ) : sampler(rows, seed) {}
+
+        ReservoirSampler sampler;
+        std::vector<std::string> records;               // the field bytes, back to back
+        std::vector<std::vector<uint32_t> > fieldEnds;
+    };
+
+    size_t m_rows;
+    int m_strataField;
+    uint64_t m_seed;
+    uint64_t m_offered;
+    std::vector<std::unique_ptr<Stratum> > m_strata;
+    std::unordered_map<std::string, size_t> m_strataIndex;
+    std::string m_key;
+    size_t m_current;    // stratum of the last offered record
+    ptrdiff_t m_slot;    // slot of the last accepted record
+
+    // Forbidden:
+    RecordSampler( const RecordSampler& );
+    RecordSampler& operator=( const RecordSampler& );
+};
+
+// -----------------------------------------------------------------------
+// ReservoirSampler methods
+// -----------------------------------------------------------------------
+
+inline ReservoirSampler::ReservoirSampler( size_t capacity, uint64_t seed )
+    : m_capacity(capacity),
+      m_seen(0),
+      m_next(std::numeric_limits<uint64_t>::max()),
+      m_weight(1),
+      m_state(seed)
+{
+    if ( m_capacity > 0 ) {
+        m_next = m_capacity - 1;
+        m_weight = std::exp( std::log( Uniform() ) / m_capacity );
+        Skip();
+    }
+}
+
+inline ptrdiff_t ReservoirSampler::Replace()
+{
+    const ptrdiff_t slot = static_cast<ptrdiff_t>( Uniform() * m_capacity );
+    m_weight *= std::exp( std::log( Uniform() ) / m_capacity );
+    Skip();
+    return std::min<ptrdiff_t>( slot, m_capacity - 1 );
+}
+
+// Draws the number of items to skip before the next replacement.
+inline void ReservoirSampler::Skip()
+{
+    const double skip = std::floor( std::log( Uniform() ) / std::log1p( -m_weight ) );
+    const double room = static_cast<double>( std::numeric_limits<uint64_t>::max() - m_next - 1 );
+    m_next = skip < room ? m_next + 1 + static_cast<uint64_t>( skip ) : std::numeric_limits<uint64_t>::max();
+}
+
+// Returns a number in (0, 1]; splitmix64 keeps the sampler independent of
+// the standard library's engines.
+inline double ReservoirSampler::Uniform()
+{
+    uint64_t z = ( m_state += 0x9E3779B97F4A7C15ull );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return ( ( z >> 11 ) + 1 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+// -----------------------------------------------------------------------
+// RecordSampler methods
+// -----------------------------------------------------------------------
+
+inline RecordSampler::RecordSampler(
+    size_t rows,
+    int strataField,
+    uint64_t seed
+) : m_rows(rows),
+    m_strataField(strataField),
+    m_seed(seed),
+    m_offered(0),
+    m_current(0),
+    m_slot(-1)
+{
+    if ( m_strataField < 0 )
+        m_strata.push_back( std::unique_ptr<Stratum>( new Stratum( m_rows, m_seed ) ) );
+}
+
+inline bool RecordSampler::Offer( const FieldView& stratum )
+{
+    ++m_offered;
+    if ( m_strataField >= 0 ) {
+        // Sorted or clustered inputs repeat the stratum of the last record.
+        if ( m_strata.empty() || !stratum.Equals( m_key ) ) {
+            m_key.assign( stratum.begin, stratum.end );
+            std::unordered_map<std::string, size_t>::iterator it = m_strataIndex.find( m_key );
+            if ( it == m_strataIndex.end() ) {
+                // Each stratum gets its own seed so their samples are independent.
+                it = m_strataIndex.insert( std::make_pair( m_key, m_strata.size() ) ).first;
+                m_strata.push_back( std::unique_ptr<Stratum>( new Stratum( m_rows, m_seed + m_strata.size() * 0x9E3779B97F4A7C15ull ) ) );
+            }
+            m_current = it->second;
+        }
+    }
+    m_slot = m_strata[m_current]->sampler.Next();
+    return m_slot >= 0;
+}
+
+inline void RecordSampler::Store( const std::vector<FieldView>& record )
+{
+    if ( m_slot < 0 )
+        return;
+    Stratum& stratum = *m_strata[m_current];
+    // The slot is past the end while the reservoir fills; it can be more
+    // than one past it if the caller skipped a Store after an Offer.
+    if ( static_cast<size_t>( m_slot ) >= stratum.records.size() ) {
+        stratum.records.resize( m_slot + 1 );
+        stratum.fieldEnds.resize( m_slot + 1 );
+    }
+    std::string& text = stratum.records[m_slot];
+    std::vector<uint32_t>& ends = stratum.fieldEnds[m_slot];
+    text.clear();
+    ends.clear();
+    for ( size_t i = 0; i < record.size(); ++i ) {
+        text.append( record[i].begin, record[i].end );
+        ends.push_back( static_cast<uint32_t>( text.size() ) );
+    }
+    m_slot = -1;
+}
+
+template <class Visit>
+inline void RecordSampler::ForEach( Visit visit ) const
+{
+    std::vector<FieldView> fields;
+    for ( size_t s = 0; s < m_strata.size(); ++s ) {
+        const Stratum& stratum = *m_strata[s];
+        for ( size_t r = 0; r < stratum.records.size(); ++r ) {
+            const char* base = stratum.records[r].data();
+            const std::vector<uint32_t>& ends = stratum.fieldEnds[r];
+            if ( ends.empty() )
+                continue;   // a slot whose record was never stored
+            fields.resize( ends.size() );
+            for ( size_t i = 0; i < ends.size(); ++i )
+                fields[i] = FieldView( base + ( i ? ends[i - 1] : 0 ), base + ends[i] );
+            visit( const_cast<const std::vector<FieldView>&>( fields ) );
+        }
+    }
+}
+
+} // namespace Tableau
+#endif // TableauSampling_CPP_H
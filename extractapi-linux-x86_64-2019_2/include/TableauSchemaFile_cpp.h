@@ -0,0 +1,387 @@
+// -----------------------------------------------------------------------
+// TableauSchemaFile_cpp.h
+// -----------------------------------------------------------------------
+// Declarative description of a delimited feed and the table it loads into.
+
+#ifndef TableauSchemaFile_CPP_H
+#define TableauSchemaFile_CPP_H
+
+#include "TableauSchema_cpp.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  SchemaField
+
+  One column of a schema file: the column to create, the input field it
+  is read from, and the field contents that mean null.
+
+  ------------------------------------------------------------------------*/
+
+struct SchemaField
+{
+    SchemaField( const ColumnSpec& column ) : column(column), sourceIndex(-1) {}
+
+    ColumnSpec column;
+    std::string source;       // header name of the input field
+    long sourceIndex;         // zero-based input field, or -1 to look up source in the header
+    std::vector<std::string> nullTokens;
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  SchemaFile
+
+  A schema file describes a feed of delimited text in a line-based format.
+  Blank lines and text after '#' are ignored; names containing spaces are
+  enclosed in double quotes.
+
+      table Orders
+      delimiter ,               # a single character, or "tab"
+      header on                 # off: fields are addressed by index only
+      null "" NULL              # default null tokens of all columns
+      column "Order ID" Integer source=order_id
+      column Customer UnicodeString collation=en_US_CI null=-,n/a
+      column Amount Double source=#4
+
+  A column names its type with the Type_ suffix (Integer, Double, Boolean,
+  Date, DateTime, Duration, CharString, UnicodeString, Spatial) and its
+  collation with the Collation_ suffix. Its source is a header name, or #N
+  for the zero-based field N, and defaults to the column name.
+
+  ------------------------------------------------------------------------*/
+
+class SchemaFile
+{
+  public:
+    /// Initializes an empty schema for table "Extract".
+    SchemaFile();
+
+    /// Reads a schema file.
+    /// @param path The file to read.
+    /// @return The schema. Throws a TableauException for unreadable or malformed files.
+    static SchemaFile Load( const std::string& path );
+
+    /// Parses the text of a schema file.
+    /// @param text The schema.
+    /// @param origin The name used in error messages.
+    /// @return The schema. Throws a TableauException naming the line of the first error.
+    static SchemaFile Parse( const std::string& text, const std::string& origin = "schema" );
+
+    /// Returns the name of the table to create.
+    const std::wstring& GetTableName() const { return m_tableName; }
+
+    /// Returns the field separator of the feed.
+    char GetDelimiter() const { return m_delimiter; }
+
+    /// Returns true if the first record of the feed names its fields.
+    bool HasHeader() const { return m_header; }
+
+    /// Returns the columns with their sources.
+    const std::vector<SchemaField>& GetFields() const { return m_fields; }
+
+    /// Returns the columns of the table, in order.
+    std::vector<ColumnSpec> GetColumns() const;
+
+    /// Returns a string that is equal for two schemas exactly if they describe the same feed and table.
+    const std::string& GetFingerprint() const { return m_fingerprint; }
+
+  private:
+    std::wstring m_tableName;
+    char m_delimiter;
+    bool m_header;
+    std::vector<SchemaField> m_fields;
+    std::string m_fingerprint;
+};
+
+namespace {
+
+    const char* const TypeNames[] = {
+        "Integer", "Double", "Boolean", "Date", "DateTime", "Duration", "CharString", "UnicodeString", "Spatial"
+    };
+    const Type TypeValues[] = {
+        Type_Integer, Type_Double, Type_Boolean, Type_Date, Type_DateTime, Type_Duration,
+        Type_CharString, Type_UnicodeString, Type_Spatial
+    };
+
+    // Indexed by Collation.
+    const char* const CollationNames[] = {
+        "Binary", "ar", "cs", "cs_CI", "cs_CI_AI", "da", "de", "el", "en_GB", "en_US", "en_US_CI",
+        "es", "es_CI_AI", "et", "fi", "fr_CA", "fr_FR", "fr_FR_CI_AI", "he", "hu", "is", "it", "ja",
+        "ja_JIS", "ko", "lt", "lv", "nl_NL", "nn", "pl", "pt_BR", "pt_BR_CI_AI", "pt_PT", "root", "ru",
+        "sl", "sv_FI", "sv_SE", "tr", "uk", "vi", "zh_Hans_CN", "zh_Hant_TW"
+    };
+
+    // Decodes one UTF-8 sequence and advances pos. Malformed input decodes to U+FFFD.
+    inline unsigned int DecodeUtf8( const char*& pos, const char* end )
+    {
+        const unsigned char lead = static_cast<unsigned char>( *pos++ );
+        if ( lead < 0x80 )
+            return lead;
+        int extra;
+        unsigned int codePoint;
+        if ( ( lead & 0xE0 ) == 0xC0 ) {
+            extra = 1;
+            codePoint = lead & 0x1F;
+        }
+        else if ( ( lead & 0xF0 ) == 0xE0 ) {
+            extra = 2;
+            codePoint = lead & 0x0F;
+        }
+        else if ( ( lead & 0xF8 ) == 0xF0 ) {
+            extra = 3;
+            codePoint = lead & 0x07;
+        }
+        else {
+            return 0xFFFD;
+        }
+        for ( int i = 0; i < extra; ++i ) {
+            if ( pos == end || ( static_cast<unsigned char>( *pos ) & 0xC0 ) != 0x80 )
+                return 0xFFFD;
+            codePoint = ( codePoint << 6 ) | ( static_cast<unsigned char>( *pos++ ) & 0x3F );
+        }
+        if ( codePoint > 0x10FFFF || ( codePoint >= 0xD800 && codePoint < 0xE000 ) )
+            return 0xFFFD;
+        return codePoint;
+    }
+
+    inline std::wstring WidenUtf8( const std::string& text )
+    {
+        std::wstring wide;
+        const char* pos = text.data();
+        const char* end = pos + text.size();
+        while ( pos < end )
+            wide.push_back( static_cast<wchar_t>( DecodeUtf8( pos, end ) ) );
+        return wide;
+    }
+
+    inline void ThrowSchemaError( const std::string& origin, int line, const std::string& message )
+    {
+        std::ostringstream text;
+        text << origin << ":" << line << ": " << message;
+        throw TableauException( TAB_RESULT_InvalidArgument, WidenUtf8( text.str() ) );
+    }
+
+    // Splits a line into whitespace-separated tokens. Double quotes group
+    // characters into a token and are removed; a doubled quote inside quotes
+    // stands for itself. A '#' at the start of a token begins a comment.
+    inline bool TokenizeSchemaLine( const std::string& line, std::vector<std::string>& tokens )
+    {
+        tokens.clear();
+        size_t i = 0;
+        while ( i < line.size() ) {
+            if ( line[i] == ' ' || line[i] == '\t' || line[i] == '\r' ) {
+                ++i;
+                continue;
+            }
+            if ( line[i] == '#' )
+                break;
+            std::string token;
+            bool quoted = false;
+            for ( ; i < line.size(); ++i ) {
+                const char c = line[i];
+                if ( c == '"' ) {
+                    if ( quoted && i + 1 < line.size() && line[i + 1] == '"' ) {
+                        token.push_back( '"' );
+                        ++i;
+                    }
+                    else {
+                        quoted = !quoted;
+                    }
+                }
+                else if ( !quoted && ( c == ' ' || c == '\t' || c == '\r' ) ) {
+                    break;
+                }
+                else {
+                    token.push_back( c );
+                }
+            }
+            if ( quoted )
+                return false;
+            tokens.push_back( token );
+        }
+        return true;
+    }
+
+    // Splits a comma-separated list of null tokens.
+    inline std::vector<std::string> SplitNullTokens( const std::string& list )
+    {
+        std::vector<std::string> tokens;
+        size_t start = 0;
+        for ( ;; ) {
+            const size_t comma = list.find( ',', start );
+            tokens.push_back( list.substr( start, comma == std::string::npos ? std::string::npos : comma - start ) );
+            if ( comma == std::string::npos )
+                return tokens;
+            start = comma + 1;
+        }
+    }
+
+    inline void AppendFingerprint( std::string& out, const std::string& part )
+    {
+        out += std::to_string( part.size() );
+        out += ':';
+        out += part;
+    }
+
+    inline void AppendFingerprint( std::string& out, const std::wstring& part )
+    {
+        AppendFingerprint( out, std::string( reinterpret_cast<const char*>( part.data() ), part.size() * sizeof( wchar_t ) ) );
+    }
+
+}
+
+// -----------------------------------------------------------------------
+// SchemaFile methods
+// -----------------------------------------------------------------------
+
+inline SchemaFile::SchemaFile()
+    : m_tableName(L"Extract"),
+      m_delimiter(','),
+      m_header(true)
+{
+}
+
+inline SchemaFile SchemaFile::Load( const std::string& path )
+{
+    std::ifstream in( path.c_str(), std::ios::binary );
+    if ( !in )
+        throw TableauException( TAB_RESULT_FileNotFound, L"Could not open schema file " + WidenUtf8( path ) );
+    std::ostringstream text;
+    text << in.rdbuf();
+    return Parse( text.str(), path );
+}
+
+inline SchemaFile SchemaFile::Parse( const std::string& text, const std::string& origin )
+{
+    SchemaFile schema;
+    std::vector<std::string> defaultNulls( 1, std::string() );
+    std::vector<bool> explicitNulls;
+    std::vector<std::string> tokens;
+    std::istringstream lines( text );
+    std::string line;
+    int number = 0;
+    while ( std::getline( lines, line ) ) {
+        ++number;
+        if ( !TokenizeSchemaLine( line, tokens ) )
+            ThrowSchemaError( origin, number, "unterminated quote" );
+        if ( tokens.empty() )
+            continue;
+
+        const std::string& keyword = tokens[0];
+        if ( keyword == "table" ) {
+            if ( tokens.size() != 2 )
+                ThrowSchemaError( origin, number, "expected: table <name>" );
+            schema.m_tableName = WidenUtf8( tokens[1] );
+        }
+        else if ( keyword == "delimiter" ) {
+            if ( tokens.size() != 2 || ( tokens[1].size() != 1 && tokens[1] != "tab" ) )
+                ThrowSchemaError( origin, number, "expected: delimiter <character>|tab" );
+            schema.m_delimiter = tokens[1] == "tab" ? '\t' : tokens[1][0];
+        }
+        else if ( keyword == "header" ) {
+            if ( tokens.size() != 2 || ( tokens[1] != "on" && tokens[1] != "off" ) )
+                ThrowSchemaError( origin, number, "expected: header on|off" );
+            schema.m_header = tokens[1] == "on";
+        }
+        else if ( keyword == "null" ) {
+            defaultNulls.assign( tokens.begin() + 1, tokens.end() );
+        }
+        else if ( keyword == "column" ) {
+            if ( tokens.size() < 3 )
+                ThrowSchemaError( origin, number, "expected: column <name> <type> [collation=<name>] [source=<field>] [null=<tokens>]" );
+
+            size_t type = 0;
+            while ( type < sizeof( TypeNames ) / sizeof( TypeNames[0] ) && tokens[2] != TypeNames[type] )
+                ++type;
+            if ( type == sizeof( TypeNames ) / sizeof( TypeNames[0] ) )
+                ThrowSchemaError( origin, number, "unknown type '" + tokens[2] + "'" );
+
+            SchemaField field( ColumnSpec( WidenUtf8( tokens[1] ), TypeValues[type] ) );
+            field.source = tokens[1];
+            bool hasNulls = false;
+            for ( size_t i = 3; i < tokens.size(); ++i ) {
+                const size_t equals = tokens[i].find( '=' );
+                const std::string key = tokens[i].substr( 0, equals );
+                const std::string value = equals == std::string::npos ? std::string() : tokens[i].substr( equals + 1 );
+                if ( equals == std::string::npos ) {
+                    ThrowSchemaError( origin, number, "expected <option>=<value>, got '" + tokens[i] + "'" );
+                }
+                else if ( key == "collation" ) {
+                    size_t collation = 0;
+                    while ( collation < sizeof( CollationNames ) / sizeof( CollationNames[0] ) && value != CollationNames[collation] )
+                        ++collation;
+                    if ( collation == sizeof( CollationNames ) / sizeof( CollationNames[0] ) )
+                        ThrowSchemaError( origin, number, "unknown collation '" + value + "'" );
+                    field.column.collation = static_cast<Collation>( collation );
+                }
+                else if ( key == "source" ) {
+                    if ( !value.empty() && value[0] == '#' ) {
+                        char* end = nullptr;
+                        field.sourceIndex = std::strtol( value.c_str() + 1, &end, 10 );
+                        if ( value.size() == 1 || *end != '\0' || field.sourceIndex < 0 )
+                            ThrowSchemaError( origin, number, "invalid field index '" + value + "'" );
+                        field.source.clear();
+                    }
+                    else {
+                        field.source = value;
+                    }
+                }
+                else if ( key == "null" ) {
+                    field.nullTokens = SplitNullTokens( value );
+                    hasNulls = true;
+                }
+                else {
+                    ThrowSchemaError( origin, number, "unknown option '" + key + "'" );
+                }
+            }
+            schema.m_fields.push_back( field );
+            explicitNulls.push_back( hasNulls );
+        }
+        else {
+            ThrowSchemaError( origin, number, "unknown keyword '" + keyword + "'" );
+        }
+    }
+
+    if ( schema.m_fields.empty() )
+        ThrowSchemaError( origin, number, "no columns" );
+    for ( size_t i = 0; i < schema.m_fields.size(); ++i ) {
+        if ( !explicitNulls[i] )
+            schema.m_fields[i].nullTokens = defaultNulls;
+        if ( !schema.m_header && schema.m_fields[i].sourceIndex < 0 )
+            ThrowSchemaError( origin, number, "column '" + schema.m_fields[i].source + "' needs source=#N without a header" );
+    }
+
+    // Length-prefixed parts, so different schemas cannot run together into the same string.
+    std::string& fingerprint = schema.m_fingerprint;
+    AppendFingerprint( fingerprint, std::string( 1, schema.m_delimiter ) + ( schema.m_header ? "h" : "-" ) );
+    AppendFingerprint( fingerprint, schema.m_tableName );
+    for ( size_t i = 0; i < schema.m_fields.size(); ++i ) {
+        const SchemaField& field = schema.m_fields[i];
+        AppendFingerprint( fingerprint, field.column.name );
+        AppendFingerprint( fingerprint, std::to_string( field.column.type ) + "/" + std::to_string( field.column.collation )
+                                        + "/" + std::to_string( field.sourceIndex ) );
+        AppendFingerprint( fingerprint, field.source );
+        for ( size_t j = 0; j < field.nullTokens.size(); ++j )
+            AppendFingerprint( fingerprint, field.nullTokens[j] );
+        fingerprint += ';';
+    }
+    return schema;
+}
+
+inline std::vector<ColumnSpec> SchemaFile::GetColumns() const
+{
+    std::vector<ColumnSpec> columns;
+    for ( size_t i = 0; i < m_fields.size(); ++i )
+        columns.push_back( m_fields[i].column );
+    return columns;
+}
+
+} // namespace Tableau
+#endif // TableauSchemaFile_CPP_H
@@ -0,0 +1,67 @@
+// -----------------------------------------------------------------------
+// TableauSchema_cpp.h
+// -----------------------------------------------------------------------
+// Plain description of a table schema that can build TableDefinitions.
+
+#ifndef TableauSchema_CPP_H
+#define TableauSchema_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  STRUCT
+  ColumnSpec
+
+  Name, type and collation of one column. Unlike a TableDefinition, a list
+  of ColumnSpecs can be copied and kept around to create the same schema
+  again, e.g. for every extract a loader opens.
+
+  ------------------------------------------------------------------------*/
+
+struct ColumnSpec
+{
+    ColumnSpec( const std::wstring& name, Type type, Collation collation = Collation_Binary )
+        : name(name), type(type), collation(collation) {}
+
+    std::wstring name;
+    Type type;
+    Collation collation;
+};
+
+/// Adds the columns to a table definition, in order.
+/// @param tableDefinition The table definition to add the columns to.
+/// @param columns The columns to add.
+inline void
+AddColumns(
+    TableDefinition& tableDefinition,
+    const std::vector<ColumnSpec>& columns
+)
+{
+    for ( size_t i = 0; i < columns.size(); ++i )
+        tableDefinition.AddColumnWithCollation( columns[i].name, columns[i].type, columns[i].collation );
+}
+
+/// Reads the columns of a table definition.
+/// @param tableDefinition The table definition to read.
+/// @return The columns, in order.
+inline std::vector<ColumnSpec>
+GetColumns(
+    TableDefinition& tableDefinition
+)
+{
+    std::vector<ColumnSpec> columns;
+    const int count = tableDefinition.GetColumnCount();
+    for ( int i = 0; i < count; ++i ) {
+        columns.push_back( ColumnSpec( tableDefinition.GetColumnName( i ),
+                                       tableDefinition.GetColumnType( i ),
+                                       tableDefinition.GetColumnCollation( i ) ) );
+    }
+    return columns;
+}
+
+} // namespace Tableau
+#endif // TableauSchema_CPP_H
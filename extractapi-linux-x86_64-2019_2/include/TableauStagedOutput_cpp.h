@@ -0,0 +1,281 @@
+// -----------------------------------------------------------------------
+// TableauStagedOutput_cpp.h
+// -----------------------------------------------------------------------
+// Builds an extract in a fast staging directory and publishes it atomically.
+
+#ifndef TableauStagedOutput_CPP_H
+#define TableauStagedOutput_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Tableau {
+
+namespace {
+
+    inline std::string NarrowPath( const std::wstring& path )
+    {
+        std::vector<char> buffer( 4 * path.size() + 1 );
+        const size_t length = std::wcstombs( &buffer[0], path.c_str(), buffer.size() );
+        if ( length == static_cast<size_t>( -1 ) )
+            throw TableauException( TAB_RESULT_InvalidArgument, L"The path cannot be represented in the current locale" );
+        return std::string( &buffer[0], length );
+    }
+
+    inline std::wstring WidenPath( const std::string& path )
+    {
+        std::vector<wchar_t> buffer( path.size() + 1 );
+        const size_t length = std::mbstowcs( &buffer[0], path.c_str(), buffer.size() );
+        if ( length == static_cast<size_t>( -1 ) )
+            return std::wstring( path.begin(), path.end() );
+        return std::wstring( &buffer[0], length );
+    }
+
+}
+
+/// Deletes a file, e.g. a partial extract, with its path converted like the paths of a StagedOutput.
+/// @param path The path of the file.
+/// @return False if the path has no representation in the current locale or the file could not be deleted.
+inline bool RemoveFile( const std::wstring& path )
+{
+    std::vector<char> buffer( 4 * path.size() + 1 );
+    const size_t length = std::wcstombs( &buffer[0], path.c_str(), buffer.size() );
+    return length != static_cast<size_t>( -1 ) && std::remove( &buffer[0] ) == 0;
+}
+
+/*------------------------------------------------------------------------
+  CLASS
+  StagedOutput
+
+  Lets an extract be built in a staging directory, e.g. on tmpfs or local
+  NVMe, and moves it to its destination only when it is complete, so slow
+  network volumes are never on the insert path and readers never see a
+  partial file.
+
+  The estimated size is reserved on the staging volume with fallocate
+  while rows are inserted, so a full volume fails at the start instead of
+  after the inserts; <b>Publish</b> releases it just before closing the
+  extract, which is when the data is written. The closed file is synced
+  and renamed to the destination, or, across file systems, copied into a
+  preallocated temporary file next to the destination that is synced and
+  renamed. The destination directory is synced last.
+
+  ------------------------------------------------------------------------*/
+
+class StagedOutput
+{
+  public:
+    /// Creates a private staging directory and reserves the estimated size.
+    /// @param destinationPath The final path of the extract, including the ".hyper" extension.
+    /// @param stagingDirectory The directory to build the extract in.
+    /// @param estimatedBytes The expected size of the extract; zero skips the reservation.
+    StagedOutput(
+        const std::wstring& destinationPath,
+        const std::wstring& stagingDirectory,
+        off_t estimatedBytes = 0
+    );
+
+    /// Calls Abandon() unless the extract was published.
+    ~StagedOutput();
+
+    /// Returns the path to create the Extract with.
+    std::wstring GetStagingPath() const { return WidenPath( m_stagingPath ); }
+
+    /// Returns the final path of the extract.
+    const std::wstring& GetDestinationPath() const { return m_destination; }
+
+    /// Closes the extract, which must have been created at GetStagingPath(), and publishes it.
+    void Publish( Extract& extract );
+
+    /// Publishes the staged extract, which must already be closed.
+    void Publish();
+
+    /// Removes the staged files without publishing them.
+    void Abandon();
+
+    /// Returns true if the extract was moved with a rename rather than copied.
+    bool WasRenamed() const { return m_renamed; }
+
+  private:
+    void Release();
+    void CopyToDestination( const std::string& destination );
+    static void SyncPath( const std::string& path, int flags );
+    static void Throw( const std::wstring& message );
+
+    std::wstring m_destination;
+    std::string m_stagingDirectory;   // private directory created below the configured one
+    std::string m_stagingPath;
+    std::string m_reservationPath;
+    bool m_published;
+    bool m_renamed;
+
+    // Forbidden:
+    StagedOutput( const StagedOutput& );
+    StagedOutput& operator=( const StagedOutput& );
+};
+
+// -----------------------------------------------------------------------
+// StagedOutput methods
+// -----------------------------------------------------------------------
+
+inline StagedOutput::StagedOutput(
+    const std::wstring& destinationPath,
+    const std::wstring& stagingDirectory,
+    off_t estimatedBytes
+) : m_destination(destinationPath),
+    m_published(false),
+    m_renamed(false)
+{
+    const std::string destination = NarrowPath( destinationPath );
+    const size_t slash = destination.rfind( '/' );
+    const std::string fileName = slash == std::string::npos ? destination : destination.substr( slash + 1 );
+
+    std::string pattern = NarrowPath( stagingDirectory ) + "/tableau-stage-XXXXXX";
+    if ( mkdtemp( &pattern[0] ) == nullptr )
+        Throw( L"Could not create a staging directory" );
+    m_stagingDirectory = pattern;
+    m_stagingPath = m_stagingDirectory + "/" + fileName;
+
+    if ( estimatedBytes > 0 ) {
+        m_reservationPath = m_stagingDirectory + "/.reservation";
+        const int fd = open( m_reservationPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600 );
+        const int error = fd < 0 ? errno : posix_fallocate( fd, 0, estimatedBytes );
+        if ( fd >= 0 )
+            close( fd );
+        if ( error != 0 ) {
+            Abandon();
+            throw TableauException( error, L"Could not reserve space for the extract in the staging directory" );
+        }
+    }
+}
+
+inline StagedOutput::~StagedOutput()
+{
+    if ( !m_published )
+        Abandon();
+}
+
+inline void StagedOutput::Publish( Extract& extract )
+{
+    Release();
+    extract.Close();
+    Publish();
+}
+
+inline void StagedOutput::Publish()
+{
+    Release();
+    SyncPath( m_stagingPath, O_RDONLY );
+
+    const std::string destination = NarrowPath( m_destination );
+    if ( rename( m_stagingPath.c_str(), destination.c_str() ) == 0 ) {
+        m_renamed = true;
+    }
+    else if ( errno == EXDEV ) {
+        CopyToDestination( destination );
+        unlink( m_stagingPath.c_str() );
+    }
+    else {
+        Throw( L"Could not move the extract to " + m_destination );
+    }
+
+    const size_t slash = destination.rfind( '/' );
+    SyncPath( slash == std::string::npos ? "." : destination.substr( 0, slash + 1 ), O_RDONLY | O_DIRECTORY );
+    rmdir( m_stagingDirectory.c_str() );
+    m_published = true;
+}
+
+inline void StagedOutput::Abandon()
+{
+    Release();
+    unlink( m_stagingPath.c_str() );
+    rmdir( m_stagingDirectory.c_str() );
+}
+
+inline void StagedOutput::Release()
+{
+    if ( !m_reservationPath.empty() ) {
+        unlink( m_reservationPath.c_str() );
+        m_reservationPath.clear();
+    }
+}
+
+inline void StagedOutput::CopyToDestination( const std::string& destination )
+{
+    const int in = open( m_stagingPath.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( in < 0 )
+        Throw( L"Could not open the staged extract" );
+
+    std::string partial = destination + ".partial-XXXXXX";
+    const int out = mkstemp( &partial[0] );
+    if ( out < 0 ) {
+        const int error = errno;
+        close( in );
+        throw TableauException( error, L"Could not create " + m_destination + L".partial" );
+    }
+
+    struct stat status;
+    int error = fstat( in, &status ) == 0 ? 0 : errno;
+    if ( error == 0 && fchmod( out, status.st_mode & 07777 ) != 0 )
+        error = errno;   // mkstemp creates the file readable by the owner only
+    if ( error == 0 && status.st_size > 0 )
+        error = posix_fallocate( out, 0, status.st_size );
+    if ( error == EINVAL || error == EOPNOTSUPP )
+        error = 0;   // the destination file system cannot preallocate
+
+    std::vector<char> buffer( 1 << 20 );
+    while ( error == 0 ) {
+        const ssize_t got = read( in, &buffer[0], buffer.size() );
+        if ( got < 0 ) {
+            error = errno == EINTR ? 0 : errno;
+            continue;
+        }
+        if ( got == 0 )
+            break;
+        for ( ssize_t done = 0; error == 0 && done < got; ) {
+            const ssize_t wrote = write( out, &buffer[done], got - done );
+            if ( wrote < 0 )
+                error = errno == EINTR ? 0 : errno;
+            else
+                done += wrote;
+        }
+    }
+    if ( error == 0 && fsync( out ) != 0 )
+        error = errno;
+    close( in );
+    if ( close( out ) != 0 && error == 0 )
+        error = errno;
+    if ( error == 0 && rename( partial.c_str(), destination.c_str() ) != 0 )
+        error = errno;
+
+    if ( error != 0 ) {
+        unlink( partial.c_str() );
+        throw TableauException( error, L"Could not copy the extract to " + m_destination );
+    }
+}
+
+inline void StagedOutput::SyncPath( const std::string& path, int flags )
+{
+    const int fd = open( path.c_str(), flags | O_CLOEXEC );
+    if ( fd < 0 )
+        Throw( L"Could not open " + WidenPath( path ) + L" to sync it" );
+    const int error = fsync( fd ) == 0 ? 0 : errno;
+    close( fd );
+    if ( error != 0 )
+        throw TableauException( error, L"Could not sync " + WidenPath( path ) );
+}
+
+inline void StagedOutput::Throw( const std::wstring& message )
+{
+    throw TableauException( errno != 0 ? errno : TAB_RESULT_InternalError, message );
+}
+
+} // namespace Tableau
+#endif // TableauStagedOutput_CPP_H
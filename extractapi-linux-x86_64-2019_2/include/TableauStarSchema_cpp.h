@@ -0,0 +1,372 @@
+// -----------------------------------------------------------------------
+// TableauStarSchema_cpp.h
+// -----------------------------------------------------------------------
+// Single-pass loader that splits denormalized rows into a star schema.
+
+#ifndef TableauStarSchema_CPP_H
+#define TableauStarSchema_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauSchema_cpp.h"
+#include "TableauThreadPool_cpp.h"
+#include "TableauValue_cpp.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  SurrogateKeyDictionary
+
+  Assigns dense integer keys to distinct attribute tuples. The tuples are
+  compared in their serialized form and spread over independently locked
+  shards, so threads resolving different tuples rarely wait for each
+  other. Keys are drawn from one shared counter; when a single thread
+  resolves the tuples they are numbered in order of first appearance.
+
+  ------------------------------------------------------------------------*/
+
+class SurrogateKeyDictionary
+{
+  public:
+    /// Initializes an empty dictionary.
+    /// @param firstKey The key assigned to the first distinct tuple.
+    /// @param shards The number of independently locked shards.
+    explicit SurrogateKeyDictionary(
+        int64_t firstKey = 1,
+        size_t shards = 64
+    );
+
+    /// Returns the key of a tuple, assigning the next free key if the tuple is new.
+    /// @param tuple The serialized tuple, see <b>SerializeRow</b>.
+    /// @param inserted Set to true if this call assigned the key.
+    int64_t GetKey( const std::string& tuple, bool& inserted );
+
+    /// Returns the number of distinct tuples.
+    size_t GetKeyCount() const { return static_cast<size_t>( m_next.load() - m_firstKey ); }
+
+  private:
+    struct TupleHash
+    {
+        size_t operator()( const std::string& tuple ) const { return HashBytes( tuple.data(), tuple.size() ); }
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, int64_t, TupleHash> keys;
+    };
+
+    int64_t m_firstKey;
+    std::atomic<int64_t> m_next;
+    std::vector<std::unique_ptr<Shard> > m_shards;
+
+    // Forbidden:
+    SurrogateKeyDictionary( const SurrogateKeyDictionary& );
+    SurrogateKeyDictionary& operator=( const SurrogateKeyDictionary& );
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  DimensionSpec
+
+  A dimension table split off the denormalized input: its name, the name
+  of its integer key column and the input columns that become its
+  attributes.
+
+  ------------------------------------------------------------------------*/
+
+struct DimensionSpec
+{
+    DimensionSpec( const std::wstring& tableName, const std::wstring& keyColumn, const std::vector<int>& attributeColumns )
+        : tableName(tableName), keyColumn(keyColumn), attributeColumns(attributeColumns) {}
+
+    std::wstring tableName;
+    std::wstring keyColumn;
+    std::vector<int> attributeColumns;   // input columns (zero-based)
+};
+
+/*------------------------------------------------------------------------
+  STRUCT
+  StarRow
+
+  One input row resolved against the dimensions: the fact row and the
+  dimension rows whose keys were assigned while resolving it.
+
+  ------------------------------------------------------------------------*/
+
+struct StarRow
+{
+    ValueRow fact;
+    std::vector<std::pair<size_t, ValueRow> > newDimensionRows;   // dimension index, row
+};
+
+/*------------------------------------------------------------------------
+  CLASS
+  StarSchemaLoader
+
+  Loads denormalized rows into a fact table and one table per dimension
+  in a single pass. The attributes of each dimension are looked up in a
+  SurrogateKeyDictionary; a tuple seen for the first time is written to
+  its dimension table once, and the fact table receives the integer keys
+  followed by the input columns that belong to no dimension.
+
+  <b>Resolve</b> may be called from several threads at once; the tables
+  are only written by <b>Insert</b>, <b>Write</b> and <b>WriteBatch</b>,
+  which must not overlap.
+
+  ------------------------------------------------------------------------*/
+
+class StarSchemaLoader
+{
+  public:
+    /// Adds the fact and dimension tables to an extract.
+    /// @param extract The extract; it must not contain the tables yet.
+    /// @param factTableName The name of the fact table.
+    /// @param inputColumns The columns of the denormalized input rows.
+    /// @param dimensions The dimensions to split off.
+    /// @param threads The number of threads <b>WriteBatch</b> resolves rows on; 1 resolves on the calling thread.
+    StarSchemaLoader(
+        Extract& extract,
+        const std::wstring& factTableName,
+        const std::vector<ColumnSpec>& inputColumns,
+        const std::vector<DimensionSpec>& dimensions,
+        size_t threads = 1
+    );
+
+    /// Looks up the dimension keys of an input row. Thread-safe.
+    /// @param input The denormalized row.
+    /// @param resolved Receives the fact row and the new dimension rows.
+    void Resolve( const ValueRow& input, StarRow& resolved );
+
+    /// Inserts a resolved row: its new dimension rows, then its fact row.
+    void Insert( const StarRow& resolved );
+
+    /// Resolves and inserts one input row.
+    void Write( const ValueRow& input );
+
+    /// Resolves a batch of input rows in parallel, then inserts them in order.
+    void WriteBatch( const std::vector<ValueRow>& inputs );
+
+    /// Returns the columns of the fact table.
+    const std::vector<ColumnSpec>& GetFactColumns() const { return m_fact.columns; }
+
+    /// Returns the columns of a dimension table.
+    const std::vector<ColumnSpec>& GetDimensionColumns( size_t dimension ) const { return m_dimensions[dimension]->columns; }
+
+    /// Returns the number of rows inserted into the fact table.
+    size_t GetFactRowCount() const { return m_fact.rows; }
+
+    /// Returns the number of rows inserted into a dimension table.
+    size_t GetDimensionRowCount( size_t dimension ) const { return m_dimensions[dimension]->rows; }
+
+  private:
+    struct OutputTable
+    {
+        OutputTable() : rows(0) {}
+
+        void Open( Extract& extract, const std::wstring& name );
+        void Insert( const ValueRow& values );
+
+        std::vector<ColumnSpec> columns;
+        std::unique_ptr<TableDefinition> schema;
+        std::shared_ptr<Table> table;
+        std::unique_ptr<Row> row;
+        size_t rows;
+    };
+
+    struct Dimension : OutputTable
+    {
+        std::vector<int> attributeColumns;
+        SurrogateKeyDictionary keys;
+    };
+
+    OutputTable m_fact;
+    std::vector<int> m_measureColumns;   // input columns copied to the fact table
+    std::vector<std::unique_ptr<Dimension> > m_dimensions;
+    std::unique_ptr<ThreadPool> m_pool;
+    size_t m_threads;
+    std::vector<StarRow> m_batch;
+    StarRow m_single;
+
+    // Forbidden:
+    StarSchemaLoader( const StarSchemaLoader& );
+    StarSchemaLoader& operator=( const StarSchemaLoader& );
+};
+
+// -----------------------------------------------------------------------
+// SurrogateKeyDictionary methods
+// -----------------------------------------------------------------------
+
+inline SurrogateKeyDictionary::SurrogateKeyDictionary(
+    int64_t firstKey,
+    size_t shards
+) : m_firstKey(firstKey),
+    m_next(firstKey)
+{
+    for ( size_t i = 0; i < std::max<size_t>( 1, shards ); ++i )
+        m_shards.push_back( std::unique_ptr<Shard>( new Shard() ) );
+}
+
+inline int64_t SurrogateKeyDictionary::GetKey( const std::string& tuple, bool& inserted )
+{
+    // The upper half of the hash picks the shard; the map hashes the tuple again for its buckets.
+    const uint64_t hash = HashBytes( tuple.data(), tuple.size() );
+    Shard& shard = *m_shards[static_cast<size_t>( ( ( hash >> 32 ) * m_shards.size() ) >> 32 )];
+
+    std::lock_guard<std::mutex> lock( shard.mutex );
+    std::unordered_map<std::string, int64_t, TupleHash>::iterator it = shard.keys.find( tuple );
+    inserted = it == shard.keys.end();
+    if ( !inserted )
+        return it->second;
+    const int64_t key = m_next++;
+    shard.keys.insert( std::make_pair( tuple, key ) );
+    return key;
+}
+
+// -----------------------------------------------------------------------
+// StarSchemaLoader methods
+// -----------------------------------------------------------------------
+
+inline StarSchemaLoader::StarSchemaLoader(
+    Extract& extract,
+    const std::wstring& factTableName,
+    const std::vector<ColumnSpec>& inputColumns,
+    const std::vector<DimensionSpec>& dimensions,
+    size_t threads
+) : m_threads(std::max<size_t>( 1, threads ))
+{
+    std::vector<char> inDimension( inputColumns.size(), 0 );
+    for ( size_t d = 0; d < dimensions.size(); ++d ) {
+        const DimensionSpec& spec = dimensions[d];
+        if ( spec.attributeColumns.empty() )
+            throw TableauException( TAB_RESULT_InvalidArgument, L"Dimension " + spec.tableName + L" has no attribute columns" );
+
+        std::unique_ptr<Dimension> dimension( new Dimension() );
+        dimension->attributeColumns = spec.attributeColumns;
+        dimension->columns.push_back( ColumnSpec( spec.keyColumn, Type_Integer ) );
+        for ( size_t i = 0; i < spec.attributeColumns.size(); ++i ) {
+            const int column = spec.attributeColumns[i];
+            if ( column < 0 || static_cast<size_t>( column ) >= inputColumns.size() )
+                throw TableauException( TAB_RESULT_BadIndex, L"Attribute column out of range in dimension " + spec.tableName );
+            dimension->columns.push_back( inputColumns[column] );
+            inDimension[column] = 1;
+        }
+        m_fact.columns.push_back( ColumnSpec( spec.keyColumn, Type_Integer ) );
+        m_dimensions.push_back( std::move( dimension ) );
+    }
+    for ( size_t i = 0; i < inputColumns.size(); ++i ) {
+        if ( !inDimension[i] ) {
+            m_measureColumns.push_back( static_cast<int>( i ) );
+            m_fact.columns.push_back( inputColumns[i] );
+        }
+    }
+
+    for ( size_t d = 0; d < m_dimensions.size(); ++d )
+        m_dimensions[d]->Open( extract, dimensions[d].tableName );
+    m_fact.Open( extract, factTableName );
+
+    if ( m_threads > 1 )
+        m_pool.reset( new ThreadPool( m_threads ) );
+}
+
+inline void StarSchemaLoader::Resolve( const ValueRow& input, StarRow& resolved )
+{
+    resolved.fact.resize( m_fact.columns.size() );
+    resolved.newDimensionRows.clear();
+
+    std::string tuple;
+    ValueRow attributes;
+    for ( size_t d = 0; d < m_dimensions.size(); ++d ) {
+        Dimension& dimension = *m_dimensions[d];
+        attributes.resize( dimension.attributeColumns.size() );
+        for ( size_t i = 0; i < attributes.size(); ++i )
+            attributes[i] = input[dimension.attributeColumns[i]];
+        tuple.clear();
+        SerializeRow( attributes, tuple );
+
+        bool inserted;
+        const int64_t key = dimension.keys.GetKey( tuple, inserted );
+        resolved.fact[d].SetInteger( key );
+        if ( inserted ) {
+            resolved.newDimensionRows.push_back( std::make_pair( d, ValueRow() ) );
+            ValueRow& row = resolved.newDimensionRows.back().second;
+            row.reserve( attributes.size() + 1 );
+            row.push_back( resolved.fact[d] );
+            row.insert( row.end(), attributes.begin(), attributes.end() );
+        }
+    }
+    for ( size_t i = 0; i < m_measureColumns.size(); ++i )
+        resolved.fact[m_dimensions.size() + i] = input[m_measureColumns[i]];
+}
+
+inline void StarSchemaLoader::Insert( const StarRow& resolved )
+{
+    for ( size_t i = 0; i < resolved.newDimensionRows.size(); ++i )
+        m_dimensions[resolved.newDimensionRows[i].first]->Insert( resolved.newDimensionRows[i].second );
+    m_fact.Insert( resolved.fact );
+}
+
+inline void StarSchemaLoader::Write( const ValueRow& input )
+{
+    Resolve( input, m_single );
+    Insert( m_single );
+}
+
+inline void StarSchemaLoader::WriteBatch( const std::vector<ValueRow>& inputs )
+{
+    m_batch.resize( std::max( m_batch.size(), inputs.size() ) );
+    if ( m_pool && inputs.size() > m_threads ) {
+        // Contiguous slices, one per thread; the first slice is resolved here.
+        const size_t slice = ( inputs.size() + m_threads - 1 ) / m_threads;
+        std::vector<std::future<void> > resolved;
+        for ( size_t begin = slice; begin < inputs.size(); begin += slice ) {
+            const size_t end = std::min( inputs.size(), begin + slice );
+            resolved.push_back( m_pool->Submit( [this, &inputs, begin, end] {
+                for ( size_t i = begin; i < end; ++i )
+                    Resolve( inputs[i], m_batch[i] );
+            } ) );
+        }
+        for ( size_t i = 0; i < slice; ++i )
+            Resolve( inputs[i], m_batch[i] );
+        for ( size_t i = 0; i < resolved.size(); ++i )
+            resolved[i].get();
+    }
+    else {
+        for ( size_t i = 0; i < inputs.size(); ++i )
+            Resolve( inputs[i], m_batch[i] );
+    }
+
+    for ( size_t i = 0; i < inputs.size(); ++i )
+        Insert( m_batch[i] );
+}
+
+inline void StarSchemaLoader::OutputTable::Open( Extract& extract, const std::wstring& name )
+{
+    if ( extract.HasTable( name ) )
+        throw TableauException( TAB_RESULT_InvalidArgument, L"Table " + name + L" already exists" );
+    schema.reset( new TableDefinition() );
+    AddColumns( *schema, columns );
+    table = extract.AddTable( name, *schema );
+    row.reset( new Row( *schema ) );
+}
+
+inline void StarSchemaLoader::OutputTable::Insert( const ValueRow& values )
+{
+    for ( size_t c = 0; c < values.size(); ++c )
+        values[c].SetInRow( *row, static_cast<int>( c ) );
+    table->Insert( *row );
+    ++rows;
+}
+
+} // namespace Tableau
+#endif // TableauStarSchema_CPP_H
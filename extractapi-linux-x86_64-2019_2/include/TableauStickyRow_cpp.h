@@ -0,0 +1,243 @@
+// -----------------------------------------------------------------------
+// TableauStickyRow_cpp.h
+// -----------------------------------------------------------------------
+// Row wrapper that only forwards the cells that changed since the last row.
+
+#ifndef TableauStickyRow_CPP_H
+#define TableauStickyRow_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include "TableauValue_cpp.h"
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  StickyRow
+
+  A Row keeps the cells it was given until they are overwritten. StickyRow
+  remembers the last value written to every column and only calls the
+  underlying TabRowSet* function when the new value differs, which lets
+  generic loaders set every column on every row and still get the cost of
+  a hand-written loop that only touches the changing columns.
+
+  ------------------------------------------------------------------------*/
+
+class StickyRow
+{
+  public:
+    /// Initializes a new sticky row that has the specified schema.
+    /// @param tableDefinition The schema to use.
+    StickyRow(
+        TableDefinition& tableDefinition
+    );
+
+    /// Returns the underlying row, e.g. to pass it to <b>Table::Insert</b>.
+    Row& GetRow() { return m_row; }
+
+    /// Forgets the remembered values so the next value of every column is written.
+    void Invalidate();
+
+    /// Returns the number of cells that were forwarded to the row.
+    size_t GetWrittenCount() const { return m_written; }
+
+    /// Returns the number of cells that were skipped because they did not change.
+    size_t GetSkippedCount() const { return m_skipped; }
+
+    void SetNull( int columnNumber );
+    void SetInteger( int columnNumber, int value );
+    void SetLongInteger( int columnNumber, int64_t value );
+    void SetDouble( int columnNumber, double value );
+    void SetBoolean( int columnNumber, bool value );
+    void SetString( int columnNumber, const std::wstring& value );
+    void SetCharString( int columnNumber, const std::string& value );
+    void SetDate( int columnNumber, int year, int month, int day );
+    void SetDateTime( int columnNumber, int year, int month, int day, int hour, int min, int sec, int frac );
+    void SetDuration( int columnNumber, int day, int hour, int minute, int second, int frac );
+    void SetSpatial( int columnNumber, const std::string& value );
+
+    /// Sets the specified column to a Value of any type.
+    void SetValue( int columnNumber, const Value& value );
+
+  private:
+    // Returns true if the column must be written, i.e. its remembered value
+    // is unknown, null or of another type, or the bits differ.
+    bool Changed( int columnNumber, Type type, int64_t bits );
+    bool Known( int columnNumber, Type type );
+    Value& Remember( int columnNumber );
+
+    Row m_row;
+    std::vector<Value> m_last;
+    std::vector<char> m_known;
+    size_t m_written;
+    size_t m_skipped;
+
+    // Forbidden:
+    StickyRow( const StickyRow& );
+    StickyRow& operator=( const StickyRow& );
+};
+
+// -----------------------------------------------------------------------
+// StickyRow methods
+// -----------------------------------------------------------------------
+
+inline StickyRow::StickyRow(
+    TableDefinition& tableDefinition
+) : m_row(tableDefinition),
+    m_last(tableDefinition.GetColumnCount()),
+    m_known(m_last.size(), 0),
+    m_written(0),
+    m_skipped(0)
+{
+}
+
+inline void StickyRow::Invalidate()
+{
+    m_known.assign( m_known.size(), 0 );
+}
+
+inline bool StickyRow::Known( int columnNumber, Type type )
+{
+    const Value& last = m_last[columnNumber];
+    return m_known[columnNumber] && last.GetType() == type && !last.IsNull();
+}
+
+inline bool StickyRow::Changed( int columnNumber, Type type, int64_t bits )
+{
+    if ( Known( columnNumber, type ) && m_last[columnNumber].GetPacked() == bits ) {
+        ++m_skipped;
+        return false;
+    }
+    ++m_written;
+    return true;
+}
+
+inline Value& StickyRow::Remember( int columnNumber )
+{
+    m_known[columnNumber] = 1;
+    return m_last[columnNumber];
+}
+
+inline void StickyRow::SetNull( int columnNumber )
+{
+    if ( m_known[columnNumber] && m_last[columnNumber].IsNull() ) {
+        ++m_skipped;
+        return;
+    }
+    ++m_written;
+    m_row.SetNull( columnNumber );
+    Remember( columnNumber ).SetNull( m_last[columnNumber].GetType() );
+}
+
+inline void StickyRow::SetInteger( int columnNumber, int value )
+{
+    if ( Changed( columnNumber, Type_Integer, value ) ) {
+        m_row.SetInteger( columnNumber, value );
+        Remember( columnNumber ).SetInteger( value );
+    }
+}
+
+inline void StickyRow::SetLongInteger( int columnNumber, int64_t value )
+{
+    if ( Changed( columnNumber, Type_Integer, value ) ) {
+        m_row.SetLongInteger( columnNumber, value );
+        Remember( columnNumber ).SetInteger( value );
+    }
+}
+
+inline void StickyRow::SetDouble( int columnNumber, double value )
+{
+    Value next;
+    next.SetDouble( value );
+    if ( Changed( columnNumber, Type_Double, next.GetPacked() ) ) {
+        m_row.SetDouble( columnNumber, value );
+        Remember( columnNumber ) = next;
+    }
+}
+
+inline void StickyRow::SetBoolean( int columnNumber, bool value )
+{
+    if ( Changed( columnNumber, Type_Boolean, value ? 1 : 0 ) ) {
+        m_row.SetBoolean( columnNumber, value );
+        Remember( columnNumber ).SetBoolean( value );
+    }
+}
+
+inline void StickyRow::SetString( int columnNumber, const std::wstring& value )
+{
+    if ( Known( columnNumber, Type_UnicodeString ) && m_last[columnNumber].GetString() == value ) {
+        ++m_skipped;
+        return;
+    }
+    ++m_written;
+    m_row.SetString( columnNumber, value );
+    Remember( columnNumber ).SetString( value );
+}
+
+inline void StickyRow::SetCharString( int columnNumber, const std::string& value )
+{
+    if ( Known( columnNumber, Type_CharString ) && m_last[columnNumber].GetCharString() == value ) {
+        ++m_skipped;
+        return;
+    }
+    ++m_written;
+    m_row.SetCharString( columnNumber, value );
+    Remember( columnNumber ).SetCharString( value );
+}
+
+inline void StickyRow::SetDate( int columnNumber, int year, int month, int day )
+{
+    Value next;
+    next.SetDate( year, month, day );
+    if ( Changed( columnNumber, Type_Date, next.GetPacked() ) ) {
+        m_row.SetDate( columnNumber, year, month, day );
+        Remember( columnNumber ) = next;
+    }
+}
+
+inline void StickyRow::SetDateTime( int columnNumber, int year, int month, int day, int hour, int min, int sec, int frac )
+{
+    Value next;
+    next.SetDateTime( year, month, day, hour, min, sec, frac );
+    if ( Changed( columnNumber, Type_DateTime, next.GetPacked() ) ) {
+        m_row.SetDateTime( columnNumber, year, month, day, hour, min, sec, frac );
+        Remember( columnNumber ) = next;
+    }
+}
+
+inline void StickyRow::SetDuration( int columnNumber, int day, int hour, int minute, int second, int frac )
+{
+    Value next;
+    next.SetDuration( day, hour, minute, second, frac );
+    if ( Changed( columnNumber, Type_Duration, next.GetPacked() ) ) {
+        m_row.SetDuration( columnNumber, day, hour, minute, second, frac );
+        Remember( columnNumber ) = next;
+    }
+}
+
+inline void StickyRow::SetSpatial( int columnNumber, const std::string& value )
+{
+    if ( Known( columnNumber, Type_Spatial ) && m_last[columnNumber].GetCharString() == value ) {
+        ++m_skipped;
+        return;
+    }
+    ++m_written;
+    m_row.SetSpatial( columnNumber, value );
+    Remember( columnNumber ).SetSpatial( value );
+}
+
+inline void StickyRow::SetValue( int columnNumber, const Value& value )
+{
+    if ( m_known[columnNumber] && m_last[columnNumber] == value ) {
+        ++m_skipped;
+        return;
+    }
+    ++m_written;
+    value.SetInRow( m_row, columnNumber );
+    Remember( columnNumber ) = value;
+}
+
+} // namespace Tableau
+#endif // TableauStickyRow_CPP_H
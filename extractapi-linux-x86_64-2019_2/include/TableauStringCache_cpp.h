@@ -0,0 +1,201 @@
+// -----------------------------------------------------------------------
+// TableauStringCache_cpp.h
+// -----------------------------------------------------------------------
+// Per-column interning of string values for Row::SetString.
+
+#ifndef TableauStringCache_CPP_H
+#define TableauStringCache_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  StringInterner
+
+  Caches the TableauString (UTF-16) form of the string values written to
+  one column, so that each distinct value is converted only once. The
+  hit rate is judged once the cache holds maxEntries values: below that
+  every distinct value fits, so columns of a few thousand repeating values
+  are always cached. A full cache with a low hit rate means a
+  high-cardinality column, where caching would only cost memory, and the
+  interner switches itself off. It tries again after retryLookups lookups,
+  in case the values start to repeat.
+
+  ------------------------------------------------------------------------*/
+
+class StringInterner
+{
+  public:
+    /// Initializes a new, enabled interner.
+    /// @param maxEntries The number of distinct values cached; once they are, the hit rate is evaluated on every miss.
+    /// @param retryLookups The number of lookups after which a disabled interner enables itself again.
+    /// @param minHitRate The hit rate (0..1) below which a full interner disables itself.
+    StringInterner(
+        size_t maxEntries = 16384,
+        size_t retryLookups = 1 << 20,
+        double minHitRate = 0.5
+    );
+
+    /// Returns the TableauString form of the value. The returned string stays valid until the next call to <b>Intern</b> or <b>Clear</b>.
+    /// @param value The string value.
+    /// @return The null-terminated TableauString.
+    TableauString
+    Intern(
+        const std::wstring& value
+    );
+
+    /// Sets the specified column in the row to the interned form of the value.
+    /// @param row The row to set the value in.
+    /// @param columnNumber The column number (zero-based) to set a value for.
+    /// @param value The string value.
+    void
+    SetString(
+        Row& row,
+        int columnNumber,
+        const std::wstring& value
+    );
+
+    /// Drops all cached values and re-enables the interner.
+    void Clear();
+
+    /// Returns false while the interner has turned itself off.
+    bool IsEnabled() const { return m_enabled; }
+
+    /// Returns the number of lookups served so far.
+    size_t GetLookupCount() const { return m_lookups; }
+
+    /// Returns the number of lookups that were answered from the cache.
+    size_t GetHitCount() const { return m_hits; }
+
+    /// Returns the number of distinct values currently cached.
+    size_t GetEntryCount() const { return m_entries.size(); }
+
+  private:
+    typedef std::basic_string<TableauWChar> TableauStdString;
+
+    const TableauStdString& Convert( const std::wstring& value, TableauStdString& out );
+    void Enable();
+    void Disable();
+
+    std::unordered_map<std::wstring, TableauStdString> m_entries;
+    TableauStdString m_scratch;
+    std::vector<TableauWChar> m_buffer;
+    size_t m_maxEntries;
+    size_t m_retryLookups;
+    double m_minHitRate;
+    size_t m_lookups;
+    size_t m_hits;
+    size_t m_windowLookups;     // lookups since the interner was last enabled
+    size_t m_windowHits;
+    size_t m_disabledLookups;   // lookups since the interner was last disabled
+    bool m_enabled;
+};
+
+// -----------------------------------------------------------------------
+// StringInterner methods
+// -----------------------------------------------------------------------
+
+inline StringInterner::StringInterner(
+    size_t maxEntries,
+    size_t retryLookups,
+    double minHitRate
+) : m_maxEntries(maxEntries),
+    m_retryLookups(retryLookups),
+    m_minHitRate(minHitRate),
+    m_lookups(0),
+    m_hits(0),
+    m_windowLookups(0),
+    m_windowHits(0),
+    m_disabledLookups(0),
+    m_enabled(true)
+{
+}
+
+inline TableauString
+StringInterner::Intern(
+    const std::wstring& value
+)
+{
+    ++m_lookups;
+    if ( !m_enabled ) {
+        if ( ++m_disabledLookups < m_retryLookups )
+            return Convert( value, m_scratch ).c_str();
+        Enable();
+    }
+
+    ++m_windowLookups;
+    std::unordered_map<std::wstring, TableauStdString>::const_iterator it = m_entries.find( value );
+    if ( it != m_entries.end() ) {
+        ++m_hits;
+        ++m_windowHits;
+        return it->second.c_str();
+    }
+
+    if ( m_entries.size() < m_maxEntries ) {
+        TableauStdString& interned = m_entries[value];
+        Convert( value, interned );
+        return interned.c_str();
+    }
+
+    // The cache is full, so the window spans more lookups than a column
+    // worth caching has distinct values. If they rarely repeat, the cache
+    // is not worth the memory; otherwise misses are just not cached.
+    if ( m_windowHits < m_minHitRate * m_windowLookups )
+        Disable();
+    return Convert( value, m_scratch ).c_str();
+}
+
+inline void
+StringInterner::SetString(
+    Row& row,
+    int columnNumber,
+    const std::wstring& value
+)
+{
+    row.SetTableauString( columnNumber, Intern( value ) );
+}
+
+inline void StringInterner::Clear()
+{
+    m_entries.clear();
+    m_lookups = 0;
+    m_hits = 0;
+    Enable();
+}
+
+inline const StringInterner::TableauStdString&
+StringInterner::Convert(
+    const std::wstring& value,
+    TableauStdString& out
+)
+{
+    // Characters outside the BMP take two UTF-16 code units.
+    m_buffer.resize( 2 * value.size() + 1 );
+    ToTableauString( value.c_str(), &m_buffer[0] );
+    out.assign( &m_buffer[0] );
+    return out;
+}
+
+inline void StringInterner::Enable()
+{
+    m_enabled = true;
+    m_windowLookups = 0;
+    m_windowHits = 0;
+    m_disabledLookups = 0;
+}
+
+inline void StringInterner::Disable()
+{
+    m_enabled = false;
+    m_disabledLookups = 0;
+    std::unordered_map<std::wstring, TableauStdString>().swap( m_entries );
+}
+
+} // namespace Tableau
+#endif // TableauStringCache_CPP_H
@@ -0,0 +1,115 @@
+// -----------------------------------------------------------------------
+// TableauThreadPool_cpp.h
+// -----------------------------------------------------------------------
+// Fixed-size thread pool for running blocking work in the background.
+
+#ifndef TableauThreadPool_CPP_H
+#define TableauThreadPool_CPP_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  ThreadPool
+
+  Runs submitted tasks in FIFO order on a fixed number of threads. Each
+  <b>Submit</b> returns a future that becomes ready when the task has run
+  and rethrows any exception the task threw. The destructor runs the
+  remaining tasks and joins the threads.
+
+  ------------------------------------------------------------------------*/
+
+class ThreadPool
+{
+  public:
+    /// Starts the threads.
+    /// @param threads The number of threads; at least one is started.
+    explicit ThreadPool( size_t threads ) : m_stopping(false)
+    {
+        for ( size_t i = 0; i < ( threads ? threads : 1 ); ++i )
+            m_threads.push_back( std::thread( &ThreadPool::Run, this ) );
+    }
+
+    /// Runs the queued tasks and joins the threads.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for ( size_t i = 0; i < m_threads.size(); ++i )
+            m_threads[i].join();
+    }
+
+    /// Queues a task.
+    /// @param task The task to run.
+    /// @return A future that is ready once the task has run.
+    std::future<void> Submit( std::function<void()> task )
+    {
+        std::shared_ptr<std::packaged_task<void()> > packaged( new std::packaged_task<void()>( task ) );
+        std::future<void> done = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_tasks.push_back( [packaged] { ( *packaged )(); } );
+        }
+        m_wake.notify_one();
+        return done;
+    }
+
+    /// Returns the number of tasks that are queued but not yet running.
+    size_t GetQueuedCount() const
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return m_tasks.size();
+    }
+
+  private:
+    void Run()
+    {
+        for ( ;; ) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_wake.wait( lock, [this] { return m_stopping || !m_tasks.empty(); } );
+                if ( m_tasks.empty() )
+                    return;
+                task = std::move( m_tasks.front() );
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    bool m_stopping;
+    std::deque<std::function<void()> > m_tasks;
+    std::vector<std::thread> m_threads;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+
+    // Forbidden:
+    ThreadPool( const ThreadPool& );
+    ThreadPool& operator=( const ThreadPool& );
+};
+
+/// Returns the process-wide pool for extract I/O such as Extract::CloseAsync.
+/// It has two threads, so one slow close does not hold up the next.
+inline ThreadPool&
+IOThreadPool()
+{
+    static ThreadPool pool( 2 );
+    return pool;
+}
+
+} // namespace Tableau
+#endif // TableauThreadPool_CPP_H
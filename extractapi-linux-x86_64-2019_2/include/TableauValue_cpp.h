@@ -0,0 +1,460 @@
+// -----------------------------------------------------------------------
+// TableauValue_cpp.h
+// -----------------------------------------------------------------------
+// A typed cell value that can be kept, compared and written into a Row.
+
+#ifndef TableauValue_CPP_H
+#define TableauValue_CPP_H
+
+#include "TableauHyperExtract_cpp.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Tableau {
+
+/*------------------------------------------------------------------------
+  CLASS
+  Value
+
+  Holds one cell of any extract column type. Rows handed to the Extract API
+  are write-only, so every stage that has to look at a value after it was
+  produced (change tracking, sorting, grouping) keeps it as a Value.
+
+  Integers and booleans are stored as 64-bit integers, doubles by their bit
+  pattern, and Date, DateTime and Duration values packed into a single
+  64-bit integer whose order matches the chronological order.
+
+  ------------------------------------------------------------------------*/
+
+class Value
+{
+  public:
+    /// Initializes a null value of type Type_Integer.
+    Value() : m_type(Type_Integer), m_null(true), m_bits(0) {}
+
+    /// Returns the type of the value.
+    Type GetType() const { return m_type; }
+
+    /// Returns true if the value is null.
+    bool IsNull() const { return m_null; }
+
+    /// Sets the value to null.
+    /// @param type The type of the null value.
+    void SetNull( Type type );
+
+    /// Sets the value to an integer (Type_Integer).
+    void SetInteger( int64_t value );
+
+    /// Sets the value to a double (Type_Double).
+    void SetDouble( double value );
+
+    /// Sets the value to a Boolean (Type_Boolean).
+    void SetBoolean( bool value );
+
+    /// Sets the value to a date (Type_Date).
+    void SetDate( int year, int month, int day );
+
+    /// Sets the value to a datetime (Type_DateTime). frac is in 1/10000 seconds.
+    void SetDateTime( int year, int month, int day, int hour, int min, int sec, int frac );
+
+    /// Sets the value to a duration (Type_Duration). frac is in 1/10000 seconds.
+    void SetDuration( int day, int hour, int minute, int second, int frac );
+
+    /// Sets the value to a string (Type_CharString).
+    void SetCharString( const std::string& value );
+
+    /// Sets the value to a string (Type_UnicodeString).
+    void SetString( const std::wstring& value );
+
+    /// Sets the value to a geospatial value in WKT form (Type_Spatial).
+    void SetSpatial( const std::string& value );
+
+    /// Returns the integer or Boolean value.
+    int64_t GetInteger() const { return m_bits; }
+
+    /// Returns the double value.
+    double GetDouble() const;
+
+    /// Returns the Boolean value.
+    bool GetBoolean() const { return m_bits != 0; }
+
+    /// Returns the packed Date, DateTime or Duration value.
+    int64_t GetPacked() const { return m_bits; }
+
+    /// Unpacks a Date value.
+    void GetDate( int& year, int& month, int& day ) const;
+
+    /// Unpacks a DateTime value.
+    void GetDateTime( int& year, int& month, int& day, int& hour, int& min, int& sec, int& frac ) const;
+
+    /// Unpacks a Duration value.
+    void GetDuration( int& day, int& hour, int& minute, int& second, int& frac ) const;
+
+    /// Returns the CharString or Spatial value.
+    const std::string& GetCharString() const { return m_string; }
+
+    /// Returns the UnicodeString value.
+    const std::wstring& GetString() const { return m_wstring; }
+
+    /// Returns true if both values have the same type, nullness and content. Doubles compare by bit pattern.
+    bool operator==( const Value& other ) const;
+    bool operator!=( const Value& other ) const { return !( *this == other ); }
+
+    /// Orders values of the same type; nulls sort first.
+    /// @return A negative number, zero or a positive number.
+    int Compare( const Value& other ) const;
+
+    /// Writes the value into the specified column of a row.
+    /// @param row The row to set the value in.
+    /// @param columnNumber The column number (zero-based) to set the value for.
+    void SetInRow( Row& row, int columnNumber ) const;
+
+    /// Appends a compact binary encoding of the value to a buffer.
+    /// @param out The buffer to append to.
+    void Serialize( std::string& out ) const;
+
+    /// Reads a value written by <b>Serialize</b> and advances the read position.
+    /// @param pos The read position.
+    /// @param end The end of the buffer.
+    /// @return False if the buffer ends before the value.
+    bool Deserialize( const char*& pos, const char* end );
+
+  private:
+    void SetBits( Type type, int64_t bits ) { m_type = type; m_null = false; m_bits = bits; }
+
+    Type m_type;
+    bool m_null;
+    int64_t m_bits;
+    std::string m_string;
+    std::wstring m_wstring;
+};
+
+typedef std::vector<Value> ValueRow;
+
+namespace {
+
+    inline void AppendVarint( std::string& out, uint64_t value )
+    {
+        while ( value >= 0x80 ) {
+            out.push_back( static_cast<char>( value | 0x80 ) );
+            value >>= 7;
+        }
+        out.push_back( static_cast<char>( value ) );
+    }
+
+    inline bool ReadVarint( const char*& pos, const char* end, uint64_t& value )
+    {
+        value = 0;
+        for ( int shift = 0; pos != end && shift < 64; shift += 7 ) {
+            const uint8_t byte = static_cast<uint8_t>( *pos++ );
+            value |= uint64_t( byte & 0x7F ) << shift;
+            if ( !( byte & 0x80 ) )
+                return true;
+        }
+        return false;
+    }
+
+    // 64-bit hash of a byte string, eight bytes per multiply-xorshift step.
+    inline uint64_t HashBytes( const char* data, size_t size )
+    {
+        const uint64_t m = 0x9E3779B97F4A7C15ull;
+        uint64_t h = size * m;
+        size_t i = 0;
+        for ( ; i + 8 <= size; i += 8 ) {
+            uint64_t word;
+            std::memcpy( &word, data + i, sizeof( word ) );
+            h = ( h ^ word ) * m;
+            h ^= h >> 32;
+        }
+        uint64_t tail = 0;
+        std::memcpy( &tail, data + i, size - i );
+        h = ( h ^ tail ) * m;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return h ^ ( h >> 32 );
+    }
+
+    inline void SerializeRow( const ValueRow& row, std::string& out )
+    {
+        AppendVarint( out, row.size() );
+        for ( size_t i = 0; i < row.size(); ++i )
+            row[i].Serialize( out );
+    }
+
+    inline bool DeserializeRow( const char*& pos, const char* end, ValueRow& row )
+    {
+        uint64_t count;
+        if ( !ReadVarint( pos, end, count ) )
+            return false;
+        row.resize( count );
+        for ( size_t i = 0; i < row.size(); ++i ) {
+            if ( !row[i].Deserialize( pos, end ) )
+                return false;
+        }
+        return true;
+    }
+}
+
+// -----------------------------------------------------------------------
+// Value methods
+// -----------------------------------------------------------------------
+
+inline void Value::SetNull( Type type )
+{
+    m_type = type;
+    m_null = true;
+    m_bits = 0;
+    m_string.clear();
+    m_wstring.clear();
+}
+
+inline void Value::SetInteger( int64_t value )
+{
+    SetBits( Type_Integer, value );
+}
+
+inline void Value::SetDouble( double value )
+{
+    int64_t bits;
+    std::memcpy( &bits, &value, sizeof( bits ) );
+    SetBits( Type_Double, bits );
+}
+
+inline void Value::SetBoolean( bool value )
+{
+    SetBits( Type_Boolean, value ? 1 : 0 );
+}
+
+inline void Value::SetDate( int year, int month, int day )
+{
+    SetBits( Type_Date, ( int64_t( year ) * 100 + month ) * 100 + day );
+}
+
+inline void Value::SetDateTime( int year, int month, int day, int hour, int min, int sec, int frac )
+{
+    int64_t packed = ( int64_t( year ) * 100 + month ) * 100 + day;
+    packed = ( ( packed * 100 + hour ) * 100 + min ) * 100 + sec;
+    SetBits( Type_DateTime, packed * 10000 + frac );
+}
+
+inline void Value::SetDuration( int day, int hour, int minute, int second, int frac )
+{
+    const int64_t seconds = ( ( int64_t( day ) * 24 + hour ) * 60 + minute ) * 60 + second;
+    SetBits( Type_Duration, seconds * 10000 + frac );
+}
+
+inline void Value::SetCharString( const std::string& value )
+{
+    SetBits( Type_CharString, 0 );
+    m_string = value;
+}
+
+inline void Value::SetString( const std::wstring& value )
+{
+    SetBits( Type_UnicodeString, 0 );
+    m_wstring = value;
+}
+
+inline void Value::SetSpatial( const std::string& value )
+{
+    SetBits( Type_Spatial, 0 );
+    m_string = value;
+}
+
+inline double Value::GetDouble() const
+{
+    double value;
+    std::memcpy( &value, &m_bits, sizeof( value ) );
+    return value;
+}
+
+inline void Value::GetDate( int& year, int& month, int& day ) const
+{
+    day = static_cast<int>( m_bits % 100 );
+    month = static_cast<int>( m_bits / 100 % 100 );
+    year = static_cast<int>( m_bits / 10000 );
+}
+
+inline void Value::GetDateTime( int& year, int& month, int& day, int& hour, int& min, int& sec, int& frac ) const
+{
+    int64_t packed = m_bits;
+    frac = static_cast<int>( packed % 10000 ); packed /= 10000;
+    sec = static_cast<int>( packed % 100 ); packed /= 100;
+    min = static_cast<int>( packed % 100 ); packed /= 100;
+    hour = static_cast<int>( packed % 100 ); packed /= 100;
+    day = static_cast<int>( packed % 100 ); packed /= 100;
+    month = static_cast<int>( packed % 100 ); packed /= 100;
+    year = static_cast<int>( packed );
+}
+
+inline void Value::GetDuration( int& day, int& hour, int& minute, int& second, int& frac ) const
+{
+    int64_t packed = m_bits;
+    frac = static_cast<int>( packed % 10000 ); packed /= 10000;
+    second = static_cast<int>( packed % 60 ); packed /= 60;
+    minute = static_cast<int>( packed % 60 ); packed /= 60;
+    hour = static_cast<int>( packed % 24 ); packed /= 24;
+    day = static_cast<int>( packed );
+}
+
+inline bool Value::operator==( const Value& other ) const
+{
+    if ( m_type != other.m_type || m_null != other.m_null || m_bits != other.m_bits )
+        return false;
+
+    switch ( m_type ) {
+        case Type_CharString:
+        case Type_Spatial:
+            return m_string == other.m_string;
+        case Type_UnicodeString:
+            return m_wstring == other.m_wstring;
+        default:
+            return true;
+    }
+}
+
+inline int Value::Compare( const Value& other ) const
+{
+    if ( m_null || other.m_null )
+        return ( m_null ? 0 : 1 ) - ( other.m_null ? 0 : 1 );
+
+    switch ( m_type ) {
+        case Type_Double: {
+            const double a = GetDouble(), b = other.GetDouble();
+            return a < b ? -1 : ( b < a ? 1 : 0 );
+        }
+        case Type_CharString:
+        case Type_Spatial:
+            return m_string.compare( other.m_string );
+        case Type_UnicodeString:
+            return m_wstring.compare( other.m_wstring );
+        default:
+            return m_bits < other.m_bits ? -1 : ( other.m_bits < m_bits ? 1 : 0 );
+    }
+}
+
+inline void Value::SetInRow( Row& row, int columnNumber ) const
+{
+    if ( m_null ) {
+        row.SetNull( columnNumber );
+        return;
+    }
+
+    int year, month, day, hour, min, sec, frac;
+    switch ( m_type ) {
+        case Type_Integer:
+            row.SetLongInteger( columnNumber, m_bits );
+            break;
+        case Type_Double:
+            row.SetDouble( columnNumber, GetDouble() );
+            break;
+        case Type_Boolean:
+            row.SetBoolean( columnNumber, GetBoolean() );
+            break;
+        case Type_Date:
+            GetDate( year, month, day );
+            row.SetDate( columnNumber, year, month, day );
+            break;
+        case Type_DateTime:
+            GetDateTime( year, month, day, hour, min, sec, frac );
+            row.SetDateTime( columnNumber, year, month, day, hour, min, sec, frac );
+            break;
+        case Type_Duration:
+            GetDuration( day, hour, min, sec, frac );
+            row.SetDuration( columnNumber, day, hour, min, sec, frac );
+            break;
+        case Type_CharString:
+            row.SetCharString( columnNumber, m_string );
+            break;
+        case Type_UnicodeString:
+            row.SetString( columnNumber, m_wstring );
+            break;
+        case Type_Spatial:
+            row.SetSpatial( columnNumber, m_string );
+            break;
+    }
+}
+
+// Layout: one byte holding the type and a null flag (0x80), followed for
+// non-null values by a zigzag varint (integer, Boolean, packed temporal
+// types), eight raw bytes (double) or a varint length and the characters
+// (strings; UnicodeString characters as varints).
+inline void Value::Serialize( std::string& out ) const
+{
+    out.push_back( static_cast<char>( m_type | ( m_null ? 0x80 : 0 ) ) );
+    if ( m_null )
+        return;
+
+    switch ( m_type ) {
+        case Type_Double:
+            out.append( reinterpret_cast<const char*>( &m_bits ), sizeof( m_bits ) );
+            break;
+        case Type_CharString:
+        case Type_Spatial:
+            AppendVarint( out, m_string.size() );
+            out.append( m_string );
+            break;
+        case Type_UnicodeString:
+            AppendVarint( out, m_wstring.size() );
+            for ( size_t i = 0; i < m_wstring.size(); ++i )
+                AppendVarint( out, static_cast<uint32_t>( m_wstring[i] ) );
+            break;
+        default:
+            AppendVarint( out, ( static_cast<uint64_t>( m_bits ) << 1 ) ^ static_cast<uint64_t>( m_bits >> 63 ) );
+            break;
+    }
+}
+
+inline bool Value::Deserialize( const char*& pos, const char* end )
+{
+    if ( pos == end )
+        return false;
+
+    const uint8_t header = static_cast<uint8_t>( *pos++ );
+    const Type type = static_cast<Type>( header & 0x7F );
+    if ( header & 0x80 ) {
+        SetNull( type );
+        return true;
+    }
+
+    uint64_t value;
+    switch ( type ) {
+        case Type_Double:
+            if ( end - pos < static_cast<ptrdiff_t>( sizeof( m_bits ) ) )
+                return false;
+            SetBits( type, 0 );
+            std::memcpy( &m_bits, pos, sizeof( m_bits ) );
+            pos += sizeof( m_bits );
+            return true;
+        case Type_CharString:
+        case Type_Spatial:
+            if ( !ReadVarint( pos, end, value ) || static_cast<uint64_t>( end - pos ) < value )
+                return false;
+            SetBits( type, 0 );
+            m_string.assign( pos, value );
+            pos += value;
+            return true;
+        case Type_UnicodeString: {
+            if ( !ReadVarint( pos, end, value ) )
+                return false;
+            SetBits( type, 0 );
+            m_wstring.resize( value );
+            for ( size_t i = 0; i < m_wstring.size(); ++i ) {
+                uint64_t c;
+                if ( !ReadVarint( pos, end, c ) )
+                    return false;
+                m_wstring[i] = static_cast<wchar_t>( c );
+            }
+            return true;
+        }
+        default:
+            if ( !ReadVarint( pos, end, value ) )
+                return false;
+            SetBits( type, static_cast<int64_t>( ( value >> 1 ) ^ ( ~( value & 1 ) + 1 ) ) );
+            return true;
+    }
+}
+
+} // namespace Tableau
+#endif // TableauValue_CPP_H
@@ -0,0 +1,405 @@
+//------------------------------------------------------------------------------
+//
+//  Compares two runs of TableauSDKBenchmark and flags regressions.
+//
+//  Both inputs are the JSON lines printed by the benchmarks, ideally with
+//  several repetitions each. For every benchmark and metric the tool tests
+//  whether the candidate differs from the baseline (Mann-Whitney U) and
+//  computes a bootstrap confidence interval of the ratio of the medians. A
+//  significant change in the worse direction that exceeds the threshold is a
+//  regression, and the tool exits with status 1.
+//
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//  Metrics
+//------------------------------------------------------------------------------
+struct Metric
+{
+    const char* name;
+    bool higherIsBetter;
+};
+
+const Metric METRICS[] = {
+    {"rows_per_sec", true},
+    {"ns_per_cell", false},
+    {"close_seconds", false},
+    {"peak_rss_kb", false},
+};
+
+//  Samples of every metric, by benchmark name and metric name.
+typedef std::map<std::string, std::map<std::string, std::vector<double>>> Samples;
+
+//------------------------------------------------------------------------------
+//  Read Results
+//------------------------------------------------------------------------------
+//  Parses one flat JSON object of string and number values. Returns 'false' if
+//  the line is not such an object.
+bool ParseLine(const std::string& line, std::string& benchmark, std::map<std::string, double>& numbers)
+{
+    size_t pos = line.find('{');
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    ++pos;
+    while (pos < line.size())
+    {
+        pos = line.find_first_not_of(" \t,", pos);
+        if (pos == std::string::npos || line[pos] == '}')
+        {
+            return !benchmark.empty();
+        }
+        if (line[pos] != '"')
+        {
+            return false;
+        }
+        const size_t keyEnd = line.find('"', pos + 1);
+        if (keyEnd == std::string::npos)
+        {
+            return false;
+        }
+        const std::string key = line.substr(pos + 1, keyEnd - pos - 1);
+        pos = line.find_first_not_of(" \t", keyEnd + 1);
+        if (pos == std::string::npos || line[pos] != ':')
+        {
+            return false;
+        }
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos == std::string::npos)
+        {
+            return false;
+        }
+        if (line[pos] == '"')
+        {
+            const size_t valueEnd = line.find('"', pos + 1);
+            if (valueEnd == std::string::npos)
+            {
+                return false;
+            }
+            if (key == "benchmark")
+            {
+                benchmark = line.substr(pos + 1, valueEnd - pos - 1);
+            }
+            pos = valueEnd + 1;
+        }
+        else
+        {
+            char* end = nullptr;
+            const double value = std::strtod(line.c_str() + pos, &end);
+            if (end == line.c_str() + pos)
+            {
+                return false;
+            }
+            numbers[key] = value;
+            pos = end - line.c_str();
+        }
+    }
+    return false;
+}
+
+bool ReadResults(const char* path, Samples& samples)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        std::string benchmark;
+        std::map<std::string, double> numbers;
+        if (!ParseLine(line, benchmark, numbers))
+        {
+            std::cerr << path << ":" << lineNumber << ": not a benchmark result" << std::endl;
+            return false;
+        }
+        for (const Metric& metric : METRICS)
+        {
+            if (numbers.count(metric.name))
+            {
+                samples[benchmark][metric.name].push_back(numbers[metric.name]);
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//  Statistics
+//------------------------------------------------------------------------------
+double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+//  Two-sided p-value of the Mann-Whitney U test. Exact for small samples
+//  without ties, otherwise the normal approximation with tie correction.
+double MannWhitneyP(const std::vector<double>& a, const std::vector<double>& b)
+{
+    const size_t n1 = a.size();
+    const size_t n2 = b.size();
+    std::vector<std::pair<double, int>> all;
+    for (double v : a)
+    {
+        all.push_back(std::make_pair(v, 0));
+    }
+    for (double v : b)
+    {
+        all.push_back(std::make_pair(v, 1));
+    }
+    std::sort(all.begin(), all.end());
+
+    //  Mid-ranks, the rank sum of `a` and the tie correction term
+    double rankSumA = 0;
+    double tieTerm = 0;
+    bool ties = false;
+    for (size_t i = 0; i < all.size();)
+    {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+        {
+            ++j;
+        }
+        const double rank = (i + j + 1) / 2.0;
+        for (size_t k = i; k < j; ++k)
+        {
+            if (all[k].second == 0)
+            {
+                rankSumA += rank;
+            }
+        }
+        const double t = static_cast<double>(j - i);
+        tieTerm += t * t * t - t;
+        ties = ties || j - i > 1;
+        i = j;
+    }
+    const double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    const double mean = n1 * n2 / 2.0;
+
+    if (!ties && n1 * n2 <= 400)
+    {
+        //  f[i][j][k] is the number of orderings of i values of `a` and j values
+        //  of `b` with U = k; the largest value is either from `a`, which then
+        //  exceeds all j values of `b`, or from `b`.
+        std::vector<std::vector<std::vector<double>>> f(n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+        for (size_t i = 0; i <= n1; ++i)
+        {
+            for (size_t j = 0; j <= n2; ++j)
+            {
+                f[i][j].assign(i * j + 1, 0);
+                if (i == 0 || j == 0)
+                {
+                    f[i][j][0] = 1;
+                    continue;
+                }
+                for (size_t k = 0; k <= i * j; ++k)
+                {
+                    double value = 0;
+                    if (k >= j && k - j <= (i - 1) * j)
+                    {
+                        value += f[i - 1][j][k - j];
+                    }
+                    if (k <= i * (j - 1))
+                    {
+                        value += f[i][j - 1][k];
+                    }
+                    f[i][j][k] = value;
+                }
+            }
+        }
+        const std::vector<double>& dist = f[n1][n2];
+        double total = 0;
+        double tail = 0;
+        const double extreme = std::fabs(u - mean);
+        for (size_t k = 0; k < dist.size(); ++k)
+        {
+            total += dist[k];
+            if (std::fabs(k - mean) >= extreme - 1e-9)
+            {
+                tail += dist[k];
+            }
+        }
+        return std::min(1.0, tail / total);
+    }
+
+    const double n = static_cast<double>(n1 + n2);
+    const double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance <= 0)
+    {
+        return 1.0;
+    }
+    const double z = (std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    return std::min(1.0, std::erfc(std::max(0.0, z) / std::sqrt(2.0)));
+}
+
+//  Percentile bootstrap interval of median(candidate) / median(baseline) with
+//  a fixed seed, so repeated comparisons of the same files agree.
+void BootstrapRatio(const std::vector<double>& baseline, const std::vector<double>& candidate,
+                    double confidence, double& low, double& high)
+{
+    const int resamples = 2000;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next = [&state](size_t n) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<size_t>(state % n);
+    };
+
+    std::vector<double> ratios;
+    std::vector<double> a(baseline.size());
+    std::vector<double> b(candidate.size());
+    for (int r = 0; r < resamples; ++r)
+    {
+        for (double& v : a)
+        {
+            v = baseline[next(baseline.size())];
+        }
+        for (double& v : b)
+        {
+            v = candidate[next(candidate.size())];
+        }
+        const double base = Median(a);
+        if (base != 0)
+        {
+            ratios.push_back(Median(b) / base);
+        }
+    }
+    if (ratios.empty())
+    {
+        low = high = 1;
+        return;
+    }
+    std::sort(ratios.begin(), ratios.end());
+    const double alpha = (1 - confidence) / 2;
+    low = ratios[static_cast<size_t>(alpha * (ratios.size() - 1))];
+    high = ratios[static_cast<size_t>((1 - alpha) * (ratios.size() - 1))];
+}
+
+//------------------------------------------------------------------------------
+//  Display Usage
+//------------------------------------------------------------------------------
+void DisplayUsage()
+{
+    std::cerr << "Compares benchmark results of TableauSDKBenchmark against a baseline:" << std::endl
+              << std::endl
+              << "USAGE: TableauBenchCompare-cpp [OPTIONS] BASELINE CANDIDATE" << std::endl
+              << std::endl
+              << "BASELINE and CANDIDATE are files with the JSON lines printed by the benchmarks." << std::endl
+              << "Exits with status 1 if a benchmark regressed." << std::endl
+              << std::endl
+              << "OPTIONS:" << std::endl
+              << " -h, --help            Show this help message and exit" << std::endl
+              << std::endl
+              << " -a P, --alpha P       Significance level of the tests (default=0.05)" << std::endl
+              << std::endl
+              << " -t PCT, --threshold PCT" << std::endl
+              << "                       Smallest change of a median, in percent, that counts as a regression (default=5)" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+//  Main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    double alpha = 0.05;
+    double threshold = 0.05;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if ((!strcmp(argv[i], "-a") || !strcmp(argv[i], "--alpha")) && hasValue)
+        {
+            alpha = std::atof(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threshold")) && hasValue)
+        {
+            threshold = std::atof(argv[++i]) / 100;
+        }
+        else if (argv[i][0] != '-' && files.size() < 2)
+        {
+            files.push_back(argv[i]);
+        }
+        else
+        {
+            DisplayUsage();
+            exit(strcmp(argv[i], "-h") && strcmp(argv[i], "--help") ? 2 : EXIT_SUCCESS);
+        }
+    }
+    if (files.size() != 2)
+    {
+        DisplayUsage();
+        exit(2);
+    }
+
+    Samples baseline;
+    Samples candidate;
+    if (!ReadResults(files[0], baseline) || !ReadResults(files[1], candidate))
+    {
+        exit(2);
+    }
+
+    int regressions = 0;
+    std::printf("%-36s %-14s %5s %14s %14s %8s %19s %8s\n",
+                "benchmark", "metric", "n", "baseline", "candidate", "change", "ci", "p");
+    for (const auto& benchmark : candidate)
+    {
+        if (!baseline.count(benchmark.first))
+        {
+            std::printf("%-36s (not in baseline)\n", benchmark.first.c_str());
+            continue;
+        }
+        for (const Metric& metric : METRICS)
+        {
+            const auto base = baseline[benchmark.first].find(metric.name);
+            const auto cand = benchmark.second.find(metric.name);
+            if (base == baseline[benchmark.first].end() || cand == benchmark.second.end())
+            {
+                continue;
+            }
+            const std::vector<double>& a = base->second;
+            const std::vector<double>& b = cand->second;
+            const double baseMedian = Median(a);
+            const double candMedian = Median(b);
+            const double p = MannWhitneyP(a, b);
+            double low, high;
+            BootstrapRatio(a, b, 1 - alpha, low, high);
+
+            //  Worse means lower throughput or higher cost, and the whole
+            //  interval must lie on the worse side of the threshold.
+            const double change = baseMedian != 0 ? candMedian / baseMedian - 1 : 0;
+            const bool worse = metric.higherIsBetter ? high < 1 - threshold : low > 1 + threshold;
+            const bool regression = p < alpha && worse;
+            regressions += regression;
+
+            std::printf("%-36s %-14s %2zu/%-2zu %14.3f %14.3f %+7.1f%% [%7.3f, %7.3f] %8.4f%s\n",
+                        benchmark.first.c_str(), metric.name, a.size(), b.size(), baseMedian, candMedian,
+                        change * 100, low, high, p, regression ? "  REGRESSION" : "");
+        }
+    }
+
+    std::printf("\n%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+    exit(regressions ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,2468 @@
+//------------------------------------------------------------------------------
+//
+//  Throughput benchmarks for the Tableau Extract API C++ wrapper.
+//
+//  Every benchmark writes one or more extracts into the output directory and
+//  prints one JSON object per line to stdout.
+//
+//------------------------------------------------------------------------------
+#if defined(__APPLE__) && defined(__MACH__)
+#include <TableauHyperExtract/TableauHyperExtract_cpp.h>
+#include <TableauHyperExtract/TableauAggregation_cpp.h>
+#include <TableauHyperExtract/TableauAsyncWriter_cpp.h>
+#include <TableauHyperExtract/TableauCancellation_cpp.h>
+#include <TableauHyperExtract/TableauCloseAsync_cpp.h>
+#include <TableauHyperExtract/TableauDataGenerator_cpp.h>
+#include <TableauHyperExtract/TableauDeduplicator_cpp.h>
+#include <TableauHyperExtract/TableauExternalSort_cpp.h>
+#include <TableauHyperExtract/TableauFanOut_cpp.h>
+#include <TableauHyperExtract/TableauFeedLoader_cpp.h>
+#include <TableauHyperExtract/TableauFixedWidth_cpp.h>
+#include <TableauHyperExtract/TableauJobScheduler_cpp.h>
+#include <TableauHyperExtract/TableauJsonLines_cpp.h>
+#include <TableauHyperExtract/TableauPartitionedWriter_cpp.h>
+#include <TableauHyperExtract/TableauProgress_cpp.h>
+#include <TableauHyperExtract/TableauRangeInsert_cpp.h>
+#include <TableauHyperExtract/TableauRowBinding_cpp.h>
+#include <TableauHyperExtract/TableauStagedOutput_cpp.h>
+#include <TableauHyperExtract/TableauStarSchema_cpp.h>
+#include <TableauHyperExtract/TableauStickyRow_cpp.h>
+#include <TableauHyperExtract/TableauStringCache_cpp.h>
+#else
+#include "TableauHyperExtract_cpp.h"
+#include "TableauAggregation_cpp.h"
+#include "TableauAsyncWriter_cpp.h"
+#include "TableauCancellation_cpp.h"
+#include "TableauCloseAsync_cpp.h"
+#include "TableauDataGenerator_cpp.h"
+#include "TableauDeduplicator_cpp.h"
+#include "TableauExternalSort_cpp.h"
+#include "TableauFanOut_cpp.h"
+#include "TableauFeedLoader_cpp.h"
+#include "TableauFixedWidth_cpp.h"
+#include "TableauJobScheduler_cpp.h"
+#include "TableauJsonLines_cpp.h"
+#include "TableauPartitionedWriter_cpp.h"
+#include "TableauProgress_cpp.h"
+#include "TableauRangeInsert_cpp.h"
+#include "TableauRowBinding_cpp.h"
+#include "TableauStagedOutput_cpp.h"
+#include "TableauStarSchema_cpp.h"
+#include "TableauStickyRow_cpp.h"
+#include "TableauStringCache_cpp.h"
+#endif
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace Tableau;
+
+//------------------------------------------------------------------------------
+//  Benchmark Infrastructure
+//------------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+    long rows = 1000000;
+    size_t memoryBudget = 64 << 20;
+    std::string outputDir = ".";
+    std::string stagingDir;
+    std::string filter;
+    int repetitions = 1;
+};
+
+struct BenchmarkResult
+{
+    long rows = 0;
+    long cells = 0;
+    double insertSeconds = 0;
+    double closeSeconds = 0;
+    std::vector<std::pair<std::string, double>> extra;
+};
+
+typedef std::function<BenchmarkResult(const BenchmarkOptions&, const std::string&)> BenchmarkFunction;
+
+struct Benchmark
+{
+    const char* name;
+    BenchmarkFunction run;
+};
+
+class Stopwatch
+{
+  public:
+    Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    double Seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+std::wstring ExtractPath(const BenchmarkOptions& options, const std::string& name)
+{
+    std::string path = options.outputDir + "/bench-" + name + ".hyper";
+    std::remove(path.c_str());
+    return std::wstring(path.begin(), path.end());
+}
+
+//  Resets the peak resident set size so that every run reports its own peak.
+//  Needs Linux 4.0 or later; elsewhere the peak covers the whole process.
+void ResetPeakRss()
+{
+    if (FILE* file = std::fopen("/proc/self/clear_refs", "w"))
+    {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+}
+
+long PeakRssKb()
+{
+    long peak = -1;
+    if (FILE* file = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        while (peak < 0 && std::fgets(line, sizeof(line), file))
+        {
+            std::sscanf(line, "VmHWM: %ld kB", &peak);
+        }
+        std::fclose(file);
+    }
+    if (peak < 0)
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak = usage.ru_maxrss;
+    }
+    return peak;
+}
+
+void PrintResult(const std::string& name, int repetition, const BenchmarkResult& result)
+{
+    const double rowsPerSec = result.insertSeconds > 0 ? result.rows / result.insertSeconds : 0;
+    const double nsPerCell = result.cells > 0 ? result.insertSeconds * 1e9 / result.cells : 0;
+
+    std::printf("{\"benchmark\":\"%s\",\"repetition\":%d,\"rows\":%ld,\"cells\":%ld,\"seconds\":%.6f,"
+                "\"rows_per_sec\":%.1f,\"ns_per_cell\":%.3f,\"close_seconds\":%.6f,\"peak_rss_kb\":%ld",
+                name.c_str(), repetition, result.rows, result.cells, result.insertSeconds,
+                rowsPerSec, nsPerCell, result.closeSeconds, PeakRssKb());
+    for (const auto& extra : result.extra)
+    {
+        std::printf(",\"%s\":%.6f", extra.first.c_str(), extra.second);
+    }
+    std::printf("}\n");
+    std::fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+//  Unicode String Benchmarks
+//------------------------------------------------------------------------------
+//  Writes four Type_UnicodeString columns per row. `cardinality` distinct
+//  values cycle through every column, so a small cardinality models product or
+//  country columns and a large one models free text.
+const int UNICODE_COLUMNS = 4;
+
+BenchmarkResult RunUnicodeStrings(const BenchmarkOptions& options, const std::string& name, long cardinality, bool intern)
+{
+    std::vector<std::wstring> values;
+    const long distinct = std::min(cardinality, options.rows);
+    values.reserve(distinct);
+    for (long i = 0; i < distinct; ++i)
+    {
+        values.push_back(L"Produkt über " + std::to_wstring(i * 7919));
+    }
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    for (int c = 0; c < UNICODE_COLUMNS; ++c)
+    {
+        schema.AddColumn(L"uString" + std::to_wstring(c), Type_UnicodeString);
+    }
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    Row row(schema);
+
+    std::vector<StringInterner> interners(UNICODE_COLUMNS);
+    Stopwatch insertTime;
+    for (long i = 0; i < options.rows; ++i)
+    {
+        for (int c = 0; c < UNICODE_COLUMNS; ++c)
+        {
+            const std::wstring& value = values[(i + c) % distinct];
+            if (intern)
+            {
+                interners[c].SetString(row, c, value);
+            }
+            else
+            {
+                row.SetString(c, value);
+            }
+        }
+        table->Insert(row);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * UNICODE_COLUMNS;
+    if (intern)
+    {
+        size_t hits = 0, lookups = 0, enabled = 0;
+        for (const StringInterner& interner : interners)
+        {
+            hits += interner.GetHitCount();
+            lookups += interner.GetLookupCount();
+            enabled += interner.IsEnabled() ? 1 : 0;
+        }
+        result.extra.push_back(std::make_pair("intern_hit_rate", lookups ? double(hits) / lookups : 0.0));
+        result.extra.push_back(std::make_pair("intern_enabled_columns", double(enabled)));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Wide Dimension Benchmarks
+//------------------------------------------------------------------------------
+//  Writes a wide, slowly changing dimension table: column `c` only changes
+//  every `c + 1` rows, cycling through integer, double, char string, unicode
+//  string and date columns. The plain variant re-sets every cell of every row
+//  the way generic loaders do; the sticky variant goes through StickyRow.
+const int WIDE_COLUMNS = 40;
+
+template <class RowType>
+void SetWideCell(RowType& row, int column, long version, const std::vector<std::string>& strings,
+                 const std::vector<std::wstring>& wstrings)
+{
+    switch (column % 5)
+    {
+    case 0:
+        row.SetLongInteger(column, version);
+        break;
+    case 1:
+        row.SetDouble(column, version * 0.25);
+        break;
+    case 2:
+        row.SetCharString(column, strings[version % strings.size()]);
+        break;
+    case 3:
+        row.SetString(column, wstrings[version % wstrings.size()]);
+        break;
+    default:
+        row.SetDate(column, 2000 + static_cast<int>(version % 30), 1 + static_cast<int>(version % 12), 1);
+        break;
+    }
+}
+
+BenchmarkResult RunWideDimension(const BenchmarkOptions& options, const std::string& name, bool sticky)
+{
+    const Type types[] = {Type_Integer, Type_Double, Type_CharString, Type_UnicodeString, Type_Date};
+    std::vector<std::string> strings;
+    std::vector<std::wstring> wstrings;
+    for (int i = 0; i < 64; ++i)
+    {
+        strings.push_back("Attribute value " + std::to_string(i));
+        wstrings.push_back(L"Attributwert " + std::to_wstring(i));
+    }
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    for (int c = 0; c < WIDE_COLUMNS; ++c)
+    {
+        schema.AddColumn(L"Attribute" + std::to_wstring(c), types[c % 5]);
+    }
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    StickyRow stickyRow(schema);
+    Row row(schema);
+
+    Stopwatch insertTime;
+    for (long i = 0; i < options.rows; ++i)
+    {
+        for (int c = 0; c < WIDE_COLUMNS; ++c)
+        {
+            if (sticky)
+            {
+                SetWideCell(stickyRow, c, i / (c + 1), strings, wstrings);
+            }
+            else
+            {
+                SetWideCell(row, c, i / (c + 1), strings, wstrings);
+            }
+        }
+        table->Insert(sticky ? stickyRow.GetRow() : row);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * WIDE_COLUMNS;
+    if (sticky)
+    {
+        const double written = static_cast<double>(stickyRow.GetWrittenCount());
+        result.extra.push_back(std::make_pair("written_cell_ratio", written / std::max(1L, result.cells)));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Sorted Insert Benchmarks
+//------------------------------------------------------------------------------
+//  Inserts fact rows that arrive in random order, either as they come or
+//  clustered by (Date, Region) through the ExternalSorter with the configured
+//  memory budget. The reported time includes sorting and merging.
+BenchmarkResult RunSortedInsert(const BenchmarkOptions& options, const std::string& name, bool sorted)
+{
+    const wchar_t* regions[] = {L"Nord", L"Süd", L"Ost", L"West", L"Zentral"};
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    schema.AddColumn(L"Date", Type_Date);
+    schema.AddColumn(L"Region", Type_UnicodeString);
+    schema.AddColumn(L"Amount", Type_Double);
+    schema.AddColumn(L"Id", Type_Integer);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    Row row(schema);
+
+    ExternalSorter sorter({SortKey(0), SortKey(1)}, options.memoryBudget, options.outputDir);
+    ValueRow values(4);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+
+    Stopwatch insertTime;
+    for (long i = 0; i < options.rows; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        values[0].SetDate(2015 + static_cast<int>(state % 5), 1 + static_cast<int>((state >> 8) % 12), 1 + static_cast<int>((state >> 16) % 28));
+        values[1].SetString(regions[(state >> 24) % 5]);
+        values[2].SetDouble(static_cast<double>((state >> 32) % 100000) / 100);
+        values[3].SetInteger(i);
+        if (sorted)
+        {
+            sorter.Add(values);
+        }
+        else
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                values[c].SetInRow(row, c);
+            }
+            table->Insert(row);
+        }
+    }
+    if (sorted)
+    {
+        sorter.Insert(*table);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * 4;
+    if (sorted)
+    {
+        result.extra.push_back(std::make_pair("spilled_runs", double(sorter.GetSpilledRunCount())));
+        result.extra.push_back(std::make_pair("spilled_bytes", double(sorter.GetSpilledBytes())));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Deduplication Benchmarks
+//------------------------------------------------------------------------------
+//  A parser thread produces batches of events of which about 20% replay an
+//  earlier event id; the main thread inserts them. The dedup variant runs a
+//  DedupStage keyed on the event id between the two threads.
+const size_t DEDUP_BATCH_ROWS = 4096;
+
+BenchmarkResult RunDedup(const BenchmarkOptions& options, const std::string& name, bool dedup)
+{
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    schema.AddColumn(L"EventId", Type_Integer);
+    schema.AddColumn(L"Source", Type_CharString);
+    schema.AddColumn(L"Value", Type_Double);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    Row row(schema);
+
+    std::unique_ptr<DedupStage> stage(dedup ? new DedupStage({0, 1}, static_cast<size_t>(options.rows)) : nullptr);
+    BoundedQueue<DedupStage::Batch> direct(8);
+
+    Stopwatch insertTime;
+    std::thread parser([&options, &stage, &direct]() {
+        uint64_t state = 0x2545F4914F6CDD1Dull;
+        DedupStage::Batch batch;
+        for (long i = 0; i < options.rows; ++i)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            const long id = (state % 5 == 0 && i > 0) ? static_cast<long>((state >> 8) % i) : i;
+            ValueRow values(3);
+            values[0].SetInteger(id);
+            values[1].SetCharString(id % 2 ? "web" : "mobile");
+            values[2].SetDouble(id * 0.5);
+            batch.push_back(std::move(values));
+            if (batch.size() == DEDUP_BATCH_ROWS || i + 1 == options.rows)
+            {
+                if (stage)
+                {
+                    stage->Push(std::move(batch));
+                }
+                else
+                {
+                    direct.Push(std::move(batch));
+                }
+                batch = DedupStage::Batch();
+            }
+        }
+        if (stage)
+        {
+            stage->Finish();
+        }
+        else
+        {
+            direct.Close();
+        }
+    });
+
+    DedupStage::Batch batch;
+    while (stage ? stage->Pop(batch) : direct.Pop(batch))
+    {
+        for (const ValueRow& values : batch)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                values[c].SetInRow(row, c);
+            }
+            table->Insert(row);
+            ++result.rows;
+        }
+    }
+    parser.join();
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.cells = result.rows * 3;
+    if (stage)
+    {
+        const DedupStats stats = stage->GetStats();
+        result.extra.push_back(std::make_pair("dedup_ratio", stats.GetDedupRatio()));
+        result.extra.push_back(std::make_pair("dedup_busy_seconds", stats.busySeconds));
+        result.extra.push_back(std::make_pair("dedup_rows_per_sec", stats.busySeconds > 0 ? stats.rowsIn / stats.busySeconds : 0));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Partitioned Output Benchmarks
+//------------------------------------------------------------------------------
+//  Writes rows of PARTITION_TENANTS tenants in random order into one extract
+//  per tenant, with at most `maxOpen` extracts open at a time. With fewer open
+//  extracts than tenants the writer closes and reopens partitions.
+const int PARTITION_TENANTS = 32;
+
+BenchmarkResult RunPartitioned(const BenchmarkOptions& options, const std::string& name, size_t maxOpen)
+{
+    std::vector<ColumnSpec> columns;
+    columns.push_back(ColumnSpec(L"Tenant", Type_Integer));
+    columns.push_back(ColumnSpec(L"Date", Type_Date));
+    columns.push_back(ColumnSpec(L"Amount", Type_Double));
+    std::wstring prefix = ExtractPath(options, name);
+    prefix.resize(prefix.size() - 6);
+    prefix += L"-";
+
+    BenchmarkResult result;
+    PartitionedWriter writer(prefix, L"Extract", columns, 0, ValuePartitioner(), maxOpen);
+    ValueRow values(3);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+
+    Stopwatch insertTime;
+    for (long i = 0; i < options.rows; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        values[0].SetInteger(static_cast<int64_t>(state % PARTITION_TENANTS));
+        values[1].SetDate(2019, 1 + static_cast<int>((state >> 8) % 12), 1 + static_cast<int>((state >> 16) % 28));
+        values[2].SetDouble(static_cast<double>((state >> 32) % 100000) / 100);
+        writer.Write(values);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    writer.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * 3;
+    result.extra.push_back(std::make_pair("partitions", double(writer.GetPaths().size())));
+    result.extra.push_back(std::make_pair("reopens", double(writer.GetReopenCount())));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Background Close Benchmark
+//------------------------------------------------------------------------------
+//  Writes the rows into ROTATION_EXTRACTS extracts one after the other, once
+//  closing each extract before starting the next and once handing it to
+//  CloseAsync. Reports both wall clocks and the time recovered.
+const int ROTATION_EXTRACTS = 8;
+
+double WriteRotation(const BenchmarkOptions& options, const std::string& name, bool async, double& blockedSeconds)
+{
+    std::vector<std::future<void>> closing;
+    blockedSeconds = 0;
+
+    Stopwatch wallTime;
+    for (int e = 0; e < ROTATION_EXTRACTS; ++e)
+    {
+        Extract extract(ExtractPath(options, name + (async ? "-async-" : "-sync-") + std::to_string(e)));
+        TableDefinition schema;
+        schema.AddColumn(L"Id", Type_Integer);
+        schema.AddColumn(L"Amount", Type_Double);
+        schema.AddColumn(L"Label", Type_CharString);
+        std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+        Row row(schema);
+        for (long i = e; i < options.rows; i += ROTATION_EXTRACTS)
+        {
+            row.SetLongInteger(0, i);
+            row.SetDouble(1, i * 0.25);
+            row.SetCharString(2, i % 2 ? "odd" : "even");
+            table->Insert(row);
+        }
+
+        Stopwatch closeTime;
+        if (async)
+        {
+            closing.push_back(CloseAsync(extract));
+        }
+        else
+        {
+            extract.Close();
+        }
+        blockedSeconds += closeTime.Seconds();
+    }
+
+    Stopwatch waitTime;
+    for (std::future<void>& done : closing)
+    {
+        done.get();
+    }
+    blockedSeconds += waitTime.Seconds();
+    return wallTime.Seconds();
+}
+
+BenchmarkResult RunRotatingClose(const BenchmarkOptions& options, const std::string& name)
+{
+    double syncBlocked, asyncBlocked;
+    const double syncWall = WriteRotation(options, name, false, syncBlocked);
+    const double asyncWall = WriteRotation(options, name, true, asyncBlocked);
+
+    BenchmarkResult result;
+    result.rows = options.rows;
+    result.cells = options.rows * 3;
+    result.insertSeconds = asyncWall - asyncBlocked;
+    result.closeSeconds = asyncBlocked;
+    result.extra.push_back(std::make_pair("sync_wall_seconds", syncWall));
+    result.extra.push_back(std::make_pair("sync_close_seconds", syncBlocked));
+    result.extra.push_back(std::make_pair("async_wall_seconds", asyncWall));
+    result.extra.push_back(std::make_pair("recovered_seconds", syncWall - asyncWall));
+    result.extra.push_back(std::make_pair("recovered_fraction", syncWall > 0 ? (syncWall - asyncWall) / syncWall : 0));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Staged Output Benchmarks
+//------------------------------------------------------------------------------
+//  Writes an extract straight to the output directory, or builds it in the
+//  staging directory through StagedOutput and publishes it there. Without
+//  --staging the staging directory is the output directory, which measures
+//  the cost of the reservation, syncs and rename alone.
+const off_t STAGED_BYTES_PER_ROW = 32;
+
+BenchmarkResult RunStagedOutput(const BenchmarkOptions& options, const std::string& name, bool staged)
+{
+    const std::wstring destination = ExtractPath(options, name);
+    const std::string stagingDir = options.stagingDir.empty() ? options.outputDir : options.stagingDir;
+    std::unique_ptr<StagedOutput> output(staged ? new StagedOutput(destination, std::wstring(stagingDir.begin(), stagingDir.end()), options.rows * STAGED_BYTES_PER_ROW) : nullptr);
+
+    BenchmarkResult result;
+    Extract extract(output ? output->GetStagingPath() : destination);
+    TableDefinition schema;
+    schema.AddColumn(L"Id", Type_Integer);
+    schema.AddColumn(L"Amount", Type_Double);
+    schema.AddColumn(L"Label", Type_CharString);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    Row row(schema);
+
+    Stopwatch insertTime;
+    for (long i = 0; i < options.rows; ++i)
+    {
+        row.SetLongInteger(0, i);
+        row.SetDouble(1, i * 0.25);
+        row.SetCharString(2, i % 2 ? "odd" : "even");
+        table->Insert(row);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    if (output)
+    {
+        output->Publish(extract);
+    }
+    else
+    {
+        extract.Close();
+    }
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * 3;
+    if (output)
+    {
+        result.extra.push_back(std::make_pair("renamed", output->WasRenamed() ? 1.0 : 0.0));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Mixed Job Benchmarks
+//------------------------------------------------------------------------------
+//  Writes MIXED_SMALL_JOBS extracts of 100 rows, like Utils.writeHyperFile in
+//  the Java tests, followed by MIXED_LARGE_JOBS extracts that share the
+//  remaining rows. The baseline runs one task per extract in that order on a
+//  fixed thread pool; the other runs them through RunExtractJobs on a
+//  WorkStealingScheduler. Both use one thread per hardware thread.
+const int MIXED_SMALL_JOBS = 1000;
+const long MIXED_SMALL_ROWS = 100;
+const int MIXED_LARGE_JOBS = 4;
+
+BenchmarkResult RunMixedJobs(const BenchmarkOptions& options, const std::string& name, bool stealing)
+{
+    std::vector<ColumnSpec> columns;
+    columns.push_back(ColumnSpec(L"col", Type_UnicodeString));
+    columns.push_back(ColumnSpec(L"n", Type_Integer));
+    const long largeRows = std::max(0L, options.rows - MIXED_SMALL_JOBS * MIXED_SMALL_ROWS) / MIXED_LARGE_JOBS;
+
+    std::vector<ExtractJob> jobs;
+    for (int j = 0; j < MIXED_SMALL_JOBS + MIXED_LARGE_JOBS; ++j)
+    {
+        ExtractJob job;
+        job.path = ExtractPath(options, name + "-" + std::to_string(j));
+        job.rows = j < MIXED_SMALL_JOBS ? MIXED_SMALL_ROWS : largeRows;
+        job.fill = [](Row& row, long i) {
+            row.SetString(0, L"My string " + std::to_wstring(i));
+            row.SetLongInteger(1, i);
+        };
+        jobs.push_back(job);
+    }
+
+    BenchmarkResult result;
+    const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    Stopwatch insertTime;
+    if (stealing)
+    {
+        WorkStealingScheduler scheduler(workers);
+        RunExtractJobs(scheduler, L"Extract", columns, jobs);
+        result.extra.push_back(std::make_pair("steals", double(scheduler.GetStealCount())));
+    }
+    else
+    {
+        ThreadPool pool(workers);
+        std::vector<std::future<void>> done;
+        for (const ExtractJob& job : jobs)
+        {
+            done.push_back(pool.Submit([&job, &columns]() {
+                TableDefinition schema;
+                AddColumns(schema, columns);
+                Row row(schema);
+                Extract extract(job.path);
+                std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+                for (long i = 0; i < job.rows; ++i)
+                {
+                    job.fill(row, i);
+                    table->Insert(row);
+                }
+                extract.Close();
+            }));
+        }
+        for (std::future<void>& d : done)
+        {
+            d.get();
+        }
+    }
+    result.insertSeconds = insertTime.Seconds();
+    result.rows = MIXED_SMALL_JOBS * MIXED_SMALL_ROWS + MIXED_LARGE_JOBS * largeRows;
+    result.cells = result.rows * 2;
+    result.extra.push_back(std::make_pair("workers", double(workers)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Synthetic Data Benchmarks
+//------------------------------------------------------------------------------
+//  Generates order rows with the seeded DataGenerator on all hardware threads,
+//  either discarding them, which shows the generator's own rate, or inserting
+//  them on the main thread.
+std::vector<ColumnSpec> SyntheticColumns()
+{
+    std::vector<ColumnSpec> columns;
+    columns.push_back(ColumnSpec(L"Purchased", Type_DateTime));
+    columns.push_back(ColumnSpec(L"Customer", Type_UnicodeString));
+    columns.push_back(ColumnSpec(L"Product", Type_CharString));
+    columns.push_back(ColumnSpec(L"Amount", Type_Double));
+    columns.push_back(ColumnSpec(L"Quantity", Type_Integer));
+    columns.push_back(ColumnSpec(L"Returned", Type_Boolean));
+    columns.push_back(ColumnSpec(L"Ship Date", Type_Date));
+    return columns;
+}
+
+DataGenerator SyntheticGenerator(const std::vector<ColumnSpec>& columns)
+{
+    DataGenerator generator(columns, 42);
+    ColumnProfile customer;
+    customer.cardinality = 100000;
+    customer.zipfSkew = 1.0;
+    customer.unicodeRatio = 0.2;
+    generator.SetProfile(1, customer);
+    ColumnProfile product;
+    product.cardinality = 500;
+    product.zipfSkew = 1.2;
+    generator.SetProfile(2, product);
+    ColumnProfile quantity;
+    quantity.minValue = 1;
+    quantity.maxValue = 20;
+    generator.SetProfile(4, quantity);
+    ColumnProfile returned;
+    returned.nullRatio = 0.1;
+    generator.SetProfile(5, returned);
+    return generator;
+}
+
+BenchmarkResult RunSynthetic(const BenchmarkOptions& options, const std::string& name, bool insert)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    BenchmarkResult result;
+    std::unique_ptr<Extract> extract(insert ? new Extract(ExtractPath(options, name)) : nullptr);
+    TableDefinition schema;
+    AddColumns(schema, columns);
+    std::shared_ptr<Table> table = extract ? extract->AddTable(L"Extract", schema) : nullptr;
+    Row row(schema);
+
+    Stopwatch insertTime;
+    GenerateParallel(generator, static_cast<uint64_t>(options.rows), threads, 4096, [&](std::vector<ValueRow>& batch) {
+        if (table)
+        {
+            for (const ValueRow& values : batch)
+            {
+                for (size_t c = 0; c < values.size(); ++c)
+                {
+                    values[c].SetInRow(row, static_cast<int>(c));
+                }
+                table->Insert(row);
+            }
+        }
+        result.rows += static_cast<long>(batch.size());
+    });
+    result.insertSeconds = insertTime.Seconds();
+
+    if (extract)
+    {
+        Stopwatch closeTime;
+        extract->Close();
+        result.closeSeconds = closeTime.Seconds();
+    }
+    result.cells = result.rows * static_cast<long>(columns.size());
+    result.extra.push_back(std::make_pair("threads", double(threads)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Schema File Benchmarks
+//------------------------------------------------------------------------------
+//  Loads the synthetic order rows from FEED_FILES CSV files, written untimed
+//  beforehand. The plan variant goes through a FeedLoader and the conversion
+//  plan compiled from FEED_SCHEMA; the interpreted variant does what generic
+//  loaders do, looking up every field by name and switching on the column
+//  type for every cell.
+const int FEED_FILES = 8;
+
+const char* const FEED_SCHEMA =
+    "table Orders\n"
+    "null \"\" NULL\n"
+    "column Purchased DateTime source=purchased\n"
+    "column Customer UnicodeString collation=en_US_CI source=customer\n"
+    "column Product CharString source=product\n"
+    "column Amount Double source=amount\n"
+    "column Quantity Integer source=quantity\n"
+    "column Returned Boolean source=returned\n"
+    "column \"Ship Date\" Date source=ship_date\n";
+
+void AppendUtf8(std::string& out, const std::wstring& value)
+{
+    for (wchar_t c : value)
+    {
+        const unsigned int u = static_cast<unsigned int>(c);
+        if (u < 0x80)
+        {
+            out.push_back(static_cast<char>(u));
+        }
+        else if (u < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (u >> 6)));
+            out.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+        }
+        else if (u < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (u >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (u >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((u >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (u & 0x3F)));
+        }
+    }
+}
+
+void AppendCsvField(std::string& out, const Value& value)
+{
+    char buffer[64];
+    int year, month, day, hour, min, sec, frac;
+    if (value.IsNull())
+    {
+        return;
+    }
+    switch (value.GetType())
+    {
+        case Type_DateTime:
+            value.GetDateTime(year, month, day, hour, min, sec, frac);
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d.%04d", year, month, day, hour, min, sec, frac);
+            out += buffer;
+            break;
+        case Type_Date:
+            value.GetDate(year, month, day);
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+            out += buffer;
+            break;
+        case Type_Double:
+            std::snprintf(buffer, sizeof(buffer), "%.17g", value.GetDouble());
+            out += buffer;
+            break;
+        case Type_Boolean:
+            out += value.GetBoolean() ? "true" : "false";
+            break;
+        case Type_UnicodeString:
+        case Type_CharString:
+        {
+            std::string text;
+            if (value.GetType() == Type_UnicodeString)
+            {
+                AppendUtf8(text, value.GetString());
+            }
+            else
+            {
+                text = value.GetCharString();
+            }
+            out.push_back('"');
+            for (char c : text)
+            {
+                out.append(c == '"' ? 2 : 1, c);
+            }
+            out.push_back('"');
+            break;
+        }
+        default:
+            out += std::to_string(value.GetInteger());
+            break;
+    }
+}
+
+std::vector<std::string> WriteFeedFiles(const BenchmarkOptions& options, const std::string& name)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    std::vector<std::string> paths;
+    std::vector<ValueRow> batch;
+    std::string text;
+    for (int f = 0; f < FEED_FILES; ++f)
+    {
+        paths.push_back(options.outputDir + "/bench-" + name + "-" + std::to_string(f) + ".csv");
+        FILE* file = std::fopen(paths.back().c_str(), "w");
+        if (!file)
+        {
+            throw TableauException(errno, L"Could not write the benchmark input");
+        }
+        std::fputs("purchased,customer,product,amount,quantity,returned,ship_date\n", file);
+        const long first = options.rows * f / FEED_FILES;
+        const long last = options.rows * (f + 1) / FEED_FILES;
+        for (long r = first; r < last; r += 4096)
+        {
+            generator.Generate(static_cast<uint64_t>(r), static_cast<size_t>(std::min(4096L, last - r)), batch);
+            text.clear();
+            for (const ValueRow& values : batch)
+            {
+                for (size_t c = 0; c < values.size(); ++c)
+                {
+                    if (c > 0)
+                    {
+                        text.push_back(',');
+                    }
+                    AppendCsvField(text, values[c]);
+                }
+                text.push_back('\n');
+            }
+            std::fwrite(text.data(), 1, text.size(), file);
+        }
+        std::fclose(file);
+    }
+    return paths;
+}
+
+//  Sets one cell the way a loader without a compiled plan does.
+bool SetInterpretedCell(Row& row, int column, Type type, const std::string& text)
+{
+    int year, month, day, hour = 0, min = 0, sec = 0, frac = 0;
+    try
+    {
+        switch (type)
+        {
+            case Type_Integer:
+                row.SetLongInteger(column, std::stoll(text));
+                return true;
+            case Type_Double:
+                row.SetDouble(column, std::stod(text));
+                return true;
+            case Type_Boolean:
+                row.SetBoolean(column, text == "true" || text == "1");
+                return true;
+            case Type_Date:
+                if (std::sscanf(text.c_str(), "%d-%d-%d", &year, &month, &day) != 3)
+                {
+                    return false;
+                }
+                row.SetDate(column, year, month, day);
+                return true;
+            case Type_DateTime:
+                if (std::sscanf(text.c_str(), "%d-%d-%d %d:%d:%d.%d", &year, &month, &day, &hour, &min, &sec, &frac) < 3)
+                {
+                    return false;
+                }
+                row.SetDateTime(column, year, month, day, hour, min, sec, frac);
+                return true;
+            case Type_UnicodeString:
+            {
+                std::wstring wide;
+                const char* pos = text.data();
+                const char* end = pos + text.size();
+                while (pos < end)
+                {
+                    wide.push_back(static_cast<wchar_t>(DecodeUtf8(pos, end)));
+                }
+                row.SetString(column, wide);
+                return true;
+            }
+            default:
+                row.SetCharString(column, text);
+                return true;
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        return false;
+    }
+}
+
+BenchmarkResult RunSchemaFeed(const BenchmarkOptions& options, const std::string& name, bool plan)
+{
+    const std::vector<std::string> inputs = WriteFeedFiles(options, name);
+    const SchemaFile schema = SchemaFile::Parse(FEED_SCHEMA, "FEED_SCHEMA");
+    const std::vector<SchemaField>& fields = schema.GetFields();
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition tableDefinition;
+    AddColumns(tableDefinition, schema.GetColumns());
+    std::shared_ptr<Table> table = extract.AddTable(schema.GetTableName(), tableDefinition);
+    PlanCache cache;
+    long rejected = 0;
+
+    Stopwatch insertTime;
+    for (const std::string& input : inputs)
+    {
+        if (plan)
+        {
+            const LoadStats stats = FeedLoader(schema, cache).Load(input, *table, tableDefinition);
+            result.rows += static_cast<long>(stats.rows);
+            rejected += static_cast<long>(stats.rejected);
+            continue;
+        }
+
+        DelimitedReader reader(input, schema.GetDelimiter());
+        std::vector<FieldView> record;
+        std::map<std::string, size_t> header;
+        reader.Next(record);
+        for (size_t i = 0; i < record.size(); ++i)
+        {
+            header[std::string(record[i].begin, record[i].end)] = i;
+        }
+        Row row(tableDefinition);
+        while (reader.Next(record))
+        {
+            bool valid = true;
+            for (size_t c = 0; c < fields.size() && valid; ++c)
+            {
+                const size_t index = header.at(fields[c].source);
+                if (index >= record.size())
+                {
+                    valid = false;
+                    break;
+                }
+                const std::string text(record[index].begin, record[index].end);
+                if (std::find(fields[c].nullTokens.begin(), fields[c].nullTokens.end(), text) != fields[c].nullTokens.end())
+                {
+                    row.SetNull(static_cast<int>(c));
+                }
+                else
+                {
+                    valid = SetInterpretedCell(row, static_cast<int>(c), fields[c].column.type, text);
+                }
+            }
+            if (valid)
+            {
+                table->Insert(row);
+                ++result.rows;
+            }
+            else
+            {
+                ++rejected;
+            }
+        }
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    for (const std::string& input : inputs)
+    {
+        std::remove(input.c_str());
+    }
+    result.cells = result.rows * static_cast<long>(fields.size());
+    result.extra.push_back(std::make_pair("rejected", double(rejected)));
+    result.extra.push_back(std::make_pair("plan_builds", double(cache.GetBuildCount())));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Deadline Benchmark
+//------------------------------------------------------------------------------
+//  Loads the FEED_FILES CSV files into one extract each through a FeedLoader
+//  whose cancellation token expires halfway through, judged by how long the
+//  first file took. Reports how many extracts were finished and how many were
+//  started but discarded, and how long the load overran its deadline, i.e. how
+//  promptly it stopped.
+BenchmarkResult RunDeadlineFeed(const BenchmarkOptions& options, const std::string& name)
+{
+    const std::vector<std::string> inputs = WriteFeedFiles(options, name);
+    const SchemaFile schema = SchemaFile::Parse(FEED_SCHEMA, "FEED_SCHEMA");
+    CancellationToken token;
+    long finished = 0;
+    long discarded = 0;
+
+    BenchmarkResult result;
+    Stopwatch insertTime;
+    CancellationToken::Clock::time_point deadline;
+    for (size_t f = 0; f < inputs.size(); ++f)
+    {
+        const LoadStats stats = FeedLoader(schema).Load(inputs[f], ExtractPath(options, name + "-" + std::to_string(f)), token);
+        result.rows += static_cast<long>(stats.rows);
+        finished += stats.cancelled ? 0 : 1;
+        discarded += stats.discarded ? 1 : 0;
+        if (f == 0)
+        {
+            const double perFile = insertTime.Seconds();
+            deadline = CancellationToken::Clock::now() + std::chrono::duration_cast<CancellationToken::Clock::duration>(
+                                                             std::chrono::duration<double>(perFile * (inputs.size() / 2.0 - 1)));
+            token.SetDeadline(deadline);
+        }
+    }
+    result.insertSeconds = insertTime.Seconds();
+    const double overrun = std::chrono::duration<double>(CancellationToken::Clock::now() - deadline).count();
+
+    for (const std::string& input : inputs)
+    {
+        std::remove(input.c_str());
+    }
+    result.cells = result.rows * static_cast<long>(schema.GetColumns().size());
+    result.extra.push_back(std::make_pair("finished", double(finished)));
+    result.extra.push_back(std::make_pair("discarded", double(discarded)));
+    result.extra.push_back(std::make_pair("overrun_seconds", std::max(0.0, overrun)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Struct Binding Benchmarks
+//------------------------------------------------------------------------------
+//  Inserts prepared OrderRecord structs, once through a runtime mapping of
+//  column names to accessors that fills a ValueRow and sets it cell by cell,
+//  and once through the RowInserter generated by TABLEAU_ROW.
+struct OrderRecord
+{
+    DateTimeParts purchased;
+    std::string product;
+    double price;
+    int quantity;
+    bool returned;
+    DateParts shipped;
+};
+
+TABLEAU_ROW(OrderRecord, purchased, product, price, quantity, returned, shipped)
+
+std::vector<OrderRecord> MakeOrderRecords(long rows)
+{
+    std::vector<OrderRecord> orders(static_cast<size_t>(rows));
+    for (long i = 0; i < rows; ++i)
+    {
+        OrderRecord& order = orders[static_cast<size_t>(i)];
+        order.purchased = {2000 + static_cast<int>(i % 20), 1 + static_cast<int>(i % 12), 1 + static_cast<int>(i % 28),
+                           static_cast<int>(i % 24), static_cast<int>(i % 60), static_cast<int>(i % 59), 0};
+        order.product = "product-" + std::to_string(i % 500);
+        order.price = (i % 100000) / 100.0;
+        order.quantity = 1 + static_cast<int>(i % 20);
+        order.returned = i % 10 == 0;
+        order.shipped = {2000 + static_cast<int>(i % 20), 1 + static_cast<int>(i % 12), 1 + static_cast<int>(i % 28)};
+    }
+    return orders;
+}
+
+BenchmarkResult RunStructBinding(const BenchmarkOptions& options, const std::string& name, bool binding)
+{
+    const std::vector<OrderRecord> orders = MakeOrderRecords(options.rows);
+    const std::vector<ColumnSpec> columns = RowColumns<OrderRecord>();
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    AddColumns(schema, columns);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+
+    Stopwatch insertTime;
+    if (binding)
+    {
+        RowInserter<OrderRecord> inserter(*table, schema);
+        inserter.InsertRange(orders.data(), orders.size());
+    }
+    else
+    {
+        typedef std::function<void(const OrderRecord&, Value&)> Accessor;
+        std::map<std::wstring, Accessor> accessors;
+        accessors[L"purchased"] = [](const OrderRecord& o, Value& v) {
+            v.SetDateTime(o.purchased.year, o.purchased.month, o.purchased.day, o.purchased.hour,
+                          o.purchased.min, o.purchased.sec, o.purchased.frac);
+        };
+        accessors[L"product"] = [](const OrderRecord& o, Value& v) { v.SetCharString(o.product); };
+        accessors[L"price"] = [](const OrderRecord& o, Value& v) { v.SetDouble(o.price); };
+        accessors[L"quantity"] = [](const OrderRecord& o, Value& v) { v.SetInteger(o.quantity); };
+        accessors[L"returned"] = [](const OrderRecord& o, Value& v) { v.SetBoolean(o.returned); };
+        accessors[L"shipped"] = [](const OrderRecord& o, Value& v) { v.SetDate(o.shipped.year, o.shipped.month, o.shipped.day); };
+
+        Row row(schema);
+        ValueRow values(columns.size());
+        for (const OrderRecord& order : orders)
+        {
+            for (size_t c = 0; c < columns.size(); ++c)
+            {
+                accessors.at(columns[c].name)(order, values[c]);
+                values[c].SetInRow(row, static_cast<int>(c));
+            }
+            table->Insert(row);
+        }
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * static_cast<long>(columns.size());
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Range Insert Benchmarks
+//------------------------------------------------------------------------------
+//  Inserts prepared records of UTF-8 text, date text and spatial WKT through
+//  Table::Insert(first, last, projection), converting on the calling thread
+//  only or on all hardware threads while the calling thread inserts.
+struct TextRecord
+{
+    std::string customer;
+    std::string purchased;
+    std::string location;
+    double amount;
+    long quantity;
+};
+
+BenchmarkResult RunRangeInsert(const BenchmarkOptions& options, const std::string& name, bool parallel)
+{
+    std::vector<TextRecord> records(static_cast<size_t>(options.rows));
+    for (long i = 0; i < options.rows; ++i)
+    {
+        TextRecord& record = records[static_cast<size_t>(i)];
+        char text[64];
+        record.customer = "Kunde M\xc3\xbcller-" + std::to_string(i % 100000);
+        std::snprintf(text, sizeof(text), "%04ld-%02ld-%02ld %02ld:%02ld:%02ld.%04ld",
+                      2000 + i % 20, 1 + i % 12, 1 + i % 28, i % 24, i % 60, i % 59, i % 10000);
+        record.purchased = text;
+        std::snprintf(text, sizeof(text), "POINT(%.4f %.4f)", (i % 36000) / 100.0 - 180, (i % 18000) / 100.0 - 90);
+        record.location = text;
+        record.amount = (i % 100000) / 100.0;
+        record.quantity = 1 + i % 20;
+    }
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    schema.AddColumn(L"Customer", Type_UnicodeString);
+    schema.AddColumn(L"Purchased", Type_DateTime);
+    schema.AddColumn(L"Location", Type_Spatial);
+    schema.AddColumn(L"Amount", Type_Double);
+    schema.AddColumn(L"Quantity", Type_Integer);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+
+    RangeInsertOptions insertOptions;
+    if (!parallel)
+    {
+        insertOptions.threads = 1;
+    }
+    Stopwatch insertTime;
+    InsertRange(*table, records.begin(), records.end(), [](const TextRecord& r) {
+        return std::tie(r.customer, r.purchased, r.location, r.amount, r.quantity);
+    }, insertOptions);
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * 5;
+    result.extra.push_back(std::make_pair("threads", double(insertOptions.threads)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Coroutine Writer Benchmarks
+//------------------------------------------------------------------------------
+//  FEED_CONNECTIONS feeds each write their share of the synthetic rows into
+//  their own extract in batches of FEED_BATCH_ROWS rows, all driven by one
+//  event loop thread. The blocking variant inserts and closes on the loop
+//  thread; the coroutine variant hands the batches to an AsyncExtractWriter
+//  on FEED_SDK_THREADS executor threads, which post the feeds back to the
+//  loop when they had to wait for room in the queue.
+//  Needs C++20 coroutines (make build-bench BENCHSTD=c++20).
+const int FEED_CONNECTIONS = 64;
+const long FEED_BATCH_ROWS = 1000;
+const size_t FEED_SDK_THREADS = 2;
+
+#ifdef __cpp_impl_coroutine
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return DetachedTask(); }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class EventLoop
+{
+  public:
+    void Post(std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready.push_back(handle);
+        }
+        m_wake.notify_one();
+    }
+
+    void Finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_finished;
+    }
+
+    void Run(int feeds)
+    {
+        for (;;)
+        {
+            std::coroutine_handle<> handle;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return !m_ready.empty(); });
+                if (m_ready.empty())
+                {
+                    if (m_finished == feeds)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                handle = m_ready.front();
+                m_ready.pop_front();
+            }
+            handle.resume();
+        }
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::coroutine_handle<>> m_ready;
+    int m_finished = 0;
+};
+
+DetachedTask RunFeed(EventLoop& loop, SdkExecutor& executor, const BenchmarkOptions& options, const std::string& name,
+                     const DataGenerator& generator, const std::vector<ColumnSpec>& columns, int feed)
+{
+    AsyncExtractWriter writer(executor, ExtractPath(options, name + "-" + std::to_string(feed)), L"Extract", columns);
+    const long first = options.rows * feed / FEED_CONNECTIONS;
+    const long last = options.rows * (feed + 1) / FEED_CONNECTIONS;
+    for (long r = first; r < last; r += FEED_BATCH_ROWS)
+    {
+        std::vector<ValueRow> batch;
+        generator.Generate(static_cast<uint64_t>(r), static_cast<size_t>(std::min(FEED_BATCH_ROWS, last - r)), batch);
+        co_await writer.InsertBatch(std::move(batch));
+    }
+    co_await writer.Close();
+    loop.Finish();
+}
+#endif
+
+BenchmarkResult RunFeedConnections(const BenchmarkOptions& options, const std::string& name, bool coroutines)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    BenchmarkResult result;
+
+    Stopwatch insertTime;
+    if (coroutines)
+    {
+#ifdef __cpp_impl_coroutine
+        EventLoop loop;
+        SdkExecutor executor(FEED_SDK_THREADS, 8, [&loop](std::coroutine_handle<> handle) { loop.Post(handle); });
+        // The feeds run on this thread up to their first suspension, then on the loop.
+        for (int feed = 0; feed < FEED_CONNECTIONS; ++feed)
+        {
+            RunFeed(loop, executor, options, name, generator, columns, feed);
+        }
+        loop.Run(FEED_CONNECTIONS);
+        result.extra.push_back(std::make_pair("suspensions", double(executor.GetSuspendCount())));
+#endif
+    }
+    else
+    {
+        TableDefinition schema;
+        AddColumns(schema, columns);
+        Row row(schema);
+        std::vector<std::unique_ptr<Extract>> extracts;
+        std::vector<std::shared_ptr<Table>> tables;
+        for (int feed = 0; feed < FEED_CONNECTIONS; ++feed)
+        {
+            extracts.emplace_back(new Extract(ExtractPath(options, name + "-" + std::to_string(feed))));
+            tables.push_back(extracts.back()->AddTable(L"Extract", schema));
+        }
+        // Round robin over the feeds, as an event loop serving them would.
+        std::vector<ValueRow> batch;
+        for (long offset = 0; offset < options.rows / FEED_CONNECTIONS + FEED_BATCH_ROWS; offset += FEED_BATCH_ROWS)
+        {
+            for (int feed = 0; feed < FEED_CONNECTIONS; ++feed)
+            {
+                const long first = options.rows * feed / FEED_CONNECTIONS;
+                const long last = options.rows * (feed + 1) / FEED_CONNECTIONS;
+                if (first + offset >= last)
+                {
+                    continue;
+                }
+                generator.Generate(static_cast<uint64_t>(first + offset),
+                                   static_cast<size_t>(std::min(FEED_BATCH_ROWS, last - first - offset)), batch);
+                for (const ValueRow& values : batch)
+                {
+                    for (size_t c = 0; c < values.size(); ++c)
+                    {
+                        values[c].SetInRow(row, static_cast<int>(c));
+                    }
+                    tables[feed]->Insert(row);
+                }
+            }
+        }
+        tables.clear();
+        for (std::unique_ptr<Extract>& extract : extracts)
+        {
+            extract->Close();
+        }
+    }
+    result.insertSeconds = insertTime.Seconds();
+    result.rows = options.rows;
+    result.cells = options.rows * static_cast<long>(columns.size());
+    result.extra.push_back(std::make_pair("feeds", double(FEED_CONNECTIONS)));
+    result.extra.push_back(std::make_pair("sdk_threads", double(coroutines ? FEED_SDK_THREADS : 0)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Star Schema Benchmarks
+//------------------------------------------------------------------------------
+//  Loads denormalized order rows: the synthetic rows widened with the category
+//  and supplier of each product and the city and segment of each customer.
+//  The wide variant inserts them as they are; the star variant splits them
+//  through a StarSchemaLoader into Products and Customers dimensions and an
+//  Orders fact table, resolving keys on all hardware threads.
+const char* const STAR_CATEGORIES[] = {"Beverages", "Bakery", "Dairy", "Produce", "Frozen", "Snacks", "Household", "Pet Care"};
+const char* const STAR_SEGMENTS[] = {"Consumer", "Corporate", "Home Office", "Small Business"};
+
+std::vector<ColumnSpec> StarInputColumns()
+{
+    std::vector<ColumnSpec> columns;
+    columns.push_back(ColumnSpec(L"Purchased", Type_DateTime));
+    columns.push_back(ColumnSpec(L"Customer", Type_UnicodeString));
+    columns.push_back(ColumnSpec(L"City", Type_UnicodeString));
+    columns.push_back(ColumnSpec(L"Segment", Type_CharString));
+    columns.push_back(ColumnSpec(L"Product", Type_CharString));
+    columns.push_back(ColumnSpec(L"Category", Type_CharString));
+    columns.push_back(ColumnSpec(L"Supplier", Type_CharString));
+    columns.push_back(ColumnSpec(L"Amount", Type_Double));
+    columns.push_back(ColumnSpec(L"Quantity", Type_Integer));
+    columns.push_back(ColumnSpec(L"Returned", Type_Boolean));
+    columns.push_back(ColumnSpec(L"Ship Date", Type_Date));
+    return columns;
+}
+
+//  Widens a synthetic row; the added attributes depend only on the product or
+//  the customer, as they would in a denormalized export.
+void WidenOrder(const ValueRow& order, ValueRow& wide)
+{
+    const std::wstring& customer = order[1].GetString();
+    const std::string& product = order[2].GetCharString();
+    const uint64_t customerHash = HashBytes(reinterpret_cast<const char*>(customer.data()), customer.size() * sizeof(wchar_t));
+    const uint64_t productHash = HashBytes(product.data(), product.size());
+
+    wide.resize(11);
+    wide[0] = order[0];
+    wide[1] = order[1];
+    wide[2].SetString(L"City " + std::to_wstring(customerHash % 400));
+    wide[3].SetCharString(STAR_SEGMENTS[(customerHash >> 16) % 4]);
+    wide[4] = order[2];
+    wide[5].SetCharString(STAR_CATEGORIES[(productHash >> 16) % 8]);
+    wide[6].SetCharString("Supplier " + std::to_string(productHash % 60));
+    for (int c = 3; c < 7; ++c)
+    {
+        wide[c + 4] = order[c];
+    }
+}
+
+BenchmarkResult RunStarSchema(const BenchmarkOptions& options, const std::string& name, bool star)
+{
+    const std::vector<ColumnSpec> orderColumns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(orderColumns);
+    const std::vector<ColumnSpec> columns = StarInputColumns();
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    AddColumns(schema, columns);
+    std::shared_ptr<Table> table = star ? nullptr : extract.AddTable(L"Extract", schema);
+    Row row(schema);
+    std::vector<DimensionSpec> dimensions;
+    dimensions.push_back(DimensionSpec(L"Customers", L"CustomerKey", {1, 2, 3}));
+    dimensions.push_back(DimensionSpec(L"Products", L"ProductKey", {4, 5, 6}));
+    std::unique_ptr<StarSchemaLoader> loader(star ? new StarSchemaLoader(extract, L"Orders", columns, dimensions, threads) : nullptr);
+
+    Stopwatch insertTime;
+    std::vector<ValueRow> wide;
+    GenerateParallel(generator, static_cast<uint64_t>(options.rows), threads, 4096, [&](std::vector<ValueRow>& batch) {
+        wide.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            WidenOrder(batch[i], wide[i]);
+        }
+        if (loader)
+        {
+            loader->WriteBatch(wide);
+        }
+        else
+        {
+            for (const ValueRow& values : wide)
+            {
+                for (size_t c = 0; c < values.size(); ++c)
+                {
+                    values[c].SetInRow(row, static_cast<int>(c));
+                }
+                table->Insert(row);
+            }
+        }
+        result.rows += static_cast<long>(batch.size());
+    });
+    result.insertSeconds = insertTime.Seconds();
+
+    if (loader)
+    {
+        result.cells = result.rows * static_cast<long>(loader->GetFactColumns().size());
+        for (size_t d = 0; d < dimensions.size(); ++d)
+        {
+            result.cells += static_cast<long>(loader->GetDimensionRowCount(d) * loader->GetDimensionColumns(d).size());
+        }
+        result.extra.push_back(std::make_pair("customers", double(loader->GetDimensionRowCount(0))));
+        result.extra.push_back(std::make_pair("products", double(loader->GetDimensionRowCount(1))));
+    }
+    else
+    {
+        result.cells = result.rows * static_cast<long>(columns.size());
+    }
+    loader.reset();
+    table.reset();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.extra.push_back(std::make_pair("threads", double(star ? threads : 1)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Progress Benchmarks
+//------------------------------------------------------------------------------
+//  Inserts the synthetic order rows like generated_insert, once unobserved and
+//  once with a ProgressMonitor sampling the extract every PROGRESS_INTERVAL
+//  seconds on its own thread, far more often than an orchestrator would. The
+//  per-row counters are maintained in both variants; compare generated_insert
+//  against a baseline from before they existed to see their cost.
+const double PROGRESS_INTERVAL = 0.01;
+
+BenchmarkResult RunProgress(const BenchmarkOptions& options, const std::string& name, bool monitored)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    AddColumns(schema, columns);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    table->GetProgressCounters().AddExpected(static_cast<uint64_t>(options.rows), 0);
+    Row row(schema);
+
+    ProgressOptions progressOptions;
+    progressOptions.intervalSeconds = PROGRESS_INTERVAL;
+    progressOptions.shortWindowSeconds = 1;
+    progressOptions.longWindowSeconds = 10;
+    ProgressMonitor monitor(extract, progressOptions);
+    long samples = 0;
+    double peakRowsPerSecond = 0;
+    if (monitored)
+    {
+        monitor.Start([&](const ProgressSnapshot& snapshot) {
+            ++samples;
+            peakRowsPerSecond = std::max(peakRowsPerSecond, snapshot.rowsPerSecond);
+        });
+    }
+
+    Stopwatch insertTime;
+    GenerateParallel(generator, static_cast<uint64_t>(options.rows), threads, 4096, [&](std::vector<ValueRow>& batch) {
+        for (const ValueRow& values : batch)
+        {
+            for (size_t c = 0; c < values.size(); ++c)
+            {
+                values[c].SetInRow(row, static_cast<int>(c));
+            }
+            table->Insert(row);
+        }
+    });
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    monitor.Stop();
+
+    const ProgressSnapshot last = monitor.Sample();
+    result.rows = static_cast<long>(last.progress.rows);
+    result.cells = result.rows * static_cast<long>(columns.size());
+    result.extra.push_back(std::make_pair("samples", double(samples)));
+    result.extra.push_back(std::make_pair("peak_window_rows_per_sec", peakRowsPerSecond));
+    result.extra.push_back(std::make_pair("fraction_done", last.fractionDone));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Fixed-Width Benchmarks
+//------------------------------------------------------------------------------
+//  Loads the synthetic order rows from one file of FIXED_LAYOUT records,
+//  written untimed beforehand, through a FixedWidthLoader that maps the file
+//  and decodes binary integers, packed decimals and padded text on the
+//  inserting thread only or on all hardware threads.
+const size_t FIXED_RECORD = 97;
+
+const char* const FIXED_LAYOUT =
+    "table Orders\n"
+    "record 97\n"
+    "field Purchased DateTime offset=0 width=8 encoding=binary\n"
+    "field Customer UnicodeString offset=8 width=48 encoding=text collation=en_US_CI\n"
+    "field Product CharString offset=56 width=24 encoding=text\n"
+    "field Amount Double offset=80 width=8 encoding=packed scale=2\n"
+    "field Quantity Integer offset=88 width=2 encoding=binary byteorder=little\n"
+    "field Returned Boolean offset=90 width=1 encoding=text\n"
+    "field \"Ship Date\" Date offset=91 width=5 encoding=packed\n";
+
+//  Writes a packed decimal of 2 * width - 1 digits and a sign nibble.
+void PutPacked(unsigned char* out, size_t width, int64_t value)
+{
+    uint64_t magnitude = static_cast<uint64_t>(value < 0 ? -value : value);
+    out[width - 1] = static_cast<unsigned char>(((magnitude % 10) << 4) | (value < 0 ? 0x0D : 0x0C));
+    magnitude /= 10;
+    for (size_t i = width - 1; i-- > 0;)
+    {
+        out[i] = static_cast<unsigned char>(magnitude % 10 | (magnitude / 10 % 10) << 4);
+        magnitude /= 100;
+    }
+}
+
+//  Copies text padded with spaces, cut at a character boundary.
+void PutText(unsigned char* out, size_t width, const std::string& text)
+{
+    size_t size = std::min(width, text.size());
+    while (size < text.size() && size > 0 && (static_cast<unsigned char>(text[size]) & 0xC0) == 0x80)
+    {
+        --size;
+    }
+    std::memset(out, ' ', width);
+    std::memcpy(out, text.data(), size);
+}
+
+std::string WriteFixedWidthFile(const BenchmarkOptions& options, const std::string& name)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    const std::string path = options.outputDir + "/bench-" + name + ".dat";
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        throw TableauException(errno, L"Could not write the benchmark input");
+    }
+    std::vector<ValueRow> batch;
+    std::vector<unsigned char> records;
+    std::string text;
+    int year, month, day, hour, min, sec, frac;
+    for (long r = 0; r < options.rows; r += 4096)
+    {
+        generator.Generate(static_cast<uint64_t>(r), static_cast<size_t>(std::min(4096L, options.rows - r)), batch);
+        records.assign(batch.size() * FIXED_RECORD, ' ');
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const ValueRow& values = batch[i];
+            unsigned char* record = &records[i * FIXED_RECORD];
+            values[0].GetDateTime(year, month, day, hour, min, sec, frac);
+            uint64_t purchased = ((year * 100ULL + month) * 100 + day) * 1000000 + hour * 10000 + min * 100 + sec;
+            for (int b = 7; b >= 0; --b, purchased >>= 8)
+            {
+                record[b] = static_cast<unsigned char>(purchased);
+            }
+            text.clear();
+            AppendUtf8(text, values[1].GetString());
+            PutText(record + 8, 48, text);
+            PutText(record + 56, 24, values[2].GetCharString());
+            PutPacked(record + 80, 8, std::llround(values[3].GetDouble() * 100));
+            const int64_t quantity = values[4].GetInteger();
+            record[88] = static_cast<unsigned char>(quantity);
+            record[89] = static_cast<unsigned char>(quantity >> 8);
+            record[90] = values[5].IsNull() ? ' ' : values[5].GetBoolean() ? 'Y' : 'N';
+            values[6].GetDate(year, month, day);
+            PutPacked(record + 91, 5, (year * 100 + month) * 100 + day);
+            record[FIXED_RECORD - 1] = '\n';
+        }
+        std::fwrite(records.data(), 1, records.size(), file);
+    }
+    std::fclose(file);
+    return path;
+}
+
+BenchmarkResult RunFixedWidth(const BenchmarkOptions& options, const std::string& name, bool parallel)
+{
+    const std::string input = WriteFixedWidthFile(options, name);
+    const RecordLayout layout = RecordLayout::Parse(FIXED_LAYOUT, "FIXED_LAYOUT");
+    FixedWidthOptions loaderOptions;
+    if (!parallel)
+    {
+        loaderOptions.threads = 1;
+    }
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition tableDefinition;
+    AddColumns(tableDefinition, layout.GetColumns());
+    std::shared_ptr<Table> table = extract.AddTable(layout.GetTableName(), tableDefinition);
+
+    Stopwatch insertTime;
+    const LoadStats stats = FixedWidthLoader(layout, loaderOptions).Load(input, *table, tableDefinition);
+    result.insertSeconds = insertTime.Seconds();
+    result.rows = static_cast<long>(stats.rows);
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    std::remove(input.c_str());
+    result.cells = result.rows * static_cast<long>(layout.GetFields().size());
+    result.extra.push_back(std::make_pair("rejected", double(stats.rejected)));
+    result.extra.push_back(std::make_pair("threads", double(loaderOptions.threads)));
+    result.extra.push_back(std::make_pair("input_mb", stats.bytes / 1048576.0));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  JSON Lines Benchmarks
+//------------------------------------------------------------------------------
+//  Loads the synthetic order rows from one NDJSON file, written untimed
+//  beforehand, through a JsonLinesLoader on all hardware threads. Each object
+//  carries two keys no column reads. The scalar variant finds structural
+//  characters byte by byte, the simd variant 64 bytes at a time with SSE2.
+const char* const JSON_SCHEMA =
+    "table Orders\n"
+    "null \"\" NULL\n"
+    "column Purchased DateTime source=purchased\n"
+    "column Customer UnicodeString collation=en_US_CI source=customer\n"
+    "column Product CharString source=product\n"
+    "column Amount Double source=amount\n"
+    "column Quantity Integer source=quantity\n"
+    "column Returned Boolean source=returned\n"
+    "column \"Ship Date\" Date source=ship_date\n";
+
+const char* const JSON_KEYS[] = {"purchased", "customer", "product", "amount", "quantity", "returned", "ship_date"};
+
+void AppendJsonString(std::string& out, const std::string& text)
+{
+    out.push_back('"');
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+std::string WriteJsonLinesFile(const BenchmarkOptions& options, const std::string& name)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    const DataGenerator generator = SyntheticGenerator(columns);
+    const std::string path = options.outputDir + "/bench-" + name + ".json";
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        throw TableauException(errno, L"Could not write the benchmark input");
+    }
+    std::vector<ValueRow> batch;
+    std::string text;
+    std::string field;
+    for (long r = 0; r < options.rows; r += 4096)
+    {
+        generator.Generate(static_cast<uint64_t>(r), static_cast<size_t>(std::min(4096L, options.rows - r)), batch);
+        text.clear();
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const ValueRow& values = batch[i];
+            text += "{\"order_id\":" + std::to_string(r + static_cast<long>(i)) + ",\"channel\":{\"source\":\"web\",\"tags\":[\"a\",\"b\"]}";
+            for (size_t c = 0; c < values.size(); ++c)
+            {
+                text += ",\"";
+                text += JSON_KEYS[c];
+                text += "\":";
+                field.clear();
+                AppendCsvField(field, values[c]);
+                const Type type = values[c].GetType();
+                if (values[c].IsNull())
+                {
+                    text += "null";
+                }
+                else if (type == Type_Double || type == Type_Integer || type == Type_Boolean)
+                {
+                    text += field;
+                }
+                else if (type == Type_UnicodeString || type == Type_CharString)
+                {
+                    // Strip the CSV quoting again.
+                    std::string unquoted;
+                    for (size_t j = 1; j + 1 < field.size(); ++j)
+                    {
+                        unquoted.push_back(field[j]);
+                        j += field[j] == '"' ? 1 : 0;
+                    }
+                    AppendJsonString(text, unquoted);
+                }
+                else
+                {
+                    AppendJsonString(text, field);
+                }
+            }
+            text += "}\n";
+        }
+        std::fwrite(text.data(), 1, text.size(), file);
+    }
+    std::fclose(file);
+    return path;
+}
+
+BenchmarkResult RunJsonLines(const BenchmarkOptions& options, const std::string& name, bool simd)
+{
+    const std::string input = WriteJsonLinesFile(options, name);
+    const SchemaFile schema = SchemaFile::Parse(JSON_SCHEMA, "JSON_SCHEMA");
+    JsonLinesOptions loaderOptions;
+    loaderOptions.simd = simd;
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition tableDefinition;
+    AddColumns(tableDefinition, schema.GetColumns());
+    std::shared_ptr<Table> table = extract.AddTable(schema.GetTableName(), tableDefinition);
+
+    Stopwatch insertTime;
+    const LoadStats stats = JsonLinesLoader(schema, loaderOptions).Load(input, *table, tableDefinition);
+    result.insertSeconds = insertTime.Seconds();
+    result.rows = static_cast<long>(stats.rows);
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    std::remove(input.c_str());
+    result.cells = result.rows * static_cast<long>(schema.GetFields().size());
+    result.extra.push_back(std::make_pair("rejected", double(stats.rejected)));
+    result.extra.push_back(std::make_pair("threads", double(loaderOptions.threads)));
+    result.extra.push_back(std::make_pair("input_mb", stats.bytes / 1048576.0));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Projection Benchmarks
+//------------------------------------------------------------------------------
+//  Loads PROJECTION_COLUMNS columns out of records of PROJECTION_FIELDS fields, a tenth
+//  of --rows records, written untimed beforehand. Every third field is a
+//  quoted string. The CSV baseline splits and keeps every field, like the
+//  FeedLoader did before projections; the projected variant goes through the
+//  FeedLoader, which hands the plan's projection to the reader. The NDJSON
+//  variants put the mapped keys at the end or at the start of each object;
+//  at the start, the loader skips the rest of the line once it found them.
+const int PROJECTION_FIELDS = 300;
+const int PROJECTION_COLUMNS = 20;
+const long PROJECTION_ROW_DIVISOR = 10;
+
+int ProjectionSourceField(int column)
+{
+    return column * (PROJECTION_FIELDS / PROJECTION_COLUMNS) + column % 3;
+}
+
+std::string ProjectionSchema()
+{
+    const char* const types[] = {"Integer", "CharString", "Double"};
+    std::string schema = "table Wide\n";
+    for (int c = 0; c < PROJECTION_COLUMNS; ++c)
+    {
+        const int field = ProjectionSourceField(c);
+        schema += "column c" + std::to_string(c) + " " + types[field % 3] + " source=f" + std::to_string(field) + "\n";
+    }
+    return schema;
+}
+
+void AppendProjectionValue(std::string& out, long row, int field, char quote)
+{
+    switch (field % 3)
+    {
+        case 0:
+            out += std::to_string((row * 31 + field) % 100000);
+            break;
+        case 1:
+            out.push_back(quote);
+            out += "item " + std::to_string(row) + "-" + std::to_string(field);
+            out.push_back(quote);
+            break;
+        default:
+            out += std::to_string(row + field * 0.125);
+            break;
+    }
+}
+
+std::string WriteProjectionFile(const BenchmarkOptions& options, const std::string& name, bool json, bool mappedFirst)
+{
+    const long rows = std::max(1L, options.rows / PROJECTION_ROW_DIVISOR);
+    const std::string path = options.outputDir + "/bench-" + name + (json ? ".json" : ".csv");
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        throw TableauException(errno, L"Could not write the benchmark input");
+    }
+    std::vector<int> order;
+    for (int f = 0; f < PROJECTION_FIELDS; ++f)
+    {
+        order.push_back(f);
+    }
+    if (mappedFirst)
+    {
+        std::stable_partition(order.begin(), order.end(), [](int f) {
+            return f % (PROJECTION_FIELDS / PROJECTION_COLUMNS) == f / (PROJECTION_FIELDS / PROJECTION_COLUMNS) % 3;
+        });
+    }
+    else if (json)
+    {
+        std::stable_partition(order.begin(), order.end(), [](int f) {
+            return f % (PROJECTION_FIELDS / PROJECTION_COLUMNS) != f / (PROJECTION_FIELDS / PROJECTION_COLUMNS) % 3;
+        });
+    }
+
+    std::string text;
+    if (!json)
+    {
+        for (int f = 0; f < PROJECTION_FIELDS; ++f)
+        {
+            text += (f > 0 ? ",f" : "f") + std::to_string(f);
+        }
+        text.push_back('\n');
+    }
+    for (long r = 0; r < rows; ++r)
+    {
+        if (json)
+        {
+            text.push_back('{');
+        }
+        for (int i = 0; i < PROJECTION_FIELDS; ++i)
+        {
+            if (i > 0)
+            {
+                text.push_back(',');
+            }
+            if (json)
+            {
+                text += "\"f" + std::to_string(order[i]) + "\":";
+            }
+            AppendProjectionValue(text, r, order[i], '"');
+        }
+        text += json ? "}\n" : "\n";
+        if (text.size() > (1 << 20))
+        {
+            std::fwrite(text.data(), 1, text.size(), file);
+            text.clear();
+        }
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+    return path;
+}
+
+BenchmarkResult RunProjection(const BenchmarkOptions& options, const std::string& name, bool json, bool projected)
+{
+    const std::string input = WriteProjectionFile(options, name, json, json && projected);
+    const SchemaFile schema = SchemaFile::Parse(ProjectionSchema(), "ProjectionSchema");
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition tableDefinition;
+    AddColumns(tableDefinition, schema.GetColumns());
+    std::shared_ptr<Table> table = extract.AddTable(schema.GetTableName(), tableDefinition);
+    LoadStats stats;
+
+    Stopwatch insertTime;
+    if (json)
+    {
+        stats = JsonLinesLoader(schema).Load(input, *table, tableDefinition);
+    }
+    else if (projected)
+    {
+        PlanCache cache;
+        stats = FeedLoader(schema, cache).Load(input, *table, tableDefinition);
+    }
+    else
+    {
+        DelimitedReader reader(input, schema.GetDelimiter());
+        std::vector<FieldView> fields;
+        std::vector<std::string> header;
+        reader.Next(fields);
+        for (const FieldView& field : fields)
+        {
+            header.push_back(std::string(field.begin, field.end));
+        }
+        const ConversionPlan plan(schema, header);
+        ConversionScratch scratch;
+        Row row(tableDefinition);
+        while (reader.Next(fields))
+        {
+            if (plan.Apply(row, fields, scratch))
+            {
+                table->Insert(row);
+                ++stats.rows;
+            }
+            else
+            {
+                ++stats.rejected;
+            }
+        }
+        stats.bytes = reader.GetBytesRead();
+    }
+    result.insertSeconds = insertTime.Seconds();
+    result.rows = static_cast<long>(stats.rows);
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    std::remove(input.c_str());
+    result.cells = result.rows * PROJECTION_COLUMNS;
+    result.extra.push_back(std::make_pair("rejected", double(stats.rejected)));
+    result.extra.push_back(std::make_pair("input_fields", double(PROJECTION_FIELDS)));
+    result.extra.push_back(std::make_pair("input_mb", stats.bytes / 1048576.0));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Rollup Benchmarks
+//------------------------------------------------------------------------------
+//  Generates a year of synthetic order rows on all hardware threads and either
+//  inserts every row or rolls them up into hourly totals through an Aggregator
+//  with the configured memory budget, on the inserting thread only or on all
+//  hardware threads. The reported time includes aggregating and inserting the
+//  groups. Use --memory to force spilling.
+const size_t ROLLUP_BATCH_ROWS = 65536;
+
+BenchmarkResult RunRollup(const BenchmarkOptions& options, const std::string& name, size_t aggregationThreads)
+{
+    const std::vector<ColumnSpec> columns = SyntheticColumns();
+    DataGenerator generator = SyntheticGenerator(columns);
+    ColumnProfile purchased;
+    purchased.minYear = 2019;
+    purchased.maxYear = 2019;
+    generator.SetProfile(0, purchased);
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    AggregationOptions aggregationOptions;
+    aggregationOptions.threads = std::max<size_t>(1, aggregationThreads);
+    aggregationOptions.memoryBudget = options.memoryBudget;
+    aggregationOptions.tempDirectory = options.outputDir;
+    std::unique_ptr<Aggregator> aggregator;
+    if (aggregationThreads > 0)
+    {
+        aggregator.reset(new Aggregator(columns,
+            {GroupColumn(0, DateTruncation_Hour, L"Hour")},
+            {AggregateColumn(AggregateFunction_Count, -1, L"Orders"),
+             AggregateColumn(AggregateFunction_Sum, 3, L"Amount"),
+             AggregateColumn(AggregateFunction_Min, 3, L"Min Amount"),
+             AggregateColumn(AggregateFunction_Max, 3, L"Max Amount"),
+             AggregateColumn(AggregateFunction_Sum, 4, L"Quantity")},
+            aggregationOptions));
+    }
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition schema;
+    AddColumns(schema, aggregator ? aggregator->GetOutputColumns() : columns);
+    std::shared_ptr<Table> table = extract.AddTable(L"Extract", schema);
+    Row row(schema);
+    std::vector<ValueRow> pending;
+
+    Stopwatch insertTime;
+    GenerateParallel(generator, static_cast<uint64_t>(options.rows), threads, 4096, [&](std::vector<ValueRow>& batch) {
+        if (aggregator)
+        {
+            std::move(batch.begin(), batch.end(), std::back_inserter(pending));
+            if (pending.size() >= ROLLUP_BATCH_ROWS)
+            {
+                aggregator->AddBatch(pending);
+                pending.clear();
+            }
+        }
+        else
+        {
+            for (const ValueRow& values : batch)
+            {
+                for (size_t c = 0; c < values.size(); ++c)
+                {
+                    values[c].SetInRow(row, static_cast<int>(c));
+                }
+                table->Insert(row);
+            }
+        }
+        result.rows += static_cast<long>(batch.size());
+    });
+    if (aggregator)
+    {
+        aggregator->AddBatch(pending);
+        aggregator->Insert(*table);
+    }
+    result.insertSeconds = insertTime.Seconds();
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    result.cells = result.rows * static_cast<long>(columns.size());
+
+    struct stat file;
+    const std::string path = options.outputDir + "/bench-" + name + ".hyper";
+    const double extractBytes = stat(path.c_str(), &file) == 0 ? double(file.st_size) : 0;
+    const AggregationStats stats = aggregator ? aggregator->GetStats() : AggregationStats();
+    result.extra.push_back(std::make_pair("output_rows", double(aggregator ? stats.rowsOut : static_cast<size_t>(result.rows))));
+    result.extra.push_back(std::make_pair("reduction", aggregator ? stats.GetReduction() : 1.0));
+    result.extra.push_back(std::make_pair("spills", double(stats.spills)));
+    result.extra.push_back(std::make_pair("spilled_bytes", double(stats.spilledBytes)));
+    result.extra.push_back(std::make_pair("extract_mb", extractBytes / 1048576.0));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Preview Benchmarks
+//------------------------------------------------------------------------------
+//  Loads the FEED_FILES CSV files into one extract like csv_schema_plan while
+//  a RecordSampler keeps a uniform sample of PREVIEW_ROWS rows, or one of
+//  PREVIEW_STRATUM_ROWS rows per product. The preview extract is published
+//  once the last file has been read and before the full extract is closed.
+//  Compare the seconds against csv_schema_plan to see the sampling cost.
+const size_t PREVIEW_ROWS = 10000;
+const size_t PREVIEW_STRATUM_ROWS = 20;
+
+BenchmarkResult RunPreviewFeed(const BenchmarkOptions& options, const std::string& name, bool stratified)
+{
+    const std::vector<std::string> inputs = WriteFeedFiles(options, name);
+    const SchemaFile schema = SchemaFile::Parse(FEED_SCHEMA, "FEED_SCHEMA");
+
+    BenchmarkResult result;
+    Extract extract(ExtractPath(options, name));
+    TableDefinition tableDefinition;
+    AddColumns(tableDefinition, schema.GetColumns());
+    std::shared_ptr<Table> table = extract.AddTable(schema.GetTableName(), tableDefinition);
+    FeedLoader loader(schema);
+    RecordSampler sample(stratified ? PREVIEW_STRATUM_ROWS : PREVIEW_ROWS, stratified ? 2 : -1);
+    long rejected = 0;
+
+    Stopwatch insertTime;
+    for (const std::string& input : inputs)
+    {
+        const LoadStats stats = loader.Load(input, *table, tableDefinition, CancellationToken(), &sample);
+        result.rows += static_cast<long>(stats.rows);
+        rejected += static_cast<long>(stats.rejected);
+    }
+    const double readSeconds = insertTime.Seconds();
+    const uint64_t previewRows = loader.PublishPreview(sample, ExtractPath(options, name + "-preview"));
+    const double previewSeconds = insertTime.Seconds();
+    result.insertSeconds = readSeconds;
+
+    Stopwatch closeTime;
+    extract.Close();
+    result.closeSeconds = closeTime.Seconds();
+    for (const std::string& input : inputs)
+    {
+        std::remove(input.c_str());
+    }
+    result.cells = result.rows * static_cast<long>(schema.GetFields().size());
+    result.extra.push_back(std::make_pair("rejected", double(rejected)));
+    result.extra.push_back(std::make_pair("preview_rows", double(previewRows)));
+    result.extra.push_back(std::make_pair("strata", double(sample.GetStrataCount())));
+    result.extra.push_back(std::make_pair("preview_ready_seconds", previewSeconds));
+    result.extra.push_back(std::make_pair("full_ready_seconds", previewSeconds + result.closeSeconds));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Fan-Out Benchmarks
+//------------------------------------------------------------------------------
+//  Loads the FEED_FILES CSV files into three extracts: the orders of
+//  FEED_SCHEMA, a sales table whose Customer column uses another collation,
+//  and a shipping table. The reread variant runs a FeedLoader per extract, so
+//  every file is read and converted three times; the single pass variant runs
+//  one FanOutLoader, which converts each field once and writes the three
+//  extracts on their own threads.
+const char* const FANOUT_SALES_SCHEMA =
+    "table Sales\n"
+    "null \"\" NULL\n"
+    "column Customer UnicodeString collation=Binary source=customer\n"
+    "column Product CharString source=product\n"
+    "column Amount Double source=amount\n";
+
+const char* const FANOUT_SHIPPING_SCHEMA =
+    "table Shipping\n"
+    "null \"\" NULL\n"
+    "column Product CharString source=product\n"
+    "column Quantity Integer source=quantity\n"
+    "column Returned Boolean source=returned\n"
+    "column \"Ship Date\" Date source=ship_date\n";
+
+BenchmarkResult RunFanOut(const BenchmarkOptions& options, const std::string& name, bool singlePass)
+{
+    const std::vector<std::string> inputs = WriteFeedFiles(options, name);
+    const std::vector<SchemaFile> schemas = {
+        SchemaFile::Parse(FEED_SCHEMA, "FEED_SCHEMA"),
+        SchemaFile::Parse(FANOUT_SALES_SCHEMA, "FANOUT_SALES_SCHEMA"),
+        SchemaFile::Parse(FANOUT_SHIPPING_SCHEMA, "FANOUT_SHIPPING_SCHEMA"),
+    };
+    std::vector<std::wstring> paths;
+    for (size_t i = 0; i < schemas.size(); ++i)
+    {
+        paths.push_back(ExtractPath(options, name + "-" + std::to_string(i)));
+    }
+
+    BenchmarkResult result;
+    long rejected = 0;
+    long conversions = 0;
+    Stopwatch loadTime;
+    if (singlePass)
+    {
+        FanOutLoader loader;
+        for (size_t i = 0; i < schemas.size(); ++i)
+        {
+            loader.AddOutput(schemas[i], paths[i]);
+        }
+        const std::vector<LoadStats> stats = loader.Load(inputs);
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            result.rows += static_cast<long>(stats[i].rows);
+            result.cells += static_cast<long>(stats[i].rows * schemas[i].GetFields().size());
+            rejected += static_cast<long>(stats[i].rejected);
+        }
+        conversions = static_cast<long>(loader.GetConversionCount());
+    }
+    else
+    {
+        PlanCache cache;
+        for (size_t i = 0; i < schemas.size(); ++i)
+        {
+            Extract extract(paths[i]);
+            TableDefinition tableDefinition;
+            AddColumns(tableDefinition, schemas[i].GetColumns());
+            std::shared_ptr<Table> table = extract.AddTable(schemas[i].GetTableName(), tableDefinition);
+            for (const std::string& input : inputs)
+            {
+                const LoadStats stats = FeedLoader(schemas[i], cache).Load(input, *table, tableDefinition);
+                result.rows += static_cast<long>(stats.rows);
+                result.cells += static_cast<long>(stats.rows * schemas[i].GetFields().size());
+                rejected += static_cast<long>(stats.rejected);
+            }
+            table.reset();
+            extract.Close();
+            conversions += static_cast<long>(schemas[i].GetFields().size());
+        }
+    }
+    // The extracts are closed inside the load, so the close is part of it.
+    result.insertSeconds = loadTime.Seconds();
+
+    for (const std::string& input : inputs)
+    {
+        std::remove(input.c_str());
+    }
+    result.extra.push_back(std::make_pair("extracts", double(schemas.size())));
+    result.extra.push_back(std::make_pair("rejected", double(rejected)));
+    result.extra.push_back(std::make_pair("conversions_per_record", double(conversions)));
+    return result;
+}
+
+//------------------------------------------------------------------------------
+//  Benchmark Registry
+//------------------------------------------------------------------------------
+std::vector<Benchmark> AllBenchmarks()
+{
+    return {
+        {"unicode_low_cardinality", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, 2000, false); }},
+        {"unicode_low_cardinality_interned", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, 2000, true); }},
+        {"unicode_mid_cardinality", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, 5000, false); }},
+        {"unicode_mid_cardinality_interned", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, 5000, true); }},
+        {"unicode_high_cardinality", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, o.rows, false); }},
+        {"unicode_high_cardinality_interned", [](const BenchmarkOptions& o, const std::string& n) { return RunUnicodeStrings(o, n, o.rows, true); }},
+        {"wide_dimension", [](const BenchmarkOptions& o, const std::string& n) { return RunWideDimension(o, n, false); }},
+        {"wide_dimension_sticky", [](const BenchmarkOptions& o, const std::string& n) { return RunWideDimension(o, n, true); }},
+        {"unsorted_insert", [](const BenchmarkOptions& o, const std::string& n) { return RunSortedInsert(o, n, false); }},
+        {"sorted_insert", [](const BenchmarkOptions& o, const std::string& n) { return RunSortedInsert(o, n, true); }},
+        {"events", [](const BenchmarkOptions& o, const std::string& n) { return RunDedup(o, n, false); }},
+        {"events_dedup", [](const BenchmarkOptions& o, const std::string& n) { return RunDedup(o, n, true); }},
+        {"partitioned_all_open", [](const BenchmarkOptions& o, const std::string& n) { return RunPartitioned(o, n, PARTITION_TENANTS); }},
+        {"partitioned_lru", [](const BenchmarkOptions& o, const std::string& n) { return RunPartitioned(o, n, PARTITION_TENANTS / 4); }},
+        {"rotating_close_async", RunRotatingClose},
+        {"mixed_jobs_fixed_pool", [](const BenchmarkOptions& o, const std::string& n) { return RunMixedJobs(o, n, false); }},
+        {"mixed_jobs_work_stealing", [](const BenchmarkOptions& o, const std::string& n) { return RunMixedJobs(o, n, true); }},
+        {"generate_only", [](const BenchmarkOptions& o, const std::string& n) { return RunSynthetic(o, n, false); }},
+        {"generated_insert", [](const BenchmarkOptions& o, const std::string& n) { return RunSynthetic(o, n, true); }},
+        {"direct_output", [](const BenchmarkOptions& o, const std::string& n) { return RunStagedOutput(o, n, false); }},
+        {"staged_output", [](const BenchmarkOptions& o, const std::string& n) { return RunStagedOutput(o, n, true); }},
+        {"csv_interpreted", [](const BenchmarkOptions& o, const std::string& n) { return RunSchemaFeed(o, n, false); }},
+        {"csv_schema_plan", [](const BenchmarkOptions& o, const std::string& n) { return RunSchemaFeed(o, n, true); }},
+        {"csv_deadline", RunDeadlineFeed},
+        {"struct_runtime_mapping", [](const BenchmarkOptions& o, const std::string& n) { return RunStructBinding(o, n, false); }},
+        {"struct_row_binding", [](const BenchmarkOptions& o, const std::string& n) { return RunStructBinding(o, n, true); }},
+        {"range_insert_serial", [](const BenchmarkOptions& o, const std::string& n) { return RunRangeInsert(o, n, false); }},
+        {"range_insert_parallel", [](const BenchmarkOptions& o, const std::string& n) { return RunRangeInsert(o, n, true); }},
+        {"feeds_blocking", [](const BenchmarkOptions& o, const std::string& n) { return RunFeedConnections(o, n, false); }},
+#ifdef __cpp_impl_coroutine
+        {"feeds_coroutine", [](const BenchmarkOptions& o, const std::string& n) { return RunFeedConnections(o, n, true); }},
+#endif
+        {"star_denormalized", [](const BenchmarkOptions& o, const std::string& n) { return RunStarSchema(o, n, false); }},
+        {"star_schema", [](const BenchmarkOptions& o, const std::string& n) { return RunStarSchema(o, n, true); }},
+        {"progress_unmonitored", [](const BenchmarkOptions& o, const std::string& n) { return RunProgress(o, n, false); }},
+        {"progress_monitored", [](const BenchmarkOptions& o, const std::string& n) { return RunProgress(o, n, true); }},
+        {"fixed_width_serial", [](const BenchmarkOptions& o, const std::string& n) { return RunFixedWidth(o, n, false); }},
+        {"fixed_width_parallel", [](const BenchmarkOptions& o, const std::string& n) { return RunFixedWidth(o, n, true); }},
+        {"ndjson_scalar_scan", [](const BenchmarkOptions& o, const std::string& n) { return RunJsonLines(o, n, false); }},
+        {"ndjson_simd_scan", [](const BenchmarkOptions& o, const std::string& n) { return RunJsonLines(o, n, true); }},
+        {"projection_csv_all_fields", [](const BenchmarkOptions& o, const std::string& n) { return RunProjection(o, n, false, false); }},
+        {"projection_csv", [](const BenchmarkOptions& o, const std::string& n) { return RunProjection(o, n, false, true); }},
+        {"projection_ndjson_keys_last", [](const BenchmarkOptions& o, const std::string& n) { return RunProjection(o, n, true, false); }},
+        {"projection_ndjson_keys_first", [](const BenchmarkOptions& o, const std::string& n) { return RunProjection(o, n, true, true); }},
+        {"rollup_raw_events", [](const BenchmarkOptions& o, const std::string& n) { return RunRollup(o, n, 0); }},
+        {"rollup_hourly_serial", [](const BenchmarkOptions& o, const std::string& n) { return RunRollup(o, n, 1); }},
+        {"rollup_hourly_parallel", [](const BenchmarkOptions& o, const std::string& n) { return RunRollup(o, n, std::max(1u, std::thread::hardware_concurrency())); }},
+        {"csv_preview_uniform", [](const BenchmarkOptions& o, const std::string& n) { return RunPreviewFeed(o, n, false); }},
+        {"csv_preview_stratified", [](const BenchmarkOptions& o, const std::string& n) { return RunPreviewFeed(o, n, true); }},
+        {"fanout_reread", [](const BenchmarkOptions& o, const std::string& n) { return RunFanOut(o, n, false); }},
+        {"fanout_single_pass", [](const BenchmarkOptions& o, const std::string& n) { return RunFanOut(o, n, true); }},
+    };
+}
+
+//------------------------------------------------------------------------------
+//  Display Usage
+//------------------------------------------------------------------------------
+void DisplayUsage()
+{
+    std::cerr << "Throughput benchmarks for the Tableau Extract API:" << std::endl
+              << std::endl
+              << "USAGE: tableauSDKBenchmark-cpp [OPTIONS]" << std::endl
+              << std::endl
+              << "OPTIONS:" << std::endl
+              << " -h, --help            Show this help message and exit" << std::endl
+              << std::endl
+              << " -l, --list            List the available benchmarks and exit" << std::endl
+              << std::endl
+              << " -r ROWS, --rows ROWS  Number of rows per benchmark (default=1000000)" << std::endl
+              << std::endl
+              << " -m MB, --memory MB    Memory budget of buffering stages in MiB (default=64)" << std::endl
+              << std::endl
+              << " -o DIR, --output DIR  Directory for the benchmark extracts and temporary files (default='.')" << std::endl
+              << std::endl
+              << " -s DIR, --staging DIR Directory to build staged extracts in, e.g. on tmpfs (default=output directory)" << std::endl
+              << std::endl
+              << " -n N, --repetitions N Run every benchmark N times (default=1)" << std::endl
+              << std::endl
+              << " -b NAME, --benchmark NAME" << std::endl
+              << "                       Only run benchmarks whose name contains NAME" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+//  Main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-l") || !strcmp(argv[i], "--list"))
+        {
+            for (const Benchmark& benchmark : AllBenchmarks())
+            {
+                std::cout << benchmark.name << std::endl;
+            }
+            exit(EXIT_SUCCESS);
+        }
+        else if ((!strcmp(argv[i], "-r") || !strcmp(argv[i], "--rows")) && hasValue)
+        {
+            options.rows = std::atol(argv[++i]);
+        }
+        else if ((!strcmp(argv[i], "-m") || !strcmp(argv[i], "--memory")) && hasValue)
+        {
+            options.memoryBudget = static_cast<size_t>(std::atol(argv[++i])) << 20;
+        }
+        else if ((!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) && hasValue)
+        {
+            options.outputDir = argv[++i];
+        }
+        else if ((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--staging")) && hasValue)
+        {
+            options.stagingDir = argv[++i];
+        }
+        else if ((!strcmp(argv[i], "-n") || !strcmp(argv[i], "--repetitions")) && hasValue)
+        {
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        }
+        else if ((!strcmp(argv[i], "-b") || !strcmp(argv[i], "--benchmark")) && hasValue)
+        {
+            options.filter = argv[++i];
+        }
+        else
+        {
+            DisplayUsage();
+            exit(strcmp(argv[i], "-h") && strcmp(argv[i], "--help") ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+    }
+
+    try
+    {
+        ExtractAPI::Initialize();
+        for (const Benchmark& benchmark : AllBenchmarks())
+        {
+            if (std::string(benchmark.name).find(options.filter) == std::string::npos)
+            {
+                continue;
+            }
+            for (int repetition = 0; repetition < options.repetitions; ++repetition)
+            {
+                ResetPeakRss();
+                PrintResult(benchmark.name, repetition, benchmark.run(options, benchmark.name));
+            }
+        }
+        ExtractAPI::Cleanup();
+    }
+    catch (const TableauException& e)
+    {
+        std::wcerr << L"A fatal error occurred while running the benchmarks: " << std::endl
+                   << e.GetMessage() << std::endl
+                   << L"Exiting Now." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
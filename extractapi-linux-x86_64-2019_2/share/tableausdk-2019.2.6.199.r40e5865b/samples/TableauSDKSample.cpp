@@ -10,16 +10,22 @@
 //------------------------------------------------------------------------------
 #if defined(__APPLE__) && defined(__MACH__)
 #include <TableauHyperExtract/TableauHyperExtract_cpp.h>
+#include <TableauHyperExtract/TableauDataGenerator_cpp.h>
 #else
 #include "TableauHyperExtract_cpp.h"
+#include "TableauDataGenerator_cpp.h"
 #endif
 
+#include <algorithm>
+#include <cerrno>
 #include <codecvt>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <locale>
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace Tableau;
 
@@ -53,7 +59,11 @@ void DisplayUsage()
               << std::endl
               << " -f FILENAME, --filename FILENAME" << std::endl
               << "                       FILENAME of the extract to be created or extended." << std::endl
-              << "                       (default='order-cpp.hyper')" << std::endl;
+              << "                       (default='order-cpp.hyper')" << std::endl
+              << std::endl
+              << " -g N, --generate N    Insert N rows of seeded synthetic data instead of the 10 sample rows." << std::endl
+              << "                       The same N always produces the same rows." << std::endl
+              << "                       (default=0)" << std::endl;
 }
 
 //------------------------------------------------------------------------------
@@ -98,6 +108,23 @@ bool ParseArguments(int argc, char* argv[], std::map<std::string, std::wstring>&
             }
             options[std::string("filename")] = converter.from_bytes(argv[++i]);
         }
+        else if (!strcmp(argv[i], "-g") || !strcmp(argv[i], "--generate"))
+        {
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            //  A non-negative row count that fits a long
+            const char* value = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            std::strtol(value, &end, 10);
+            if (*value < '0' || *value > '9' || *end != '\0' || errno == ERANGE)
+            {
+                return false;
+            }
+            options[std::string("generate")] = converter.from_bytes(value);
+        }
         else
         {
             return false;
@@ -191,14 +218,89 @@ std::shared_ptr<Extract> CreateExtract(const std::wstring& fileName, const bool
     return extractPtr;
 }
 
+//------------------------------------------------------------------------------
+//  Generate Rows
+//------------------------------------------------------------------------------
+//  Inserts `rowCount` rows of synthetic data into the `Extract`/`Products`
+//  table: a skewed product mix, prices and quantities in realistic ranges,
+//  purchases between 2010 and 2019 and a few missing expiration dates.
+void GenerateRows(Table& table, TableDefinition& schema, long rowCount, bool createMultipleTables)
+{
+    const std::vector<ColumnSpec> columns = GetColumns(schema);
+    DataGenerator generator(columns, 42);
+
+    ColumnProfile purchased;
+    purchased.minYear = 2010;
+    purchased.maxYear = 2019;
+    generator.SetProfile(0, purchased);
+
+    ColumnProfile product;
+    product.cardinality = 500;
+    product.zipfSkew = 1.1;
+    product.minLength = 3;
+    product.maxLength = 20;
+    generator.SetProfile(1, product);
+    generator.SetProfile(2, product);
+    generator.SetProfile(7, product);
+
+    ColumnProfile price;
+    price.minValue = 0.5;
+    price.maxValue = 200;
+    generator.SetProfile(3, price);
+
+    ColumnProfile quantity;
+    quantity.minValue = 1;
+    quantity.maxValue = 100;
+    generator.SetProfile(4, quantity);
+
+    ColumnProfile expiration;
+    expiration.nullRatio = 0.05;
+    expiration.minYear = 2020;
+    expiration.maxYear = 2030;
+    generator.SetProfile(6, expiration);
+
+    if (createMultipleTables)
+    {
+        ColumnProfile supplierKey;
+        supplierKey.cardinality = 3;
+        generator.SetProfile(generator.GetColumnCount() - 1, supplierKey);
+    }
+
+    Row row(schema);
+    std::vector<ValueRow> batch;
+    const long batchRows = 4096;
+    for (long first = 0; first < rowCount; first += batchRows)
+    {
+        generator.Generate(first, static_cast<size_t>(std::min(batchRows, rowCount - first)), batch);
+        for (const ValueRow& values : batch)
+        {
+            for (int c = 0; c < generator.GetColumnCount(); ++c)
+            {
+                values[c].SetInRow(row, c);
+            }
+            table.Insert(row);
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 //  Populate Extract
 //------------------------------------------------------------------------------
-void PopulateExtract(const std::shared_ptr<Extract> extractPtr, bool useSpatial, bool createMultipleTables)
+void PopulateExtract(const std::shared_ptr<Extract> extractPtr, bool useSpatial, bool createMultipleTables, long generateRows)
 {
     try
     {
+        // Populate `Extract`/`Products` table with synthetic data
+        if (generateRows > 0)
+        {
+            auto tableName = createMultipleTables ? L"Products" : L"Extract";
+            std::shared_ptr<Table> tablePtr = extractPtr->OpenTable(tableName);
+            std::shared_ptr<Tableau::TableDefinition> schema = tablePtr->GetTableDefinition();
+            GenerateRows(*tablePtr, *schema, generateRows, createMultipleTables);
+        }
+
         // Populate `Extract`/`Products` table
+        else
         {
             //  Get Schema
             auto tableName = createMultipleTables ? L"Products" : L"Extract";
@@ -277,7 +379,8 @@ int main(int argc, char* argv[])
         //  Create or Expand the Extract
         std::shared_ptr<Extract> extractPtr = nullptr;
         extractPtr = std::move(CreateExtract(options["filename"], options.count("spatial") > 0, options.count("multitable") > 0));
-        PopulateExtract(extractPtr, options.count("spatial") > 0, options.count("multitable") > 0);
+        const long generateRows = options.count("generate") ? std::stol(options["generate"]) : 0;
+        PopulateExtract(extractPtr, options.count("spatial") > 0, options.count("multitable") > 0, generateRows);
 
         //  Flush the Extract to Disk
         extractPtr->Close();
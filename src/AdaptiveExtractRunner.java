@@ -0,0 +1,171 @@
+import java.io.File;
+import java.io.IOException;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.util.UUID;
+import java.util.concurrent.Semaphore;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicReference;
+import java.util.concurrent.atomic.LongAdder;
+
+import com.tableausoftware.TableauException;
+import com.tableausoftware.hyperextract.ExtractAPI;
+
+/**
+ * Writes many extracts with a number of concurrent writers that is adjusted
+ * while the job runs.
+ * <p>
+ * Unlike {@link StresstestExtractAPI}, which starts a fixed
+ * <code>NUM_RUNNERS</code> writers, this runner measures the aggregate rows/sec,
+ * the CPU load and the disk queue depth every interval and lets a
+ * {@link ConcurrencyController} grow or shrink the number of writers until it
+ * finds the level with the highest throughput on this machine.
+ * <p>
+ * Usage: <code>AdaptiveExtractRunner [extracts [rowsPerExtract [maxWriters]]]</code>
+ */
+public class AdaptiveExtractRunner {
+
+	private static final int DEFAULT_EXTRACTS = 1000;
+	private static final int DEFAULT_ROWS_PER_EXTRACT = 100000;
+	private static final long INTERVAL_MILLIS = 2000;
+
+	/** Average disk queue depth above which the disks are considered congested */
+	private static final double MAX_DISK_QUEUE = 8;
+
+	private AdaptiveExtractRunner() {
+	}
+
+	public static void main(String[] args) throws IOException, InterruptedException, TableauException {
+		final int extracts = args.length > 0 ? Integer.parseInt(args[0]) : DEFAULT_EXTRACTS;
+		final int rowsPerExtract = args.length > 1 ? Integer.parseInt(args[1]) : DEFAULT_ROWS_PER_EXTRACT;
+		final int maxWriters = args.length > 2 ? Integer.parseInt(args[2])
+				: 4 * Runtime.getRuntime().availableProcessors();
+
+		ExtractAPI.initialize();
+		run(extracts, rowsPerExtract, maxWriters);
+		ExtractAPI.cleanup();
+	}
+
+	private static void run(final int extracts, final int rowsPerExtract, final int maxWriters)
+			throws IOException, InterruptedException {
+		final String tmpDir = Files.createTempDirectory("tableau-test-" + UUID.randomUUID().toString()).toAbsolutePath()
+				.toString();
+		System.out.println("Temp dir is " + tmpDir);
+
+		final ConcurrencyController controller = new ConcurrencyController(1, 1, maxWriters, MAX_DISK_QUEUE);
+		final ResizableSemaphore permits = new ResizableSemaphore(controller.getLevel());
+		final AtomicInteger nextExtract = new AtomicInteger();
+		final AtomicInteger extractsWritten = new AtomicInteger();
+		final AtomicReference<Throwable> failure = new AtomicReference<>();
+		final LongAdder rowsWritten = new LongAdder();
+
+		// Start the largest number of writers; the permits decide how many of them run
+		final Thread[] writers = new Thread[maxWriters];
+		for (int i = 0; i < maxWriters; i++) {
+			writers[i] = new Thread(new Writer(tmpDir, extracts, rowsPerExtract, permits, nextExtract,
+					extractsWritten, rowsWritten, failure), "extract-writer-" + i);
+			writers[i].setDaemon(true);
+			writers[i].start();
+		}
+
+		// Measure and adjust until all extracts are written
+		final SystemMonitor monitor = new SystemMonitor();
+		final long start = System.nanoTime();
+		long lastRows = 0;
+		long lastNanos = start;
+		while (extractsWritten.get() < extracts && failure.get() == null) {
+			Thread.sleep(INTERVAL_MILLIS);
+			final long rows = rowsWritten.sum();
+			final long now = System.nanoTime();
+			final double rowsPerSecond = (rows - lastRows) * 1e9 / (now - lastNanos);
+			final double cpuLoad = monitor.getCpuLoad();
+			final double diskQueue = monitor.sampleDiskQueue();
+			lastRows = rows;
+			lastNanos = now;
+
+			final int level = controller.getLevel();
+			final int newLevel = controller.update(rowsPerSecond, cpuLoad, diskQueue);
+			permits.resize(level, newLevel);
+			System.out.println(String.format(
+					"writers=%d rows/sec=%.0f cpu=%.2f diskQueue=%.2f extracts=%d/%d -> writers=%d%s", level,
+					rowsPerSecond, cpuLoad, diskQueue, extractsWritten.get(), extracts, newLevel,
+					controller.isConverged() ? " (converged)" : ""));
+		}
+
+		final double seconds = (System.nanoTime() - start) / 1e9;
+		System.out.println(String.format("Wrote %d rows in %.1f s (%.0f rows/sec), best level %d writers",
+				rowsWritten.sum(), seconds, rowsWritten.sum() / seconds, controller.getBestLevel()));
+		if (failure.get() != null) {
+			System.out.println("A writer failed:");
+			failure.get().printStackTrace();
+		}
+	}
+
+	/** A semaphore whose number of permits can be lowered as well as raised */
+	private static class ResizableSemaphore extends Semaphore {
+		private static final long serialVersionUID = 1L;
+
+		ResizableSemaphore(final int permits) {
+			super(permits);
+		}
+
+		void resize(final int oldPermits, final int newPermits) {
+			if (newPermits > oldPermits) {
+				release(newPermits - oldPermits);
+			} else if (newPermits < oldPermits) {
+				// Running writers finish their extract before the lower level takes effect
+				reducePermits(oldPermits - newPermits);
+			}
+		}
+	}
+
+	/** Writes extracts until all are taken, one at a time while it holds a permit */
+	private static class Writer implements Runnable {
+		private final String tmpDir;
+		private final int extracts;
+		private final int rowsPerExtract;
+		private final Semaphore permits;
+		private final AtomicInteger nextExtract;
+		private final AtomicInteger extractsWritten;
+		private final LongAdder rowsWritten;
+		private final AtomicReference<Throwable> failure;
+
+		Writer(final String tmpDir, final int extracts, final int rowsPerExtract, final Semaphore permits,
+				final AtomicInteger nextExtract, final AtomicInteger extractsWritten, final LongAdder rowsWritten,
+				final AtomicReference<Throwable> failure) {
+			this.tmpDir = tmpDir;
+			this.extracts = extracts;
+			this.rowsPerExtract = rowsPerExtract;
+			this.permits = permits;
+			this.nextExtract = nextExtract;
+			this.extractsWritten = extractsWritten;
+			this.rowsWritten = rowsWritten;
+			this.failure = failure;
+		}
+
+		@Override
+		public void run() {
+			try {
+				while (true) {
+					permits.acquire();
+					try {
+						final int i = nextExtract.getAndIncrement();
+						if (i >= extracts) {
+							return;
+						}
+						final String destination = tmpDir + File.separator + "extract" + i + ".hyper";
+						Utils.writeHyperFile(destination, rowsPerExtract, rowsWritten);
+						Files.delete(Paths.get(destination));
+						extractsWritten.incrementAndGet();
+					} finally {
+						permits.release();
+					}
+				}
+			} catch (final InterruptedException e) {
+				Thread.currentThread().interrupt();
+			} catch (final TableauException | IOException | RuntimeException e) {
+				failure.compareAndSet(null, e);
+			}
+		}
+	}
+}
@@ -0,0 +1,139 @@
+/**
+ * Chooses the number of concurrent extract writers by hill climbing on the
+ * measured throughput, with a multiplicative decrease when the machine shows
+ * congestion (AIMD).
+ * <p>
+ * After every measurement interval the controller is told the aggregate
+ * rows/sec at the current level. While throughput improves it keeps moving the
+ * level one step in the same direction; when it drops, it turns around. When
+ * the CPU is saturated or the disk queue is deep and throughput did not
+ * improve, it cuts the level by a quarter. Once the level has bounced between
+ * neighbours for a few intervals it settles on the best level seen and only
+ * probes a neighbour every few intervals, to follow changes in the load.
+ */
+class ConcurrencyController {
+
+	/** Relative change of throughput that counts as better or worse */
+	private static final double TOLERANCE = 0.05;
+
+	/** CPU load (0..1) above which the machine is considered saturated */
+	private static final double CPU_SATURATED = 0.95;
+
+	/** Number of direction changes after which the level is considered converged */
+	private static final int REVERSALS_TO_CONVERGE = 3;
+
+	/** Number of intervals between probes once converged */
+	private static final int PROBE_INTERVAL = 10;
+
+	private final int minLevel;
+	private final int maxLevel;
+	private final double maxDiskQueue;
+
+	private int level;
+	private int direction = 1;
+	private double lastThroughput = -1;
+	private int reversals;
+	private int bestLevel;
+	private double bestThroughput = -1;
+	private int intervalsSinceProbe;
+	private boolean probing;
+
+	/**
+	 * @param initialLevel the number of writers to start with
+	 * @param minLevel     the smallest number of writers
+	 * @param maxLevel     the largest number of writers
+	 * @param maxDiskQueue the average disk queue depth above which the disks are
+	 *                     considered congested
+	 */
+	ConcurrencyController(final int initialLevel, final int minLevel, final int maxLevel, final double maxDiskQueue) {
+		this.minLevel = Math.max(1, minLevel);
+		this.maxLevel = Math.max(this.minLevel, maxLevel);
+		this.maxDiskQueue = maxDiskQueue;
+		this.level = clamp(initialLevel);
+		this.bestLevel = this.level;
+	}
+
+	/** The number of writers that should run now */
+	int getLevel() {
+		return level;
+	}
+
+	/** The level with the highest throughput seen so far */
+	int getBestLevel() {
+		return bestLevel;
+	}
+
+	/** True once the controller stopped climbing and only probes occasionally */
+	boolean isConverged() {
+		return reversals >= REVERSALS_TO_CONVERGE;
+	}
+
+	/**
+	 * Report the measurements of the last interval, taken at the current level,
+	 * and compute the next level.
+	 *
+	 * @param rowsPerSecond the aggregate throughput
+	 * @param cpuLoad       the system CPU load between 0 and 1, or a negative value
+	 *                      if unknown
+	 * @param diskQueue     the average number of queued disk requests, or a
+	 *                      negative value if unknown
+	 * @return the new level
+	 */
+	int update(final double rowsPerSecond, final double cpuLoad, final double diskQueue) {
+		if (level == bestLevel) {
+			bestThroughput = rowsPerSecond;
+		} else if (rowsPerSecond > bestThroughput * (1 + TOLERANCE)) {
+			bestLevel = level;
+			bestThroughput = rowsPerSecond;
+		}
+		final boolean congested = cpuLoad > CPU_SATURATED || (maxDiskQueue > 0 && diskQueue > maxDiskQueue);
+		final boolean better = lastThroughput < 0 || rowsPerSecond > lastThroughput * (1 + TOLERANCE);
+		final boolean worse = lastThroughput >= 0 && rowsPerSecond < lastThroughput * (1 - TOLERANCE);
+		lastThroughput = rowsPerSecond;
+
+		if (isConverged()) {
+			return settle();
+		}
+
+		if (congested && !better) {
+			// Multiplicative decrease, then climb back up additively
+			if (direction > 0) {
+				reversals++;
+			}
+			level = clamp(level - Math.max(1, level / 4));
+			direction = 1;
+		} else if (worse) {
+			reversals++;
+			direction = -direction;
+			level = clamp(level + direction);
+		} else if (better) {
+			level = clamp(level + direction);
+		} else {
+			// Plateau: more writers do not help, so prefer fewer
+			reversals++;
+			direction = -1;
+			level = clamp(level - 1);
+		}
+		return level;
+	}
+
+	private int settle() {
+		if (probing) {
+			// The probe interval has been measured; return to the best level
+			probing = false;
+			level = bestLevel;
+		} else if (++intervalsSinceProbe >= PROBE_INTERVAL) {
+			intervalsSinceProbe = 0;
+			probing = true;
+			direction = -direction;
+			level = clamp(bestLevel + direction);
+		} else {
+			level = bestLevel;
+		}
+		return level;
+	}
+
+	private int clamp(final int value) {
+		return Math.max(minLevel, Math.min(maxLevel, value));
+	}
+}
@@ -20,7 +20,7 @@ public class LongRunExtractAPI {
 	private static void longRun() throws TableauException, IOException {
 		final String tmpDir = Files.createTempDirectory("tableau-test-" + UUID.randomUUID().toString()).toAbsolutePath()
 				.toString();
-		final String destination = tmpDir + File.pathSeparator + "extract.hyper";
+		final String destination = tmpDir + File.separator + "extract.hyper";
 		long filesWritten = 0;
 		while (true) {
 			ExtractAPI.initialize();
@@ -32,7 +32,7 @@ public class StresstestExtractAPI {
 		// Run many writers
 		final Future[] futures = new Future[NUM_RUNNERS];
 		for (int i = 0; i < NUM_RUNNERS; i++) {
-			final String destination = tmpDir + File.pathSeparator + "extract" + i + ".hyper";
+			final String destination = tmpDir + File.separator + "extract" + i + ".hyper";
 			futures[i] = executor.submit(new Utils.ExtractWriter(destination));
 		}
 
@@ -0,0 +1,65 @@
+import java.io.File;
+import java.io.IOException;
+import java.lang.management.ManagementFactory;
+import java.lang.management.OperatingSystemMXBean;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+
+/**
+ * Samples the system CPU load and the average disk queue depth.
+ * <p>
+ * The disk queue depth is the growth of the weighted time spent doing I/Os
+ * (field 14 of <code>/proc/diskstats</code>) of all whole disks, divided by the
+ * elapsed time. It is only available on Linux.
+ */
+class SystemMonitor {
+
+	private static final String DISKSTATS = "/proc/diskstats";
+
+	private final OperatingSystemMXBean os = ManagementFactory.getOperatingSystemMXBean();
+
+	private long lastSampleNanos = System.nanoTime();
+	private long lastWeightedIoMillis = readWeightedIoMillis();
+
+	/** The system CPU load between 0 and 1, or -1 if the JVM does not report it */
+	double getCpuLoad() {
+		if (os instanceof com.sun.management.OperatingSystemMXBean) {
+			return ((com.sun.management.OperatingSystemMXBean) os).getSystemCpuLoad();
+		}
+		return -1;
+	}
+
+	/**
+	 * The average number of queued and running disk requests since the last call,
+	 * or -1 if unknown
+	 */
+	double sampleDiskQueue() {
+		final long now = System.nanoTime();
+		final long weightedIoMillis = readWeightedIoMillis();
+		final double elapsedMillis = (now - lastSampleNanos) / 1e6;
+		final double queue = weightedIoMillis < 0 || lastWeightedIoMillis < 0 || elapsedMillis <= 0 ? -1
+				: (weightedIoMillis - lastWeightedIoMillis) / elapsedMillis;
+		lastSampleNanos = now;
+		lastWeightedIoMillis = weightedIoMillis;
+		return queue;
+	}
+
+	private static long readWeightedIoMillis() {
+		try {
+			long total = 0;
+			for (final String line : Files.readAllLines(Paths.get(DISKSTATS))) {
+				final String[] fields = line.trim().split("\\s+");
+				// Only whole disks have a directory in /sys/block; skip partitions and
+				// virtual devices without a queue
+				if (fields.length < 14 || !new File("/sys/block/" + fields[2] + "/queue").isDirectory()
+						|| fields[2].startsWith("loop") || fields[2].startsWith("ram")) {
+					continue;
+				}
+				total += Long.parseLong(fields[13]);
+			}
+			return total;
+		} catch (final IOException | NumberFormatException e) {
+			return -1;
+		}
+	}
+}
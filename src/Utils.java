@@ -1,3 +1,5 @@
+import java.util.concurrent.atomic.LongAdder;
+
 import com.tableausoftware.TableauException;
 import com.tableausoftware.common.Collation;
 import com.tableausoftware.common.Type;
@@ -15,6 +17,15 @@ class Utils {
 
 	/** Write a hyper extract to the given file */
 	static void writeHyperFile(final String destination) throws TableauException {
+		writeHyperFile(destination, NUM_ROWS, null);
+	}
+
+	/**
+	 * Write a hyper extract with the given number of rows to the given file and
+	 * add every inserted row to <code>rowsWritten</code> if it is not null
+	 */
+	static void writeHyperFile(final String destination, final int numRows, final LongAdder rowsWritten)
+			throws TableauException {
 
 		// Create the table definition
 		final TableDefinition td = new TableDefinition();
@@ -26,10 +37,13 @@ class Utils {
 		final Table table = extract.addTable("table", td);
 
 		// Write data
-		for (int i = 0; i < NUM_ROWS; i++) {
+		for (int i = 0; i < numRows; i++) {
 			final Row row = new Row(td);
 			row.setString(0, "My string " + i);
 			table.insert(row);
+			if (rowsWritten != null) {
+				rowsWritten.increment();
+			}
 		}
 
 		// Close the extract